@@ -2,11 +2,13 @@
 #define ABSTRACTPIPELINE_H
 
 class VulkanRenderer;
+class PipelineBuilder;
 
 #include <QVulkanInstance>
 #include <QHash>
 
 #include "glm.h"
+#include "rendergraph.h"
 
 struct DescriptorPoolSizes
 {
@@ -14,6 +16,16 @@ struct DescriptorPoolSizes
     uint32_t maxSets;
 };
 
+struct CullStats
+{
+    uint32_t instances;
+    uint32_t frustumCulled;
+    uint32_t occluded;
+    uint32_t drawn;
+    // CPU time spent culling in the frame, 0 when the GPU culls
+    double cpuMs;
+};
+
 class AbstractPipeline
 {
 public:
@@ -26,15 +38,32 @@ public:
 
     virtual ~AbstractPipeline();
 
+    [[nodiscard]] virtual const char *name() const = 0;
+
     virtual void preInitResources() = 0;
     virtual void initResources() = 0;
+    virtual void describeShaderModules(PipelineBuilder &pipelineBuilder) = 0;
     virtual void initSwapChainResources() = 0;
-    [[nodiscard]] virtual DescriptorPoolSizes descriptorPoolSizes(int swapChainImageCount) const = 0;
-    virtual void updateUniformBuffers(float time, int currentSwapChainImageIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView) const = 0;
-    virtual void drawCommands(VkCommandBuffer commandBuffer, int currentSwapChainImageIndex) const = 0;
+    // Every pipeline of the swap chain, the ones of describeScenePipelines unless the pipeline has others
+    virtual void describePipelines(PipelineBuilder &pipelineBuilder) { describeScenePipelines(pipelineBuilder); }
+    // Pipelines for the scene render pass, recreated on their own when its sample count changes
+    virtual void describeScenePipelines(PipelineBuilder &pipelineBuilder) = 0;
+    virtual void releaseScenePipelines() = 0;
+    [[nodiscard]] virtual DescriptorPoolSizes descriptorPoolSizes(int frameCount) const = 0;
+    // Moves the scene nodes of the pipeline, world matrices are updated once every pipeline moved its nodes
+    virtual void updateScene(float /*time*/) {}
+    virtual void updateUniformBuffers(float time, int currentFrameIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView) = 0;
+    // Passes of the frame graph recorded before the scene pass, the graph is built once per swap chain
+    virtual void addPasses(RenderGraph & /*graph*/) {}
+    // What drawCommands reads of the resources written by addPasses
+    virtual void addSceneReads(RenderGraph::PassBuilder & /*scenePass*/) const {}
+    virtual void drawCommands(VkCommandBuffer commandBuffer, int currentFrameIndex) const = 0;
     virtual void releaseSwapChainResources() = 0;
     virtual void releaseResources() = 0;
 
+    // Pipelines which do not cull report nothing
+    [[nodiscard]] virtual CullStats cullStats() const { return {}; }
+
 protected:
     [[nodiscard]] VulkanRenderer *vulkanRenderer() const { return m_vulkanRenderer; }
 
@@ -0,0 +1,126 @@
+#include "assetpack.h"
+
+#include "cpuprofiler.h"
+#include "lz4codec.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN, "asset packs are read in place, they need a little endian host");
+
+namespace {
+const QString packFileName = QStringLiteral("vktutor2.pack");
+// Blobs are returned in a QByteArray, which is indexed with int
+constexpr uint64_t maxBlobSize = std::numeric_limits<int>::max();
+
+[[nodiscard]] QByteArray entryName(const char *names, const AssetPackEntry &entry)
+{
+    return QByteArray::fromRawData(names + entry.nameOffset, entry.nameSize);
+}
+}
+
+AssetPack::AssetPack(const QString &fileName)
+    : m_file{fileName}
+    , m_mapping{}
+    , m_size{}
+    , m_entries{}
+    , m_entryCount{}
+    , m_names{}
+{
+    PROFILE_ZONE("AssetPack::AssetPack");
+    qDebug() << "Map asset pack: " << fileName;
+    if (!m_file.open(QFile::OpenModeFlag::ReadOnly)) {
+        qDebug() << "asset pack not found: " << fileName;
+        throw std::runtime_error{"asset pack not found"};
+    }
+    m_size = m_file.size();
+    m_mapping = m_size >= static_cast<qint64>(sizeof(AssetPackHeader)) ? m_file.map(0, m_size) : nullptr;
+    if (m_mapping == nullptr) {
+        throw std::runtime_error{"can not map asset pack"};
+    }
+
+    AssetPackHeader header{};
+    std::memcpy(&header, m_mapping, sizeof(header));
+    auto size = static_cast<uint64_t>(m_size);
+    if (header.magic != assetPackMagic || header.version != assetPackVersion
+            || header.entryCount > (size - sizeof(header)) / sizeof(AssetPackEntry)
+            || header.namesOffset < sizeof(header) + header.entryCount * sizeof(AssetPackEntry)
+            || header.namesOffset > size || header.namesSize > size - header.namesOffset) {
+        throw std::runtime_error{"not an asset pack of this version"};
+    }
+    // The header keeps the table aligned
+    m_entries = reinterpret_cast<const AssetPackEntry *>(m_mapping + sizeof(header));
+    m_entryCount = header.entryCount;
+    m_names = reinterpret_cast<const char *>(m_mapping + header.namesOffset);
+    for (uint32_t i = 0; i < m_entryCount; ++i) {
+        const auto &entry = m_entries[i];
+        if (uint64_t{entry.nameOffset} + entry.nameSize > header.namesSize || entry.offset > size || entry.storedSize > size - entry.offset
+                || entry.size > maxBlobSize || entry.storedSize > maxBlobSize
+                || (entry.codec == static_cast<uint16_t>(Codec::NONE) && entry.storedSize != entry.size)
+                || entry.codec > static_cast<uint16_t>(Codec::LZ4)
+                || (i > 0 && !(entryName(m_names, m_entries[i - 1]) < entryName(m_names, entry)))) {
+            throw std::runtime_error{"corrupt asset pack table of contents"};
+        }
+    }
+    qDebug() << "Asset pack entries: " << m_entryCount << ", bytes: " << m_size;
+}
+
+AssetPack::~AssetPack()
+{
+    // Closing the file unmaps it, the data returned for uncompressed blobs dies with it
+    m_file.close();
+}
+
+AssetPack &AssetPack::instance()
+{
+    static AssetPack assetPack{QDir{QCoreApplication::applicationDirPath()}.filePath(packFileName)};
+    return assetPack;
+}
+
+uint64_t AssetPack::contentHash(const QString &fileName)
+{
+    QFile file{fileName};
+    AssetPackHeader header{};
+    if (!file.open(QFile::OpenModeFlag::ReadOnly)
+            || file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header)
+            || header.magic != assetPackMagic || header.version != assetPackVersion) {
+        return 0;
+    }
+    return header.contentHash;
+}
+
+const AssetPackEntry *AssetPack::find(const QString &name) const
+{
+    auto key = name.toUtf8();
+    const auto *end = m_entries + m_entryCount;
+    const auto *entry = std::lower_bound(m_entries, end, key, [this](const AssetPackEntry &entry, const QByteArray &key) {
+        return entryName(m_names, entry) < key;
+    });
+    return entry != end && entryName(m_names, *entry) == key ? entry : nullptr;
+}
+
+bool AssetPack::contains(const QString &name) const
+{
+    return find(name) != nullptr;
+}
+
+QByteArray AssetPack::data(const QString &name) const
+{
+    PROFILE_ZONE("AssetPack::data");
+    const auto *entry = find(name);
+    if (entry == nullptr) {
+        qDebug() << "asset not found: " << name;
+        throw std::runtime_error{"asset not found"};
+    }
+    const auto *blob = reinterpret_cast<const char *>(m_mapping + entry->offset);
+    if (entry->codec == static_cast<uint16_t>(Codec::LZ4)) {
+        return lz4Decompress(blob, static_cast<qint64>(entry->storedSize), static_cast<qint64>(entry->size));
+    }
+    return QByteArray::fromRawData(blob, static_cast<int>(entry->size));
+}
@@ -0,0 +1,85 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <cstdint>
+
+// Assets of the application in one file next to the executable, written by vktutor2_cook at build time and memory
+// mapped instead of compiled in. Pages are read by the first access to them and shared with every other process
+// mapping the same pack. Layout: header, table of contents sorted by name, names, then the blobs, each one starting on
+// a page of its own. Multi byte values are little endian.
+constexpr uint32_t assetPackMagic = 0x4b504b56U; // "VKPK"
+constexpr uint32_t assetPackVersion = 1;
+constexpr uint64_t assetPackBlobAlignment = 4096;
+
+struct AssetPackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    // Covers the names and contents of the packed files, the cooker leaves a pack with the same hash untouched
+    uint64_t contentHash;
+    uint32_t entryCount;
+    uint32_t namesSize;
+    // The table of contents follows the header, the names follow the table
+    uint64_t namesOffset;
+};
+
+struct AssetPackEntry
+{
+    uint64_t offset;
+    // Bytes in the pack, less than size when the codec compressed the blob
+    uint64_t storedSize;
+    uint64_t size;
+    // Into the names, UTF-8 without a terminator
+    uint32_t nameOffset;
+    uint16_t nameSize;
+    uint16_t codec;
+};
+
+static_assert(sizeof(AssetPackHeader) == 32, "asset pack header must not be padded");
+static_assert(sizeof(AssetPackEntry) == 32, "asset pack entry must not be padded");
+
+class AssetPack
+{
+public:
+    enum class Codec : int
+    {
+        NONE = 0,
+        LZ4 = 1
+    };
+
+    // Maps the file and checks the table of contents, the blobs are not touched until they are looked up
+    explicit AssetPack(const QString &fileName);
+
+    AssetPack(const AssetPack &) = delete;
+    AssetPack(AssetPack &&) = delete;
+    AssetPack &operator=(const AssetPack &) = delete;
+    AssetPack &operator=(AssetPack &&) = delete;
+
+    ~AssetPack();
+
+    // vktutor2.pack in the directory of the executable, opened by the first call
+    [[nodiscard]] static AssetPack &instance();
+    // Hash stored in the pack, 0 when the file is missing or not a pack of the current version
+    [[nodiscard]] static uint64_t contentHash(const QString &fileName);
+
+    [[nodiscard]] bool contains(const QString &name) const;
+    // An uncompressed blob refers to the mapping without a copy and stays valid as long as the pack, a compressed one
+    // is decoded into memory of its own. Throws when the pack has no such asset.
+    [[nodiscard]] QByteArray data(const QString &name) const;
+
+private:
+    QFile m_file;
+    const uchar *m_mapping;
+    qint64 m_size;
+    const AssetPackEntry *m_entries;
+    uint32_t m_entryCount;
+    const char *m_names;
+
+    [[nodiscard]] const AssetPackEntry *find(const QString &name) const;
+};
+
+#endif // ASSETPACK_H
@@ -0,0 +1,143 @@
+#include "benchmark.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QSysInfo>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <utility>
+
+namespace {
+constexpr int64_t maxIterations = 1'000'000'000;
+constexpr int growthFactor = 10;
+}
+
+BenchmarkState::BenchmarkState(int64_t iterations)
+    : m_iterations{iterations}
+    , m_remaining{iterations}
+    , m_elapsedNs{}
+    , m_itemsPerIteration{}
+    , m_running{}
+    , m_timer{}
+{
+}
+
+bool BenchmarkState::keepRunning()
+{
+    if (!m_running && m_remaining == m_iterations) {
+        m_running = true;
+        m_timer.start();
+    }
+    if (m_remaining-- > 0) {
+        return true;
+    }
+    pauseTiming();
+    return false;
+}
+
+void BenchmarkState::pauseTiming()
+{
+    if (m_running) {
+        m_elapsedNs += m_timer.nsecsElapsed();
+        m_running = false;
+    }
+}
+
+void BenchmarkState::resumeTiming()
+{
+    if (!m_running) {
+        m_running = true;
+        m_timer.start();
+    }
+}
+
+void BenchmarkRegistry::add(const QString &name, Body body)
+{
+    m_benchmarks.push_back({name, std::move(body)});
+}
+
+QJsonObject BenchmarkRegistry::run(const BenchmarkOptions &options) const
+{
+    QJsonArray results{};
+    for (const auto &benchmark : m_benchmarks) {
+        if (!options.filter.isEmpty() && !benchmark.name.contains(options.filter)) {
+            continue;
+        }
+        results << runBenchmark(benchmark, options);
+    }
+    return {
+        {QStringLiteral("context"), context()},
+        {QStringLiteral("benchmarks"), results}
+    };
+}
+
+QJsonObject BenchmarkRegistry::runBenchmark(const Benchmark &benchmark, const BenchmarkOptions &options)
+{
+    // Grow the iteration count until one repetition lasts long enough to be timed reliably
+    int64_t iterations = 1;
+    for (;;) {
+        BenchmarkState state{iterations};
+        benchmark.body(state);
+        if (state.elapsedNs() >= options.minTimeNs || iterations >= maxIterations) {
+            break;
+        }
+        auto estimate = state.elapsedNs() > 0
+                ? static_cast<int64_t>(std::ceil(1.4 * static_cast<double>(options.minTimeNs) * static_cast<double>(iterations) / static_cast<double>(state.elapsedNs())))
+                : iterations * growthFactor;
+        iterations = std::min(std::max(estimate, iterations + 1), std::min(iterations * growthFactor, maxIterations));
+    }
+
+    std::vector<double> samples{};
+    samples.reserve(options.repetitions);
+    int64_t itemsPerIteration{};
+    for (int repetition = 0; repetition < options.repetitions; ++repetition) {
+        BenchmarkState state{iterations};
+        benchmark.body(state);
+        samples.push_back(static_cast<double>(state.elapsedNs()) / static_cast<double>(iterations));
+        itemsPerIteration = state.itemsPerIteration();
+    }
+    std::sort(samples.begin(), samples.end());
+    auto mean = std::accumulate(samples.cbegin(), samples.cend(), 0.0) / static_cast<double>(samples.size());
+    auto variance = std::accumulate(samples.cbegin(), samples.cend(), 0.0, [mean](double sum, double sample) {
+        return sum + (sample - mean) * (sample - mean);
+    }) / static_cast<double>(samples.size());
+    auto median = samples.size() % 2 == 1
+            ? samples.at(samples.size() / 2)
+            : (samples.at(samples.size() / 2 - 1) + samples.at(samples.size() / 2)) / 2.0;
+
+    QJsonObject result{
+        {QStringLiteral("name"), benchmark.name},
+        {QStringLiteral("iterations"), static_cast<qint64>(iterations)},
+        {QStringLiteral("repetitions"), options.repetitions},
+        {QStringLiteral("min_ns"), samples.front()},
+        {QStringLiteral("median_ns"), median},
+        {QStringLiteral("mean_ns"), mean},
+        {QStringLiteral("stddev_ns"), std::sqrt(variance)}
+    };
+    if (itemsPerIteration > 0) {
+        result.insert(QStringLiteral("items_per_second"), static_cast<double>(itemsPerIteration) * 1.0e9 / median);
+    }
+    std::printf("%-48s %14.0f ns %14.0f ns (min) %12lld iterations\n",
+                qPrintable(benchmark.name), median, samples.front(), static_cast<long long>(iterations));
+    std::fflush(stdout);
+    return result;
+}
+
+QJsonObject BenchmarkRegistry::context()
+{
+    return {
+        {QStringLiteral("date"), QDateTime::currentDateTimeUtc().toString(Qt::DateFormat::ISODate)},
+        {QStringLiteral("host"), QSysInfo::machineHostName()},
+        {QStringLiteral("cpu_architecture"), QSysInfo::currentCpuArchitecture()},
+        {QStringLiteral("num_cpus"), QThread::idealThreadCount()},
+#ifdef NDEBUG
+        {QStringLiteral("build_type"), QStringLiteral("release")}
+#else
+        {QStringLiteral("build_type"), QStringLiteral("debug")}
+#endif
+    };
+}
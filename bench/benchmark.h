@@ -0,0 +1,77 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QString>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Timing loop handed to every benchmark body:
+//     while (state.keepRunning()) { ... }
+// Work between pauseTiming() and resumeTiming() is excluded from the measurement.
+class BenchmarkState
+{
+public:
+    explicit BenchmarkState(int64_t iterations);
+
+    [[nodiscard]] bool keepRunning();
+    void pauseTiming();
+    void resumeTiming();
+    // Items processed per iteration, reported as throughput
+    void setItemsPerIteration(int64_t items) { m_itemsPerIteration = items; }
+
+    [[nodiscard]] int64_t iterations() const { return m_iterations; }
+    [[nodiscard]] int64_t elapsedNs() const { return m_elapsedNs; }
+    [[nodiscard]] int64_t itemsPerIteration() const { return m_itemsPerIteration; }
+
+private:
+    const int64_t m_iterations;
+    int64_t m_remaining;
+    int64_t m_elapsedNs;
+    int64_t m_itemsPerIteration;
+    bool m_running;
+    QElapsedTimer m_timer;
+};
+
+// Keeps the compiler from discarding a computed value
+template<typename T>
+inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct BenchmarkOptions
+{
+    // Minimal measured time of a single repetition
+    int64_t minTimeNs;
+    int repetitions;
+    // Runs only benchmarks with names containing it, when not empty
+    QString filter;
+};
+
+class BenchmarkRegistry
+{
+public:
+    using Body = std::function<void(BenchmarkState &state)>;
+
+    void add(const QString &name, Body body);
+    // Prints a line per benchmark and returns the results with the run context
+    [[nodiscard]] QJsonObject run(const BenchmarkOptions &options) const;
+
+private:
+    struct Benchmark
+    {
+        QString name;
+        Body body;
+    };
+
+    std::vector<Benchmark> m_benchmarks;
+
+    [[nodiscard]] static QJsonObject runBenchmark(const Benchmark &benchmark, const BenchmarkOptions &options);
+    [[nodiscard]] static QJsonObject context();
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,626 @@
+#include "benchmark.h"
+#include "syntheticmodel.h"
+
+#include "cook/assetpackwriter.h"
+#include "cook/meshcooker.h"
+#include "cook/texturecooker.h"
+
+#include "assetpack.h"
+#include "cookedasset.h"
+#include "glm.h"
+#include "jobsystem.h"
+#include "lz4codec.h"
+#include "model.h"
+#include "occlusionbuffer.h"
+#include "scenegraph.h"
+#include "settings.h"
+#include "texvertex.h"
+#include "utils.h"
+
+#include <QColorSpace>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <QSettings>
+#include <QThread>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+const QString modelDirName = QStringLiteral(VKTUTOR2_BENCH_DATA_DIR "/models");
+const QString modelName = QStringLiteral("viking_room.obj");
+const QString textureName = QStringLiteral(VKTUTOR2_BENCH_DATA_DIR "/textures/viking_room.png");
+constexpr uint64_t pipelineCacheShaderHash = 0x5eed;
+constexpr uint64_t cookedSourceHashValue = 0xc00c;
+
+// Vertex stream with the same duplication as an indexed mesh expanded per corner, what loadModel sees from tinyobj
+[[nodiscard]] QVector<TexVertex> expandedVertices(const Model &model)
+{
+    QVector<TexVertex> result{};
+    result.reserve(model.indices.size());
+    for (auto index : model.indices) {
+        result << model.vertices.at(static_cast<int>(index));
+    }
+    return result;
+}
+
+void writeBenchFile(const QString &fileName, const QByteArray &data)
+{
+    QSaveFile file{fileName};
+    if (!file.open(QFile::OpenModeFlag::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        throw std::runtime_error{"can not write benchmark data"};
+    }
+}
+
+// Roughly as compressible as a driver pipeline cache: headers and padding mixed with machine code
+[[nodiscard]] QByteArray pipelineCacheBlob(int size)
+{
+    QByteArray result(size, char{});
+    QRandomGenerator generator{42};
+    for (int i = 0; i < size; ++i) {
+        result[i] = (i % 64) < 24 ? char{} : static_cast<char>(generator.bounded(256));
+    }
+    return result;
+}
+
+void addModelBenchmarks(BenchmarkRegistry &registry, const QString &syntheticDirName)
+{
+    registry.add(QStringLiteral("Model::loadModel/viking_room"), [](BenchmarkState &state) {
+        while (state.keepRunning()) {
+            auto model = Model::loadModel(modelDirName, modelName);
+            doNotOptimize(model);
+        }
+    });
+    for (int gridSize : {256, 1024}) {
+        auto fileName = QStringLiteral("grid%1.obj").arg(gridSize);
+        writeSyntheticObj(QDir{syntheticDirName}.filePath(fileName), gridSize);
+        registry.add(QStringLiteral("Model::loadModel/synthetic_%1x%1").arg(gridSize), [syntheticDirName, fileName, gridSize](BenchmarkState &state) {
+            state.setItemsPerIteration(int64_t{2} * gridSize * gridSize);
+            while (state.keepRunning()) {
+                auto model = Model::loadModel(syntheticDirName, fileName);
+                doNotOptimize(model);
+            }
+        });
+    }
+}
+
+[[nodiscard]] QByteArray randomBytes(QRandomGenerator &generator, int size)
+{
+    QByteArray result(size, char{});
+    for (int i = 0; i < size; ++i) {
+        result[i] = static_cast<char>(generator.bounded(256));
+    }
+    return result;
+}
+
+struct Lz4CheckInput
+{
+    QString name;
+    QByteArray data;
+    // The compressor has to find matches in it, otherwise the match paths of the decoder stay untested
+    bool compressible;
+};
+
+// Literal and match lengths on both sides of the first (15) and the second (15 + 255) length extension byte, runs
+// whose matches overlap the bytes they copy, and the short blocks which are all literals
+[[nodiscard]] std::vector<Lz4CheckInput> lz4CheckInputs()
+{
+    QRandomGenerator generator{42};
+    std::vector<Lz4CheckInput> result{};
+    result.push_back({QStringLiteral("empty"), QByteArray{}, false});
+    for (int size : {1, 12, 14, 15, 16, 269, 270, 271, 1000}) {
+        result.push_back({QStringLiteral("literals/%1").arg(size), randomBytes(generator, size), false});
+    }
+    // Match length minus the 4 implied bytes against the extension thresholds, the random tail ends the match
+    for (int length : {18, 19, 20, 273, 274, 275, 600}) {
+        auto source = randomBytes(generator, length);
+        result.push_back({QStringLiteral("match/%1").arg(length), source + source + randomBytes(generator, 16), true});
+    }
+    for (int offset : {1, 2, 4, 7}) {
+        auto pattern = randomBytes(generator, offset);
+        result.push_back({QStringLiteral("overlap/offset:%1").arg(offset), pattern.repeated(5000 / offset) + randomBytes(generator, 16), true});
+    }
+    result.push_back({QStringLiteral("pipelineCache"), pipelineCacheBlob(1 << 20), true});
+    return result;
+}
+
+// vktutor2_bench --check-lz4: round trips of the codec of the asset pack, for the lz4_check target
+int checkLz4()
+{
+    for (const auto &input : lz4CheckInputs()) {
+        try {
+            auto compressed = lz4Compress(input.data);
+            if (input.compressible && compressed.size() >= input.data.size()) {
+                throw std::runtime_error{"no matches found"};
+            }
+            if (lz4Decompress(compressed.constData(), compressed.size(), input.data.size()) != input.data) {
+                throw std::runtime_error{"round trip changed the data"};
+            }
+            std::printf("LZ4 check passed, %s: %lld -> %lld bytes\n", qPrintable(input.name),
+                        static_cast<long long>(input.data.size()), static_cast<long long>(compressed.size()));
+        } catch (const std::exception &e) {
+            std::printf("LZ4 check failed, %s: %s\n", qPrintable(input.name), e.what());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Startup cost of the cooked assets against the importers above, and what the cooker itself costs per asset
+void addCookedAssetBenchmarks(BenchmarkRegistry &registry, const QString &workDirName)
+{
+    auto model = Model::loadModel(modelDirName, modelName);
+    auto meshFileName = QDir{workDirName}.filePath(QStringLiteral("viking_room.mesh"));
+    writeBenchFile(meshFileName, cookMesh(model, cookedSourceHashValue));
+    registry.add(QStringLiteral("loadCookedModel/viking_room"), [meshFileName](BenchmarkState &state) {
+        while (state.keepRunning()) {
+            auto cooked = loadCookedModel(readFile(meshFileName));
+            doNotOptimize(cooked);
+        }
+    });
+    registry.add(QStringLiteral("cookMesh/viking_room"), [model](BenchmarkState &state) {
+        state.setItemsPerIteration(model.indices.size() / 3);
+        while (state.keepRunning()) {
+            auto cooked = cookMesh(model, cookedSourceHashValue);
+            doNotOptimize(cooked);
+        }
+    });
+
+    auto texture = loadTextureImage(textureName);
+    auto textureFileName = QDir{workDirName}.filePath(QStringLiteral("viking_room.tex"));
+    auto cookedTexture = cookTexture(texture, cookedSourceHashValue);
+    writeBenchFile(textureFileName, cookedTexture);
+    registry.add(QStringLiteral("loadCookedTexture/viking_room"), [textureFileName](BenchmarkState &state) {
+        while (state.keepRunning()) {
+            auto cooked = loadCookedTexture(readFile(textureFileName), VkFormat::VK_FORMAT_R8G8B8A8_SRGB);
+            doNotOptimize(cooked);
+        }
+    });
+    // The same texture out of a mapped pack, straight from the page cache or through the LZ4 decoder
+    for (bool compress : {false, true}) {
+        auto packFileName = QDir{workDirName}.filePath(compress ? QStringLiteral("lz4.pack") : QStringLiteral("raw.pack"));
+        writeBenchFile(packFileName, writeAssetPack({{QStringLiteral("viking_room.tex"), cookedTexture}}, compress, cookedSourceHashValue));
+        auto name = QStringLiteral("AssetPack/loadCookedTexture/%1").arg(compress ? QStringLiteral("lz4") : QStringLiteral("raw"));
+        registry.add(name, [packFileName](BenchmarkState &state) {
+            AssetPack pack{packFileName};
+            while (state.keepRunning()) {
+                auto cooked = loadCookedTexture(pack.data(QStringLiteral("viking_room.tex")), VkFormat::VK_FORMAT_R8G8B8A8_SRGB);
+                doNotOptimize(cooked);
+            }
+        });
+    }
+    registry.add(QStringLiteral("cookTexture/viking_room"), [texture](BenchmarkState &state) {
+        state.setItemsPerIteration(int64_t{texture.width()} * texture.height());
+        while (state.keepRunning()) {
+            auto cooked = cookTexture(texture, cookedSourceHashValue);
+            doNotOptimize(cooked);
+        }
+    });
+}
+
+void addVertexBenchmarks(BenchmarkRegistry &registry)
+{
+    auto vertices = expandedVertices(Model::loadModel(modelDirName, modelName));
+    registry.add(QStringLiteral("qHash(TexVertex)"), [vertices](BenchmarkState &state) {
+        state.setItemsPerIteration(vertices.size());
+        while (state.keepRunning()) {
+            uint hash{};
+            for (const auto &vertex : vertices) {
+                hash ^= qHash(vertex);
+            }
+            doNotOptimize(hash);
+        }
+    });
+    registry.add(QStringLiteral("TexVertex/dedup"), [vertices](BenchmarkState &state) {
+        state.setItemsPerIteration(vertices.size());
+        while (state.keepRunning()) {
+            // Same loop as Model::loadModel
+            Model result{};
+            QHash<TexVertex, uint32_t> uniqueVertices{};
+            result.indices.reserve(vertices.size());
+            result.vertices.reserve(vertices.size());
+            for (const auto &vertex : vertices) {
+                if (auto iUniqueVertices = uniqueVertices.constFind(vertex); iUniqueVertices != uniqueVertices.cend()) {
+                    result.indices << iUniqueVertices.value();
+                    continue;
+                }
+                auto verticesSize = result.vertices.size();
+                uniqueVertices.insert(vertex, verticesSize);
+                result.indices << verticesSize;
+                result.vertices << vertex;
+            }
+            doNotOptimize(result);
+        }
+    });
+}
+
+void addSettingsBenchmarks(BenchmarkRegistry &registry)
+{
+    for (int size : {256 * 1024, 4 * 1024 * 1024}) {
+        auto cache = pipelineCacheBlob(size);
+        registry.add(QStringLiteral("Settings::savePipelineCache/%1KiB").arg(size / 1024), [cache](BenchmarkState &state) {
+            state.setItemsPerIteration(cache.size());
+            while (state.keepRunning()) {
+                Settings::savePipelineCache(cache, pipelineCacheShaderHash);
+                // QSettings writes back on destruction, so the save above already hit the disk
+            }
+        });
+        registry.add(QStringLiteral("Settings::loadPipelineCache/%1KiB").arg(size / 1024), [cache](BenchmarkState &state) {
+            state.pauseTiming();
+            Settings::savePipelineCache(cache, pipelineCacheShaderHash);
+            state.resumeTiming();
+            state.setItemsPerIteration(cache.size());
+            while (state.keepRunning()) {
+                auto loaded = Settings::loadPipelineCache(pipelineCacheShaderHash);
+                if (loaded.size() != cache.size()) {
+                    throw std::runtime_error{"pipeline cache round trip failed"};
+                }
+                doNotOptimize(loaded);
+            }
+        });
+    }
+}
+
+void addUniformBenchmarks(BenchmarkRegistry &registry)
+{
+    // TexPipeline::updateScene, the scene graph update and the uniform fill of updateUniformBuffers, into plain
+    // memory instead of the mapped buffers
+    registry.add(QStringLiteral("TexPipeline/uniformMatrices"), [](BenchmarkState &state) {
+        // Same layout as the uniform blocks of tex.vert and tex.frag
+        struct VertBindingObject {
+            alignas(16) glm::mat4 model;
+            alignas(16) glm::mat4 projView;
+            alignas(16) glm::mat3 modelInvTrans;
+        };
+        struct FragBindingObject {
+            alignas(16) glm::vec3 ambientColor;
+            alignas(16) glm::vec3 diffuseLightPos;
+            alignas(16) glm::vec3 diffuseLightColor;
+        };
+
+        SceneGraph sceneGraph{};
+        auto modelNode = sceneGraph.addNode();
+        glm::mat4 proj = glm::perspective(glm::radians(45.0F), 16.0F / 9.0F, 0.1F, 100.0F);
+        glm::mat4 view = glm::lookAt(glm::vec3{2.0F, 2.0F, 2.0F}, glm::vec3{0.0F, 0.0F, 0.0F}, glm::vec3{0.0F, 0.0F, 1.0F});
+        glm::mat4 projView = proj * view;
+        VertBindingObject vertUbo{};
+        FragBindingObject fragUbo{};
+        float time{};
+        while (state.keepRunning()) {
+            time += 1.0F / 60.0F;
+            sceneGraph.setRotation(modelNode, time * glm::radians(16.0F), glm::vec3{0.0F, 0.0F, 1.0F});
+            sceneGraph.update();
+
+            vertUbo.model = sceneGraph.worldMatrix(modelNode);
+            vertUbo.modelInvTrans = sceneGraph.normalMatrix(modelNode);
+            vertUbo.projView = projView;
+            glm::vec3 eye{glm::inverse(view)[3]};
+            glm::vec3 modelCenter{vertUbo.model[3]};
+
+            glm::mat3 modelDiffuseLightPos{glm::rotate(glm::mat4{1.0F}, -time * glm::radians(45.0F), glm::vec3{0.0F, 0.0F, 1.0F})};
+            fragUbo.ambientColor = {0.01F, 0.01F, 0.01F};
+            fragUbo.diffuseLightPos = modelDiffuseLightPos * glm::vec3{-0.7F, 0.7F, 1.2F};
+            fragUbo.diffuseLightColor = {1.0F, 1.0F, 0.5F};
+
+            doNotOptimize(vertUbo);
+            doNotOptimize(fragUbo);
+            doNotOptimize(glm::distance(eye, modelCenter));
+        }
+    });
+}
+
+constexpr int stressParentCount = 256;
+constexpr int stressChildCount = 64;
+constexpr int stressItemCount = 1024;
+// Pool sizes and rounds of the checked run, small pools make the waiting threads run most of the jobs
+constexpr std::array stressCheckThreadCounts{1, 2, 4, 8};
+constexpr int stressCheckRounds = 200;
+
+// Nested jobs waiting for their children while other workers steal them, then a parallelFor and a failing one.
+// Throws unless every job and every item ran exactly once, every counter drained and the failure was rethrown.
+void stressJobSystem(JobSystem &jobSystem)
+{
+    std::vector<std::atomic_int> jobRuns(stressParentCount * (stressChildCount + 1));
+    for (auto &runs : jobRuns) {
+        runs = 0;
+    }
+    std::atomic_int undrainedCounters{0};
+    JobCounter parents{};
+    for (int parent = 0; parent < stressParentCount; ++parent) {
+        jobSystem.submit(parents, [&jobSystem, &jobRuns, &undrainedCounters, parent] {
+            auto *children = &jobRuns[parent * (stressChildCount + 1)];
+            JobCounter childCounter{};
+            for (int child = 1; child <= stressChildCount; ++child) {
+                jobSystem.submit(childCounter, [children, child]{ ++children[child]; });
+            }
+            jobSystem.wait(childCounter);
+            if (!childCounter.done()) {
+                ++undrainedCounters;
+            }
+            ++children[0];
+        });
+    }
+    jobSystem.wait(parents);
+    if (!parents.done() || undrainedCounters != 0) {
+        throw std::runtime_error{"job counter not drained after its wait"};
+    }
+    if (std::any_of(jobRuns.cbegin(), jobRuns.cend(), [](const std::atomic_int &runs) { return runs != 1; })) {
+        throw std::runtime_error{"job lost or run twice"};
+    }
+
+    auto workerCount = jobSystem.workerCount() + 1;
+    std::vector<std::atomic_int> itemRuns(stressItemCount);
+    for (auto &runs : itemRuns) {
+        runs = 0;
+    }
+    std::atomic_bool workerIndexValid{true};
+    jobSystem.parallelFor(stressItemCount, workerCount, [&itemRuns, &workerIndexValid, workerCount](int workerIndex, int itemIndex) {
+        if (workerIndex < 0 || workerIndex >= workerCount) {
+            workerIndexValid = false;
+        }
+        ++itemRuns[itemIndex];
+    });
+    if (!workerIndexValid) {
+        throw std::runtime_error{"parallelFor worker index out of range"};
+    }
+    if (std::any_of(itemRuns.cbegin(), itemRuns.cend(), [](const std::atomic_int &runs) { return runs != 1; })) {
+        throw std::runtime_error{"parallelFor item lost or run twice"};
+    }
+
+    bool rethrown{};
+    try {
+        jobSystem.parallelFor(stressItemCount, workerCount, [](int, int itemIndex) {
+            if (itemIndex == stressItemCount / 2) {
+                throw std::runtime_error{"expected"};
+            }
+        });
+    } catch (const std::runtime_error &) {
+        rethrown = true;
+    }
+    if (!rethrown) {
+        throw std::runtime_error{"job system swallowed an exception"};
+    }
+}
+
+// vktutor2_bench --check-jobs: the stress run on several pool sizes without timing, for the jobsystem_check target
+int checkJobSystem()
+{
+    for (int threadCount : stressCheckThreadCounts) {
+        JobSystem jobSystem{threadCount - 1};
+        for (int round = 0; round < stressCheckRounds; ++round) {
+            try {
+                stressJobSystem(jobSystem);
+            } catch (const std::exception &e) {
+                std::printf("JobSystem check failed, threads: %d, round: %d: %s\n", threadCount, round, e.what());
+                return 1;
+            }
+        }
+        std::printf("JobSystem check passed, threads: %d, rounds: %d\n", threadCount, stressCheckRounds);
+    }
+    return 0;
+}
+
+void addJobSystemBenchmarks(BenchmarkRegistry &registry)
+{
+    registry.add(QStringLiteral("JobSystem/stress"), [](BenchmarkState &state) {
+        auto &jobSystem = JobSystem::instance();
+        state.setItemsPerIteration(stressParentCount * (stressChildCount + 1) + 2 * stressItemCount);
+        while (state.keepRunning()) {
+            stressJobSystem(jobSystem);
+        }
+    });
+    // Same fixed amount of work on growing pools, items per second should grow with the workers
+    for (int threadCount = 1; threadCount <= QThread::idealThreadCount(); threadCount *= 2) {
+        registry.add(QStringLiteral("JobSystem::parallelFor/threads:%1").arg(threadCount), [threadCount](BenchmarkState &state) {
+            constexpr int itemCount = 4096;
+            constexpr int itemWork = 256;
+            // The benchmark thread is the last one
+            JobSystem jobSystem{threadCount - 1};
+            std::vector<float> results(itemCount);
+            state.setItemsPerIteration(itemCount);
+            while (state.keepRunning()) {
+                jobSystem.parallelFor(itemCount, threadCount, [&results](int, int itemIndex) {
+                    float value = static_cast<float>(itemIndex);
+                    for (int i = 0; i < itemWork; ++i) {
+                        value = std::sqrt(value + static_cast<float>(i));
+                    }
+                    results[itemIndex] = value;
+                });
+                doNotOptimize(results);
+            }
+        });
+    }
+}
+
+void addSceneGraphBenchmarks(BenchmarkRegistry &registry)
+{
+    constexpr int nodeCount = 100000;
+    // Every node moves every frame: a flat list of roots and a tree with eight children per node
+    for (int fanOut : {0, 8}) {
+        auto name = fanOut == 0 ? QStringLiteral("SceneGraph::update/flat100k") : QStringLiteral("SceneGraph::update/tree100k");
+        registry.add(name, [fanOut](BenchmarkState &state) {
+            SceneGraph sceneGraph{};
+            for (int i = 0; i < nodeCount; ++i) {
+                auto node = sceneGraph.addNode(fanOut == 0 || i == 0 ? SceneGraph::noParent : (i - 1) / fanOut);
+                sceneGraph.setTranslation(node, glm::vec3{1.0F, 0.0F, 0.0F});
+            }
+            state.setItemsPerIteration(nodeCount);
+            float time{};
+            while (state.keepRunning()) {
+                time += 1.0F / 60.0F;
+                for (int i = 0; i < nodeCount; ++i) {
+                    sceneGraph.setRotation(i, time, glm::vec3{0.0F, 0.0F, 1.0F});
+                }
+                sceneGraph.update();
+                doNotOptimize(sceneGraph.worldMatrix(nodeCount - 1));
+            }
+        });
+    }
+    // Only the root moves, the whole tree below it follows
+    registry.add(QStringLiteral("SceneGraph::update/tree100kRootOnly"), [](BenchmarkState &state) {
+        SceneGraph sceneGraph{};
+        for (int i = 0; i < nodeCount; ++i) {
+            static_cast<void>(sceneGraph.addNode(i == 0 ? SceneGraph::noParent : (i - 1) / 8));
+        }
+        state.setItemsPerIteration(nodeCount);
+        float time{};
+        while (state.keepRunning()) {
+            time += 1.0F / 60.0F;
+            sceneGraph.setRotation(0, time, glm::vec3{0.0F, 0.0F, 1.0F});
+            sceneGraph.update();
+            doNotOptimize(sceneGraph.worldMatrix(nodeCount - 1));
+        }
+    });
+}
+
+void addOcclusionBenchmarks(BenchmarkRegistry &registry)
+{
+    // A row of rooms in front of the camera hides a grid of boxes behind it, like the instanced tex pipeline
+    auto model = Model::loadModel(modelDirName, modelName);
+    glm::mat4 proj = glm::perspective(glm::radians(45.0F), 16.0F / 9.0F, 0.1F, 100.0F);
+    glm::mat4 view = glm::lookAt(glm::vec3{0.0F, -4.0F, 1.0F}, glm::vec3{0.0F, 10.0F, 0.5F}, glm::vec3{0.0F, 0.0F, 1.0F});
+    glm::mat4 projView = proj * view;
+    QVector<glm::mat4> occluders{};
+    for (int i = 0; i < 32; ++i) {
+        occluders << glm::translate(glm::mat4{1.0F}, glm::vec3{static_cast<float>(i % 8 - 4) * 2.0F, static_cast<float>(i / 8) * 2.0F, 0.0F});
+    }
+    QVector<std::array<glm::vec3, 8>> boxes{};
+    for (int i = 0; i < 4096; ++i) {
+        glm::vec3 boxMin{static_cast<float>(i % 64 - 32) * 1.5F, 10.0F + static_cast<float>(i / 64) * 1.5F, 0.0F};
+        std::array<glm::vec3, 8> corners{};
+        for (size_t corner = 0; corner < corners.size(); ++corner) {
+            corners[corner] = boxMin + glm::vec3{(corner & 1U) != 0 ? 1.0F : 0.0F, (corner & 2U) != 0 ? 1.0F : 0.0F, (corner & 4U) != 0 ? 1.0F : 0.0F};
+        }
+        boxes << corners;
+    }
+    registry.add(QStringLiteral("OcclusionBuffer::renderOccluders/32"), [model, occluders, projView](BenchmarkState &state) {
+        OcclusionBuffer buffer{};
+        state.setItemsPerIteration(int64_t{occluders.size()} * (model.occluderIndices.size() / 3));
+        while (state.keepRunning()) {
+            buffer.begin(projView, 16.0F / 9.0F);
+            buffer.renderOccluders(model.occluderVertices, model.occluderIndices, occluders);
+            doNotOptimize(buffer);
+        }
+    });
+    registry.add(QStringLiteral("OcclusionBuffer::isVisible/4096"), [model, occluders, projView, boxes](BenchmarkState &state) {
+        OcclusionBuffer buffer{};
+        buffer.begin(projView, 16.0F / 9.0F);
+        buffer.renderOccluders(model.occluderVertices, model.occluderIndices, occluders);
+        state.setItemsPerIteration(boxes.size());
+        while (state.keepRunning()) {
+            int visible{};
+            for (const auto &box : boxes) {
+                visible += buffer.isVisible(box) ? 1 : 0;
+            }
+            doNotOptimize(visible);
+        }
+    });
+}
+
+void addTextureBenchmarks(BenchmarkRegistry &registry)
+{
+    registry.add(QStringLiteral("loadTextureImage/viking_room"), [](BenchmarkState &state) {
+        while (state.keepRunning()) {
+            auto texture = loadTextureImage(textureName);
+            doNotOptimize(texture);
+        }
+    });
+    QImage decoded{textureName};
+    if (decoded.isNull()) {
+        throw std::runtime_error{"failed to load texture image"};
+    }
+    registry.add(QStringLiteral("loadTextureImage/convertOnly"), [decoded](BenchmarkState &state) {
+        state.setItemsPerIteration(int64_t{decoded.width()} * decoded.height());
+        while (state.keepRunning()) {
+            QImage texture = decoded.convertToFormat(QImage::Format::Format_RGBA8888);
+            texture.convertToColorSpace(QColorSpace::NamedColorSpace::SRgb);
+            doNotOptimize(texture);
+        }
+    });
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a{argc, argv};
+    QCoreApplication::setOrganizationName(QStringLiteral("maratik"));
+    QCoreApplication::setOrganizationDomain(QStringLiteral("maratik.name"));
+    QCoreApplication::setApplicationName(QStringLiteral("vktutor2_bench"));
+
+    QCommandLineParser parser{};
+    parser.addHelpOption();
+    QCommandLineOption jsonOption{QStringLiteral("json"), QStringLiteral("Write results as JSON."), QStringLiteral("file")};
+    QCommandLineOption filterOption{QStringLiteral("filter"), QStringLiteral("Run only benchmarks containing the text."), QStringLiteral("text")};
+    QCommandLineOption minTimeOption{QStringLiteral("min-time"), QStringLiteral("Minimal time of a repetition."), QStringLiteral("ms"), QStringLiteral("200")};
+    QCommandLineOption repetitionsOption{QStringLiteral("repetitions"), QStringLiteral("Repetitions per benchmark."), QStringLiteral("count"), QStringLiteral("5")};
+    QCommandLineOption checkJobsOption{QStringLiteral("check-jobs"), QStringLiteral("Only run the checked JobSystem stress run, exit with 1 when it fails.")};
+    QCommandLineOption checkLz4Option{QStringLiteral("check-lz4"), QStringLiteral("Only run the LZ4 round trips, exit with 1 when one fails.")};
+    parser.addOptions({jsonOption, filterOption, minTimeOption, repetitionsOption, checkJobsOption, checkLz4Option});
+    parser.process(a);
+
+    if (parser.isSet(checkJobsOption)) {
+        return checkJobSystem();
+    }
+    if (parser.isSet(checkLz4Option)) {
+        return checkLz4();
+    }
+
+    // Loaders log every call, which would dominate the measurements
+    QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false"));
+
+    // Keep the pipeline cache of the application untouched
+    QTemporaryDir workDir{};
+    if (!workDir.isValid()) {
+        std::fprintf(stderr, "can not create temporary directory\n");
+        return 1;
+    }
+    QSettings::setDefaultFormat(QSettings::Format::IniFormat);
+    QSettings::setPath(QSettings::Format::IniFormat, QSettings::Scope::UserScope, workDir.path());
+
+    BenchmarkOptions options{};
+    options.minTimeNs = parser.value(minTimeOption).toLongLong() * 1'000'000;
+    options.repetitions = std::max(1, parser.value(repetitionsOption).toInt());
+    options.filter = parser.value(filterOption);
+
+    QJsonObject results{};
+    try {
+        BenchmarkRegistry registry{};
+        addModelBenchmarks(registry, workDir.path());
+        addCookedAssetBenchmarks(registry, workDir.path());
+        addVertexBenchmarks(registry);
+        addSettingsBenchmarks(registry);
+        addUniformBenchmarks(registry);
+        addJobSystemBenchmarks(registry);
+        addSceneGraphBenchmarks(registry);
+        addOcclusionBenchmarks(registry);
+        addTextureBenchmarks(registry);
+        results = registry.run(options);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "benchmark failed: %s\n", e.what());
+        return 1;
+    }
+
+    auto json = QJsonDocument{results}.toJson(QJsonDocument::JsonFormat::Indented);
+    if (auto fileName = parser.value(jsonOption); !fileName.isEmpty()) {
+        QFile file{fileName};
+        if (!file.open(QFile::OpenModeFlag::WriteOnly | QFile::OpenModeFlag::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "can not write %s\n", qPrintable(fileName));
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "chrometrace.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+
+#include <chrono>
+
+namespace {
+constexpr int maxEvents = 1'000'000;
+}
+
+int64_t traceClockNs() noexcept
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+ChromeTrace::ChromeTrace()
+    : m_overflowReported{}
+{
+}
+
+void ChromeTrace::setProcessName(int processId, const QString &name)
+{
+    addEvent({
+        {QStringLiteral("name"), QStringLiteral("process_name")},
+        {QStringLiteral("ph"), QStringLiteral("M")},
+        {QStringLiteral("pid"), processId},
+        {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), name}}}
+    });
+}
+
+void ChromeTrace::setThreadName(int processId, int threadId, const QString &name)
+{
+    addEvent({
+        {QStringLiteral("name"), QStringLiteral("thread_name")},
+        {QStringLiteral("ph"), QStringLiteral("M")},
+        {QStringLiteral("pid"), processId},
+        {QStringLiteral("tid"), threadId},
+        {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), name}}}
+    });
+}
+
+void ChromeTrace::addCompleteEvent(const QString &name, const QString &category, int processId, int threadId, double startUs, double durationUs)
+{
+    addEvent({
+        {QStringLiteral("name"), name},
+        {QStringLiteral("cat"), category},
+        {QStringLiteral("ph"), QStringLiteral("X")},
+        {QStringLiteral("pid"), processId},
+        {QStringLiteral("tid"), threadId},
+        {QStringLiteral("ts"), startUs},
+        {QStringLiteral("dur"), durationUs}
+    });
+}
+
+bool ChromeTrace::isEmpty() const
+{
+    QMutexLocker locker{&m_mutex};
+    return m_events.isEmpty();
+}
+
+bool ChromeTrace::save(const QString &fileName) const
+{
+    QByteArray json{};
+    {
+        QMutexLocker locker{&m_mutex};
+        qDebug() << "Save trace events: " << m_events.size() << " to: " << fileName;
+        json = QJsonDocument{QJsonObject{
+            {QStringLiteral("traceEvents"), m_events},
+            {QStringLiteral("displayTimeUnit"), QStringLiteral("ms")}
+        }}.toJson(QJsonDocument::JsonFormat::Compact);
+    }
+    QFile file{fileName};
+    if (!file.open(QIODevice::OpenModeFlag::WriteOnly | QIODevice::OpenModeFlag::Truncate)) {
+        qDebug() << "Can not open trace file: " << fileName;
+        return false;
+    }
+    return file.write(json) == json.size();
+}
+
+void ChromeTrace::addEvent(QJsonObject event)
+{
+    QMutexLocker locker{&m_mutex};
+    if (m_events.size() >= maxEvents) {
+        if (!m_overflowReported) {
+            qDebug() << "Trace is full, further events are dropped";
+            m_overflowReported = true;
+        }
+        return;
+    }
+    m_events.append(std::move(event));
+}
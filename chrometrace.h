@@ -0,0 +1,34 @@
+#ifndef CHROMETRACE_H
+#define CHROMETRACE_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+
+#include <cstdint>
+
+// Monotonic nanoseconds since the first call, the common time base of all trace events
+[[nodiscard]] int64_t traceClockNs() noexcept;
+
+// Collects events in the Chrome trace event format, viewable in chrome://tracing or Perfetto
+class ChromeTrace
+{
+public:
+    ChromeTrace();
+
+    void setProcessName(int processId, const QString &name);
+    void setThreadName(int processId, int threadId, const QString &name);
+    void addCompleteEvent(const QString &name, const QString &category, int processId, int threadId, double startUs, double durationUs);
+    [[nodiscard]] bool isEmpty() const;
+    [[nodiscard]] bool save(const QString &fileName) const;
+
+private:
+    mutable QMutex m_mutex;
+    QJsonArray m_events;
+    bool m_overflowReported;
+
+    void addEvent(QJsonObject event);
+};
+
+#endif // CHROMETRACE_H
@@ -0,0 +1,46 @@
+# Generates a C++ source with every SPIR-V module embedded as an aligned uint32_t array.
+# Usage: cmake -DOUTPUT=<embeddedshaders.cpp> -DSHADERS=<a.spv|b.spv|...> -P embedspirv.cmake
+cmake_minimum_required(VERSION 3.21)
+
+string(REPLACE "|" ";" shader_list "${SHADERS}")
+
+set(shader_arrays)
+set(shader_entries)
+set(shader_count 0)
+foreach(shader ${shader_list})
+    cmake_path(GET shader FILENAME shader_file)
+    string(REGEX REPLACE "\\.spv$" "" shader_name "${shader_file}")
+    string(MAKE_C_IDENTIFIER "${shader_name}" shader_id)
+
+    file(READ "${shader}" shader_hex HEX)
+    string(LENGTH "${shader_hex}" shader_hex_length)
+    math(EXPR shader_remainder "${shader_hex_length} % 8")
+    if(shader_hex_length EQUAL 0 OR NOT shader_remainder EQUAL 0)
+        message(FATAL_ERROR "${shader} is not a valid SPIR-V module")
+    endif()
+
+    file(SHA256 "${shader}" shader_sha256)
+    string(SUBSTRING "${shader_sha256}" 0 16 shader_hash)
+
+    # SPIR-V words are little endian on disk
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1U, " shader_words "${shader_hex}")
+    set(word_regex "0x[0-9a-f]+U, ")
+    string(REGEX REPLACE "(${word_regex}${word_regex}${word_regex}${word_regex}${word_regex}${word_regex}${word_regex}${word_regex})" "\\1\n    " shader_words "${shader_words}")
+
+    string(APPEND shader_arrays "alignas(16) constexpr uint32_t ${shader_id}[]{\n    ${shader_words}\n};\n\n")
+    string(APPEND shader_entries "    EmbeddedShader{\"${shader_name}\", ${shader_id}, sizeof(${shader_id}), 0x${shader_hash}ULL},\n")
+    math(EXPR shader_count "${shader_count} + 1")
+endforeach()
+
+set(content "// Generated by embedspirv.cmake, do not edit\n")
+string(APPEND content "#include \"shaderregistry.h\"\n\n#include <array>\n\n")
+string(APPEND content "namespace {\n// NOLINTBEGIN(cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays,modernize-avoid-c-arrays)\n")
+string(APPEND content "${shader_arrays}")
+string(APPEND content "// NOLINTEND(cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays,modernize-avoid-c-arrays)\n\n")
+string(APPEND content "constexpr std::array<EmbeddedShader, ${shader_count}> embeddedShaders{\n${shader_entries}};\n}\n\n")
+string(APPEND content "const EmbeddedShader *ShaderRegistry::begin()\n{\n    return embeddedShaders.data();\n}\n\n")
+string(APPEND content "const EmbeddedShader *ShaderRegistry::end()\n{\n    return embeddedShaders.data() + embeddedShaders.size();\n}\n")
+
+file(WRITE "${OUTPUT}.tmp" "${content}")
+file(COPY_FILE "${OUTPUT}.tmp" "${OUTPUT}" ONLY_IF_DIFFERENT)
+file(REMOVE "${OUTPUT}.tmp")
@@ -5,6 +5,8 @@
 
 #include <QVulkanDeviceFunctions>
 
+#include <cmath>
+
 namespace {
 const glm::vec3 lightCubeColor{1.0F, 1.0F, 0.0F};
 const glm::vec3 lightCubeCenterColor{1.0F, 1.0F, 1.0F};
@@ -34,19 +36,34 @@ constexpr std::array<uint16_t, 72> lightCubeIndices{
     1, 0, 11, 0, 4, 11, 4, 5, 11, 5, 1, 11
 };
 
-const QString colorVertShaderName = QStringLiteral(":/shaders/color.vert.spv");
-const QString colorFragShaderName = QStringLiteral(":/shaders/color.frag.spv");
+const QString colorVertShaderName = QStringLiteral("color.vert");
+const QString colorFragShaderName = QStringLiteral("color.frag");
 
 struct VertBindingObject {
     alignas(16) glm::mat4 projViewModel;
 };
+
+// Specialization constants of color.frag: 0 - useVertexColor
+constexpr uint32_t colorVariantConstantCount = 1;
+// Not passed to the shader, minSampleShading in percent, 0 shades once per pixel
+constexpr uint32_t minSampleShadingConstant = 1;
+constexpr PipelineVariantKey vertexColorVariant{{VK_TRUE}};
+
+[[nodiscard]] PipelineVariantKey withSampleShading(PipelineVariantKey key, float minSampleShading)
+{
+    key.constants[minSampleShadingConstant] = static_cast<uint32_t>(std::lround(minSampleShading * 100.0F));
+    return key;
+}
 }
 
 ColorPipeline::ColorPipeline(VulkanRenderer *vulkanRenderer)
     : AbstractPipeline{vulkanRenderer}
     , m_vertexBuffer{}
     , m_indexBuffer{}
-    , m_graphicsPipelineWithLayout{}
+    , m_orbitNode{}
+    , m_lightNode{}
+    , m_pipelineVariants{vulkanRenderer, [this](const PipelineVariantKey &key) { return createGraphicsPipelineDescription(key); }}
+    , m_drawVariant{vertexColorVariant}
     , m_shaderModules{}
     , m_descriptorSetLayout{}
 {
@@ -55,40 +72,64 @@ ColorPipeline::ColorPipeline(VulkanRenderer *vulkanRenderer)
 
 void ColorPipeline::preInitResources()
 {
-
+    auto &sceneGraph = vulkanRenderer()->sceneGraph();
+    m_orbitNode = sceneGraph.addNode();
+    m_lightNode = sceneGraph.addNode(m_orbitNode);
+    sceneGraph.setTranslation(m_lightNode, glm::vec3{-0.7F, 0.7F, 1.2F});
+    sceneGraph.setScale(m_lightNode, 0.05F);
 }
 
 void ColorPipeline::initResources()
 {
     m_vertexBuffer = vulkanRenderer()->createVertexBuffer(lightCubeVertices);
     m_indexBuffer = vulkanRenderer()->createIndexBuffer(lightCubeIndices);
-    m_shaderModules = vulkanRenderer()->createShaderModules(colorVertShaderName, colorFragShaderName);
     m_descriptorSetLayout = createDescriptorSetLayout();
 }
 
+void ColorPipeline::describeShaderModules(PipelineBuilder &pipelineBuilder)
+{
+    pipelineBuilder.addShaderModules(colorVertShaderName, colorFragShaderName, &m_shaderModules);
+}
+
 void ColorPipeline::initSwapChainResources()
 {
     createVertUniformBuffers();
     createDescriptorSets(m_descriptorSets);
-    m_graphicsPipelineWithLayout = createGraphicsPipeline();
+    m_pipelineVariants.setLayout(createPipelineLayout());
+}
+
+void ColorPipeline::describeScenePipelines(PipelineBuilder &pipelineBuilder)
+{
+    QVector<PipelineVariantKey> variants{};
+    for (auto minSampleShading : vulkanRenderer()->minSampleShadings()) {
+        variants << withSampleShading(vertexColorVariant, minSampleShading);
+    }
+    m_pipelineVariants.describe(pipelineBuilder, variants);
 }
 
-DescriptorPoolSizes ColorPipeline::descriptorPoolSizes(int swapChainImageCount) const
+DescriptorPoolSizes ColorPipeline::descriptorPoolSizes(int frameCount) const
 {
     return {
         {
-            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, swapChainImageCount)
+            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount)
         },
-        static_cast<uint32_t>(swapChainImageCount)
+        static_cast<uint32_t>(frameCount)
     };
 }
 
-void ColorPipeline::updateUniformBuffers(float time, int currentSwapChainImageIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView) const
+void ColorPipeline::updateScene(float time)
+{
+    auto &sceneGraph = vulkanRenderer()->sceneGraph();
+    sceneGraph.setRotation(m_orbitNode, -time * glm::radians(45.0F), glm::vec3{0.0F, 0.0F, 1.0F});
+    sceneGraph.setRotation(m_lightNode, time * glm::radians(45.0F), glm::vec3{0.0F, 0.0F, 1.0F});
+}
+
+void ColorPipeline::updateUniformBuffers(float time, int currentFrameIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView)
 {
     auto *devFuncs = vulkanRenderer()->devFuncs();
     VkDevice device = vulkanRenderer()->device();
     VmaAllocator allocator = vulkanRenderer()->allocator();
-    VmaAllocation vertUniformBufferAllocation = m_vertUniformBuffers.at(currentSwapChainImageIndex).allocation;
+    VmaAllocation vertUniformBufferAllocation = m_vertUniformBuffers.at(currentFrameIndex).allocation;
 
     VertBindingObject *vertUbo{};
 
@@ -96,44 +137,34 @@ void ColorPipeline::updateUniformBuffers(float time, int currentSwapChainImageIn
                                   "failed to map uniform buffer object memory");
     auto mapGuard = sg::make_scope_guard([&]{ vmaUnmapMemory(allocator, vertUniformBufferAllocation); });
 
-    vertUbo->projViewModel = projView;
-
-    auto model{
-        glm::rotate(
-            glm::scale(
-                glm::translate(
-                    glm::rotate(
-                        glm::mat4{1.0F},
-                        -time * glm::radians(45.0F),
-                        glm::vec3{0.0F, 0.0F, 1.0F}),
-                    glm::vec3{-0.7F, 0.7F, 1.2F}),
-                glm::vec3{0.05F, 0.05F, 0.05F}),
-        time * glm::radians(45.0F),
-        glm::vec3{0.0F, 0.0F, 1.0F}),
-    };
-    vertUbo->projViewModel *= model;
+    vertUbo->projViewModel = projView * vulkanRenderer()->sceneGraph().worldMatrix(m_lightNode);
 }
 
-void ColorPipeline::drawCommands(VkCommandBuffer commandBuffer, int currentSwapChainImageIndex) const
+void ColorPipeline::drawCommands(VkCommandBuffer commandBuffer, int currentFrameIndex) const
 {
     auto *devFuncs = vulkanRenderer()->devFuncs();
-    devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipelineWithLayout.pipeline);
+    devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineVariants.pipeline(withSampleShading(m_drawVariant, vulkanRenderer()->minSampleShading())));
 
     std::array vertexBuffers{m_vertexBuffer.object};
     std::array offsets{static_cast<VkDeviceSize>(0)};
     devFuncs->vkCmdBindVertexBuffers(commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), offsets.data());
 
-    devFuncs->vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipelineWithLayout.layout, 0,
-                                        1, &m_descriptorSets.at(currentSwapChainImageIndex), 0, nullptr);
+    devFuncs->vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineVariants.layout(), 0,
+                                        1, &m_descriptorSets.at(currentFrameIndex), 0, nullptr);
     devFuncs->vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.object, 0, VkIndexType::VK_INDEX_TYPE_UINT16);
 
     devFuncs->vkCmdDrawIndexed(commandBuffer, lightCubeIndices.size(), 1, 0, 0, 0);
 
 }
 
+void ColorPipeline::releaseScenePipelines()
+{
+    m_pipelineVariants.destroyPipelines();
+}
+
 void ColorPipeline::releaseSwapChainResources()
 {
-    vulkanRenderer()->destroyPipelineWithLayout(m_graphicsPipelineWithLayout);
+    m_pipelineVariants.destroy();
     vulkanRenderer()->destroyUniformBuffers(m_vertUniformBuffers);
 }
 
@@ -184,15 +215,15 @@ void ColorPipeline::createDescriptorSets(QVector<VkDescriptorSet> &descriptorSet
     qDebug() << "Create descriptors sets";
     auto *devFuncs = vulkanRenderer()->devFuncs();
     VkDevice device = vulkanRenderer()->device();
-    auto swapChainImageCount = vulkanRenderer()->window()->swapChainImageCount();
-    QVector<VkDescriptorSetLayout> layouts{swapChainImageCount, m_descriptorSetLayout};
+    auto frameCount = vulkanRenderer()->surface()->concurrentFrameCount();
+    QVector<VkDescriptorSetLayout> layouts{frameCount, m_descriptorSetLayout};
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = vulkanRenderer()->descriptorPool();
-    allocInfo.descriptorSetCount = swapChainImageCount;
+    allocInfo.descriptorSetCount = frameCount;
     allocInfo.pSetLayouts = layouts.data();
     descriptorSets.clear();
-    descriptorSets.resize(swapChainImageCount);
+    descriptorSets.resize(frameCount);
     VulkanRenderer::checkVkResult(devFuncs->vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()),
                                   "failed to allocate descriptor sets");
 
@@ -220,43 +251,59 @@ void ColorPipeline::createDescriptorSets(QVector<VkDescriptorSet> &descriptorSet
     }
 }
 
-PipelineWithLayout ColorPipeline::createGraphicsPipeline() const
+VkPipelineLayout ColorPipeline::createPipelineLayout() const
 {
-    qDebug() << "Create graphics pipeline";
+    qDebug() << "Create pipeline layout";
 
-    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+    VkPipelineLayout pipelineLayout{};
+    VulkanRenderer::checkVkResult(vulkanRenderer()->devFuncs()->vkCreatePipelineLayout(vulkanRenderer()->device(), &pipelineLayoutInfo, nullptr, &pipelineLayout),
+                                  "failed to create pipeline layout");
+    return pipelineLayout;
+}
+
+GraphicsPipelineDescription ColorPipeline::createGraphicsPipelineDescription(const PipelineVariantKey &key) const
+{
+    qDebug() << "Describe graphics pipeline";
+
+    GraphicsPipelineDescription description{};
+
+    description.shaderStages.resize(2);
 
-    VkPipelineShaderStageCreateInfo &vertShaderStageInfo = shaderStages[0];
+    VkPipelineShaderStageCreateInfo &vertShaderStageInfo = description.shaderStages[0];
     vertShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT;
     vertShaderStageInfo.module = m_shaderModules.vert;
     vertShaderStageInfo.pName = "main";
 
-    VkPipelineShaderStageCreateInfo &fragShaderStageInfo = shaderStages[1];
+    VkPipelineShaderStageCreateInfo &fragShaderStageInfo = description.shaderStages[1];
     fragShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module = m_shaderModules.frag;
     fragShaderStageInfo.pName = "main";
 
-    auto bindingDescription = ColorVertex::createBindingDescription();
+    description.bindingDescriptions << ColorVertex::createBindingDescription();
     auto attributeDescriptions = ColorVertex::createAttributeDescriptions();
+    std::copy(attributeDescriptions.cbegin(), attributeDescriptions.cend(), std::back_inserter(description.attributeDescriptions));
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    VkPipelineVertexInputStateCreateInfo &vertexInputInfo = description.vertexInputInfo;
     vertexInputInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    VkPipelineInputAssemblyStateCreateInfo &inputAssembly = description.inputAssembly;
     inputAssembly.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssembly.topology = VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    auto *window = vulkanRenderer()->window();
-    auto swapChainImageSize = window->swapChainImageSize();
+    auto *surface = vulkanRenderer()->surface();
+    auto swapChainImageSize = surface->swapChainImageSize();
 
-    VkViewport viewport{};
+    VkViewport &viewport = description.viewport;
     viewport.x = 0.0F;
     viewport.y = 0.0F;
     viewport.width = static_cast<float>(swapChainImageSize.width());
@@ -264,16 +311,12 @@ PipelineWithLayout ColorPipeline::createGraphicsPipeline() const
     viewport.minDepth = 0.0F;
     viewport.maxDepth = 1.0F;
 
-    VkRect2D scissor = VulkanRenderer::createVkRect2D(swapChainImageSize);
+    description.scissor = VulkanRenderer::createVkRect2D(swapChainImageSize);
 
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    description.viewportState.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    description.dynamicViewport = true;
 
-    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    VkPipelineRasterizationStateCreateInfo &rasterizer = description.rasterizer;
     rasterizer.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizer.depthClampEnable = VK_FALSE;
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
@@ -286,16 +329,17 @@ PipelineWithLayout ColorPipeline::createGraphicsPipeline() const
     rasterizer.depthBiasClamp = 0.0F;
     rasterizer.depthBiasSlopeFactor = 0.0F;
 
-    VkPipelineMultisampleStateCreateInfo multisampling{};
+    VkPipelineMultisampleStateCreateInfo &multisampling = description.multisampling;
     multisampling.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_TRUE;
-    multisampling.rasterizationSamples = window->sampleCountFlagBits();
-    multisampling.minSampleShading = 0.2F;
+    auto minSampleShadingPercent = key.constants[minSampleShadingConstant];
+    multisampling.sampleShadingEnable = minSampleShadingPercent > 0 ? VK_TRUE : VK_FALSE;
+    multisampling.rasterizationSamples = vulkanRenderer()->sceneSampleCountFlagBits();
+    multisampling.minSampleShading = static_cast<float>(minSampleShadingPercent) / 100.0F;
     multisampling.pSampleMask = nullptr;
     multisampling.alphaToCoverageEnable = VK_FALSE;
     multisampling.alphaToOneEnable = VK_FALSE;
 
-    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    VkPipelineDepthStencilStateCreateInfo &depthStencil = description.depthStencil;
     depthStencil.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
     depthStencil.depthTestEnable = VK_TRUE;
     depthStencil.depthWriteEnable = VK_TRUE;
@@ -307,7 +351,7 @@ PipelineWithLayout ColorPipeline::createGraphicsPipeline() const
     depthStencil.front = {};
     depthStencil.back = {};
 
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    VkPipelineColorBlendAttachmentState &colorBlendAttachment = description.colorBlendAttachment;
     colorBlendAttachment.colorWriteMask =
             VkColorComponentFlags{}
             | VkColorComponentFlagBits::VK_COLOR_COMPONENT_B_BIT
@@ -322,45 +366,16 @@ PipelineWithLayout ColorPipeline::createGraphicsPipeline() const
     colorBlendAttachment.dstAlphaBlendFactor = VkBlendFactor::VK_BLEND_FACTOR_ZERO;
     colorBlendAttachment.alphaBlendOp = VkBlendOp::VK_BLEND_OP_ADD;
 
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    VkPipelineColorBlendStateCreateInfo &colorBlending = description.colorBlending;
     colorBlending.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VkLogicOp::VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
     std::fill(std::begin(colorBlending.blendConstants), std::end(colorBlending.blendConstants), 0.0F);
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-    auto *devFuncs = vulkanRenderer()->devFuncs();
-    VkDevice device = vulkanRenderer()->device();
-    PipelineWithLayout pipelineWithLayout{};
-    VulkanRenderer::checkVkResult(devFuncs->vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineWithLayout.layout),
-                                  "failed to create pipeline layout");
+    description.specialize(key, colorVariantConstantCount);
 
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = shaderStages.size();
-    pipelineInfo.pStages = shaderStages.data();
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = &depthStencil;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = nullptr;
-    pipelineInfo.layout = pipelineWithLayout.layout;
-    pipelineInfo.renderPass = window->defaultRenderPass();
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.basePipelineIndex = -1;
-    VulkanRenderer::checkVkResult(devFuncs->vkCreateGraphicsPipelines(device, vulkanRenderer()->pipelineCache(), 1, &pipelineInfo, nullptr, &pipelineWithLayout.pipeline),
-                                  "failed to create graphics pipeline");
-    return pipelineWithLayout;
+    description.layout = m_pipelineVariants.layout();
+    description.renderPass = vulkanRenderer()->sceneRenderPass();
+    description.subpass = 0;
+    return description;
 }
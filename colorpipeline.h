@@ -2,6 +2,8 @@
 #define COLORPIPELINE_H
 
 #include "abstractpipeline.h"
+#include "pipelinebuilder.h"
+#include "pipelinevariants.h"
 #include "vulkanrenderer.h"
 
 class ColorPipeline final : public AbstractPipeline
@@ -9,25 +11,36 @@ class ColorPipeline final : public AbstractPipeline
 public:
     explicit ColorPipeline(VulkanRenderer *vulkanRenderer);
 
+    [[nodiscard]] const char *name() const override { return "color pipeline"; }
+
     void preInitResources() override;
     void initResources() override;
+    void describeShaderModules(PipelineBuilder &pipelineBuilder) override;
     void initSwapChainResources() override;
-    [[nodiscard]] DescriptorPoolSizes descriptorPoolSizes(int swapChainImageCount) const override;
-    void updateUniformBuffers(float time, int currentSwapChainImageIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView) const override;
-    void drawCommands(VkCommandBuffer commandBuffer, int currentSwapChainImageIndex) const override;
+    void describeScenePipelines(PipelineBuilder &pipelineBuilder) override;
+    void releaseScenePipelines() override;
+    [[nodiscard]] DescriptorPoolSizes descriptorPoolSizes(int frameCount) const override;
+    void updateScene(float time) override;
+    void updateUniformBuffers(float time, int currentFrameIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView) override;
+    void drawCommands(VkCommandBuffer commandBuffer, int currentFrameIndex) const override;
     void releaseSwapChainResources() override;
     void releaseResources() override;
 
 private:
     BufferWithAllocation m_vertexBuffer;
     BufferWithAllocation m_indexBuffer;
-    PipelineWithLayout m_graphicsPipelineWithLayout;
+    // The light cube circles around the origin with orbitNode and spins around its own axis with lightNode
+    int m_orbitNode;
+    int m_lightNode;
+    PipelineVariants m_pipelineVariants;
+    PipelineVariantKey m_drawVariant;
     QVector<VkDescriptorSet> m_descriptorSets;
     ShaderModules m_shaderModules;
     VkDescriptorSetLayout m_descriptorSetLayout;
     QVector<BufferWithAllocation> m_vertUniformBuffers;
 
-    [[nodiscard]] PipelineWithLayout createGraphicsPipeline() const;
+    [[nodiscard]] VkPipelineLayout createPipelineLayout() const;
+    [[nodiscard]] GraphicsPipelineDescription createGraphicsPipelineDescription(const PipelineVariantKey &key) const;
     [[nodiscard]] VkDescriptorSetLayout createDescriptorSetLayout() const;
     void createDescriptorSets(QVector<VkDescriptorSet> &descriptorSets) const;
     void createVertUniformBuffers();
@@ -0,0 +1,101 @@
+#include "commandrecorder.h"
+
+#include "cpuprofiler.h"
+#include "jobsystem.h"
+#include "vulkanrenderer.h"
+
+#include <QDebug>
+#include <QVulkanDeviceFunctions>
+
+CommandRecorder::CommandRecorder(VulkanRenderer *vulkanRenderer)
+    : m_vulkanRenderer{vulkanRenderer}
+    , m_workerCount{}
+{
+}
+
+CommandRecorder::~CommandRecorder()
+{
+    destroy();
+}
+
+void CommandRecorder::create(int frameCount, int workerCount)
+{
+    qDebug() << "Create command recorder, frames: " << frameCount << ", workers: " << workerCount;
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+
+    m_workerCount = workerCount;
+    m_workerFrames.resize(frameCount * workerCount);
+    for (auto &workerFrame : m_workerFrames) {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = m_vulkanRenderer->surface()->graphicsQueueFamilyIndex();
+        VulkanRenderer::checkVkResult(devFuncs->vkCreateCommandPool(device, &poolInfo, nullptr, &workerFrame.commandPool),
+                                      "failed to create worker command pool");
+    }
+}
+
+void CommandRecorder::destroy()
+{
+    if (m_workerFrames.isEmpty()) {
+        return;
+    }
+    qDebug() << "Destroy command recorder";
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    for (auto &workerFrame : m_workerFrames) {
+        devFuncs->vkDestroyCommandPool(device, workerFrame.commandPool, nullptr);
+    }
+    m_workerFrames.clear();
+    m_workerCount = 0;
+}
+
+QVector<VkCommandBuffer> CommandRecorder::record(int frameIndex, const VkCommandBufferInheritanceInfo &inheritanceInfo, const std::vector<RecordTask> &tasks)
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    auto *frameWorkers = m_workerFrames.data() + frameIndex * m_workerCount;
+    for (int workerIndex = 0; workerIndex < m_workerCount; ++workerIndex) {
+        auto &workerFrame = frameWorkers[workerIndex];
+        VulkanRenderer::checkVkResult(devFuncs->vkResetCommandPool(device, workerFrame.commandPool, {}),
+                                      "failed to reset worker command pool");
+        workerFrame.usedCommandBuffers = 0;
+    }
+
+    QVector<VkCommandBuffer> commandBuffers(static_cast<int>(tasks.size()));
+    auto *taskCommandBuffers = commandBuffers.data();
+    JobSystem::instance().parallelFor(static_cast<int>(tasks.size()), m_workerCount, [&, this](int workerIndex, int taskIndex) {
+        PROFILE_ZONE("CommandRecorder::recordTask");
+        VkCommandBuffer commandBuffer = nextCommandBuffer(frameWorkers[workerIndex]);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = static_cast<VkCommandBufferUsageFlags>(VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)
+                | VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+        VulkanRenderer::checkVkResult(devFuncs->vkBeginCommandBuffer(commandBuffer, &beginInfo),
+                                      "failed to begin secondary command buffer");
+        tasks[taskIndex](commandBuffer);
+        VulkanRenderer::checkVkResult(devFuncs->vkEndCommandBuffer(commandBuffer),
+                                      "failed to end secondary command buffer");
+        taskCommandBuffers[taskIndex] = commandBuffer;
+    });
+    return commandBuffers;
+}
+
+VkCommandBuffer CommandRecorder::nextCommandBuffer(WorkerFrame &workerFrame) const
+{
+    if (workerFrame.usedCommandBuffers == workerFrame.commandBuffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = workerFrame.commandPool;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer{};
+        VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkAllocateCommandBuffers(m_vulkanRenderer->device(), &allocInfo, &commandBuffer),
+                                      "failed to allocate secondary command buffer");
+        workerFrame.commandBuffers << commandBuffer;
+    }
+    return workerFrame.commandBuffers.at(workerFrame.usedCommandBuffers++);
+}
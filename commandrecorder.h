@@ -0,0 +1,49 @@
+#ifndef COMMANDRECORDER_H
+#define COMMANDRECORDER_H
+
+#include <QVector>
+#include <QVulkanInstance>
+
+#include <functional>
+#include <vector>
+
+class VulkanRenderer;
+
+// Records secondary command buffers on the jobs of the JobSystem, every worker index owns a command pool per frame
+class CommandRecorder
+{
+public:
+    using RecordTask = std::function<void(VkCommandBuffer commandBuffer)>;
+
+    explicit CommandRecorder(VulkanRenderer *vulkanRenderer);
+
+    CommandRecorder(const CommandRecorder &) = delete;
+    CommandRecorder(CommandRecorder &&) = delete;
+    CommandRecorder &operator=(const CommandRecorder &) = delete;
+    CommandRecorder &operator=(CommandRecorder &&) = delete;
+
+    ~CommandRecorder();
+
+    void create(int frameCount, int workerCount);
+    void destroy();
+
+    // Records every task into its own secondary command buffer, the result keeps the order of tasks
+    [[nodiscard]] QVector<VkCommandBuffer> record(int frameIndex, const VkCommandBufferInheritanceInfo &inheritanceInfo, const std::vector<RecordTask> &tasks);
+
+private:
+    struct WorkerFrame
+    {
+        VkCommandPool commandPool;
+        QVector<VkCommandBuffer> commandBuffers;
+        int usedCommandBuffers;
+    };
+
+    VulkanRenderer *m_vulkanRenderer;
+    int m_workerCount;
+    // Indexed by frameIndex * m_workerCount + workerIndex, every worker records only into its own pools
+    QVector<WorkerFrame> m_workerFrames;
+
+    [[nodiscard]] VkCommandBuffer nextCommandBuffer(WorkerFrame &workerFrame) const;
+};
+
+#endif // COMMANDRECORDER_H
@@ -0,0 +1,88 @@
+#include "assetpackwriter.h"
+
+#include "assetpack.h"
+#include "lz4codec.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+[[nodiscard]] constexpr uint64_t alignBlobOffset(uint64_t offset)
+{
+    return (offset + assetPackBlobAlignment - 1) & ~(assetPackBlobAlignment - 1);
+}
+}
+
+QByteArray writeAssetPack(QVector<PackedAsset> assets, bool compress, uint64_t contentHash)
+{
+    // Sorted by the UTF-8 bytes, which is the order AssetPack searches in
+    QVector<QByteArray> names{};
+    names.reserve(assets.size());
+    for (const auto &asset : qAsConst(assets)) {
+        names << asset.name.toUtf8();
+    }
+    QVector<int> order(assets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&names](int a, int b) { return names.at(a) < names.at(b); });
+    for (int i = 1; i < order.size(); ++i) {
+        if (names.at(order.at(i - 1)) == names.at(order.at(i))) {
+            throw std::runtime_error{"asset packed twice"};
+        }
+    }
+
+    QByteArray namesData{};
+    QVector<AssetPackEntry> entries{};
+    QVector<QByteArray> blobs{};
+    uint64_t namesOffset = sizeof(AssetPackHeader) + order.size() * sizeof(AssetPackEntry);
+    for (auto index : qAsConst(order)) {
+        const auto &name = names.at(index);
+        if (name.size() > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error{"asset name too long"};
+        }
+        auto blob = assets.at(index).data;
+        AssetPackEntry entry{};
+        entry.size = static_cast<uint64_t>(blob.size());
+        entry.codec = static_cast<uint16_t>(AssetPack::Codec::NONE);
+        if (compress) {
+            auto compressed = lz4Compress(blob);
+            if (compressed.size() <= blob.size() - blob.size() / 8) {
+                blob = compressed;
+                entry.codec = static_cast<uint16_t>(AssetPack::Codec::LZ4);
+            }
+        }
+        entry.storedSize = static_cast<uint64_t>(blob.size());
+        entry.nameOffset = static_cast<uint32_t>(namesData.size());
+        entry.nameSize = static_cast<uint16_t>(name.size());
+        namesData += name;
+        qDebug() << "Pack " << name << ": " << entry.size << " bytes, stored " << entry.storedSize;
+        entries << entry;
+        blobs << blob;
+    }
+    uint64_t offset = namesOffset + namesData.size();
+    for (auto &entry : entries) {
+        offset = alignBlobOffset(offset);
+        entry.offset = offset;
+        offset += entry.storedSize;
+    }
+
+    AssetPackHeader header{};
+    header.magic = assetPackMagic;
+    header.version = assetPackVersion;
+    header.contentHash = contentHash;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.namesSize = static_cast<uint32_t>(namesData.size());
+    header.namesOffset = namesOffset;
+    QByteArray result(static_cast<int>(offset), char{});
+    std::memcpy(result.data(), &header, sizeof(header));
+    std::memcpy(result.data() + sizeof(header), entries.constData(), entries.size() * sizeof(AssetPackEntry));
+    std::memcpy(result.data() + namesOffset, namesData.constData(), namesData.size());
+    for (int i = 0; i < entries.size(); ++i) {
+        std::memcpy(result.data() + entries.at(i).offset, blobs.at(i).constData(), blobs.at(i).size());
+    }
+    return result;
+}
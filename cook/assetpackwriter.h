@@ -0,0 +1,21 @@
+#ifndef ASSETPACKWRITER_H
+#define ASSETPACKWRITER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <cstdint>
+
+struct PackedAsset
+{
+    // Looked up by AssetPack::data
+    QString name;
+    QByteArray data;
+};
+
+// Builds an asset pack of the assets in any order. With compress every blob LZ4 shrinks by an eighth or more is stored
+// compressed, which trades the zero copy lookup for a smaller file.
+[[nodiscard]] QByteArray writeAssetPack(QVector<PackedAsset> assets, bool compress, uint64_t contentHash);
+
+#endif // ASSETPACKWRITER_H
@@ -0,0 +1,134 @@
+#include "assetpackwriter.h"
+#include "meshcooker.h"
+#include "texturecooker.h"
+
+#include "assetpack.h"
+#include "cookedasset.h"
+#include "model.h"
+#include "utils.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+const QString modelKind = QStringLiteral("model");
+const QString textureKind = QStringLiteral("texture");
+const QString packKind = QStringLiteral("pack");
+
+// Input content, the kind and the cooker version: a new cooker rebuilds only what it cooks differently
+[[nodiscard]] uint64_t sourceHash(const QString &kind, const QByteArray &source)
+{
+    QCryptographicHash hash{QCryptographicHash::Algorithm::Sha256};
+    hash.addData(kind.toUtf8());
+    auto version = qToLittleEndian(cookedAssetVersion);
+    hash.addData(reinterpret_cast<const char *>(&version), sizeof(version));
+    hash.addData(source);
+    // Same truncation as the shader hashes of embedspirv.cmake
+    return qFromBigEndian<quint64>(hash.result().constData());
+}
+
+void writeCooked(const QString &fileName, const QByteArray &cooked)
+{
+    QSaveFile file{fileName};
+    if (!file.open(QFile::OpenModeFlag::WriteOnly) || file.write(cooked) != cooked.size() || !file.commit()) {
+        throw std::runtime_error{"can not write cooked asset"};
+    }
+}
+
+// Inputs are named by their paths relative to baseDirName, the hash covers the names, the contents and the codec
+void cookPack(const QString &output, const QString &baseDirName, const QStringList &inputs, bool compress)
+{
+    QDir baseDir{baseDirName};
+    QVector<PackedAsset> assets{};
+    QCryptographicHash hash{QCryptographicHash::Algorithm::Sha256};
+    hash.addData(compress ? QByteArrayLiteral("lz4") : QByteArrayLiteral("none"));
+    auto version = qToLittleEndian(assetPackVersion);
+    hash.addData(reinterpret_cast<const char *>(&version), sizeof(version));
+    auto sortedInputs = inputs;
+    sortedInputs.sort();
+    for (const auto &input : qAsConst(sortedInputs)) {
+        PackedAsset asset{QDir::fromNativeSeparators(baseDir.relativeFilePath(input)), readFile(input)};
+        if (asset.name.startsWith(QStringLiteral("../"))) {
+            throw std::runtime_error{"packed file outside of the base directory"};
+        }
+        auto name = asset.name.toUtf8();
+        auto nameSize = qToLittleEndian(static_cast<quint32>(name.size()));
+        hash.addData(reinterpret_cast<const char *>(&nameSize), sizeof(nameSize));
+        hash.addData(name);
+        hash.addData(asset.data);
+        assets << asset;
+    }
+    auto contentHash = qFromBigEndian<quint64>(hash.result().constData());
+    if (AssetPack::contentHash(output) == contentHash) {
+        std::printf("%s is up to date\n", qPrintable(output));
+        return;
+    }
+    writeCooked(output, writeAssetPack(std::move(assets), compress, contentHash));
+    std::printf("Packed %s\n", qPrintable(output));
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a{argc, argv};
+    QCoreApplication::setApplicationName(QStringLiteral("vktutor2_cook"));
+
+    QCommandLineParser parser{};
+    parser.setApplicationDescription(QStringLiteral("Cooks an asset into the binary form the renderer loads, or packs cooked assets.\n"
+                                                    "  vktutor2_cook model|texture <input> <output>\n"
+                                                    "  vktutor2_cook [--lz4] pack <output> <base dir> <input>..."));
+    parser.addHelpOption();
+    QCommandLineOption verboseOption{QStringLiteral("verbose"), QStringLiteral("Log the cooking steps.")};
+    QCommandLineOption lz4Option{QStringLiteral("lz4"), QStringLiteral("Store the packed files LZ4 compressed when that makes them smaller.")};
+    parser.addOptions({verboseOption, lz4Option});
+    parser.addPositionalArgument(QStringLiteral("kind"), QStringLiteral("model (Wavefront OBJ), texture (any image Qt reads) or pack."));
+    parser.addPositionalArgument(QStringLiteral("arguments"), QStringLiteral("Input and output, or the pack, its base directory and the inputs."));
+    parser.process(a);
+
+    auto arguments = parser.positionalArguments();
+    const auto &kind = arguments.value(0);
+    bool pack = kind == packKind && arguments.size() >= 3;
+    if (!pack && (arguments.size() != 3 || (kind != modelKind && kind != textureKind))) {
+        parser.showHelp(1);
+    }
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false"));
+    }
+    const auto &input = arguments.at(1);
+    const auto &output = arguments.at(2);
+
+    try {
+        if (pack) {
+            cookPack(arguments.at(1), arguments.at(2), arguments.mid(3), parser.isSet(lz4Option));
+            return 0;
+        }
+        bool model = kind == modelKind;
+        // Rewriting an unchanged output would rebuild the resources depending on it
+        auto hash = sourceHash(kind, readFile(input));
+        if (cookedSourceHash(output, model ? cookedMeshMagic : cookedTextureMagic) == hash) {
+            std::printf("%s is up to date\n", qPrintable(output));
+            return 0;
+        }
+        if (model) {
+            QFileInfo inputInfo{input};
+            writeCooked(output, cookMesh(Model::loadModel(inputInfo.absolutePath(), inputInfo.fileName()), hash));
+        } else {
+            writeCooked(output, cookTexture(loadTextureImage(input), hash));
+        }
+        std::printf("Cooked %s\n", qPrintable(output));
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "cooking %s failed: %s\n", qPrintable(input), e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include "meshcooker.h"
+
+#include "cookedasset.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+// Small enough for the caches of older GPUs, bigger caches still profit from the ordering
+constexpr int postTransformCacheSize = 16;
+constexpr float unorm16Max = 65535.0F;
+constexpr float snorm16Max = 32767.0F;
+constexpr uint32_t noVertex = std::numeric_limits<uint32_t>::max();
+
+using VertexKey = std::array<uint64_t, 2>;
+
+struct VertexKeyHash
+{
+    std::size_t operator()(const VertexKey &key) const noexcept
+    {
+        // combiner taken from N3876 / boost::hash_combine
+        auto hash = std::hash<uint64_t>{}(key[0]);
+        return hash ^ (std::hash<uint64_t>{}(key[1]) + 0x9e3779b97f4a7c15ULL + (hash << 6U) + (hash >> 2U));
+    }
+};
+
+struct Quantization
+{
+    glm::vec3 positionMin;
+    glm::vec3 positionScale;
+    glm::vec2 texCoordMin;
+    glm::vec2 texCoordScale;
+};
+
+[[nodiscard]] Quantization quantizationOf(const QVector<TexVertex> &vertices)
+{
+    glm::vec3 positionMin{std::numeric_limits<float>::max()};
+    glm::vec3 positionMax{std::numeric_limits<float>::lowest()};
+    glm::vec2 texCoordMin{std::numeric_limits<float>::max()};
+    glm::vec2 texCoordMax{std::numeric_limits<float>::lowest()};
+    for (const auto &vertex : vertices) {
+        positionMin = glm::min(positionMin, vertex.pos);
+        positionMax = glm::max(positionMax, vertex.pos);
+        texCoordMin = glm::min(texCoordMin, vertex.texCoord);
+        texCoordMax = glm::max(texCoordMax, vertex.texCoord);
+    }
+    return {positionMin, (positionMax - positionMin) / unorm16Max, texCoordMin, (texCoordMax - texCoordMin) / unorm16Max};
+}
+
+[[nodiscard]] uint16_t quantizeUnorm(float value, float min, float scale)
+{
+    if (scale <= 0.0F) {
+        return 0;
+    }
+    return static_cast<uint16_t>(std::clamp(std::round((value - min) / scale), 0.0F, unorm16Max));
+}
+
+[[nodiscard]] std::array<int16_t, 2> encodeOctahedral(const glm::vec3 &normal)
+{
+    glm::vec3 n = normal / std::max(std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z), 1e-20F);
+    glm::vec2 e{n.x, n.y};
+    // The lower hemisphere is folded over the diagonals
+    if (n.z < 0.0F) {
+        e = glm::vec2{(1.0F - std::abs(n.y)) * (n.x >= 0.0F ? 1.0F : -1.0F), (1.0F - std::abs(n.x)) * (n.y >= 0.0F ? 1.0F : -1.0F)};
+    }
+    return {static_cast<int16_t>(std::round(std::clamp(e.x, -1.0F, 1.0F) * snorm16Max)),
+            static_cast<int16_t>(std::round(std::clamp(e.y, -1.0F, 1.0F) * snorm16Max))};
+}
+
+[[nodiscard]] QuantizedVertex quantize(const TexVertex &vertex, const Quantization &quantization)
+{
+    QuantizedVertex result{};
+    for (int i = 0; i < 3; ++i) {
+        result.position[i] = quantizeUnorm(vertex.pos[i], quantization.positionMin[i], quantization.positionScale[i]);
+    }
+    result.normal = encodeOctahedral(vertex.normal);
+    for (int i = 0; i < 2; ++i) {
+        result.texCoord[i] = quantizeUnorm(vertex.texCoord[i], quantization.texCoordMin[i], quantization.texCoordScale[i]);
+    }
+    return result;
+}
+
+[[nodiscard]] glm::vec3 dequantizedPosition(const QuantizedVertex &vertex, const Quantization &quantization)
+{
+    return quantization.positionMin + quantization.positionScale * glm::vec3{vertex.position[0], vertex.position[1], vertex.position[2]};
+}
+
+// Source vertices which differ below the quantization step end up equal, they are merged
+void quantizeVertices(const Model &model, const Quantization &quantization, QVector<QuantizedVertex> &vertices, QVector<uint32_t> &indices)
+{
+    QVector<uint32_t> remap{};
+    remap.reserve(model.vertices.size());
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> uniqueVertices{};
+    for (const auto &vertex : model.vertices) {
+        auto quantized = quantize(vertex, quantization);
+        VertexKey key{};
+        std::memcpy(key.data(), &quantized, sizeof(quantized));
+        auto [iUnique, inserted] = uniqueVertices.try_emplace(key, static_cast<uint32_t>(vertices.size()));
+        if (inserted) {
+            vertices << quantized;
+        }
+        remap << iUnique->second;
+    }
+    indices.reserve(model.indices.size());
+    for (auto index : model.indices) {
+        indices << remap.at(static_cast<int>(index));
+    }
+}
+
+// Stores the vertices in the order the indices first use them, drops the unused ones
+void optimizeVertexFetch(QVector<QuantizedVertex> &vertices, QVector<uint32_t> &indices)
+{
+    QVector<uint32_t> remap(vertices.size(), noVertex);
+    QVector<QuantizedVertex> result{};
+    result.reserve(vertices.size());
+    for (auto &index : indices) {
+        auto &newIndex = remap[static_cast<int>(index)];
+        if (newIndex == noVertex) {
+            newIndex = static_cast<uint32_t>(result.size());
+            result << vertices.at(static_cast<int>(index));
+        }
+        index = newIndex;
+    }
+    vertices.swap(result);
+}
+
+template<typename T>
+void writeSection(QByteArray &data, uint64_t offset, const QVector<T> &section)
+{
+    std::memcpy(data.data() + offset, section.constData(), section.size() * sizeof(T));
+}
+}
+
+QVector<uint32_t> optimizeVertexCache(const QVector<uint32_t> &indices, int vertexCount, int cacheSize)
+{
+    auto triangleCount = indices.size() / 3;
+    // Triangles around every vertex, a triangle is listed once per corner
+    QVector<int> adjacencyOffsets(vertexCount + 1, 0);
+    for (auto index : indices) {
+        ++adjacencyOffsets[static_cast<int>(index) + 1];
+    }
+    std::partial_sum(adjacencyOffsets.cbegin(), adjacencyOffsets.cend(), adjacencyOffsets.begin());
+    QVector<int> adjacency(triangleCount * 3);
+    {
+        auto fill = adjacencyOffsets;
+        for (int i = 0; i < triangleCount * 3; ++i) {
+            adjacency[fill[static_cast<int>(indices.at(i))]++] = i / 3;
+        }
+    }
+    QVector<int> liveTriangles(vertexCount);
+    for (int vertex = 0; vertex < vertexCount; ++vertex) {
+        liveTriangles[vertex] = adjacencyOffsets.at(vertex + 1) - adjacencyOffsets.at(vertex);
+    }
+
+    QVector<int> cacheTimes(vertexCount, 0);
+    QVector<bool> emitted(triangleCount, false);
+    QVector<int> deadEnd{};
+    QVector<int> candidates{};
+    QVector<uint32_t> result{};
+    result.reserve(triangleCount * 3);
+    int time = cacheSize + 1;
+    int cursor = 0;
+    int fanning = vertexCount > 0 ? 0 : -1;
+    while (fanning >= 0) {
+        candidates.clear();
+        for (int i = adjacencyOffsets.at(fanning); i < adjacencyOffsets.at(fanning + 1); ++i) {
+            auto triangle = adjacency.at(i);
+            if (emitted.at(triangle)) {
+                continue;
+            }
+            emitted[triangle] = true;
+            for (int corner = 0; corner < 3; ++corner) {
+                auto vertex = static_cast<int>(indices.at(triangle * 3 + corner));
+                result << static_cast<uint32_t>(vertex);
+                deadEnd << vertex;
+                candidates << vertex;
+                --liveTriangles[vertex];
+                if (time - cacheTimes.at(vertex) > cacheSize) {
+                    cacheTimes[vertex] = time++;
+                }
+            }
+        }
+
+        // The candidate which stays in the cache the longest while its remaining triangles are emitted
+        fanning = -1;
+        int bestPriority = -1;
+        for (auto vertex : qAsConst(candidates)) {
+            if (liveTriangles.at(vertex) <= 0) {
+                continue;
+            }
+            int priority{};
+            if (time - cacheTimes.at(vertex) + 2 * liveTriangles.at(vertex) <= cacheSize) {
+                priority = time - cacheTimes.at(vertex);
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanning = vertex;
+            }
+        }
+        // Dead end: the most recently used vertex with triangles left, any vertex with triangles left after that
+        while (fanning < 0 && !deadEnd.isEmpty()) {
+            auto vertex = deadEnd.takeLast();
+            if (liveTriangles.at(vertex) > 0) {
+                fanning = vertex;
+            }
+        }
+        for (; fanning < 0 && cursor < vertexCount; ++cursor) {
+            if (liveTriangles.at(cursor) > 0) {
+                fanning = cursor;
+            }
+        }
+    }
+    return result;
+}
+
+QByteArray cookMesh(const Model &model, uint64_t sourceHash)
+{
+    if (model.vertices.isEmpty() || model.indices.size() % 3 != 0) {
+        throw std::runtime_error{"model has no triangle list"};
+    }
+    auto quantization = quantizationOf(model.vertices);
+    QVector<QuantizedVertex> vertices{};
+    QVector<uint32_t> indices{};
+    quantizeVertices(model, quantization, vertices, indices);
+    indices = optimizeVertexCache(indices, vertices.size(), postTransformCacheSize);
+    optimizeVertexFetch(vertices, indices);
+    qDebug() << "Cooked vertices: " << vertices.size() << " of " << model.vertices.size() << ", indices: " << indices.size();
+
+    // Bounds of what the runtime dequantizes, not of the source
+    glm::vec3 boundsMin{std::numeric_limits<float>::max()};
+    glm::vec3 boundsMax{std::numeric_limits<float>::lowest()};
+    for (const auto &vertex : qAsConst(vertices)) {
+        auto position = dequantizedPosition(vertex, quantization);
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    glm::vec3 center{0.5F * (boundsMin + boundsMax)};
+    float radius{};
+    for (const auto &vertex : qAsConst(vertices)) {
+        radius = std::max(radius, glm::distance(center, dequantizedPosition(vertex, quantization)));
+    }
+
+    CookedMeshHeader header{};
+    header.asset = {cookedMeshMagic, cookedAssetVersion, sourceHash};
+    header.vertexCount = static_cast<uint32_t>(vertices.size());
+    header.indexCount = static_cast<uint32_t>(indices.size());
+    header.occluderVertexCount = static_cast<uint32_t>(model.occluderVertices.size());
+    header.occluderIndexCount = static_cast<uint32_t>(model.occluderIndices.size());
+    header.positionMin = {quantization.positionMin.x, quantization.positionMin.y, quantization.positionMin.z};
+    header.positionScale = {quantization.positionScale.x, quantization.positionScale.y, quantization.positionScale.z};
+    header.texCoordMin = {quantization.texCoordMin.x, quantization.texCoordMin.y};
+    header.texCoordScale = {quantization.texCoordScale.x, quantization.texCoordScale.y};
+    header.boundsMin = {boundsMin.x, boundsMin.y, boundsMin.z};
+    header.boundsMax = {boundsMax.x, boundsMax.y, boundsMax.z};
+    header.boundingSphere = {center.x, center.y, center.z, radius};
+    header.verticesOffset = alignCookedOffset(sizeof(header));
+    header.indicesOffset = alignCookedOffset(header.verticesOffset + vertices.size() * sizeof(QuantizedVertex));
+    header.occluderVerticesOffset = alignCookedOffset(header.indicesOffset + indices.size() * sizeof(uint32_t));
+    header.occluderIndicesOffset = alignCookedOffset(header.occluderVerticesOffset + model.occluderVertices.size() * sizeof(CookedPosition));
+    auto size = header.occluderIndicesOffset + model.occluderIndices.size() * sizeof(uint32_t);
+
+    QByteArray result(static_cast<int>(size), char{});
+    std::memcpy(result.data(), &header, sizeof(header));
+    writeSection(result, header.verticesOffset, vertices);
+    writeSection(result, header.indicesOffset, indices);
+    QVector<CookedPosition> occluderVertices{};
+    occluderVertices.reserve(model.occluderVertices.size());
+    for (const auto &vertex : model.occluderVertices) {
+        occluderVertices << CookedPosition{vertex.x, vertex.y, vertex.z};
+    }
+    writeSection(result, header.occluderVerticesOffset, occluderVertices);
+    writeSection(result, header.occluderIndicesOffset, model.occluderIndices);
+    return result;
+}
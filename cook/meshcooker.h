@@ -0,0 +1,19 @@
+#ifndef MESHCOOKER_H
+#define MESHCOOKER_H
+
+#include "model.h"
+
+#include <QByteArray>
+#include <QVector>
+
+#include <cstdint>
+
+// Quantizes the vertices, merges the ones which became equal, orders the triangles for the post transform cache and
+// the vertices by first use, and stores the result with its bounds in the cooked mesh format
+[[nodiscard]] QByteArray cookMesh(const Model &model, uint64_t sourceHash);
+
+// Tipsify of Sander, Nehab and Barczak: walks the fans of vertices still in the cache, so neighbouring triangles share
+// transformed vertices. Returns the reordered triangle list.
+[[nodiscard]] QVector<uint32_t> optimizeVertexCache(const QVector<uint32_t> &indices, int vertexCount, int cacheSize);
+
+#endif // MESHCOOKER_H
@@ -0,0 +1,110 @@
+#include "texturecooker.h"
+
+#include "cookedasset.h"
+
+#include <QDebug>
+#include <QVector>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+constexpr int channelCount = 4;
+constexpr int alphaChannel = 3;
+
+[[nodiscard]] std::array<float, 256> linearTable()
+{
+    std::array<float, 256> result{};
+    for (size_t i = 0; i < result.size(); ++i) {
+        auto value = static_cast<float>(i) / 255.0F;
+        result[i] = value <= 0.04045F ? value / 12.92F : std::pow((value + 0.055F) / 1.055F, 2.4F);
+    }
+    return result;
+}
+
+[[nodiscard]] uint8_t toSrgb(float value)
+{
+    value = value <= 0.0031308F ? value * 12.92F : 1.055F * std::pow(value, 1.0F / 2.4F) - 0.055F;
+    return static_cast<uint8_t>(std::clamp(std::round(value * 255.0F), 0.0F, 255.0F));
+}
+
+// Averages 2x2 texels of the level above, odd sizes drop its last row and column, a side of one texel is repeated
+[[nodiscard]] QVector<float> downsample(const QVector<float> &source, int sourceWidth, int sourceHeight, int width, int height)
+{
+    QVector<float> result(width * height * channelCount);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            for (int channel = 0; channel < channelCount; ++channel) {
+                auto texel = [&](int dx, int dy) {
+                    auto sourceX = std::min(2 * x + dx, sourceWidth - 1);
+                    auto sourceY = std::min(2 * y + dy, sourceHeight - 1);
+                    return source.at((sourceY * sourceWidth + sourceX) * channelCount + channel);
+                };
+                result[(y * width + x) * channelCount + channel] = 0.25F * (texel(0, 0) + texel(1, 0) + texel(0, 1) + texel(1, 1));
+            }
+        }
+    }
+    return result;
+}
+
+// sRGB encoded color, linear alpha
+void storeLevel(const QVector<float> &linear, uint8_t *texels)
+{
+    for (int i = 0; i < linear.size(); ++i) {
+        texels[i] = i % channelCount == alphaChannel
+                ? static_cast<uint8_t>(std::clamp(std::round(linear.at(i) * 255.0F), 0.0F, 255.0F))
+                : toSrgb(linear.at(i));
+    }
+}
+}
+
+QByteArray cookTexture(const QImage &image, uint64_t sourceHash)
+{
+    if (image.isNull() || image.format() != QImage::Format::Format_RGBA8888) {
+        throw std::runtime_error{"texture must be RGBA8888"};
+    }
+    QVector<CookedTextureLevel> levels{};
+    int width = image.width();
+    int height = image.height();
+    auto levelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+    uint64_t offset = alignCookedOffset(sizeof(CookedTextureHeader) + levelCount * sizeof(CookedTextureLevel));
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        auto size = static_cast<uint64_t>(width) * height * channelCount;
+        levels << CookedTextureLevel{static_cast<uint32_t>(width), static_cast<uint32_t>(height), offset, size};
+        offset = alignCookedOffset(offset + size);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    qDebug() << "Cooked levels: " << levels.size() << ", bytes: " << offset;
+
+    CookedTextureHeader header{};
+    header.asset = {cookedTextureMagic, cookedAssetVersion, sourceHash};
+    header.format = VkFormat::VK_FORMAT_R8G8B8A8_SRGB;
+    header.levelCount = levelCount;
+    QByteArray result(static_cast<int>(offset), char{});
+    std::memcpy(result.data(), &header, sizeof(header));
+    std::memcpy(result.data() + sizeof(header), levels.constData(), levels.size() * sizeof(CookedTextureLevel));
+
+    // Level 0 is stored as it is, the others from the linear values of the level above
+    static const auto toLinear = linearTable();
+    const auto &base = levels.constFirst();
+    QVector<float> linear(static_cast<int>(base.size));
+    for (uint32_t y = 0; y < base.height; ++y) {
+        const auto *line = image.constScanLine(static_cast<int>(y));
+        std::memcpy(result.data() + base.offset + y * base.width * channelCount, line, base.width * channelCount);
+        for (uint32_t i = 0; i < base.width * channelCount; ++i) {
+            linear[static_cast<int>(y * base.width * channelCount + i)] = i % channelCount == alphaChannel ? static_cast<float>(line[i]) / 255.0F : toLinear.at(line[i]);
+        }
+    }
+    for (int level = 1; level < levels.size(); ++level) {
+        const auto &above = levels.at(level - 1);
+        const auto &current = levels.at(level);
+        linear = downsample(linear, static_cast<int>(above.width), static_cast<int>(above.height), static_cast<int>(current.width),
+                            static_cast<int>(current.height));
+        storeLevel(linear, reinterpret_cast<uint8_t *>(result.data() + current.offset));
+    }
+    return result;
+}
@@ -0,0 +1,13 @@
+#ifndef TEXTURECOOKER_H
+#define TEXTURECOOKER_H
+
+#include <QByteArray>
+#include <QImage>
+
+#include <cstdint>
+
+// Stores the full mip chain of an sRGB RGBA8888 image in the cooked texture format. Levels are box filtered in linear
+// space and round their sizes down, like the chains built at runtime.
+[[nodiscard]] QByteArray cookTexture(const QImage &image, uint64_t sourceHash);
+
+#endif // TEXTURECOOKER_H
@@ -0,0 +1,186 @@
+#include "cookedasset.h"
+
+#include "cpuprofiler.h"
+#include "utils.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN, "cooked assets are read in place, they need a little endian host");
+
+namespace {
+const QString cookedModelSuffix = QStringLiteral("mesh");
+const QString cookedTextureSuffix = QStringLiteral("tex");
+
+constexpr float snorm16Max = 32767.0F;
+// Cooked textures hold RGBA8 texels in either color space
+constexpr uint64_t cookedTexelSize = 4;
+
+// Copies count elements at offset, throws when they are not inside of the data
+template<typename T>
+void readSection(const QByteArray &data, uint64_t offset, uint64_t count, T *result)
+{
+    if (offset > static_cast<uint64_t>(data.size()) || count > (static_cast<uint64_t>(data.size()) - offset) / sizeof(T)) {
+        throw std::runtime_error{"truncated cooked asset"};
+    }
+    std::memcpy(result, data.constData() + offset, count * sizeof(T));
+}
+
+template<typename Header>
+[[nodiscard]] Header readHeader(const QByteArray &data, uint32_t magic)
+{
+    Header header{};
+    readSection(data, 0, 1, &header);
+    if (header.asset.magic != magic || header.asset.version != cookedAssetVersion) {
+        throw std::runtime_error{"not a cooked asset of this version"};
+    }
+    return header;
+}
+
+[[nodiscard]] glm::vec3 decodeOctahedral(const std::array<int16_t, 2> &encoded)
+{
+    glm::vec2 e{std::max(static_cast<float>(encoded[0]) / snorm16Max, -1.0F), std::max(static_cast<float>(encoded[1]) / snorm16Max, -1.0F)};
+    glm::vec3 n{e.x, e.y, 1.0F - std::abs(e.x) - std::abs(e.y)};
+    // The lower hemisphere is folded over the diagonals
+    float t = std::max(-n.z, 0.0F);
+    n.x += n.x >= 0.0F ? -t : t;
+    n.y += n.y >= 0.0F ? -t : t;
+    return glm::normalize(n);
+}
+}
+
+TextureData TextureData::fromImage(QImage image, VkFormat format)
+{
+    TextureData result{};
+    result.format = format;
+    result.levels << CookedTextureLevel{static_cast<uint32_t>(image.width()), static_cast<uint32_t>(image.height()), 0,
+                                        static_cast<uint64_t>(image.sizeInBytes())};
+    result.image = std::move(image);
+    result.texels = QByteArray::fromRawData(reinterpret_cast<const char *>(result.image.constBits()), static_cast<int>(result.image.sizeInBytes()));
+    return result;
+}
+
+uint64_t cookedSourceHash(const QString &fileName, uint32_t magic)
+{
+    QFile file{fileName};
+    CookedAssetHeader header{};
+    if (!file.open(QFile::OpenModeFlag::ReadOnly)
+            || file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header)
+            || header.magic != magic || header.version != cookedAssetVersion) {
+        return 0;
+    }
+    return header.sourceHash;
+}
+
+Model loadCookedModel(const QByteArray &data)
+{
+    PROFILE_ZONE("loadCookedModel");
+    auto header = readHeader<CookedMeshHeader>(data, cookedMeshMagic);
+
+    QVector<QuantizedVertex> quantized(static_cast<int>(header.vertexCount));
+    readSection(data, header.verticesOffset, header.vertexCount, quantized.data());
+    Model result{};
+    result.indices.resize(static_cast<int>(header.indexCount));
+    readSection(data, header.indicesOffset, header.indexCount, result.indices.data());
+    QVector<CookedPosition> occluderVertices(static_cast<int>(header.occluderVertexCount));
+    readSection(data, header.occluderVerticesOffset, header.occluderVertexCount, occluderVertices.data());
+    result.occluderVertices.reserve(occluderVertices.size());
+    for (const auto &vertex : qAsConst(occluderVertices)) {
+        result.occluderVertices << glm::vec3{vertex[0], vertex[1], vertex[2]};
+    }
+    result.occluderIndices.resize(static_cast<int>(header.occluderIndexCount));
+    readSection(data, header.occluderIndicesOffset, header.occluderIndexCount, result.occluderIndices.data());
+    if (std::any_of(result.indices.cbegin(), result.indices.cend(), [&header](uint32_t index) { return index >= header.vertexCount; })
+            || std::any_of(result.occluderIndices.cbegin(), result.occluderIndices.cend(),
+                           [&header](uint32_t index) { return index >= header.occluderVertexCount; })) {
+        throw std::runtime_error{"cooked model index out of range"};
+    }
+
+    // The vertex input stays in floats, the quantization only shrinks the file
+    glm::vec3 positionMin{header.positionMin[0], header.positionMin[1], header.positionMin[2]};
+    glm::vec3 positionScale{header.positionScale[0], header.positionScale[1], header.positionScale[2]};
+    glm::vec2 texCoordMin{header.texCoordMin[0], header.texCoordMin[1]};
+    glm::vec2 texCoordScale{header.texCoordScale[0], header.texCoordScale[1]};
+    result.vertices.reserve(quantized.size());
+    for (const auto &vertex : qAsConst(quantized)) {
+        result.vertices << TexVertex{
+            positionMin + positionScale * glm::vec3{vertex.position[0], vertex.position[1], vertex.position[2]},
+            decodeOctahedral(vertex.normal),
+            texCoordMin + texCoordScale * glm::vec2{vertex.texCoord[0], vertex.texCoord[1]}
+        };
+    }
+    result.boundsMin = {header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]};
+    result.boundsMax = {header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]};
+    result.boundingSphere = {header.boundingSphere[0], header.boundingSphere[1], header.boundingSphere[2], header.boundingSphere[3]};
+
+    qDebug() << "Vertices: " << result.vertices.size() << ", indices: " << result.indices.size()
+             << ", occluder triangles: " << result.occluderIndices.size() / 3;
+    return result;
+}
+
+TextureData loadCookedTexture(QByteArray data, VkFormat format)
+{
+    PROFILE_ZONE("loadCookedTexture");
+    auto header = readHeader<CookedTextureHeader>(data, cookedTextureMagic);
+    if (header.levelCount == 0) {
+        throw std::runtime_error{"cooked texture without levels"};
+    }
+    if (header.format != static_cast<uint32_t>(format)) {
+        throw std::runtime_error{"cooked texture has an unexpected format"};
+    }
+
+    // The size of the first level bounds the level count before the table is read
+    CookedTextureLevel base{};
+    readSection(data, sizeof(header), 1, &base);
+    if (base.width == 0 || base.height == 0) {
+        throw std::runtime_error{"cooked texture without texels"};
+    }
+    if (header.levelCount > static_cast<uint32_t>(std::floor(std::log2(std::max(base.width, base.height)))) + 1) {
+        throw std::runtime_error{"cooked texture has more levels than its size allows"};
+    }
+
+    TextureData result{};
+    result.format = static_cast<VkFormat>(header.format);
+    result.levels.resize(static_cast<int>(header.levelCount));
+    readSection(data, sizeof(header), header.levelCount, result.levels.data());
+    auto dataSize = static_cast<uint64_t>(data.size());
+    for (int i = 0; i < result.levels.size(); ++i) {
+        const auto &level = result.levels.at(i);
+        if (level.width != std::max(1U, base.width >> i) || level.height != std::max(1U, base.height >> i)) {
+            throw std::runtime_error{"cooked texture level has an unexpected size"};
+        }
+        if (level.size != static_cast<uint64_t>(level.width) * level.height * cookedTexelSize) {
+            throw std::runtime_error{"cooked texture level has an unexpected byte count"};
+        }
+        if (level.offset > dataSize || level.size > dataSize - level.offset || level.offset % cookedSectionAlignment != 0) {
+            throw std::runtime_error{"truncated cooked asset"};
+        }
+    }
+    // The level offsets are from the start of the file, the upload copies the header along instead of the texels
+    result.texels = std::move(data);
+    return result;
+}
+
+Model loadModelFile(const QString &fileName)
+{
+    QFileInfo fileInfo{fileName};
+    if (fileInfo.suffix() == cookedModelSuffix) {
+        return loadCookedModel(readFile(fileName));
+    }
+    return Model::loadModel(fileInfo.absolutePath(), fileInfo.fileName());
+}
+
+TextureData loadTextureFile(const QString &fileName, VkFormat format)
+{
+    if (QFileInfo{fileName}.suffix() == cookedTextureSuffix) {
+        return loadCookedTexture(readFile(fileName), format);
+    }
+    return TextureData::fromImage(loadTextureImage(fileName), format);
+}
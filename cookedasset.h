@@ -0,0 +1,124 @@
+#ifndef COOKEDASSET_H
+#define COOKEDASSET_H
+
+#include "model.h"
+
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+#include <QVector>
+#include <QVulkanInstance>
+
+#include <array>
+#include <cstdint>
+
+// Binary assets written by vktutor2_cook at build time. Every section starts 16 byte aligned, multi byte values are
+// little endian. The source hash covers the input file and the cooker version, the cooker skips inputs whose output
+// already carries their hash.
+constexpr uint32_t cookedMeshMagic = 0x4853454dU; // "MESH"
+constexpr uint32_t cookedTextureMagic = 0x58455454U; // "TTEX"
+// Bumped with every change of the formats or of the cooking, so outputs of an older cooker get rebuilt
+constexpr uint32_t cookedAssetVersion = 3;
+constexpr uint64_t cookedSectionAlignment = 16;
+
+struct CookedAssetHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+};
+
+// Followed by the quantized vertices, the indices, the occluder vertices and the occluder indices
+struct CookedMeshHeader
+{
+    CookedAssetHeader asset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t occluderVertexCount;
+    uint32_t occluderIndexCount;
+    // Dequantized attribute = min + quantized * scale
+    std::array<float, 3> positionMin;
+    std::array<float, 3> positionScale;
+    std::array<float, 2> texCoordMin;
+    std::array<float, 2> texCoordScale;
+    std::array<float, 3> boundsMin;
+    std::array<float, 3> boundsMax;
+    // xyz - center, w - radius
+    std::array<float, 4> boundingSphere;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint64_t occluderVerticesOffset;
+    uint64_t occluderIndicesOffset;
+};
+
+// Half the size of TexVertex. Positions and texture coordinates are unorm16 within the ranges of the header, normals
+// are octahedral snorm16.
+struct QuantizedVertex
+{
+    std::array<uint16_t, 3> position;
+    uint16_t padding;
+    std::array<int16_t, 2> normal;
+    std::array<uint16_t, 2> texCoord;
+};
+
+// Occluder vertices are stored as three floats, glm::vec3 may be padded to 16 bytes
+using CookedPosition = std::array<float, 3>;
+
+struct CookedTextureLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Followed by levelCount CookedTextureLevel entries and the texels of the levels, biggest first. Level offsets are from
+// the start of the file.
+struct CookedTextureHeader
+{
+    CookedAssetHeader asset;
+    // VkFormat of the texels
+    uint32_t format;
+    uint32_t levelCount;
+};
+
+static_assert(sizeof(CookedMeshHeader) % cookedSectionAlignment == 0, "cooked mesh sections must stay aligned");
+static_assert(sizeof(QuantizedVertex) == 16, "quantized vertex must not be padded");
+static_assert(sizeof(CookedPosition) == 12, "cooked position must not be padded");
+static_assert(sizeof(CookedTextureHeader) == 24, "cooked texture header must not be padded");
+static_assert(sizeof(CookedTextureLevel) == 24, "cooked texture level must not be padded");
+
+// Texels ready for the upload into an image, a single level when the mip chain is left to the GPU
+struct TextureData
+{
+    VkFormat format;
+    QVector<CookedTextureLevel> levels;
+    // What the level offsets point into, starts with the header for a cooked file
+    QByteArray texels;
+    // Owns the texels of a decoded image file, texels refers to its bits without a copy
+    QImage image;
+
+    [[nodiscard]] uint32_t width() const { return levels.constFirst().width; }
+    [[nodiscard]] uint32_t height() const { return levels.constFirst().height; }
+    [[nodiscard]] bool hasMipmaps() const { return levels.size() > 1; }
+
+    [[nodiscard]] static TextureData fromImage(QImage image, VkFormat format);
+};
+
+[[nodiscard]] constexpr uint64_t alignCookedOffset(uint64_t offset)
+{
+    return (offset + cookedSectionAlignment - 1) & ~(cookedSectionAlignment - 1);
+}
+
+// Hash the cooker stored in the file, 0 when the file is missing or not a cooked asset of the current version
+[[nodiscard]] uint64_t cookedSourceHash(const QString &fileName, uint32_t magic);
+[[nodiscard]] Model loadCookedModel(const QByteArray &data);
+// The data has to outlive the returned texels, which refer to it without a copy. Throws on a texture cooked to another
+// format.
+[[nodiscard]] TextureData loadCookedTexture(QByteArray data, VkFormat format);
+
+// Cooked files by their .mesh and .tex suffixes, source files through the importers otherwise
+[[nodiscard]] Model loadModelFile(const QString &fileName);
+[[nodiscard]] TextureData loadTextureFile(const QString &fileName, VkFormat format);
+
+#endif // COOKEDASSET_H
@@ -0,0 +1,133 @@
+#include "cpuinstanceculler.h"
+
+#include "cpuprofiler.h"
+#include "frustum.h"
+#include "parallel.h"
+#include "vulkanrenderer.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+// The nearest instances hide the most, farther ones rarely add coverage worth their triangles
+constexpr int maxOccluders = 32;
+constexpr int testBatchSize = 1024;
+constexpr int reportInterval = 600;
+}
+
+CpuInstanceCuller::CpuInstanceCuller(VulkanRenderer *vulkanRenderer, const InstanceBuffer *instanceBuffer)
+    : m_vulkanRenderer{vulkanRenderer}
+    , m_instanceBuffer{instanceBuffer}
+    , m_visibleInstances{vulkanRenderer}
+    , m_boundsMin{}
+    , m_boundsMax{}
+    , m_stats{}
+    , m_reportedMs{}
+    , m_frames{}
+{
+}
+
+void CpuInstanceCuller::setModel(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, QVector<glm::vec3> occluderVertices, QVector<uint32_t> occluderIndices)
+{
+    m_boundsMin = boundsMin;
+    m_boundsMax = boundsMax;
+    m_occluderVertices = std::move(occluderVertices);
+    m_occluderIndices = std::move(occluderIndices);
+}
+
+void CpuInstanceCuller::initSwapChainResources()
+{
+    m_visibleInstances.create(m_vulkanRenderer->surface()->concurrentFrameCount());
+}
+
+void CpuInstanceCuller::update(int currentFrameIndex, const glm::mat4 &model, const glm::mat4 &projView)
+{
+    PROFILE_ZONE("CpuInstanceCuller::update");
+    QElapsedTimer timer{};
+    timer.start();
+
+    auto size = m_vulkanRenderer->surface()->swapChainImageSize();
+    m_occlusionBuffer.begin(projView, static_cast<float>(size.width()) / static_cast<float>(std::max(1, size.height())));
+
+    auto planes = frustumPlanes(projView);
+    glm::vec3 center{0.5F * (m_boundsMin + m_boundsMax)};
+    auto radius = 0.5F * glm::distance(m_boundsMin, m_boundsMax);
+    auto modelScale = std::max({glm::length(glm::vec3{model[0]}), glm::length(glm::vec3{model[1]}), glm::length(glm::vec3{model[2]})});
+    auto instanceCount = m_instanceBuffer->count();
+    m_candidates.clear();
+    for (int i = 0; i < instanceCount; ++i) {
+        const auto &instance = m_instanceBuffer->instance(i);
+        auto matrix = model * instance.matrix();
+        glm::vec3 worldCenter{matrix * glm::vec4{center, 1.0F}};
+        if (!sphereInFrustum(planes, worldCenter, radius * modelScale * instance.positionScale.w)) {
+            continue;
+        }
+        m_candidates.push_back({i, (projView * glm::vec4{worldCenter, 1.0F}).w, matrix});
+    }
+
+    auto candidateCount = static_cast<int>(m_candidates.size());
+    auto occluderCount = std::min(maxOccluders, candidateCount);
+    std::partial_sort(m_candidates.begin(), m_candidates.begin() + occluderCount, m_candidates.end(),
+                      [](const Candidate &a, const Candidate &b) { return a.depth < b.depth; });
+    m_occluderTransforms.clear();
+    for (int i = 0; i < occluderCount; ++i) {
+        m_occluderTransforms << m_candidates.at(i).matrix;
+    }
+    m_occlusionBuffer.renderOccluders(m_occluderVertices, m_occluderIndices, m_occluderTransforms);
+
+    m_candidateVisible.resize(candidateCount);
+    auto *candidateVisible = m_candidateVisible.data();
+    auto batchCount = (candidateCount + testBatchSize - 1) / testBatchSize;
+    parallelFor(batchCount, idealWorkerCount(batchCount), [&, this](int, int batch) {
+        auto end = std::min(candidateCount, (batch + 1) * testBatchSize);
+        for (int i = batch * testBatchSize; i < end; ++i) {
+            candidateVisible[i] = m_occlusionBuffer.isVisible(corners(m_candidates.at(i).matrix)) ? 1 : 0;
+        }
+    });
+
+    QVector<InstanceData> visibleInstances{};
+    visibleInstances.reserve(candidateCount);
+    for (int i = 0; i < candidateCount; ++i) {
+        if (m_candidateVisible.at(i) != 0) {
+            visibleInstances << m_instanceBuffer->instance(m_candidates.at(i).index);
+        }
+    }
+    auto drawnCount = static_cast<int>(visibleInstances.size());
+    m_visibleInstances.setInstances(std::move(visibleInstances));
+    m_visibleInstances.update(currentFrameIndex);
+
+    m_stats.instances = static_cast<uint32_t>(instanceCount);
+    m_stats.frustumCulled = static_cast<uint32_t>(instanceCount - candidateCount);
+    m_stats.occluded = static_cast<uint32_t>(candidateCount - drawnCount);
+    m_stats.drawn = static_cast<uint32_t>(drawnCount);
+    m_stats.cpuMs = static_cast<double>(timer.nsecsElapsed()) / 1e6;
+    m_reportedMs += m_stats.cpuMs;
+    if (++m_frames % reportInterval == 0) {
+        auto culledPercent = instanceCount > 0 ? 100.0 * (instanceCount - drawnCount) / instanceCount : 0.0;
+        qDebug() << "CPU culling, instances: " << m_stats.instances << ", frustum culled: " << m_stats.frustumCulled
+                 << ", occluded: " << m_stats.occluded << ", drawn: " << m_stats.drawn
+                 << ", culled: " << culledPercent << "%, occluder triangles: " << m_occlusionBuffer.triangleCount()
+                 << ", average cost: " << m_reportedMs / reportInterval << " ms";
+        m_reportedMs = 0.0;
+    }
+}
+
+void CpuInstanceCuller::releaseSwapChainResources()
+{
+    m_visibleInstances.destroy();
+}
+
+std::array<glm::vec3, 8> CpuInstanceCuller::corners(const glm::mat4 &matrix) const
+{
+    std::array<glm::vec3, 8> result{};
+    for (size_t i = 0; i < result.size(); ++i) {
+        glm::vec3 corner{(i & 1U) != 0 ? m_boundsMax.x : m_boundsMin.x,
+                         (i & 2U) != 0 ? m_boundsMax.y : m_boundsMin.y,
+                         (i & 4U) != 0 ? m_boundsMax.z : m_boundsMin.z};
+        result[i] = glm::vec3{matrix * glm::vec4{corner, 1.0F}};
+    }
+    return result;
+}
@@ -0,0 +1,64 @@
+#ifndef CPUINSTANCECULLER_H
+#define CPUINSTANCECULLER_H
+
+#include "abstractpipeline.h"
+#include "instancebuffer.h"
+#include "occlusionbuffer.h"
+
+#include <QVector>
+
+// Culls the instances of one mesh on the CPU before the draw is recorded, for when the GPU does not cull.
+// Every frame the nearest frustum visible instances are rasterized as occluders into an OcclusionBuffer,
+// using the low poly proxy of the model, then the box of every frustum visible instance is tested against it.
+// The survivors are copied into a vertex buffer of their own and drawn with a plain instanced draw.
+class CpuInstanceCuller
+{
+public:
+    CpuInstanceCuller(VulkanRenderer *vulkanRenderer, const InstanceBuffer *instanceBuffer);
+
+    CpuInstanceCuller(const CpuInstanceCuller &) = delete;
+    CpuInstanceCuller(CpuInstanceCuller &&) = delete;
+    CpuInstanceCuller &operator=(const CpuInstanceCuller &) = delete;
+    CpuInstanceCuller &operator=(CpuInstanceCuller &&) = delete;
+
+    ~CpuInstanceCuller() = default;
+
+    // Bounds of the drawn mesh and the occluder proxy, both in model space
+    void setModel(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, QVector<glm::vec3> occluderVertices, QVector<uint32_t> occluderIndices);
+    void initSwapChainResources();
+    void update(int currentFrameIndex, const glm::mat4 &model, const glm::mat4 &projView);
+    void releaseSwapChainResources();
+
+    [[nodiscard]] VkBuffer visibleInstanceBuffer(int imageIndex) const { return m_visibleInstances.buffer(imageIndex); }
+    [[nodiscard]] int visibleCount() const { return m_visibleInstances.count(); }
+    [[nodiscard]] const CullStats &stats() const { return m_stats; }
+
+private:
+    struct Candidate
+    {
+        int index;
+        // Clip space w of the center, the view depth for a perspective projection
+        float depth;
+        glm::mat4 matrix;
+    };
+
+    VulkanRenderer *const m_vulkanRenderer;
+    const InstanceBuffer *const m_instanceBuffer;
+    InstanceBuffer m_visibleInstances;
+    OcclusionBuffer m_occlusionBuffer;
+    glm::vec3 m_boundsMin;
+    glm::vec3 m_boundsMax;
+    QVector<glm::vec3> m_occluderVertices;
+    QVector<uint32_t> m_occluderIndices;
+    // Scratch of update, kept to reuse the allocations
+    QVector<Candidate> m_candidates;
+    QVector<glm::mat4> m_occluderTransforms;
+    QVector<char> m_candidateVisible;
+    CullStats m_stats;
+    double m_reportedMs;
+    int m_frames;
+
+    [[nodiscard]] std::array<glm::vec3, 8> corners(const glm::mat4 &matrix) const;
+};
+
+#endif // CPUINSTANCECULLER_H
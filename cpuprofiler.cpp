@@ -0,0 +1,154 @@
+#include "cpuprofiler.h"
+
+#include "chrometrace.h"
+
+#include <QDebug>
+
+#include <chrono>
+
+namespace {
+constexpr int cpuTraceProcess = 1;
+constexpr std::chrono::milliseconds collectInterval{10};
+constexpr double nanosecondsPerMicrosecond = 1000.0;
+}
+
+CpuProfiler &CpuProfiler::instance()
+{
+    static CpuProfiler profiler{};
+    return profiler;
+}
+
+CpuProfiler::CpuProfiler()
+    : m_trace{}
+    , m_stopping{}
+{
+}
+
+CpuProfiler::~CpuProfiler()
+{
+    stop();
+}
+
+void CpuProfiler::start(ChromeTrace *trace)
+{
+    stop();
+    qDebug() << "Start CPU profiler";
+    trace->setProcessName(cpuTraceProcess, QStringLiteral("CPU"));
+    {
+        std::lock_guard lock{m_buffersMutex};
+        for (auto &buffer : m_buffers) {
+            buffer->tail = buffer->head.load();
+            buffer->named = false;
+        }
+    }
+    m_stopping = false;
+    m_trace = trace;
+    m_collector = std::thread{&CpuProfiler::collectorLoop, this, trace};
+}
+
+void CpuProfiler::stop()
+{
+    if (!m_collector.joinable()) {
+        return;
+    }
+    qDebug() << "Stop CPU profiler";
+    auto *trace = m_trace.exchange(nullptr);
+    {
+        std::lock_guard lock{m_collectorMutex};
+        m_stopping = true;
+    }
+    m_collectorWake.notify_one();
+    m_collector.join();
+    collect(trace);
+}
+
+void CpuProfiler::record(const char *name, int64_t beginNs, int64_t endNs) noexcept
+{
+    if (m_trace.load(std::memory_order_relaxed) == nullptr) {
+        return;
+    }
+    auto *buffer = threadBuffer();
+    if (buffer == nullptr) {
+        return;
+    }
+    auto head = buffer->head.load(std::memory_order_relaxed);
+    if (head - buffer->tail.load(std::memory_order_acquire) == ringCapacity) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->zones[head % ringCapacity] = {name, beginNs, endNs};
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+CpuProfiler::ThreadBuffer *CpuProfiler::threadBuffer()
+{
+    thread_local ThreadBuffer *threadBuffer{};
+    if (threadBuffer != nullptr) {
+        return threadBuffer;
+    }
+    try {
+        auto buffer = std::make_unique<ThreadBuffer>();
+        std::lock_guard lock{m_buffersMutex};
+        buffer->threadId = static_cast<int>(m_buffers.size());
+        threadBuffer = buffer.get();
+        // Buffers outlive their threads, so zones of finished threads are still collected
+        m_buffers.push_back(std::move(buffer));
+    } catch (...) {
+        return nullptr;
+    }
+    return threadBuffer;
+}
+
+void CpuProfiler::collectorLoop(ChromeTrace *trace)
+{
+    std::unique_lock lock{m_collectorMutex};
+    while (!m_collectorWake.wait_for(lock, collectInterval, [this]{ return m_stopping; })) {
+        lock.unlock();
+        collect(trace);
+        lock.lock();
+    }
+}
+
+void CpuProfiler::collect(ChromeTrace *trace)
+{
+    std::vector<ThreadBuffer *> buffers{};
+    {
+        std::lock_guard lock{m_buffersMutex};
+        buffers.reserve(m_buffers.size());
+        for (auto &buffer : m_buffers) {
+            buffers.push_back(buffer.get());
+        }
+    }
+    for (auto *buffer : buffers) {
+        auto tail = buffer->tail.load(std::memory_order_relaxed);
+        auto head = buffer->head.load(std::memory_order_acquire);
+        if (tail == head) {
+            continue;
+        }
+        if (!buffer->named) {
+            trace->setThreadName(cpuTraceProcess, buffer->threadId, QStringLiteral("thread %1").arg(buffer->threadId));
+            buffer->named = true;
+        }
+        for (; tail != head; ++tail) {
+            const auto &zone = buffer->zones[tail % ringCapacity];
+            trace->addCompleteEvent(QString::fromLatin1(zone.name), QStringLiteral("cpu"), cpuTraceProcess, buffer->threadId,
+                                    static_cast<double>(zone.beginNs) / nanosecondsPerMicrosecond,
+                                    static_cast<double>(zone.endNs - zone.beginNs) / nanosecondsPerMicrosecond);
+        }
+        buffer->tail.store(tail, std::memory_order_release);
+        if (auto dropped = buffer->dropped.exchange(0, std::memory_order_relaxed); dropped > 0) {
+            qDebug() << "CPU profiler ring of thread " << buffer->threadId << " overflowed, dropped zones: " << dropped;
+        }
+    }
+}
+
+CpuZone::CpuZone(const char *name) noexcept
+    : m_name{name}
+    , m_beginNs{traceClockNs()}
+{
+}
+
+CpuZone::~CpuZone()
+{
+    CpuProfiler::instance().record(m_name, m_beginNs, traceClockNs());
+}
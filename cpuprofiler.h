@@ -0,0 +1,100 @@
+#ifndef CPUPROFILER_H
+#define CPUPROFILER_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ChromeTrace;
+
+#ifdef VKTUTOR2_ENABLE_PROFILER
+constexpr bool cpuProfilerEnabled = true;
+#define PROFILE_ZONE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_IMPL(a, b)
+// Measures the enclosing scope, name must be a string literal
+#define PROFILE_ZONE(name) const CpuZone PROFILE_ZONE_CONCAT(cpuZone, __LINE__){name}
+#else
+constexpr bool cpuProfilerEnabled = false;
+#define PROFILE_ZONE(name) static_cast<void>(0)
+#endif
+
+// Zones are stored into per thread single producer single consumer rings and moved into the trace by a collector thread
+class CpuProfiler
+{
+public:
+    [[nodiscard]] static CpuProfiler &instance();
+
+    CpuProfiler(const CpuProfiler &) = delete;
+    CpuProfiler(CpuProfiler &&) = delete;
+    CpuProfiler &operator=(const CpuProfiler &) = delete;
+    CpuProfiler &operator=(CpuProfiler &&) = delete;
+
+    ~CpuProfiler();
+
+    void start(ChromeTrace *trace);
+    // Collects the zones recorded so far and detaches from the trace
+    void stop();
+
+    void record(const char *name, int64_t beginNs, int64_t endNs) noexcept;
+
+private:
+    static constexpr std::size_t ringCapacity = 8192;
+
+    struct Zone
+    {
+        const char *name;
+        int64_t beginNs;
+        int64_t endNs;
+    };
+
+    struct ThreadBuffer
+    {
+        std::array<Zone, ringCapacity> zones;
+        // Written by the owning thread only
+        std::atomic<std::size_t> head;
+        // Written by the collector only
+        std::atomic<std::size_t> tail;
+        std::atomic<uint64_t> dropped;
+        int threadId;
+        bool named;
+    };
+
+    std::atomic<ChromeTrace *> m_trace;
+    std::mutex m_buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+
+    std::thread m_collector;
+    std::mutex m_collectorMutex;
+    std::condition_variable m_collectorWake;
+    bool m_stopping;
+
+    CpuProfiler();
+
+    [[nodiscard]] ThreadBuffer *threadBuffer();
+    void collectorLoop(ChromeTrace *trace);
+    void collect(ChromeTrace *trace);
+};
+
+class CpuZone
+{
+public:
+    explicit CpuZone(const char *name) noexcept;
+
+    CpuZone(const CpuZone &) = delete;
+    CpuZone(CpuZone &&) = delete;
+    CpuZone &operator=(const CpuZone &) = delete;
+    CpuZone &operator=(CpuZone &&) = delete;
+
+    ~CpuZone();
+
+private:
+    const char *m_name;
+    int64_t m_beginNs;
+};
+
+#endif // CPUPROFILER_H
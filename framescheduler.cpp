@@ -0,0 +1,144 @@
+#include "framescheduler.h"
+
+#include <QDebug>
+#include <QEvent>
+#include <QScreen>
+#include <QWindow>
+
+#include <algorithm>
+
+namespace {
+constexpr int statsInterval = 5000;
+constexpr int defaultRefreshRate = 60;
+constexpr int millisecondsPerSecond = 1000;
+
+[[nodiscard]] const char *framePolicyName(FramePolicy policy)
+{
+    switch (policy) {
+    case FramePolicy::CONTINUOUS:
+        return "continuous";
+    case FramePolicy::VSYNC_CAPPED:
+        return "vsync capped";
+    case FramePolicy::ON_DEMAND:
+        return "on demand";
+    case FramePolicy::FPS_CAP:
+        return "fps cap";
+    }
+    return "unknown";
+}
+}
+
+FrameScheduler::FrameScheduler(QWindow *window, const RenderSettings &renderSettings, QObject *parent)
+    : QObject{parent}
+    , m_window{window}
+    , m_policy{renderSettings.framePolicy}
+    , m_fpsCap{std::max(renderSettings.fpsCap, 1)}
+    , m_dirty{true}
+    , m_animationPausedAt{}
+    , m_animationPausedDuration{}
+    , m_animationPaused{}
+    , m_statsCpuClock{std::clock()}
+    , m_statsFrameCount{}
+{
+    qDebug() << "Create frame scheduler, policy: " << framePolicyName(m_policy) << ", fps cap: " << m_fpsCap;
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setTimerType(Qt::TimerType::PreciseTimer);
+    connect(&m_frameTimer, &QTimer::timeout, m_window, &QWindow::requestUpdate);
+    connect(&m_statsTimer, &QTimer::timeout, this, &FrameScheduler::reportStats);
+    m_statsTimer.start(statsInterval);
+    m_statsClock.start();
+    m_animationClock.start();
+    m_sinceLastFrame.start();
+    m_window->installEventFilter(this);
+}
+
+void FrameScheduler::invalidate()
+{
+    m_dirty = true;
+    scheduleFrame();
+}
+
+void FrameScheduler::frameRendered()
+{
+    m_dirty = false;
+    ++m_statsFrameCount;
+    m_sinceLastFrame.restart();
+    scheduleFrame();
+}
+
+void FrameScheduler::setAnimationPaused(bool paused)
+{
+    if (paused == m_animationPaused) {
+        return;
+    }
+    qDebug() << "Animation paused: " << paused;
+    if (paused) {
+        m_animationPausedAt = m_animationClock.elapsed();
+    } else {
+        m_animationPausedDuration += m_animationClock.elapsed() - m_animationPausedAt;
+    }
+    m_animationPaused = paused;
+    invalidate();
+}
+
+float FrameScheduler::animationTime() const
+{
+    auto elapsed = m_animationPaused ? m_animationPausedAt : m_animationClock.elapsed();
+    return static_cast<float>(elapsed - m_animationPausedDuration) / static_cast<float>(millisecondsPerSecond);
+}
+
+bool FrameScheduler::eventFilter(QObject *obj, QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::Type::Expose:
+    case QEvent::Type::Resize:
+        invalidate();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(obj, event);
+}
+
+void FrameScheduler::scheduleFrame()
+{
+    // Nothing changed since the last presented image, so stay idle until invalidate()
+    if (m_policy != FramePolicy::CONTINUOUS && !m_dirty && m_animationPaused) {
+        return;
+    }
+    switch (m_policy) {
+    case FramePolicy::CONTINUOUS:
+    case FramePolicy::ON_DEMAND:
+        m_window->requestUpdate();
+        break;
+    case FramePolicy::VSYNC_CAPPED:
+    case FramePolicy::FPS_CAP:
+        if (!m_frameTimer.isActive()) {
+            m_frameTimer.start(static_cast<int>(std::max<qint64>(frameInterval() - m_sinceLastFrame.elapsed(), 0)));
+        }
+        break;
+    }
+}
+
+int FrameScheduler::frameInterval() const
+{
+    if (m_policy == FramePolicy::FPS_CAP) {
+        return millisecondsPerSecond / m_fpsCap;
+    }
+    const QScreen *screen = m_window->screen();
+    auto refreshRate = screen != nullptr ? qRound(screen->refreshRate()) : defaultRefreshRate;
+    return millisecondsPerSecond / std::max(refreshRate, 1);
+}
+
+void FrameScheduler::reportStats()
+{
+    auto wallTime = m_statsClock.restart();
+    auto cpuClock = std::clock();
+    auto cpuTime = static_cast<double>(cpuClock - m_statsCpuClock) * millisecondsPerSecond / CLOCKS_PER_SEC;
+    m_statsCpuClock = cpuClock;
+    auto fps = static_cast<double>(m_statsFrameCount) * millisecondsPerSecond / static_cast<double>(std::max<qint64>(wallTime, 1));
+    auto cpuUsage = 100.0 * cpuTime / static_cast<double>(std::max<qint64>(wallTime, 1));
+    qDebug() << "Frame stats, policy: " << framePolicyName(m_policy)
+             << ", frames: " << m_statsFrameCount << ", fps: " << fps << ", cpu: " << cpuUsage << "%";
+    m_statsFrameCount = 0;
+}
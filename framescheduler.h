@@ -0,0 +1,57 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include "settings.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+#include <ctime>
+
+class QWindow;
+
+class FrameScheduler final : public QObject
+{
+    Q_OBJECT
+
+public:
+    FrameScheduler(QWindow *window, const RenderSettings &renderSettings, QObject *parent = nullptr);
+
+    // Marks the presented image as outdated, so a frame gets scheduled according to the policy
+    void invalidate();
+    void frameRendered();
+
+    void setAnimationPaused(bool paused);
+    [[nodiscard]] bool isAnimationPaused() const { return m_animationPaused; }
+    // Seconds of animation time, frozen while the animation is paused
+    [[nodiscard]] float animationTime() const;
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+private:
+    QWindow *const m_window;
+    const FramePolicy m_policy;
+    const int m_fpsCap;
+    bool m_dirty;
+
+    QTimer m_frameTimer;
+    QElapsedTimer m_sinceLastFrame;
+
+    QElapsedTimer m_animationClock;
+    qint64 m_animationPausedAt;
+    qint64 m_animationPausedDuration;
+    bool m_animationPaused;
+
+    QTimer m_statsTimer;
+    QElapsedTimer m_statsClock;
+    std::clock_t m_statsCpuClock;
+    int m_statsFrameCount;
+
+    void scheduleFrame();
+    [[nodiscard]] int frameInterval() const;
+    void reportStats();
+};
+
+#endif // FRAMESCHEDULER_H
@@ -0,0 +1,28 @@
+#include "frustum.h"
+
+#include <algorithm>
+
+FrustumPlanes frustumPlanes(const glm::mat4 &projView)
+{
+    // Gribb-Hartmann extraction, normalized so the distance to a sphere center is exact
+    auto row = [&projView](int i) { return glm::vec4{projView[0][i], projView[1][i], projView[2][i], projView[3][i]}; };
+    FrustumPlanes planes{
+        row(3) + row(0),
+        row(3) - row(0),
+        row(3) + row(1),
+        row(3) - row(1),
+        row(2),
+        row(3) - row(2)
+    };
+    for (auto &plane : planes) {
+        plane /= glm::length(glm::vec3{plane});
+    }
+    return planes;
+}
+
+bool sphereInFrustum(const FrustumPlanes &planes, const glm::vec3 &center, float radius)
+{
+    return std::all_of(planes.cbegin(), planes.cend(), [&](const glm::vec4 &plane) {
+        return glm::dot(glm::vec3{plane}, center) + plane.w >= -radius;
+    });
+}
@@ -0,0 +1,14 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "glm.h"
+
+#include <array>
+
+using FrustumPlanes = std::array<glm::vec4, 6>;
+
+// World space planes of projView for a 0..1 depth range, inside when dot(xyz, p) + w >= 0
+[[nodiscard]] FrustumPlanes frustumPlanes(const glm::mat4 &projView);
+[[nodiscard]] bool sphereInFrustum(const FrustumPlanes &planes, const glm::vec3 &center, float radius);
+
+#endif // FRUSTUM_H
@@ -0,0 +1,274 @@
+#include "gpuprofiler.h"
+
+#include "chrometrace.h"
+#include "vulkanrenderer.h"
+
+#include <QDebug>
+#include <QVulkanDeviceFunctions>
+#include <QVulkanFunctions>
+
+#include <algorithm>
+#include <optional>
+
+namespace {
+constexpr int reportInterval = 600;
+constexpr int gpuTraceProcess = 2;
+constexpr int graphicsQueueTraceThread = 0;
+constexpr double nanosecondsPerMicrosecond = 1000.0;
+constexpr double nanosecondsPerMillisecond = 1'000'000.0;
+// Every query is returned as a pair of value and availability
+constexpr int resultWordsPerQuery = 2;
+}
+
+void GpuProfiler::RollingAverage::add(double sample)
+{
+    if (count == averageWindow) {
+        sum -= samples.at(next);
+    } else {
+        ++count;
+    }
+    samples.at(next) = sample;
+    sum += sample;
+    next = (next + 1) % averageWindow;
+}
+
+GpuProfiler::GpuProfiler(VulkanRenderer *vulkanRenderer)
+    : m_vulkanRenderer{vulkanRenderer}
+    , m_queryPool{}
+    , m_currentFrame{}
+    , m_uploadName{}
+    , m_uploadCpuTimeNs{}
+    , m_timestampPeriod{}
+    , m_timestampMask{}
+    , m_traceOrigin{}
+    , m_traceOriginCpuNs{}
+    , m_collectedFrames{}
+    , m_lastFrameMs{}
+    , m_trace{}
+    , m_cmdBeginDebugUtilsLabel{}
+    , m_cmdEndDebugUtilsLabel{}
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    destroy();
+}
+
+void GpuProfiler::create(int frameCount, bool timestampsEnabled, ChromeTrace *trace)
+{
+    auto *surface = m_vulkanRenderer->surface();
+    auto *vkInst = surface->vulkanInstance();
+    m_frames = std::vector<FrameQueries>(frameCount);
+    m_currentFrame = 0;
+    m_trace = trace;
+    m_traceOrigin = 0;
+
+    if (vkInst->extensions().contains(QByteArrayLiteral(VK_EXT_DEBUG_UTILS_EXTENSION_NAME))) {
+        qDebug() << "Debug utils labels are enabled";
+        m_cmdBeginDebugUtilsLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(vkInst->getInstanceProcAddr("vkCmdBeginDebugUtilsLabelEXT"));
+        m_cmdEndDebugUtilsLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(vkInst->getInstanceProcAddr("vkCmdEndDebugUtilsLabelEXT"));
+    }
+
+    if (!timestampsEnabled) {
+        return;
+    }
+    uint32_t queueFamilyCount{};
+    vkInst->functions()->vkGetPhysicalDeviceQueueFamilyProperties(surface->physicalDevice(), &queueFamilyCount, nullptr);
+    QVector<VkQueueFamilyProperties> queueFamilies(static_cast<int>(queueFamilyCount));
+    vkInst->functions()->vkGetPhysicalDeviceQueueFamilyProperties(surface->physicalDevice(), &queueFamilyCount, queueFamilies.data());
+    auto timestampValidBits = queueFamilies.at(static_cast<int>(surface->graphicsQueueFamilyIndex())).timestampValidBits;
+    if (timestampValidBits == 0) {
+        qDebug() << "Graphics queue does not support timestamps, GPU profiler is disabled";
+        return;
+    }
+    m_timestampMask = timestampValidBits >= 64 ? ~uint64_t{} : (uint64_t{1} << timestampValidBits) - 1;
+    m_timestampPeriod = surface->physicalDeviceProperties()->limits.timestampPeriod;
+    qDebug() << "Create GPU profiler, frames: " << frameCount << ", timestamp period: " << m_timestampPeriod << " ns";
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VkQueryType::VK_QUERY_TYPE_TIMESTAMP;
+    // The last two queries are used by uploads
+    queryPoolInfo.queryCount = uploadQuery() + 2;
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateQueryPool(m_vulkanRenderer->device(), &queryPoolInfo, nullptr, &m_queryPool),
+                                  "failed to create timestamp query pool");
+
+    if (m_trace != nullptr) {
+        m_trace->setProcessName(gpuTraceProcess, QStringLiteral("GPU"));
+        m_trace->setThreadName(gpuTraceProcess, graphicsQueueTraceThread, QStringLiteral("graphics queue"));
+    }
+}
+
+void GpuProfiler::destroy()
+{
+    if (m_frames.empty()) {
+        return;
+    }
+    qDebug() << "Destroy GPU profiler";
+    report();
+    m_trace = nullptr;
+    m_vulkanRenderer->devFuncs()->vkDestroyQueryPool(m_vulkanRenderer->device(), m_queryPool, nullptr);
+    m_queryPool = {};
+    m_frames.clear();
+    m_cmdBeginDebugUtilsLabel = {};
+    m_cmdEndDebugUtilsLabel = {};
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex)
+{
+    m_currentFrame = frameIndex;
+    if (!timestampsEnabled()) {
+        return;
+    }
+    // The frame slot is reused, so the queries recorded into it are complete by now
+    auto &frame = m_frames.at(frameIndex);
+    auto firstQuery = static_cast<uint32_t>(frameIndex * queriesPerFrame);
+    m_lastFrameMs = 0.0;
+    if (int scopeCount = std::min<int>(frame.scopeCount, maxScopesPerFrame); scopeCount > 0) {
+        m_lastFrameMs = collect(firstQuery, frame.names.data(), scopeCount, frame.cpuTimeNs, {});
+        if (++m_collectedFrames % reportInterval == 0) {
+            report();
+        }
+    }
+    frame.scopeCount = 0;
+    frame.cpuTimeNs = traceClockNs();
+    m_vulkanRenderer->devFuncs()->vkCmdResetQueryPool(commandBuffer, m_queryPool, firstQuery, queriesPerFrame);
+}
+
+int GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char *name)
+{
+    beginLabel(commandBuffer, name);
+    if (!timestampsEnabled()) {
+        return -1;
+    }
+    auto &frame = m_frames.at(m_currentFrame);
+    int scope = frame.scopeCount++;
+    if (scope >= maxScopesPerFrame) {
+        return -1;
+    }
+    frame.names.at(scope) = name;
+    m_vulkanRenderer->devFuncs()->vkCmdWriteTimestamp(commandBuffer, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                                      m_queryPool, m_currentFrame * queriesPerFrame + scope * 2);
+    return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, int scope)
+{
+    if (scope >= 0) {
+        m_vulkanRenderer->devFuncs()->vkCmdWriteTimestamp(commandBuffer, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                                          m_queryPool, m_currentFrame * queriesPerFrame + scope * 2 + 1);
+    }
+    endLabel(commandBuffer);
+}
+
+void GpuProfiler::beginUpload(VkCommandBuffer commandBuffer, const char *name)
+{
+    beginLabel(commandBuffer, name);
+    if (!timestampsEnabled()) {
+        return;
+    }
+    m_uploadName = name;
+    m_uploadCpuTimeNs = traceClockNs();
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    devFuncs->vkCmdResetQueryPool(commandBuffer, m_queryPool, uploadQuery(), 2);
+    devFuncs->vkCmdWriteTimestamp(commandBuffer, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, uploadQuery());
+}
+
+void GpuProfiler::endUpload(VkCommandBuffer commandBuffer)
+{
+    if (m_uploadName != nullptr) {
+        m_vulkanRenderer->devFuncs()->vkCmdWriteTimestamp(commandBuffer, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, uploadQuery() + 1);
+    }
+    endLabel(commandBuffer);
+}
+
+void GpuProfiler::collectUpload()
+{
+    if (m_uploadName == nullptr) {
+        return;
+    }
+    static_cast<void>(collect(uploadQuery(), &m_uploadName, 1, m_uploadCpuTimeNs, VkQueryResultFlagBits::VK_QUERY_RESULT_WAIT_BIT));
+    m_uploadName = nullptr;
+}
+
+QHash<QString, double> GpuProfiler::averages() const
+{
+    QHash<QString, double> result{};
+    result.reserve(m_averages.size());
+    for (auto iAverage = m_averages.cbegin(); iAverage != m_averages.cend(); ++iAverage) {
+        result.insert(iAverage.key(), iAverage->value());
+    }
+    return result;
+}
+
+void GpuProfiler::beginLabel(VkCommandBuffer commandBuffer, const char *name) const
+{
+    if (m_cmdBeginDebugUtilsLabel == nullptr) {
+        return;
+    }
+    VkDebugUtilsLabelEXT label{};
+    label.sType = VkStructureType::VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name;
+    m_cmdBeginDebugUtilsLabel(commandBuffer, &label);
+}
+
+void GpuProfiler::endLabel(VkCommandBuffer commandBuffer) const
+{
+    if (m_cmdEndDebugUtilsLabel == nullptr) {
+        return;
+    }
+    m_cmdEndDebugUtilsLabel(commandBuffer);
+}
+
+double GpuProfiler::collect(uint32_t firstQuery, const char *const *names, int scopeCount, int64_t cpuTimeNs, VkQueryResultFlags flags)
+{
+    std::vector<uint64_t> results(static_cast<std::size_t>(scopeCount) * 2 * resultWordsPerQuery);
+    auto result = m_vulkanRenderer->devFuncs()->vkGetQueryPoolResults(
+                m_vulkanRenderer->device(), m_queryPool, firstQuery, scopeCount * 2,
+                results.size() * sizeof(uint64_t), results.data(), resultWordsPerQuery * sizeof(uint64_t),
+                flags | VkQueryResultFlagBits::VK_QUERY_RESULT_64_BIT | VkQueryResultFlagBits::VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VkResult::VK_NOT_READY) {
+        VulkanRenderer::checkVkResult(result, "failed to get timestamp query results");
+    }
+
+    // Scopes nest, so the frame spans from the earliest begin to the furthest end relative to it
+    std::optional<uint64_t> firstBegin{};
+    uint64_t spanTicks{};
+    for (int scope = 0; scope < scopeCount; ++scope) {
+        const uint64_t *scopeResults = results.data() + static_cast<std::ptrdiff_t>(scope) * 2 * resultWordsPerQuery;
+        if (scopeResults[1] == 0 || scopeResults[3] == 0) {
+            continue;
+        }
+        auto begin = scopeResults[0] & m_timestampMask;
+        auto end = scopeResults[2] & m_timestampMask;
+        if (!firstBegin) {
+            firstBegin = begin;
+        }
+        spanTicks = std::max(spanTicks, (end - *firstBegin) & m_timestampMask);
+        auto durationNs = static_cast<double>((end - begin) & m_timestampMask) * m_timestampPeriod;
+        m_averages[QString::fromLatin1(names[scope])].add(durationNs / nanosecondsPerMillisecond);
+
+        if (m_trace == nullptr) {
+            continue;
+        }
+        // Without calibrated timestamps the GPU timeline is anchored at the recording time of the first traced scope
+        if (m_traceOrigin == 0) {
+            m_traceOrigin = begin;
+            m_traceOriginCpuNs = cpuTimeNs;
+        }
+        auto startNs = static_cast<double>(m_traceOriginCpuNs) + static_cast<double>(static_cast<int64_t>(begin - m_traceOrigin)) * m_timestampPeriod;
+        m_trace->addCompleteEvent(QString::fromLatin1(names[scope]), QStringLiteral("gpu"), gpuTraceProcess, graphicsQueueTraceThread,
+                                 startNs / nanosecondsPerMicrosecond, durationNs / nanosecondsPerMicrosecond);
+    }
+    return static_cast<double>(spanTicks) * m_timestampPeriod / nanosecondsPerMillisecond;
+}
+
+void GpuProfiler::report() const
+{
+    auto names = m_averages.keys();
+    std::sort(names.begin(), names.end());
+    for (const auto &name : names) {
+        qDebug() << "GPU time, scope: " << name << ", average: " << m_averages.value(name).value() << " ms";
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <QHash>
+#include <QString>
+#include <QVulkanInstance>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+class ChromeTrace;
+class VulkanRenderer;
+
+// Measures GPU time of named scopes with timestamp queries. Results of a frame are read back when its
+// frame slot is reused, so reading never waits for the GPU. Scopes are also emitted as debug utils labels.
+class GpuProfiler
+{
+public:
+    explicit GpuProfiler(VulkanRenderer *vulkanRenderer);
+
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler(GpuProfiler &&) = delete;
+    GpuProfiler &operator=(const GpuProfiler &) = delete;
+    GpuProfiler &operator=(GpuProfiler &&) = delete;
+
+    ~GpuProfiler();
+
+    // Scopes are added to the trace when it is given
+    void create(int frameCount, bool timestampsEnabled, ChromeTrace *trace);
+    void destroy();
+
+    // Must be recorded outside of a render pass, before any scope of the frame
+    void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+    // Thread safe, so scopes may be recorded into secondary command buffers in parallel
+    [[nodiscard]] int beginScope(VkCommandBuffer commandBuffer, const char *name);
+    void endScope(VkCommandBuffer commandBuffer, int scope);
+
+    // Uploads are submitted and waited for one at a time, so they are read back right after completion
+    void beginUpload(VkCommandBuffer commandBuffer, const char *name);
+    void endUpload(VkCommandBuffer commandBuffer);
+    void collectUpload();
+
+    // Rolling average in milliseconds per scope name
+    [[nodiscard]] QHash<QString, double> averages() const;
+    // Milliseconds from the first to the last timestamp of the frame read back by the latest beginFrame, 0 without one
+    [[nodiscard]] double lastFrameMs() const { return m_lastFrameMs; }
+
+private:
+    static constexpr int maxScopesPerFrame = 32;
+    static constexpr int queriesPerFrame = maxScopesPerFrame * 2;
+    static constexpr int averageWindow = 64;
+
+    struct FrameQueries
+    {
+        std::array<const char *, maxScopesPerFrame> names;
+        std::atomic_int scopeCount;
+        int64_t cpuTimeNs;
+    };
+
+    struct RollingAverage
+    {
+        std::array<double, averageWindow> samples;
+        int next;
+        int count;
+        double sum;
+
+        void add(double sample);
+        [[nodiscard]] double value() const { return count > 0 ? sum / count : 0.0; }
+    };
+
+    VulkanRenderer *m_vulkanRenderer;
+    VkQueryPool m_queryPool;
+    std::vector<FrameQueries> m_frames;
+    int m_currentFrame;
+    const char *m_uploadName;
+    int64_t m_uploadCpuTimeNs;
+    float m_timestampPeriod;
+    uint64_t m_timestampMask;
+    // GPU timestamp of the first traced scope and the CPU time its frame was recorded at
+    uint64_t m_traceOrigin;
+    int64_t m_traceOriginCpuNs;
+    int m_collectedFrames;
+    double m_lastFrameMs;
+    QHash<QString, RollingAverage> m_averages;
+    ChromeTrace *m_trace;
+
+    PFN_vkCmdBeginDebugUtilsLabelEXT m_cmdBeginDebugUtilsLabel;
+    PFN_vkCmdEndDebugUtilsLabelEXT m_cmdEndDebugUtilsLabel;
+
+    [[nodiscard]] bool timestampsEnabled() const { return m_queryPool != VK_NULL_HANDLE; }
+    [[nodiscard]] uint32_t uploadQuery() const { return static_cast<uint32_t>(m_frames.size()) * queriesPerFrame; }
+    void beginLabel(VkCommandBuffer commandBuffer, const char *name) const;
+    void endLabel(VkCommandBuffer commandBuffer) const;
+    // Returns the span of the collected scopes in milliseconds, 0 when none was available
+    double collect(uint32_t firstQuery, const char *const *names, int scopeCount, int64_t cpuTimeNs, VkQueryResultFlags flags);
+    void report() const;
+};
+
+class GpuScope
+{
+public:
+    GpuScope(GpuProfiler &gpuProfiler, VkCommandBuffer commandBuffer, const char *name)
+        : m_gpuProfiler{gpuProfiler}
+        , m_commandBuffer{commandBuffer}
+        , m_scope{gpuProfiler.beginScope(commandBuffer, name)}
+    {
+    }
+
+    GpuScope(const GpuScope &) = delete;
+    GpuScope(GpuScope &&) = delete;
+    GpuScope &operator=(const GpuScope &) = delete;
+    GpuScope &operator=(GpuScope &&) = delete;
+
+    ~GpuScope() { m_gpuProfiler.endScope(m_commandBuffer, m_scope); }
+
+private:
+    GpuProfiler &m_gpuProfiler;
+    VkCommandBuffer m_commandBuffer;
+    int m_scope;
+};
+
+#endif // GPUPROFILER_H
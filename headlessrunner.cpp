@@ -0,0 +1,172 @@
+#include "headlessrunner.h"
+
+#include "offscreensurface.h"
+#include "settings.h"
+#include "vulkanrenderer.h"
+
+#include "externals/scope_guard/scope_guard.hpp"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace {
+[[nodiscard]] double elapsedMs(const QElapsedTimer &timer)
+{
+    return static_cast<double>(timer.nsecsElapsed()) / 1.0e6;
+}
+
+// Nearest rank percentile of sorted samples
+[[nodiscard]] double percentile(const std::vector<double> &sortedSamples, double fraction)
+{
+    auto rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(sortedSamples.size())));
+    return sortedSamples.at(std::max<std::size_t>(rank, 1) - 1);
+}
+
+[[nodiscard]] int64_t peakRssKiB()
+{
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // Linux reports kilobytes
+    return usage.ru_maxrss;
+}
+}
+
+QJsonObject HeadlessStats::toJson() const
+{
+    return {
+        {QStringLiteral("frames"), frames},
+        {QStringLiteral("loadTimeMs"), loadTimeMs},
+        {QStringLiteral("firstFrameMs"), firstFrameMs},
+        {QStringLiteral("minMs"), minMs},
+        {QStringLiteral("avgMs"), avgMs},
+        {QStringLiteral("p50Ms"), p50Ms},
+        {QStringLiteral("p90Ms"), p90Ms},
+        {QStringLiteral("p99Ms"), p99Ms},
+        {QStringLiteral("fps"), fps},
+        {QStringLiteral("peakRssKiB"), static_cast<qint64>(peakRssKiB)},
+        {QStringLiteral("vmaBytes"), static_cast<qint64>(vmaBytes)},
+        {QStringLiteral("instances"), static_cast<qint64>(cullStats.instances)},
+        {QStringLiteral("frustumCulled"), static_cast<qint64>(cullStats.frustumCulled)},
+        {QStringLiteral("occluded"), static_cast<qint64>(cullStats.occluded)},
+        {QStringLiteral("drawn"), static_cast<qint64>(cullStats.drawn)},
+        {QStringLiteral("cullCpuMs"), cullStats.cpuMs}
+    };
+}
+
+HeadlessRunner::HeadlessRunner(QVulkanInstance *vulkanInstance, HeadlessOptions options)
+    : m_vulkanInstance{vulkanInstance}
+    , m_options{std::move(options)}
+{
+}
+
+HeadlessStats HeadlessRunner::run()
+{
+    qDebug() << "Headless run, frames: " << m_options.frames << ", size: " << m_options.size << ", samples: " << m_options.samples;
+    HeadlessStats stats{};
+    QElapsedTimer loadTimer{};
+    loadTimer.start();
+
+    OffscreenSurface surface{m_vulkanInstance, m_options.size, m_options.samples, m_options.timeStep};
+    auto renderSettings = m_options.userSettings ? Settings::loadRenderSettings() : Settings::defaultRenderSettings();
+    renderSettings.modelFile = m_options.modelFile;
+    renderSettings.textureFile = m_options.textureFile;
+    if (m_options.blitMipmaps) {
+        renderSettings.computeMipmaps = false;
+    }
+    if (m_options.instanceCount > 0) {
+        renderSettings.instanceCount = m_options.instanceCount;
+    }
+    if (m_options.depthPrepass) {
+        renderSettings.depthPrepass = true;
+    }
+    if (m_options.qualityLevel) {
+        renderSettings.qualityLevel = *m_options.qualityLevel;
+        renderSettings.dynamicResolution = false;
+    }
+    VulkanRenderer renderer{&surface, renderSettings};
+
+    // Same call order as QVulkanWindow, torn down in reverse
+    renderer.preInitResources();
+    surface.create();
+    auto surfaceGuard = sg::make_scope_guard([&]{ surface.destroy(); });
+    renderer.initResources();
+    auto resourcesGuard = sg::make_scope_guard([&]{
+        surface.waitIdle();
+        renderer.releaseResources();
+    });
+    surface.createImages();
+    auto imagesGuard = sg::make_scope_guard([&]{ surface.destroyImages(); });
+    renderer.initSwapChainResources();
+    auto swapChainResourcesGuard = sg::make_scope_guard([&]{
+        surface.waitIdle();
+        renderer.releaseSwapChainResources();
+    });
+    stats.loadTimeMs = elapsedMs(loadTimer);
+
+    QElapsedTimer frameTimer{};
+    frameTimer.start();
+    surface.beginFrame();
+    renderer.startNextFrame();
+    surface.waitIdle();
+    stats.firstFrameMs = elapsedMs(frameTimer);
+
+    // Fence waits in beginFrame make every sample cover a whole frame once the frames in flight are saturated
+    std::vector<double> frameTimes{};
+    frameTimes.reserve(m_options.frames);
+    QElapsedTimer totalTimer{};
+    totalTimer.start();
+    for (int frame = 1; frame < m_options.frames; ++frame) {
+        frameTimer.start();
+        surface.beginFrame();
+        renderer.startNextFrame();
+        frameTimes.push_back(elapsedMs(frameTimer));
+    }
+    surface.waitIdle();
+    stats.totalMs = elapsedMs(totalTimer);
+    stats.frames = static_cast<int>(frameTimes.size()) + 1;
+    stats.vmaBytes = static_cast<int64_t>(renderer.allocatedBytes());
+    stats.cullStats = renderer.cullStats();
+
+    if (!m_options.pngFile.isEmpty()) {
+        if (surface.grabLastFrame().save(m_options.pngFile)) {
+            qDebug() << "Saved final frame to " << m_options.pngFile;
+        } else {
+            qWarning() << "Failed to save final frame to " << m_options.pngFile;
+        }
+    }
+    stats.peakRssKiB = peakRssKiB();
+
+    if (frameTimes.empty()) {
+        return stats;
+    }
+    std::sort(frameTimes.begin(), frameTimes.end());
+    stats.minMs = frameTimes.front();
+    stats.avgMs = std::accumulate(frameTimes.cbegin(), frameTimes.cend(), 0.0) / static_cast<double>(frameTimes.size());
+    stats.p50Ms = percentile(frameTimes, 0.5);
+    stats.p90Ms = percentile(frameTimes, 0.9);
+    stats.p99Ms = percentile(frameTimes, 0.99);
+    stats.fps = stats.totalMs > 0.0 ? static_cast<double>(frameTimes.size()) * 1000.0 / stats.totalMs : 0.0;
+    return stats;
+}
+
+void HeadlessRunner::report(const HeadlessStats &stats)
+{
+    std::printf("frames: %d, load: %.2f ms, first frame: %.2f ms\n", stats.frames, stats.loadTimeMs, stats.firstFrameMs);
+    std::printf("min: %.3f ms, avg: %.3f ms, p50: %.3f ms, p90: %.3f ms, p99: %.3f ms, throughput: %.1f fps\n",
+                stats.minMs, stats.avgMs, stats.p50Ms, stats.p90Ms, stats.p99Ms, stats.fps);
+    std::printf("peak RSS: %lld KiB, VMA: %lld bytes\n", static_cast<long long>(stats.peakRssKiB), static_cast<long long>(stats.vmaBytes));
+    std::printf("instances: %u, frustum culled: %u, occluded: %u, drawn: %u, cull CPU: %.3f ms\n",
+                stats.cullStats.instances, stats.cullStats.frustumCulled, stats.cullStats.occluded, stats.cullStats.drawn, stats.cullStats.cpuMs);
+    std::fflush(stdout);
+}
@@ -0,0 +1,78 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include "abstractpipeline.h"
+
+#include <QJsonObject>
+#include <QSize>
+#include <QString>
+
+#include <cstdint>
+#include <optional>
+
+class QVulkanInstance;
+
+struct HeadlessOptions
+{
+    // Starts from the render settings of the user instead of the defaults, the results then depend on them
+    bool userSettings;
+    int frames;
+    QSize size;
+    int samples;
+    // Seconds of animation time per frame, so every run renders the same sequence
+    float timeStep;
+    // Saves the final frame when not empty
+    QString pngFile;
+    // Replaces the model of the tex pipeline when not empty
+    QString modelFile;
+    // Replaces the texture of the tex pipeline when not empty
+    QString textureFile;
+    // Builds the mip chains with blits instead of the compute downsampler
+    bool blitMipmaps;
+    // Overrides the instance count of the render settings when not 0
+    int instanceCount;
+    // Overrides the depth prepass of the render settings when set
+    bool depthPrepass;
+    // Renders at this fixed level of the resolution governor instead of the calibrated or governed one when set
+    std::optional<int> qualityLevel;
+};
+
+struct HeadlessStats
+{
+    int frames;
+    // From renderer construction until the swap chain resources are ready
+    double loadTimeMs;
+    // First frame until the GPU finished it, it also pays for lazily created state
+    double firstFrameMs;
+    // Steady state frames, the first one is excluded
+    double totalMs;
+    double minMs;
+    double avgMs;
+    double p50Ms;
+    double p90Ms;
+    double p99Ms;
+    double fps;
+    int64_t peakRssKiB;
+    int64_t vmaBytes;
+    // Culling counts of the latest frame, read back from the GPU or counted by the CPU culler
+    CullStats cullStats;
+
+    [[nodiscard]] QJsonObject toJson() const;
+};
+
+// Renders the pipelines into an offscreen surface for a fixed number of frames and measures the frame times
+class HeadlessRunner
+{
+public:
+    HeadlessRunner(QVulkanInstance *vulkanInstance, HeadlessOptions options);
+
+    [[nodiscard]] HeadlessStats run();
+
+    static void report(const HeadlessStats &stats);
+
+private:
+    QVulkanInstance *const m_vulkanInstance;
+    const HeadlessOptions m_options;
+};
+
+#endif // HEADLESSRUNNER_H
@@ -0,0 +1,103 @@
+#include "instancebuffer.h"
+
+#include "cpuprofiler.h"
+#include "vulkanrenderer.h"
+
+#include "externals/scope_guard/scope_guard.hpp"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <utility>
+
+InstanceBuffer::InstanceBuffer(VulkanRenderer *vulkanRenderer)
+    : m_vulkanRenderer{vulkanRenderer}
+{
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    destroy();
+}
+
+void InstanceBuffer::setInstances(QVector<InstanceData> instances)
+{
+    m_instances = std::move(instances);
+    for (auto &frame : m_frames) {
+        frame.dirty = true;
+    }
+}
+
+void InstanceBuffer::create(int frameCount)
+{
+    qDebug() << "Create instance buffers, instances: " << m_instances.size();
+    m_frames.fill(Frame{}, frameCount);
+    for (auto &frame : m_frames) {
+        reserve(frame);
+        frame.dirty = true;
+    }
+}
+
+void InstanceBuffer::reserve(Frame &frame)
+{
+    if (frame.capacity >= m_instances.size() && frame.buffer.object != VK_NULL_HANDLE) {
+        return;
+    }
+    if (frame.buffer.object != VK_NULL_HANDLE) {
+        m_retiredBuffers.push_back({frame.buffer, static_cast<int>(m_frames.size())});
+    }
+    frame.capacity = std::max(1, m_instances.size());
+    frame.buffer = m_vulkanRenderer->createBuffer(sizeof(InstanceData) * frame.capacity,
+                                                  static_cast<VkBufferUsageFlags>(VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+                                                  | VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                  VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_TO_GPU, AllocationTag::INSTANCE);
+    // A new buffer has no content yet
+    frame.dirty = true;
+}
+
+void InstanceBuffer::update(int frameIndex)
+{
+    PROFILE_ZONE("InstanceBuffer::update");
+    destroyRetiredBuffers(false);
+    auto &frame = m_frames[frameIndex];
+    reserve(frame);
+    if (!frame.dirty) {
+        return;
+    }
+    VmaAllocator allocator = m_vulkanRenderer->allocator();
+    InstanceData *data{};
+    VulkanRenderer::checkVkResult(vmaMapMemory(allocator, frame.buffer.allocation, reinterpret_cast<void **>(&data)),
+                                  "failed to map instance buffer memory");
+    auto mapGuard = sg::make_scope_guard([&]{ vmaUnmapMemory(allocator, frame.buffer.allocation); });
+    std::copy(m_instances.cbegin(), m_instances.cend(), data);
+    VulkanRenderer::checkVkResult(vmaFlushAllocation(allocator, frame.buffer.allocation, 0, sizeof(InstanceData) * m_instances.size()),
+                                  "failed to flush instance buffer memory");
+    frame.dirty = false;
+}
+
+void InstanceBuffer::destroyRetiredBuffers(bool all)
+{
+    VmaAllocator allocator = m_vulkanRenderer->allocator();
+    auto retired = std::remove_if(m_retiredBuffers.begin(), m_retiredBuffers.end(), [&](RetiredBuffer &retiredBuffer) {
+        if (all || --retiredBuffer.updatesLeft < 0) {
+            retiredBuffer.buffer.destroy(allocator);
+            return true;
+        }
+        return false;
+    });
+    m_retiredBuffers.erase(retired, m_retiredBuffers.end());
+}
+
+void InstanceBuffer::destroy()
+{
+    if (m_frames.isEmpty() && m_retiredBuffers.isEmpty()) {
+        return;
+    }
+    qDebug() << "Destroy instance buffers";
+    destroyRetiredBuffers(true);
+    VmaAllocator allocator = m_vulkanRenderer->allocator();
+    for (auto &frame : m_frames) {
+        frame.buffer.destroy(allocator);
+    }
+    m_frames.clear();
+}
@@ -0,0 +1,61 @@
+#ifndef INSTANCEBUFFER_H
+#define INSTANCEBUFFER_H
+
+#include "instancedata.h"
+#include "objectwithallocation.h"
+
+#include <QVector>
+
+class VulkanRenderer;
+
+// Host side copy of the instances plus one host visible vertex buffer per frame in flight.
+// The instances are always replaced as a whole, each buffer is uploaded again once after every change.
+class InstanceBuffer
+{
+public:
+    explicit InstanceBuffer(VulkanRenderer *vulkanRenderer);
+
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer(InstanceBuffer &&) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(InstanceBuffer &&) = delete;
+
+    ~InstanceBuffer();
+
+    void setInstances(QVector<InstanceData> instances);
+    [[nodiscard]] const InstanceData &instance(int index) const { return m_instances.at(index); }
+    [[nodiscard]] int count() const { return m_instances.size(); }
+
+    void create(int frameCount);
+    // Copies the instances into the buffer of the frame when they changed since its last upload, growing the buffer when
+    // they do not fit
+    void update(int frameIndex);
+    void destroy();
+
+    [[nodiscard]] VkBuffer buffer(int frameIndex) const { return m_frames.at(frameIndex).buffer.object; }
+
+private:
+    struct Frame
+    {
+        BufferWithAllocation buffer;
+        int capacity;
+        bool dirty;
+    };
+
+    struct RetiredBuffer
+    {
+        BufferWithAllocation buffer;
+        // Updates to wait until the GPU is done with the buffer
+        int updatesLeft;
+    };
+
+    VulkanRenderer *const m_vulkanRenderer;
+    QVector<InstanceData> m_instances;
+    QVector<Frame> m_frames;
+    QVector<RetiredBuffer> m_retiredBuffers;
+
+    void reserve(Frame &frame);
+    void destroyRetiredBuffers(bool all);
+};
+
+#endif // INSTANCEBUFFER_H
@@ -0,0 +1,678 @@
+#include "instanceculler.h"
+
+#include "frustum.h"
+#include "instancebuffer.h"
+#include "shaderregistry.h"
+#include "vulkanrenderer.h"
+
+#include "externals/scope_guard/scope_guard.hpp"
+
+#include <QDebug>
+#include <QVulkanDeviceFunctions>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+const QString cullShaderName = QStringLiteral("cull.comp");
+const QString pyramidShaderName = QStringLiteral("hiz.comp");
+constexpr uint32_t cullGroupSize = 64;
+constexpr uint32_t pyramidGroupSize = 8;
+constexpr VkFormat depthFormat = VkFormat::VK_FORMAT_D32_SFLOAT;
+constexpr VkFormat pyramidFormat = VkFormat::VK_FORMAT_R32_SFLOAT;
+constexpr uint32_t cullBindingCount = 8;
+constexpr uint32_t instancesBinding = 1;
+constexpr int reportInterval = 600;
+
+struct CullBindingObject {
+    alignas(16) glm::mat4 model;
+    alignas(16) glm::mat4 projView;
+    alignas(16) FrustumPlanes frustumPlanes;
+    alignas(16) glm::vec4 boundingSphere;
+    alignas(8) glm::vec2 pyramidSize;
+    float modelScale;
+    uint32_t instanceCount;
+    uint32_t pyramidLevels;
+    uint32_t occlusion;
+};
+
+// Layout of the final draw command buffer, the frustum visible count rides along for the stats
+struct CullCounters {
+    VkDrawIndexedIndirectCommand drawCommand;
+    uint32_t frustumVisibleCount;
+};
+
+[[nodiscard]] VkDescriptorType cullBindingType(uint32_t binding)
+{
+    switch (binding) {
+    case 0:
+        return VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    case cullBindingCount - 1:
+        return VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    default:
+        return VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+}
+}
+
+InstanceCuller::InstanceCuller(VulkanRenderer *vulkanRenderer, const InstanceBuffer *instanceBuffer)
+    : m_vulkanRenderer{vulkanRenderer}
+    , m_instanceBuffer{instanceBuffer}
+    , m_shaderModule{}
+    , m_descriptorSetLayout{}
+    , m_pipelineLayout{}
+    , m_pipeline{}
+    , m_capacity{}
+    , m_indexCount{}
+    , m_occluderIndexCount{}
+    , m_visibility{}
+    , m_visibilityValid{}
+    , m_visibleInstancesResource{}
+    , m_drawCommandResource{}
+    , m_depthRenderPass{}
+    , m_depthImage{}
+    , m_depthImageView{}
+    , m_depthFramebuffer{}
+    , m_pyramidShaderModule{}
+    , m_pyramidDescriptorSetLayout{}
+    , m_pyramidPipelineLayout{}
+    , m_pyramidPipeline{}
+    , m_pyramidSampler{}
+    , m_pyramidImage{}
+    , m_pyramidImageView{}
+    , m_stats{}
+    , m_collectedFrames{}
+{
+}
+
+InstanceCuller::~InstanceCuller() = default;
+
+bool InstanceCuller::occlusionEnabled() const
+{
+    return m_vulkanRenderer->renderSettings().occlusionCulling;
+}
+
+// Rasterized at a lower resolution the occluders would cover whole pixels of which they only hit the center
+QSize InstanceCuller::depthSize() const
+{
+    return m_vulkanRenderer->surface()->swapChainImageSize();
+}
+
+QSize InstanceCuller::pyramidSize() const
+{
+    auto size = depthSize();
+    return {std::max(1, (size.width() + 1) / 2), std::max(1, (size.height() + 1) / 2)};
+}
+
+uint32_t InstanceCuller::pyramidLevelCount() const
+{
+    auto size = pyramidSize();
+    return static_cast<uint32_t>(std::floor(std::log2(std::max(size.width(), size.height())))) + 1;
+}
+
+void InstanceCuller::initResources()
+{
+    qDebug() << "Create instance culler";
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+
+    m_shaderModule = m_vulkanRenderer->createShaderModule(ShaderRegistry::shader(cullShaderName));
+    m_descriptorSetLayout = createDescriptorSetLayout();
+    VkPushConstantRange phaseRange{};
+    phaseRange.stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+    phaseRange.offset = 0;
+    phaseRange.size = sizeof(uint32_t);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &phaseRange;
+    VulkanRenderer::checkVkResult(devFuncs->vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout),
+                                  "failed to create cull pipeline layout");
+    m_pipeline = m_vulkanRenderer->createComputePipeline(m_shaderModule, m_pipelineLayout);
+
+    m_pyramidShaderModule = m_vulkanRenderer->createShaderModule(ShaderRegistry::shader(pyramidShaderName));
+    m_pyramidDescriptorSetLayout = createPyramidDescriptorSetLayout();
+    VkPipelineLayoutCreateInfo pyramidPipelineLayoutInfo{};
+    pyramidPipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pyramidPipelineLayoutInfo.setLayoutCount = 1;
+    pyramidPipelineLayoutInfo.pSetLayouts = &m_pyramidDescriptorSetLayout;
+    VulkanRenderer::checkVkResult(devFuncs->vkCreatePipelineLayout(device, &pyramidPipelineLayoutInfo, nullptr, &m_pyramidPipelineLayout),
+                                  "failed to create depth pyramid pipeline layout");
+    m_pyramidPipeline = m_vulkanRenderer->createComputePipeline(m_pyramidShaderModule, m_pyramidPipelineLayout);
+    m_pyramidSampler = createPyramidSampler();
+    m_depthRenderPass = createDepthRenderPass();
+}
+
+VkDescriptorSetLayout InstanceCuller::createDescriptorSetLayout() const
+{
+    std::array<VkDescriptorSetLayoutBinding, cullBindingCount> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = cullBindingType(i);
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindings.size();
+    layoutInfo.pBindings = bindings.data();
+    VkDescriptorSetLayout descriptorSetLayout{};
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateDescriptorSetLayout(m_vulkanRenderer->device(), &layoutInfo, nullptr, &descriptorSetLayout),
+                                  "failed to create cull descriptor set layout");
+    return descriptorSetLayout;
+}
+
+VkDescriptorSetLayout InstanceCuller::createPyramidDescriptorSetLayout() const
+{
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindings.size();
+    layoutInfo.pBindings = bindings.data();
+    VkDescriptorSetLayout descriptorSetLayout{};
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateDescriptorSetLayout(m_vulkanRenderer->device(), &layoutInfo, nullptr, &descriptorSetLayout),
+                                  "failed to create depth pyramid descriptor set layout");
+    return descriptorSetLayout;
+}
+
+VkRenderPass InstanceCuller::createDepthRenderPass() const
+{
+    qDebug() << "Create occluder depth render pass";
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = depthFormat;
+    depthAttachment.samples = VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // The frame graph transitions the depth before and after the pass
+    depthAttachment.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 0;
+    depthAttachmentRef.layout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &depthAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    VkRenderPass renderPass{};
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateRenderPass(m_vulkanRenderer->device(), &renderPassInfo, nullptr, &renderPass),
+                                  "failed to create occluder depth render pass");
+    return renderPass;
+}
+
+VkSampler InstanceCuller::createPyramidSampler() const
+{
+    // Only read with texelFetch, the sampler is there because the descriptors are combined image samplers
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VkFilter::VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VkFilter::VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VkSamplerMipmapMode::VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VkSamplerAddressMode::VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VkSamplerAddressMode::VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VkSamplerAddressMode::VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0F;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VkSampler sampler{};
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateSampler(m_vulkanRenderer->device(), &samplerInfo, nullptr, &sampler),
+                                  "failed to create depth pyramid sampler");
+    return sampler;
+}
+
+void InstanceCuller::initSwapChainResources(uint32_t indexCount, uint32_t occluderIndexCount)
+{
+    auto frameCount = m_vulkanRenderer->surface()->concurrentFrameCount();
+    m_capacity = std::max(1, m_instanceBuffer->count());
+    m_indexCount = indexCount;
+    m_occluderIndexCount = occluderIndexCount;
+    qDebug() << "Create instance culler buffers, capacity: " << m_capacity;
+    m_frames.fill(FrameResources{}, frameCount);
+    for (auto &frame : m_frames) {
+        frame.uniformBuffer = m_vulkanRenderer->createBuffer(sizeof(CullBindingObject), VkBufferUsageFlagBits::VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                                             VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_TO_GPU, AllocationTag::UNIFORM);
+        for (auto *instances : {&frame.visibleInstances, &frame.earlyInstances}) {
+            *instances = m_vulkanRenderer->createBuffer(sizeof(InstanceData) * m_capacity,
+                                                        static_cast<VkBufferUsageFlags>(VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+                                                        | VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                        VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY, AllocationTag::INSTANCE);
+        }
+        for (auto *drawCommand : {&frame.drawCommand, &frame.earlyDrawCommand}) {
+            *drawCommand = m_vulkanRenderer->createBuffer(sizeof(CullCounters),
+                                                          static_cast<VkBufferUsageFlags>(VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+                                                          | VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                                                          | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                                                          | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                          VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY, AllocationTag::INSTANCE);
+        }
+        frame.statsReadback = m_vulkanRenderer->createBuffer(sizeof(CullCounters), VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                             VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_TO_HOST, AllocationTag::STAGING);
+    }
+    m_visibility = m_vulkanRenderer->createBuffer(sizeof(uint32_t) * m_capacity,
+                                                  static_cast<VkBufferUsageFlags>(VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+                                                  | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                  VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY, AllocationTag::INSTANCE);
+    // Everything counts as visible in the first frame, so it is all drawn as an occluder once
+    m_visibilityValid = false;
+    createDepthResources();
+    createPyramidResources();
+    createDescriptorSets();
+    createPyramidDescriptorSets();
+}
+
+void InstanceCuller::createDepthResources()
+{
+    auto size = depthSize();
+    qDebug() << "Create occluder depth, size: " << size;
+    m_depthImage = m_vulkanRenderer->createImage(size.width(), size.height(), 1, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT, depthFormat,
+                                                 VkImageTiling::VK_IMAGE_TILING_OPTIMAL,
+                                                 static_cast<VkImageUsageFlags>(VkImageUsageFlagBits::VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
+                                                 | VkImageUsageFlagBits::VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                 VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY, AllocationTag::RENDER_TARGET);
+    m_depthImageView = m_vulkanRenderer->createImageView(m_depthImage.object, depthFormat, VkImageAspectFlagBits::VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = m_depthRenderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &m_depthImageView;
+    framebufferInfo.width = size.width();
+    framebufferInfo.height = size.height();
+    framebufferInfo.layers = 1;
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateFramebuffer(m_vulkanRenderer->device(), &framebufferInfo, nullptr, &m_depthFramebuffer),
+                                  "failed to create occluder depth framebuffer");
+}
+
+void InstanceCuller::createPyramidResources()
+{
+    auto size = pyramidSize();
+    auto levelCount = pyramidLevelCount();
+    qDebug() << "Create depth pyramid, levels: " << levelCount;
+    m_pyramidImage = m_vulkanRenderer->createImage(size.width(), size.height(), levelCount, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT, pyramidFormat,
+                                                   VkImageTiling::VK_IMAGE_TILING_OPTIMAL,
+                                                   static_cast<VkImageUsageFlags>(VkImageUsageFlagBits::VK_IMAGE_USAGE_STORAGE_BIT)
+                                                   | VkImageUsageFlagBits::VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                   VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY, AllocationTag::RENDER_TARGET);
+    m_pyramidImageView = m_vulkanRenderer->createImageView(m_pyramidImage.object, pyramidFormat, VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount);
+    m_pyramidLevelViews.reserve(levelCount);
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        m_pyramidLevelViews << m_vulkanRenderer->createImageView(m_pyramidImage.object, pyramidFormat, VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+    }
+}
+
+DescriptorPoolSizes InstanceCuller::descriptorPoolSizes(int frameCount) const
+{
+    auto levelCount = static_cast<int>(pyramidLevelCount());
+    return {
+        {
+            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount),
+            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<int>(cullBindingCount - 2) * frameCount),
+            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frameCount + levelCount),
+            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelCount)
+        },
+        static_cast<uint32_t>(frameCount + levelCount)
+    };
+}
+
+void InstanceCuller::createDescriptorSets()
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    QVector<VkDescriptorSetLayout> layouts(m_frames.size(), m_descriptorSetLayout);
+    QVector<VkDescriptorSet> descriptorSets(m_frames.size());
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_vulkanRenderer->descriptorPool();
+    allocInfo.descriptorSetCount = layouts.size();
+    allocInfo.pSetLayouts = layouts.constData();
+    VulkanRenderer::checkVkResult(devFuncs->vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()),
+                                  "failed to allocate cull descriptor sets");
+
+    VkDescriptorImageInfo pyramidInfo{m_pyramidSampler, m_pyramidImageView, VkImageLayout::VK_IMAGE_LAYOUT_GENERAL};
+    for (int frameIndex = 0; frameIndex < m_frames.size(); ++frameIndex) {
+        auto &frame = m_frames[frameIndex];
+        frame.descriptorSet = descriptorSets.at(frameIndex);
+        frame.boundInstances = m_instanceBuffer->buffer(frameIndex);
+        std::array<VkDescriptorBufferInfo, cullBindingCount - 1> bufferInfos{
+            VkDescriptorBufferInfo{frame.uniformBuffer.object, 0, sizeof(CullBindingObject)},
+            VkDescriptorBufferInfo{frame.boundInstances, 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{frame.visibleInstances.object, 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{frame.drawCommand.object, 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{frame.earlyInstances.object, 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{frame.earlyDrawCommand.object, 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{m_visibility.object, 0, VK_WHOLE_SIZE}
+        };
+        std::array<VkWriteDescriptorSet, cullBindingCount> descriptorWrites{};
+        for (uint32_t i = 0; i < descriptorWrites.size(); ++i) {
+            descriptorWrites[i].sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].dstSet = frame.descriptorSet;
+            descriptorWrites[i].dstBinding = i;
+            descriptorWrites[i].descriptorType = cullBindingType(i);
+            descriptorWrites[i].descriptorCount = 1;
+            if (i < bufferInfos.size()) {
+                descriptorWrites[i].pBufferInfo = &bufferInfos.at(i);
+            } else {
+                descriptorWrites[i].pImageInfo = &pyramidInfo;
+            }
+        }
+        devFuncs->vkUpdateDescriptorSets(device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void InstanceCuller::createPyramidDescriptorSets()
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    QVector<VkDescriptorSetLayout> layouts(m_pyramidLevelViews.size(), m_pyramidDescriptorSetLayout);
+    m_pyramidDescriptorSets.resize(m_pyramidLevelViews.size());
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_vulkanRenderer->descriptorPool();
+    allocInfo.descriptorSetCount = layouts.size();
+    allocInfo.pSetLayouts = layouts.constData();
+    VulkanRenderer::checkVkResult(devFuncs->vkAllocateDescriptorSets(device, &allocInfo, m_pyramidDescriptorSets.data()),
+                                  "failed to allocate depth pyramid descriptor sets");
+
+    for (int level = 0; level < m_pyramidLevelViews.size(); ++level) {
+        // Level 0 reduces the occluder depth 1:1, every other level the one above it
+        VkDescriptorImageInfo sourceInfo = level == 0
+                ? VkDescriptorImageInfo{m_pyramidSampler, m_depthImageView, VkImageLayout::VK_IMAGE_LAYOUT_GENERAL}
+                : VkDescriptorImageInfo{m_pyramidSampler, m_pyramidLevelViews.at(level - 1), VkImageLayout::VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorImageInfo destinationInfo{VK_NULL_HANDLE, m_pyramidLevelViews.at(level), VkImageLayout::VK_IMAGE_LAYOUT_GENERAL};
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        for (uint32_t i = 0; i < descriptorWrites.size(); ++i) {
+            descriptorWrites[i].sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].dstSet = m_pyramidDescriptorSets.at(level);
+            descriptorWrites[i].dstBinding = i;
+            descriptorWrites[i].descriptorCount = 1;
+        }
+        descriptorWrites[0].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].pImageInfo = &sourceInfo;
+        descriptorWrites[1].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[1].pImageInfo = &destinationInfo;
+        devFuncs->vkUpdateDescriptorSets(device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void InstanceCuller::updateUniformBuffers(int currentFrameIndex, const glm::mat4 &model, const glm::mat4 &projView, const glm::vec4 &boundingSphere)
+{
+    auto &frame = m_frames[currentFrameIndex];
+    collectStats(frame);
+    updateInstanceBinding(frame, currentFrameIndex);
+
+    VmaAllocator allocator = m_vulkanRenderer->allocator();
+    VmaAllocation allocation = frame.uniformBuffer.allocation;
+    CullBindingObject *cullUbo{};
+    VulkanRenderer::checkVkResult(vmaMapMemory(allocator, allocation, reinterpret_cast<void **>(&cullUbo)),
+                                  "failed to map cull uniform buffer memory");
+    auto mapGuard = sg::make_scope_guard([&]{ vmaUnmapMemory(allocator, allocation); });
+    auto size = pyramidSize();
+    cullUbo->model = model;
+    cullUbo->projView = projView;
+    cullUbo->frustumPlanes = frustumPlanes(projView);
+    cullUbo->boundingSphere = boundingSphere;
+    cullUbo->pyramidSize = {static_cast<float>(size.width()), static_cast<float>(size.height())};
+    cullUbo->modelScale = std::max({glm::length(glm::vec3{model[0]}), glm::length(glm::vec3{model[1]}), glm::length(glm::vec3{model[2]})});
+    cullUbo->instanceCount = static_cast<uint32_t>(std::min(m_instanceBuffer->count(), m_capacity));
+    cullUbo->pyramidLevels = static_cast<uint32_t>(m_pyramidLevelViews.size());
+    cullUbo->occlusion = occlusionEnabled() ? 1 : 0;
+}
+
+void InstanceCuller::collectStats(FrameResources &frame)
+{
+    // The resources of a frame are only reused once its previous submission is done on the GPU
+    if (!frame.statsPending) {
+        return;
+    }
+    frame.statsPending = false;
+    VmaAllocator allocator = m_vulkanRenderer->allocator();
+    VmaAllocation allocation = frame.statsReadback.allocation;
+    VulkanRenderer::checkVkResult(vmaInvalidateAllocation(allocator, allocation, 0, VK_WHOLE_SIZE),
+                                  "failed to invalidate cull stats memory");
+    CullCounters *counters{};
+    VulkanRenderer::checkVkResult(vmaMapMemory(allocator, allocation, reinterpret_cast<void **>(&counters)),
+                                  "failed to map cull stats memory");
+    auto mapGuard = sg::make_scope_guard([&]{ vmaUnmapMemory(allocator, allocation); });
+    m_stats.instances = frame.instanceCount;
+    m_stats.drawn = counters->drawCommand.instanceCount;
+    m_stats.frustumCulled = frame.instanceCount - counters->frustumVisibleCount;
+    m_stats.occluded = counters->frustumVisibleCount - counters->drawCommand.instanceCount;
+    if (++m_collectedFrames % reportInterval == 0) {
+        qDebug() << "Culling, instances: " << m_stats.instances << ", frustum culled: " << m_stats.frustumCulled
+                 << ", occluded: " << m_stats.occluded << ", drawn: " << m_stats.drawn;
+    }
+}
+
+void InstanceCuller::updateInstanceBinding(FrameResources &frame, int frameIndex)
+{
+    // The descriptor set is not in use, the submission of the frame which recorded it last is done
+    VkBuffer instances = m_instanceBuffer->buffer(frameIndex);
+    if (instances == frame.boundInstances) {
+        return;
+    }
+    qDebug() << "Rebind reallocated instance buffer, frame: " << frameIndex;
+    frame.boundInstances = instances;
+    VkDescriptorBufferInfo bufferInfo{instances, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = frame.descriptorSet;
+    descriptorWrite.dstBinding = instancesBinding;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = cullBindingType(instancesBinding);
+    descriptorWrite.pBufferInfo = &bufferInfo;
+    m_vulkanRenderer->devFuncs()->vkUpdateDescriptorSets(m_vulkanRenderer->device(), 1, &descriptorWrite, 0, nullptr);
+}
+
+void InstanceCuller::addPasses(RenderGraph &graph, const OccluderDraw &drawOccluders)
+{
+    // Written by the host before the submission, declared for the passes reading it
+    auto instances = graph.importBuffer(QStringLiteral("instances"));
+    auto visibility = graph.importBuffer(QStringLiteral("instance visibility"));
+    auto earlyInstances = graph.importBuffer(QStringLiteral("early instances"));
+    auto earlyDrawCommand = graph.importBuffer(QStringLiteral("early draw command"));
+    auto statsReadback = graph.importBuffer(QStringLiteral("cull stats readback"));
+    m_visibleInstancesResource = graph.importBuffer(QStringLiteral("visible instances"));
+    m_drawCommandResource = graph.importBuffer(QStringLiteral("draw command"));
+    auto depth = graph.importImage(QStringLiteral("occluder depth"), m_depthImage.object, VkImageAspectFlagBits::VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+    auto levelCount = static_cast<uint32_t>(m_pyramidLevelViews.size());
+    auto pyramid = graph.importImage(QStringLiteral("depth pyramid"), m_pyramidImage.object, VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+    graph.exportResource(statsReadback, RenderGraph::Access::HOST_READ);
+
+    graph.addPass(QStringLiteral("cull reset"), [this](VkCommandBuffer commandBuffer) {
+        recordReset(commandBuffer, m_frames[m_vulkanRenderer->surface()->currentFrame()]);
+    }).write(visibility, RenderGraph::Access::TRANSFER_WRITE)
+      .write(m_drawCommandResource, RenderGraph::Access::TRANSFER_WRITE)
+      .write(earlyDrawCommand, RenderGraph::Access::TRANSFER_WRITE);
+
+    if (occlusionEnabled()) {
+        graph.addPass(QStringLiteral("early cull"), [this](VkCommandBuffer commandBuffer) {
+            GpuScope cullScope{m_vulkanRenderer->gpuProfiler(), commandBuffer, "early cull"};
+            recordPhase(commandBuffer, m_frames.at(m_vulkanRenderer->surface()->currentFrame()), 0);
+        }).read(instances, RenderGraph::Access::COMPUTE_READ)
+          .read(visibility, RenderGraph::Access::COMPUTE_READ)
+          .read(earlyDrawCommand, RenderGraph::Access::COMPUTE_READ)
+          .write(earlyDrawCommand, RenderGraph::Access::COMPUTE_WRITE)
+          .write(earlyInstances, RenderGraph::Access::COMPUTE_WRITE, true);
+
+        graph.addPass(QStringLiteral("occluder depth"), [this, drawOccluders](VkCommandBuffer commandBuffer) {
+            recordOccluderDepth(commandBuffer, m_vulkanRenderer->surface()->currentFrame(), drawOccluders);
+        }).read(earlyInstances, RenderGraph::Access::VERTEX_READ)
+          .read(earlyDrawCommand, RenderGraph::Access::INDIRECT_READ)
+          .write(depth, RenderGraph::Access::DEPTH_ATTACHMENT_WRITE, true);
+
+        // Each level is a pass of its own, the graph puts the barrier between the write of a level and its read
+        for (uint32_t level = 0; level < levelCount; ++level) {
+            auto pass = graph.addPass(QStringLiteral("depth pyramid %1").arg(level), [this, level](VkCommandBuffer commandBuffer) {
+                recordPyramidLevel(commandBuffer, level);
+            });
+            if (level == 0) {
+                pass.read(depth, RenderGraph::Access::COMPUTE_READ);
+            } else {
+                pass.read(pyramid, RenderGraph::Access::COMPUTE_READ, level - 1);
+            }
+            pass.write(pyramid, RenderGraph::Access::COMPUTE_WRITE, level, true);
+        }
+    }
+
+    // Without occlusion the pyramid is never written, the read only gives it the layout of its descriptor
+    graph.addPass(QStringLiteral("late cull"), [this](VkCommandBuffer commandBuffer) {
+        GpuScope cullScope{m_vulkanRenderer->gpuProfiler(), commandBuffer, "late cull"};
+        recordPhase(commandBuffer, m_frames.at(m_vulkanRenderer->surface()->currentFrame()), 1);
+    }).read(instances, RenderGraph::Access::COMPUTE_READ)
+      .read(pyramid, RenderGraph::Access::COMPUTE_READ)
+      .read(m_drawCommandResource, RenderGraph::Access::COMPUTE_READ)
+      .write(m_drawCommandResource, RenderGraph::Access::COMPUTE_WRITE)
+      .write(m_visibleInstancesResource, RenderGraph::Access::COMPUTE_WRITE, true)
+      .write(visibility, RenderGraph::Access::COMPUTE_WRITE);
+
+    graph.addPass(QStringLiteral("cull stats readback"), [this](VkCommandBuffer commandBuffer) {
+        auto &frame = m_frames[m_vulkanRenderer->surface()->currentFrame()];
+        VkBufferCopy statsRegion{0, 0, sizeof(CullCounters)};
+        m_vulkanRenderer->devFuncs()->vkCmdCopyBuffer(commandBuffer, frame.drawCommand.object, frame.statsReadback.object, 1, &statsRegion);
+        frame.statsPending = true;
+    }).read(m_drawCommandResource, RenderGraph::Access::TRANSFER_READ)
+      .write(statsReadback, RenderGraph::Access::TRANSFER_WRITE, true);
+}
+
+void InstanceCuller::addDrawReads(RenderGraph::PassBuilder &pass) const
+{
+    pass.read(m_visibleInstancesResource, RenderGraph::Access::VERTEX_READ)
+        .read(m_drawCommandResource, RenderGraph::Access::INDIRECT_READ);
+}
+
+void InstanceCuller::recordReset(VkCommandBuffer commandBuffer, FrameResources &frame)
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    frame.instanceCount = static_cast<uint32_t>(std::min(m_instanceBuffer->count(), m_capacity));
+    if (!m_visibilityValid) {
+        devFuncs->vkCmdFillBuffer(commandBuffer, m_visibility.object, 0, VK_WHOLE_SIZE, 1);
+        m_visibilityValid = true;
+    }
+    CullCounters counters{{m_indexCount, 0, 0, 0, 0}, 0};
+    devFuncs->vkCmdUpdateBuffer(commandBuffer, frame.drawCommand.object, 0, sizeof(counters), &counters);
+    CullCounters earlyCounters{{m_occluderIndexCount, 0, 0, 0, 0}, 0};
+    devFuncs->vkCmdUpdateBuffer(commandBuffer, frame.earlyDrawCommand.object, 0, sizeof(earlyCounters), &earlyCounters);
+}
+
+void InstanceCuller::recordPhase(VkCommandBuffer commandBuffer, const FrameResources &frame, uint32_t late) const
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    devFuncs->vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0,
+                                      1, &frame.descriptorSet, 0, nullptr);
+    devFuncs->vkCmdPushConstants(commandBuffer, m_pipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(late), &late);
+    devFuncs->vkCmdDispatch(commandBuffer, (frame.instanceCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+}
+
+void InstanceCuller::recordOccluderDepth(VkCommandBuffer commandBuffer, int currentFrameIndex, const OccluderDraw &drawOccluders) const
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    const auto &frame = m_frames.at(currentFrameIndex);
+    GpuScope depthScope{m_vulkanRenderer->gpuProfiler(), commandBuffer, "occluder depth"};
+    VkClearValue clearValue{};
+    clearValue.depthStencil = {1.0F, 0};
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = m_depthRenderPass;
+    renderPassInfo.framebuffer = m_depthFramebuffer;
+    renderPassInfo.renderArea = VulkanRenderer::createVkRect2D(depthSize());
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearValue;
+    devFuncs->vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_INLINE);
+    drawOccluders(commandBuffer, currentFrameIndex, frame.earlyInstances.object, frame.earlyDrawCommand.object);
+    devFuncs->vkCmdEndRenderPass(commandBuffer);
+}
+
+void InstanceCuller::recordPyramidLevel(VkCommandBuffer commandBuffer, uint32_t level) const
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    auto size = pyramidSize();
+    auto levelWidth = std::max(1U, static_cast<uint32_t>(size.width()) >> level);
+    auto levelHeight = std::max(1U, static_cast<uint32_t>(size.height()) >> level);
+    devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramidPipeline);
+    devFuncs->vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramidPipelineLayout, 0,
+                                      1, &m_pyramidDescriptorSets.at(level), 0, nullptr);
+    devFuncs->vkCmdDispatch(commandBuffer, (levelWidth + pyramidGroupSize - 1) / pyramidGroupSize, (levelHeight + pyramidGroupSize - 1) / pyramidGroupSize, 1);
+}
+
+void InstanceCuller::releaseSwapChainResources()
+{
+    if (m_frames.isEmpty()) {
+        return;
+    }
+    qDebug() << "Destroy instance culler buffers";
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    VmaAllocator allocator = m_vulkanRenderer->allocator();
+    // Descriptor sets go away with the descriptor pool of the renderer
+    m_pyramidDescriptorSets.clear();
+    for (auto levelView : qAsConst(m_pyramidLevelViews)) {
+        devFuncs->vkDestroyImageView(device, levelView, nullptr);
+    }
+    m_pyramidLevelViews.clear();
+    devFuncs->vkDestroyImageView(device, m_pyramidImageView, nullptr);
+    m_pyramidImageView = {};
+    m_pyramidImage.destroy(allocator);
+    devFuncs->vkDestroyFramebuffer(device, m_depthFramebuffer, nullptr);
+    m_depthFramebuffer = {};
+    devFuncs->vkDestroyImageView(device, m_depthImageView, nullptr);
+    m_depthImageView = {};
+    m_depthImage.destroy(allocator);
+    m_visibility.destroy(allocator);
+    for (auto &frame : m_frames) {
+        frame.statsReadback.destroy(allocator);
+        frame.earlyDrawCommand.destroy(allocator);
+        frame.earlyInstances.destroy(allocator);
+        frame.drawCommand.destroy(allocator);
+        frame.visibleInstances.destroy(allocator);
+        frame.uniformBuffer.destroy(allocator);
+    }
+    m_frames.clear();
+}
+
+void InstanceCuller::releaseResources()
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    devFuncs->vkDestroyRenderPass(device, m_depthRenderPass, nullptr);
+    m_depthRenderPass = {};
+    devFuncs->vkDestroySampler(device, m_pyramidSampler, nullptr);
+    m_pyramidSampler = {};
+    devFuncs->vkDestroyPipeline(device, m_pyramidPipeline, nullptr);
+    m_pyramidPipeline = {};
+    devFuncs->vkDestroyPipelineLayout(device, m_pyramidPipelineLayout, nullptr);
+    m_pyramidPipelineLayout = {};
+    devFuncs->vkDestroyDescriptorSetLayout(device, m_pyramidDescriptorSetLayout, nullptr);
+    m_pyramidDescriptorSetLayout = {};
+    devFuncs->vkDestroyShaderModule(device, m_pyramidShaderModule, nullptr);
+    m_pyramidShaderModule = {};
+    devFuncs->vkDestroyPipeline(device, m_pipeline, nullptr);
+    m_pipeline = {};
+    devFuncs->vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+    m_pipelineLayout = {};
+    devFuncs->vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+    m_descriptorSetLayout = {};
+    devFuncs->vkDestroyShaderModule(device, m_shaderModule, nullptr);
+    m_shaderModule = {};
+}
@@ -0,0 +1,136 @@
+#ifndef INSTANCECULLER_H
+#define INSTANCECULLER_H
+
+#include "abstractpipeline.h"
+#include "objectwithallocation.h"
+#include "rendergraph.h"
+
+#include <QSize>
+#include <QVector>
+
+#include <functional>
+
+class InstanceBuffer;
+class VulkanRenderer;
+
+// Culls the instances of one mesh with compute passes of the frame graph before the render pass.
+// Visible instances are compacted into a vertex buffer and counted in a VkDrawIndexedIndirectCommand,
+// so the draw does not depend on the CPU knowing what is visible.
+//
+// Occlusion culling runs in two phases. The early phase selects the instances which were visible in the
+// previous frame, their occluder proxies are drawn into a full resolution depth pass and reduced into a depth
+// pyramid (Hi-Z) whose first level already covers 2x2 pixels with their farthest depth. The late phase tests
+// every instance against the pyramid, which also catches the instances which became visible in this frame.
+class InstanceCuller
+{
+public:
+    // Records an indirect draw of the given instances, it is called inside of the depth pass
+    using OccluderDraw = std::function<void(VkCommandBuffer commandBuffer, int currentFrameIndex, VkBuffer instanceBuffer, VkBuffer drawCommandBuffer)>;
+
+    InstanceCuller(VulkanRenderer *vulkanRenderer, const InstanceBuffer *instanceBuffer);
+
+    InstanceCuller(const InstanceCuller &) = delete;
+    InstanceCuller(InstanceCuller &&) = delete;
+    InstanceCuller &operator=(const InstanceCuller &) = delete;
+    InstanceCuller &operator=(InstanceCuller &&) = delete;
+
+    ~InstanceCuller();
+
+    void initResources();
+    // The capacity is the instance count at this point, later instances are not drawn until the swap chain is recreated.
+    // The occluder draws use occluderIndexCount, the indices of the proxy the OccluderDraw binds.
+    void initSwapChainResources(uint32_t indexCount, uint32_t occluderIndexCount);
+    [[nodiscard]] DescriptorPoolSizes descriptorPoolSizes(int frameCount) const;
+    // boundingSphere is in model space: xyz - center, w - radius. Called after the instance buffer of the frame is updated,
+    // the descriptor set follows it when it was reallocated.
+    void updateUniformBuffers(int currentFrameIndex, const glm::mat4 &model, const glm::mat4 &projView, const glm::vec4 &boundingSphere);
+    // Reset, early cull, occluder depth, one pass per pyramid level, late cull and the stats readback, each frame records
+    // them for its own buffers. Occlusion culling has to be the same until the swap chain is recreated.
+    void addPasses(RenderGraph &graph, const OccluderDraw &drawOccluders);
+    // Reads of the draw using visibleInstanceBuffer and drawCommandBuffer, its pass is added after addPasses
+    void addDrawReads(RenderGraph::PassBuilder &pass) const;
+    void releaseSwapChainResources();
+    void releaseResources();
+
+    [[nodiscard]] bool occlusionEnabled() const;
+    // Render pass and size of the occluder depth pass, pipelines drawing the occluders are built against them
+    [[nodiscard]] VkRenderPass depthRenderPass() const { return m_depthRenderPass; }
+    [[nodiscard]] QSize depthSize() const;
+    // Size of the first pyramid level, half of the depth size rounded up
+    [[nodiscard]] QSize pyramidSize() const;
+    [[nodiscard]] VkBuffer visibleInstanceBuffer(int frameIndex) const { return m_frames.at(frameIndex).visibleInstances.object; }
+    [[nodiscard]] VkBuffer drawCommandBuffer(int frameIndex) const { return m_frames.at(frameIndex).drawCommand.object; }
+    // Counts of the latest frame read back from the GPU, a few frames behind the recorded one
+    [[nodiscard]] const CullStats &stats() const { return m_stats; }
+
+private:
+    struct FrameResources
+    {
+        BufferWithAllocation uniformBuffer;
+        BufferWithAllocation visibleInstances;
+        BufferWithAllocation drawCommand;
+        BufferWithAllocation earlyInstances;
+        BufferWithAllocation earlyDrawCommand;
+        // Host readable copy of the draw command and the frustum visible count
+        BufferWithAllocation statsReadback;
+        bool statsPending;
+        uint32_t instanceCount;
+        VkDescriptorSet descriptorSet;
+        // Instance buffer the descriptor set reads, InstanceBuffer replaces it when the instances outgrow it
+        VkBuffer boundInstances;
+    };
+
+    VulkanRenderer *const m_vulkanRenderer;
+    const InstanceBuffer *const m_instanceBuffer;
+    VkShaderModule m_shaderModule;
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_pipeline;
+    QVector<FrameResources> m_frames;
+    int m_capacity;
+    uint32_t m_indexCount;
+    uint32_t m_occluderIndexCount;
+
+    // Written by the late phase and read by the early phase of the next frame, ordered by the graph
+    BufferWithAllocation m_visibility;
+    bool m_visibilityValid;
+    // One resource stands for the buffers of every frame, buffer barriers of the graph are global anyway
+    RenderGraph::Resource m_visibleInstancesResource;
+    RenderGraph::Resource m_drawCommandResource;
+
+    VkRenderPass m_depthRenderPass;
+    ObjectWithAllocation<VkImage> m_depthImage;
+    VkImageView m_depthImageView;
+    VkFramebuffer m_depthFramebuffer;
+
+    VkShaderModule m_pyramidShaderModule;
+    VkDescriptorSetLayout m_pyramidDescriptorSetLayout;
+    VkPipelineLayout m_pyramidPipelineLayout;
+    VkPipeline m_pyramidPipeline;
+    VkSampler m_pyramidSampler;
+    ObjectWithAllocation<VkImage> m_pyramidImage;
+    VkImageView m_pyramidImageView;
+    QVector<VkImageView> m_pyramidLevelViews;
+    QVector<VkDescriptorSet> m_pyramidDescriptorSets;
+
+    CullStats m_stats;
+    int m_collectedFrames;
+
+    [[nodiscard]] uint32_t pyramidLevelCount() const;
+    [[nodiscard]] VkDescriptorSetLayout createDescriptorSetLayout() const;
+    [[nodiscard]] VkDescriptorSetLayout createPyramidDescriptorSetLayout() const;
+    [[nodiscard]] VkRenderPass createDepthRenderPass() const;
+    [[nodiscard]] VkSampler createPyramidSampler() const;
+    void createDepthResources();
+    void createPyramidResources();
+    void createDescriptorSets();
+    void createPyramidDescriptorSets();
+    void collectStats(FrameResources &frame);
+    void updateInstanceBinding(FrameResources &frame, int frameIndex);
+    void recordReset(VkCommandBuffer commandBuffer, FrameResources &frame);
+    void recordPhase(VkCommandBuffer commandBuffer, const FrameResources &frame, uint32_t late) const;
+    void recordOccluderDepth(VkCommandBuffer commandBuffer, int currentFrameIndex, const OccluderDraw &drawOccluders) const;
+    void recordPyramidLevel(VkCommandBuffer commandBuffer, uint32_t level) const;
+};
+
+#endif // INSTANCECULLER_H
@@ -0,0 +1,53 @@
+#include "instancedata.h"
+
+namespace {
+constexpr uint32_t instanceBinding = 1;
+constexpr uint32_t firstInstanceLocation = 3;
+}
+
+InstanceData InstanceData::identity()
+{
+    return {glm::vec4{0.0F, 0.0F, 0.0F, 1.0F}, glm::vec4{0.0F, 0.0F, 0.0F, 1.0F}};
+}
+
+glm::mat4 InstanceData::matrix() const
+{
+    auto x = rotation.x;
+    auto y = rotation.y;
+    auto z = rotation.z;
+    auto w = rotation.w;
+    auto scale = positionScale.w;
+    glm::mat4 result{
+        glm::vec4{1.0F - 2.0F * (y * y + z * z), 2.0F * (x * y + w * z), 2.0F * (x * z - w * y), 0.0F} * scale,
+        glm::vec4{2.0F * (x * y - w * z), 1.0F - 2.0F * (x * x + z * z), 2.0F * (y * z + w * x), 0.0F} * scale,
+        glm::vec4{2.0F * (x * z + w * y), 2.0F * (y * z - w * x), 1.0F - 2.0F * (x * x + y * y), 0.0F} * scale,
+        glm::vec4{glm::vec3{positionScale}, 1.0F}
+    };
+    return result;
+}
+
+VkVertexInputBindingDescription InstanceData::createBindingDescription()
+{
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = instanceBinding;
+    bindingDescription.stride = sizeof(InstanceData);
+    bindingDescription.inputRate = VkVertexInputRate::VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 2> InstanceData::createAttributeDescriptions()
+{
+    std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+    attributeDescriptions[0].binding = instanceBinding;
+    attributeDescriptions[0].location = firstInstanceLocation;
+    attributeDescriptions[0].format = VkFormat::VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(InstanceData, rotation);
+
+    attributeDescriptions[1].binding = instanceBinding;
+    attributeDescriptions[1].location = firstInstanceLocation + 1;
+    attributeDescriptions[1].format = VkFormat::VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof(InstanceData, positionScale);
+
+    return attributeDescriptions;
+}
@@ -0,0 +1,28 @@
+#ifndef INSTANCEDATA_H
+#define INSTANCEDATA_H
+
+#include "glm.h"
+
+#include <array>
+
+#include <QVulkanInstance>
+
+// Per instance transform, applied in model space before the model matrix: rotate, scale uniformly, translate
+struct InstanceData
+{
+    // Unit quaternion, xyz - axis part, w - scalar part
+    glm::vec4 rotation;
+    // xyz - translation, w - uniform scale
+    glm::vec4 positionScale;
+
+    [[nodiscard]] static InstanceData identity();
+    // Same transform as tex.vert applies, for culling on the CPU
+    [[nodiscard]] glm::mat4 matrix() const;
+
+    // Binding 1, advanced once per instance
+    [[nodiscard]] static VkVertexInputBindingDescription createBindingDescription();
+    // Locations 3 and 4, following TexVertex
+    [[nodiscard]] static std::array<VkVertexInputAttributeDescription, 2> createAttributeDescriptions();
+};
+
+#endif // INSTANCEDATA_H
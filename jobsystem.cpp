@@ -0,0 +1,206 @@
+#include "jobsystem.h"
+
+#include "cpuprofiler.h"
+
+#include <QDebug>
+#include <QThread>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+// Queue of the worker running on this thread, or -1 on threads which are not workers
+thread_local const JobSystem *currentJobSystem{};
+thread_local int currentQueueIndex{-1};
+}
+
+JobCounter::JobCounter()
+    : m_pending{}
+    , m_failed{}
+{
+}
+
+JobSystem &JobSystem::instance()
+{
+    static JobSystem jobSystem{std::max(1, QThread::idealThreadCount() - 1)};
+    return jobSystem;
+}
+
+JobSystem::JobSystem(int workerCount)
+    : m_queuedJobs{}
+    , m_sleepers{}
+    , m_stopping{}
+    , m_nextVictim{}
+{
+    qDebug() << "Create job system, workers: " << workerCount;
+    for (int queueIndex = 0; queueIndex <= workerCount; ++queueIndex) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    m_threads.reserve(workerCount);
+    for (int workerIndex = 0; workerIndex < workerCount; ++workerIndex) {
+        m_threads.emplace_back(&JobSystem::workerLoop, this, workerIndex);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    m_stopping = true;
+    notifyStateChanged();
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void JobSystem::submit(JobCounter &counter, Job job)
+{
+    counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+    auto &queue = *m_queues[ownQueueIndex()];
+    {
+        std::lock_guard lock{queue.mutex};
+        queue.jobs.push_back({std::move(job), &counter});
+    }
+    ++m_queuedJobs;
+    notifyStateChanged();
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+    PROFILE_ZONE("JobSystem::wait");
+    while (!counter.done()) {
+        if (!runOneJob()) {
+            sleepUntil([this, &counter]{ return counter.done() || m_queuedJobs > 0; });
+        }
+    }
+    if (counter.m_failed) {
+        std::rethrow_exception(counter.m_error);
+    }
+}
+
+void JobSystem::parallelFor(int itemCount, int workerCount, const std::function<void(int workerIndex, int itemIndex)> &body)
+{
+    if (itemCount <= 0) {
+        return;
+    }
+    workerCount = std::clamp(workerCount, 1, itemCount);
+
+    std::atomic_int nextItem{0};
+    std::atomic_bool failed{false};
+    std::vector<std::exception_ptr> errors(workerCount);
+
+    auto work = [&](int workerIndex) {
+        try {
+            for (int itemIndex = nextItem++; itemIndex < itemCount && !failed; itemIndex = nextItem++) {
+                body(workerIndex, itemIndex);
+            }
+        } catch (...) {
+            errors[workerIndex] = std::current_exception();
+            failed = true;
+        }
+    };
+
+    JobCounter counter{};
+    for (int workerIndex = 1; workerIndex < workerCount; ++workerIndex) {
+        submit(counter, [&work, workerIndex]{ work(workerIndex); });
+    }
+    work(0);
+    wait(counter);
+
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void JobSystem::workerLoop(int workerIndex)
+{
+    currentJobSystem = this;
+    currentQueueIndex = workerIndex;
+    while (!m_stopping) {
+        if (!runOneJob()) {
+            sleepUntil([this]{ return m_stopping || m_queuedJobs > 0; });
+        }
+    }
+}
+
+int JobSystem::ownQueueIndex() const
+{
+    return currentJobSystem == this ? currentQueueIndex : static_cast<int>(m_queues.size()) - 1;
+}
+
+bool JobSystem::runOneJob()
+{
+    if (m_queuedJobs == 0) {
+        return false;
+    }
+    QueuedJob job{};
+    // Own jobs newest first, they are the most likely to be in the cache, stolen jobs oldest first
+    auto queueIndex = ownQueueIndex();
+    if (popJob(queueIndex, true, job)) {
+        execute(job);
+        return true;
+    }
+    auto queueCount = static_cast<int>(m_queues.size());
+    auto firstVictim = static_cast<int>(m_nextVictim++ % static_cast<unsigned int>(queueCount));
+    for (int i = 0; i < queueCount; ++i) {
+        auto victim = (firstVictim + i) % queueCount;
+        if (victim != queueIndex && popJob(victim, false, job)) {
+            execute(job);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::popJob(int queueIndex, bool back, QueuedJob &job)
+{
+    auto &queue = *m_queues[queueIndex];
+    std::lock_guard lock{queue.mutex};
+    if (queue.jobs.empty()) {
+        return false;
+    }
+    if (back) {
+        job = std::move(queue.jobs.back());
+        queue.jobs.pop_back();
+    } else {
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+    }
+    --m_queuedJobs;
+    return true;
+}
+
+void JobSystem::execute(QueuedJob &job)
+{
+    auto *counter = job.counter;
+    try {
+        job.job();
+    } catch (...) {
+        if (!counter->m_failed.exchange(true)) {
+            counter->m_error = std::current_exception();
+        }
+    }
+    // Destroy the captures before the waiting thread can return
+    job.job = nullptr;
+    // The counter may be gone as soon as it reaches 0
+    if (--counter->m_pending == 0) {
+        notifyStateChanged();
+    }
+}
+
+void JobSystem::sleepUntil(const std::function<bool()> &wake)
+{
+    std::unique_lock lock{m_sleepMutex};
+    ++m_sleepers;
+    m_stateChanged.wait(lock, wake);
+    --m_sleepers;
+}
+
+void JobSystem::notifyStateChanged()
+{
+    // Sleepers check their condition while holding the mutex, taking it orders the change before their check
+    if (m_sleepers > 0) {
+        { std::lock_guard lock{m_sleepMutex}; }
+        m_stateChanged.notify_all();
+    }
+}
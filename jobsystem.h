@@ -0,0 +1,103 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished jobs submitted with it, a job may submit children with the counter of its parent
+// or with one of its own and wait for them. Used for one batch of jobs, it is not reset after a wait.
+class JobCounter
+{
+public:
+    JobCounter();
+
+    JobCounter(const JobCounter &) = delete;
+    JobCounter(JobCounter &&) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+    JobCounter &operator=(JobCounter &&) = delete;
+
+    ~JobCounter() = default;
+
+    [[nodiscard]] bool done() const { return m_pending == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic_int m_pending;
+    std::atomic_bool m_failed;
+    // Written by the first failing job before it finishes
+    std::exception_ptr m_error;
+};
+
+// Work stealing thread pool. Every worker owns a deque, it pushes and pops its own jobs at the back
+// and steals from the front of the others when it runs dry. Threads which are not workers submit into
+// a shared queue. Waiting for a counter runs queued jobs on the waiting thread instead of blocking it,
+// so jobs can wait for their children without starving the pool.
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    // Process wide instance, one worker per core besides the thread driving the frame
+    [[nodiscard]] static JobSystem &instance();
+
+    explicit JobSystem(int workerCount);
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem(JobSystem &&) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+    JobSystem &operator=(JobSystem &&) = delete;
+
+    ~JobSystem();
+
+    [[nodiscard]] int workerCount() const { return static_cast<int>(m_threads.size()); }
+
+    void submit(JobCounter &counter, Job job);
+    // Runs jobs until every job of the counter finished, then rethrows the first exception thrown by them
+    void wait(JobCounter &counter);
+
+    // Calls body(workerIndex, itemIndex) for every item in [0, itemCount) from up to workerCount jobs, the calling
+    // thread takes part as worker 0. A worker index is used by one job only, so it can select per worker state.
+    // The first exception thrown by body is rethrown after all jobs finished.
+    void parallelFor(int itemCount, int workerCount, const std::function<void(int workerIndex, int itemIndex)> &body);
+
+private:
+    struct QueuedJob
+    {
+        Job job;
+        JobCounter *counter;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<QueuedJob> jobs;
+    };
+
+    // One per worker, the last one takes the jobs of other threads
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic_int m_queuedJobs;
+    std::atomic_int m_sleepers;
+    std::atomic_bool m_stopping;
+    std::atomic_uint m_nextVictim;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_stateChanged;
+
+    void workerLoop(int workerIndex);
+    [[nodiscard]] int ownQueueIndex() const;
+    [[nodiscard]] bool runOneJob();
+    [[nodiscard]] bool popJob(int queueIndex, bool back, QueuedJob &job);
+    void execute(QueuedJob &job);
+    void sleepUntil(const std::function<bool()> &wake);
+    void notifyStateChanged();
+};
+
+#endif // JOBSYSTEM_H
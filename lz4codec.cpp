@@ -0,0 +1,156 @@
+#include "lz4codec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+constexpr int minMatch = 4;
+// The block ends with at least this many literals
+constexpr int lastLiterals = 5;
+// No match starts in the last bytes of a block
+constexpr int matchFindLimit = 12;
+constexpr int maxOffset = 65535;
+constexpr int hashBits = 16;
+constexpr int lengthMask = 15;
+constexpr int lengthExtension = 255;
+
+[[nodiscard]] uint32_t read32(const uint8_t *data)
+{
+    uint32_t result{};
+    std::memcpy(&result, data, sizeof(result));
+    return result;
+}
+
+[[nodiscard]] uint32_t hashSequence(uint32_t sequence)
+{
+    // Knuth's multiplicative hash, the top bits are the best mixed
+    return (sequence * 2654435761U) >> (32 - hashBits);
+}
+
+void writeLength(QByteArray &output, int length)
+{
+    for (; length >= lengthExtension; length -= lengthExtension) {
+        output.append(static_cast<char>(lengthExtension));
+    }
+    output.append(static_cast<char>(length));
+}
+
+// A match length of 0 writes the closing literals of the block, which have no match after them
+void writeSequence(QByteArray &output, const uint8_t *literals, int literalLength, int offset, int matchLength)
+{
+    auto matchCode = matchLength > 0 ? matchLength - minMatch : 0;
+    auto token = (std::min(literalLength, lengthMask) << 4) | std::min(matchCode, lengthMask);
+    output.append(static_cast<char>(token));
+    if (literalLength >= lengthMask) {
+        writeLength(output, literalLength - lengthMask);
+    }
+    output.append(reinterpret_cast<const char *>(literals), literalLength);
+    if (matchLength == 0) {
+        return;
+    }
+    output.append(static_cast<char>(offset & 0xff));
+    output.append(static_cast<char>(offset >> 8));
+    if (matchCode >= lengthMask) {
+        writeLength(output, matchCode - lengthMask);
+    }
+}
+
+[[nodiscard]] int readLength(const uint8_t *&input, const uint8_t *inputEnd, int length)
+{
+    if (length != lengthMask) {
+        return length;
+    }
+    uint8_t extension{};
+    do {
+        if (input == inputEnd) {
+            throw std::runtime_error{"truncated lz4 block"};
+        }
+        extension = *input++;
+        length += extension;
+        if (length < 0) {
+            throw std::runtime_error{"lz4 length overflow"};
+        }
+    } while (extension == lengthExtension);
+    return length;
+}
+}
+
+QByteArray lz4Compress(const QByteArray &input)
+{
+    const auto *source = reinterpret_cast<const uint8_t *>(input.constData());
+    auto size = static_cast<int>(input.size());
+    QByteArray output{};
+    output.reserve(size + size / lengthExtension + 16);
+    int anchor = 0;
+    if (size > matchFindLimit) {
+        std::vector<int> table(1U << hashBits, -1);
+        auto matchLimit = size - lastLiterals;
+        auto searchLimit = size - matchFindLimit;
+        int position = 0;
+        while (position < searchLimit) {
+            auto sequence = read32(source + position);
+            auto &slot = table[hashSequence(sequence)];
+            auto candidate = slot;
+            slot = position;
+            if (candidate < 0 || position - candidate > maxOffset || read32(source + candidate) != sequence) {
+                ++position;
+                continue;
+            }
+            auto length = minMatch;
+            while (position + length < matchLimit && source[candidate + length] == source[position + length]) {
+                ++length;
+            }
+            writeSequence(output, source + anchor, position - anchor, position - candidate, length);
+            position += length;
+            anchor = position;
+        }
+    }
+    writeSequence(output, source + anchor, size - anchor, 0, 0);
+    return output;
+}
+
+QByteArray lz4Decompress(const char *input, qint64 inputSize, qint64 outputSize)
+{
+    QByteArray output(static_cast<int>(outputSize), Qt::Uninitialized);
+    const auto *in = reinterpret_cast<const uint8_t *>(input);
+    const auto *inEnd = in + inputSize;
+    auto *outBegin = reinterpret_cast<uint8_t *>(output.data());
+    auto *out = outBegin;
+    auto *outEnd = outBegin + outputSize;
+    while (in != inEnd) {
+        auto token = *in++;
+        auto literalLength = readLength(in, inEnd, token >> 4);
+        if (literalLength > inEnd - in || literalLength > outEnd - out) {
+            throw std::runtime_error{"lz4 literals out of range"};
+        }
+        std::memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        // The closing literals have no match
+        if (in == inEnd) {
+            break;
+        }
+        if (inEnd - in < 2) {
+            throw std::runtime_error{"truncated lz4 block"};
+        }
+        auto offset = in[0] | (in[1] << 8);
+        in += 2;
+        auto matchLength = readLength(in, inEnd, token & lengthMask) + minMatch;
+        if (offset == 0 || offset > out - outBegin || matchLength > outEnd - out) {
+            throw std::runtime_error{"lz4 match out of range"};
+        }
+        // Overlapping matches repeat the bytes just written, so the copy goes forward one byte at a time
+        const auto *match = out - offset;
+        for (int i = 0; i < matchLength; ++i) {
+            out[i] = match[i];
+        }
+        out += matchLength;
+    }
+    if (out != outEnd) {
+        throw std::runtime_error{"lz4 block size mismatch"};
+    }
+    return output;
+}
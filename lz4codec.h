@@ -0,0 +1,11 @@
+#ifndef LZ4CODEC_H
+#define LZ4CODEC_H
+
+#include <QByteArray>
+
+// LZ4 block format without the frame around it, the sizes are kept by the caller. The compressor is the greedy single
+// probe one, the decompressor checks every length and offset against its buffers and throws on malformed input.
+[[nodiscard]] QByteArray lz4Compress(const QByteArray &input);
+[[nodiscard]] QByteArray lz4Decompress(const char *input, qint64 inputSize, qint64 outputSize);
+
+#endif // LZ4CODEC_H
@@ -1,8 +1,12 @@
 #include "closeeventfilter.h"
+#include "headlessrunner.h"
 #include "mainwindow.h"
+#include "perfcheck.h"
+#include "qualitycalibration.h"
 #include "settings.h"
 #include "utils.h"
 
+#include <QCommandLineParser>
 #include <QGuiApplication>
 #include <QDebug>
 #include <QLoggingCategory>
@@ -10,8 +14,38 @@
 #include <QVulkanInstance>
 #include <QWindow>
 
+#include <cstring>
+#include <exception>
+
+namespace {
+[[nodiscard]] bool hasHeadlessArgument(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+[[nodiscard]] QSize parseSize(const QString &value)
+{
+    auto parts = value.split(QLatin1Char{'x'});
+    if (parts.size() != 2) {
+        return {};
+    }
+    return {parts.at(0).toInt(), parts.at(1).toInt()};
+}
+}
+
 int main(int argc, char *argv[])
 {
+    // The platform plugin has to be chosen before the application object exists, so no window system is needed
+    bool headless = hasHeadlessArgument(argc, argv);
+    if (headless && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", QByteArrayLiteral("offscreen"));
+    }
+
     QLoggingCategory::setFilterRules(QStringLiteral("qt.vulkan=true"));
 
     QCoreApplication::setOrganizationName(QStringLiteral("maratik"));
@@ -21,16 +55,84 @@ int main(int argc, char *argv[])
 
     QGuiApplication a{argc, argv};
 
+    QCommandLineParser parser{};
+    parser.addHelpOption();
+    QCommandLineOption headlessOption{QStringLiteral("headless"), QStringLiteral("Render offscreen and report frame times.")};
+    QCommandLineOption framesOption{QStringLiteral("frames"), QStringLiteral("Number of headless frames."), QStringLiteral("count"), QStringLiteral("1000")};
+    QCommandLineOption sizeOption{QStringLiteral("size"), QStringLiteral("Headless target size."), QStringLiteral("WxH"), QStringLiteral("1920x1080")};
+    QCommandLineOption samplesOption{QStringLiteral("samples"), QStringLiteral("Maximum headless sample count."), QStringLiteral("count"), QStringLiteral("8")};
+    QCommandLineOption timeStepOption{QStringLiteral("time-step"), QStringLiteral("Headless animation seconds per frame."), QStringLiteral("seconds"), QStringLiteral("0.016666")};
+    QCommandLineOption pngOption{QStringLiteral("png"), QStringLiteral("Save the final headless frame."), QStringLiteral("file")};
+    QCommandLineOption depthPrepassOption{QStringLiteral("depth-prepass"), QStringLiteral("Draw the headless frames with a depth prepass.")};
+    QCommandLineOption qualityLevelOption{QStringLiteral("quality-level"), QStringLiteral("Draw the headless frames at a fixed quality level."), QStringLiteral("level")};
+    QCommandLineOption recalibrateOption{QStringLiteral("recalibrate"), QStringLiteral("Measure the startup quality level again.")};
+    QCommandLineOption perfSceneOption{QStringLiteral("perf-scene"),
+                                       QStringLiteral("Run a fixed headless scene against the perf baseline: %1.").arg(PerfCheck::sceneNames().join(QStringLiteral(", "))),
+                                       QStringLiteral("name")};
+    QCommandLineOption perfBaselineOption{QStringLiteral("perf-baseline"), QStringLiteral("Perf baseline file."), QStringLiteral("file"), QStringLiteral("perf/baseline.json")};
+    QCommandLineOption perfUpdateOption{QStringLiteral("perf-update"), QStringLiteral("Record the perf scene as the new baseline.")};
+    QCommandLineOption perfToleranceScaleOption{QStringLiteral("perf-tolerance-scale"), QStringLiteral("Multiplier of the baseline tolerances."),
+                                                QStringLiteral("factor"), QStringLiteral("1")};
+    QCommandLineOption allowMissingBaselineOption{QStringLiteral("allow-missing-baseline"),
+                                                  QStringLiteral("Pass a perf scene which has no baseline instead of failing.")};
+    parser.addOptions({headlessOption, framesOption, sizeOption, samplesOption, timeStepOption, pngOption, depthPrepassOption,
+                       qualityLevelOption, recalibrateOption, perfSceneOption, perfBaselineOption, perfUpdateOption, perfToleranceScaleOption,
+                       allowMissingBaselineOption});
+    parser.process(a);
+
     QVulkanInstance inst{};
     inst.setApiVersion(QVersionNumber{1, 2, 0});
 
     inst.setLayers(vulkanLayers);
+    if (inst.supportedExtensions().contains(QByteArrayLiteral(VK_EXT_DEBUG_UTILS_EXTENSION_NAME))) {
+        inst.setExtensions({QByteArrayLiteral(VK_EXT_DEBUG_UTILS_EXTENSION_NAME)});
+    }
 
     if (!inst.create()) {
         qDebug() << "Vulkan is not available: " << inst.errorCode();
         return 1;
     }
 
+    if (headless && parser.isSet(perfSceneOption)) {
+        PerfCheckOptions options{};
+        options.sceneName = parser.value(perfSceneOption);
+        options.baselineFile = parser.value(perfBaselineOption);
+        options.update = parser.isSet(perfUpdateOption);
+        options.toleranceScale = parser.value(perfToleranceScaleOption).toDouble();
+        options.allowMissingBaseline = parser.isSet(allowMissingBaselineOption);
+        try {
+            return PerfCheck{&inst, options}.run();
+        } catch (const std::exception &e) {
+            qDebug() << "Perf check failed: " << e.what();
+            return 1;
+        }
+    }
+
+    if (headless) {
+        HeadlessOptions options{};
+        options.userSettings = true;
+        options.frames = parser.value(framesOption).toInt();
+        options.size = parseSize(parser.value(sizeOption));
+        options.samples = parser.value(samplesOption).toInt();
+        options.timeStep = parser.value(timeStepOption).toFloat();
+        options.pngFile = parser.value(pngOption);
+        options.depthPrepass = parser.isSet(depthPrepassOption);
+        if (parser.isSet(qualityLevelOption)) {
+            options.qualityLevel = parser.value(qualityLevelOption).toInt();
+        }
+        if (options.frames <= 0 || options.size.isEmpty() || options.samples <= 0) {
+            qDebug() << "Invalid headless options";
+            return 1;
+        }
+        try {
+            HeadlessRunner::report(HeadlessRunner{&inst, options}.run());
+        } catch (const std::exception &e) {
+            qDebug() << "Headless run failed: " << e.what();
+            return 1;
+        }
+        return 0;
+    }
+
     CloseEventFilter cef{};
 
     QObject::connect(&cef, &CloseEventFilter::close,
@@ -45,6 +147,12 @@ int main(int argc, char *argv[])
     w.installEventFilter(&cef);
     w.setVulkanInstance(&inst);
     Settings::loadSettings(w);
+    // The window renders at the calibrated level, a failed calibration leaves the highest one
+    try {
+        w.setQualityLevel(QualityCalibration{&inst, w.size()}.run(parser.isSet(recalibrateOption)));
+    } catch (const std::exception &e) {
+        qDebug() << "Quality calibration failed: " << e.what();
+    }
     w.show();
 
     return QGuiApplication::exec();
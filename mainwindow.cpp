@@ -1,16 +1,39 @@
 #include "mainwindow.h"
 
+#include "settings.h"
 #include "vulkanrenderer.h"
 
 #include <QDebug>
+#include <QKeyEvent>
 
 MainWindow::MainWindow(QWindow *parent)
     : QVulkanWindow{parent}
+    , m_renderSettings{Settings::loadRenderSettings()}
+    , m_frameScheduler{this, m_renderSettings}
+    , m_surface{this, &m_frameScheduler}
+    , m_renderer{}
 {
 }
 
 QVulkanWindowRenderer *MainWindow::createRenderer()
 {
     qDebug() << "Creating renderer";
-    return new VulkanRenderer{this};
+    m_renderer = new VulkanRenderer{&m_surface, m_renderSettings};
+    return m_renderer;
+}
+
+void MainWindow::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key::Key_Space && !event->isAutoRepeat()) {
+        m_frameScheduler.setAnimationPaused(!m_frameScheduler.isAnimationPaused());
+        return;
+    }
+    if (event->key() == Qt::Key::Key_P && !event->isAutoRepeat() && m_renderer != nullptr) {
+        auto depthPrepass = !m_renderer->renderSettings().depthPrepass;
+        qDebug() << "Depth prepass: " << depthPrepass;
+        m_renderer->setDepthPrepass(depthPrepass);
+        m_frameScheduler.invalidate();
+        return;
+    }
+    QVulkanWindow::keyPressEvent(event);
 }
@@ -1,8 +1,14 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "framescheduler.h"
+#include "settings.h"
+#include "windowsurface.h"
+
 #include <QVulkanWindow>
 
+class VulkanRenderer;
+
 class MainWindow final : public QVulkanWindow
 {
     Q_OBJECT
@@ -10,5 +16,17 @@ class MainWindow final : public QVulkanWindow
 public:
     explicit MainWindow(QWindow *parent = nullptr);
     QVulkanWindowRenderer *createRenderer() override;
+    // Takes effect with the next renderer, the calibrated level is set before the window is shown
+    void setQualityLevel(int level) { m_renderSettings.qualityLevel = level; }
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    RenderSettings m_renderSettings;
+    FrameScheduler m_frameScheduler;
+    WindowSurface m_surface;
+    // Owned by QVulkanWindow
+    VulkanRenderer *m_renderer;
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,235 @@
+#include "memorystats.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+
+namespace {
+constexpr int tickInterval = 1000;
+constexpr double budgetWarningRatio = 0.9;
+constexpr double budgetWarningResetRatio = 0.85;
+
+struct TagCounters
+{
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> allocations;
+};
+
+std::array<TagCounters, allocationTagCount> tagCounters{};
+
+volatile std::sig_atomic_t dumpRequested{};
+
+extern "C" void requestDump(int /*signal*/)
+{
+    dumpRequested = 1;
+}
+
+[[nodiscard]] QJsonObject statisticsToJson(const VmaStatistics &statistics)
+{
+    return {
+        {QStringLiteral("blockCount"), static_cast<qint64>(statistics.blockCount)},
+        {QStringLiteral("allocationCount"), static_cast<qint64>(statistics.allocationCount)},
+        {QStringLiteral("blockBytes"), static_cast<qint64>(statistics.blockBytes)},
+        {QStringLiteral("allocationBytes"), static_cast<qint64>(statistics.allocationBytes)}
+    };
+}
+}
+
+const char *allocationTagName(AllocationTag tag)
+{
+    switch (tag) {
+    case AllocationTag::VERTEX:
+        return "vertex";
+    case AllocationTag::INDEX:
+        return "index";
+    case AllocationTag::UNIFORM:
+        return "uniform";
+    case AllocationTag::TEXTURE:
+        return "texture";
+    case AllocationTag::STAGING:
+        return "staging";
+    case AllocationTag::INSTANCE:
+        return "instance";
+    case AllocationTag::RENDER_TARGET:
+        return "render target";
+    }
+    return "unknown";
+}
+
+MemoryStats::MemoryStats()
+    : m_allocator{}
+    , m_budgetSupported{}
+    , m_dumpInterval{}
+    , m_ticksUntilDump{}
+    , m_overBudgetReported{}
+{
+    QObject::connect(&m_timer, &QTimer::timeout, &m_timer, [this]{ tick(); });
+}
+
+MemoryStats::~MemoryStats()
+{
+    destroy();
+}
+
+void MemoryStats::create(VmaAllocator allocator, bool budgetSupported, int dumpInterval, const QString &dumpFileName)
+{
+    qDebug() << "Create memory stats, budget supported: " << budgetSupported << ", dump interval: " << dumpInterval << " s";
+    m_allocator = allocator;
+    m_budgetSupported = budgetSupported;
+    m_dumpInterval = dumpInterval;
+    m_ticksUntilDump = dumpInterval;
+    m_dumpFileName = dumpFileName;
+    m_overBudgetReported = {};
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, requestDump);
+#endif
+    m_timer.start(tickInterval);
+}
+
+void MemoryStats::destroy()
+{
+    if (m_allocator == VK_NULL_HANDLE) {
+        return;
+    }
+    qDebug() << "Destroy memory stats";
+    m_timer.stop();
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, SIG_DFL);
+#endif
+    m_allocator = {};
+}
+
+void MemoryStats::registerAllocation(VmaAllocator allocator, VmaAllocation allocation, AllocationTag tag)
+{
+    vmaSetAllocationUserData(allocator, allocation, reinterpret_cast<void *>(static_cast<std::uintptr_t>(tag)));
+    vmaSetAllocationName(allocator, allocation, allocationTagName(tag));
+    VmaAllocationInfo allocationInfo{};
+    vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+    auto &counters = tagCounters.at(static_cast<std::size_t>(tag));
+    counters.bytes += allocationInfo.size;
+    ++counters.allocations;
+}
+
+void MemoryStats::unregisterAllocation(VmaAllocator allocator, VmaAllocation allocation)
+{
+    VmaAllocationInfo allocationInfo{};
+    vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+    auto tag = static_cast<std::size_t>(reinterpret_cast<std::uintptr_t>(allocationInfo.pUserData));
+    if (tag >= tagCounters.size()) {
+        return;
+    }
+    auto &counters = tagCounters.at(tag);
+    counters.bytes -= allocationInfo.size;
+    --counters.allocations;
+}
+
+QJsonObject MemoryStats::toJson() const
+{
+    const VkPhysicalDeviceMemoryProperties *memoryProperties{};
+    vmaGetMemoryProperties(m_allocator, &memoryProperties);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+    vmaGetHeapBudgets(m_allocator, budgets.data());
+
+    QJsonArray heaps{};
+    for (uint32_t heapIndex = 0; heapIndex < memoryProperties->memoryHeapCount; ++heapIndex) {
+        const auto &heap = memoryProperties->memoryHeaps[heapIndex];
+        const auto &budget = budgets.at(heapIndex);
+        heaps.append(QJsonObject{
+            {QStringLiteral("index"), static_cast<int>(heapIndex)},
+            {QStringLiteral("deviceLocal"), (heap.flags & VkMemoryHeapFlagBits::VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0},
+            {QStringLiteral("size"), static_cast<qint64>(heap.size)},
+            {QStringLiteral("budget"), static_cast<qint64>(budget.budget)},
+            {QStringLiteral("usage"), static_cast<qint64>(budget.usage)},
+            {QStringLiteral("statistics"), statisticsToJson(budget.statistics)}
+        });
+    }
+
+    QJsonObject tags{};
+    for (int tag = 0; tag < allocationTagCount; ++tag) {
+        const auto &counters = tagCounters.at(tag);
+        tags.insert(QString::fromLatin1(allocationTagName(static_cast<AllocationTag>(tag))), QJsonObject{
+            {QStringLiteral("bytes"), static_cast<qint64>(counters.bytes.load())},
+            {QStringLiteral("allocations"), static_cast<qint64>(counters.allocations.load())}
+        });
+    }
+
+    VmaTotalStatistics totalStatistics{};
+    vmaCalculateStatistics(m_allocator, &totalStatistics);
+
+    char *statsString{};
+    vmaBuildStatsString(m_allocator, &statsString, VK_TRUE);
+    auto detailed = QJsonDocument::fromJson(QByteArray{statsString}).object();
+    vmaFreeStatsString(m_allocator, statsString);
+
+    return {
+        {QStringLiteral("budgetSupported"), m_budgetSupported},
+        {QStringLiteral("heaps"), heaps},
+        {QStringLiteral("tags"), tags},
+        {QStringLiteral("total"), statisticsToJson(totalStatistics.total.statistics)},
+        {QStringLiteral("vma"), detailed}
+    };
+}
+
+VkDeviceSize MemoryStats::allocatedBytes() const
+{
+    VmaTotalStatistics totalStatistics{};
+    vmaCalculateStatistics(m_allocator, &totalStatistics);
+    return totalStatistics.total.statistics.allocationBytes;
+}
+
+void MemoryStats::dump() const
+{
+    auto json = QJsonDocument{toJson()}.toJson(QJsonDocument::JsonFormat::Indented);
+    if (m_dumpFileName.isEmpty()) {
+        qDebug().noquote() << "Memory stats: " << QString::fromUtf8(json);
+        return;
+    }
+    qDebug() << "Dump memory stats to: " << m_dumpFileName;
+    QFile file{m_dumpFileName};
+    if (!file.open(QIODevice::OpenModeFlag::WriteOnly | QIODevice::OpenModeFlag::Truncate)) {
+        qDebug() << "Can not open memory stats file: " << m_dumpFileName;
+        return;
+    }
+    file.write(json);
+}
+
+void MemoryStats::tick()
+{
+    checkBudgets();
+    bool dumpDue = dumpRequested != 0;
+    dumpRequested = 0;
+    if (m_dumpInterval > 0 && --m_ticksUntilDump <= 0) {
+        m_ticksUntilDump = m_dumpInterval;
+        dumpDue = true;
+    }
+    if (dumpDue) {
+        dump();
+    }
+}
+
+void MemoryStats::checkBudgets()
+{
+    const VkPhysicalDeviceMemoryProperties *memoryProperties{};
+    vmaGetMemoryProperties(m_allocator, &memoryProperties);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+    vmaGetHeapBudgets(m_allocator, budgets.data());
+    for (uint32_t heapIndex = 0; heapIndex < memoryProperties->memoryHeapCount; ++heapIndex) {
+        const auto &budget = budgets.at(heapIndex);
+        if (budget.budget == 0) {
+            continue;
+        }
+        auto ratio = static_cast<double>(budget.usage) / static_cast<double>(budget.budget);
+        auto &reported = m_overBudgetReported.at(heapIndex);
+        if (!reported && ratio >= budgetWarningRatio) {
+            qWarning() << "Memory heap " << heapIndex << " is close to its budget, usage: " << budget.usage << ", budget: " << budget.budget;
+            reported = true;
+        } else if (reported && ratio < budgetWarningResetRatio) {
+            reported = false;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#include "vkmemalloc.h"
+
+#include <QJsonObject>
+#include <QString>
+#include <QTimer>
+
+#include <array>
+
+enum class AllocationTag : int
+{
+    VERTEX = 0,
+    INDEX = 1,
+    UNIFORM = 2,
+    TEXTURE = 3,
+    STAGING = 4,
+    INSTANCE = 5,
+    RENDER_TARGET = 6
+};
+
+constexpr int allocationTagCount = 7;
+
+[[nodiscard]] const char *allocationTagName(AllocationTag tag);
+
+// Accounts device memory per allocation tag and per heap, warns when a heap gets close to its budget
+// and dumps everything as JSON periodically or on SIGUSR1
+class MemoryStats
+{
+public:
+    MemoryStats();
+
+    MemoryStats(const MemoryStats &) = delete;
+    MemoryStats(MemoryStats &&) = delete;
+    MemoryStats &operator=(const MemoryStats &) = delete;
+    MemoryStats &operator=(MemoryStats &&) = delete;
+
+    ~MemoryStats();
+
+    void create(VmaAllocator allocator, bool budgetSupported, int dumpInterval, const QString &dumpFileName);
+    void destroy();
+
+    // Tags the allocation through its VMA user data and name
+    static void registerAllocation(VmaAllocator allocator, VmaAllocation allocation, AllocationTag tag);
+    static void unregisterAllocation(VmaAllocator allocator, VmaAllocation allocation);
+
+    [[nodiscard]] QJsonObject toJson() const;
+    // Bytes of all live allocations
+    [[nodiscard]] VkDeviceSize allocatedBytes() const;
+    void dump() const;
+
+private:
+    VmaAllocator m_allocator;
+    bool m_budgetSupported;
+    QString m_dumpFileName;
+    QTimer m_timer;
+    int m_dumpInterval;
+    int m_ticksUntilDump;
+    std::array<bool, VK_MAX_MEMORY_HEAPS> m_overBudgetReported;
+
+    void tick();
+    void checkBudgets();
+};
+
+#endif // MEMORYSTATS_H
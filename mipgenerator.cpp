@@ -0,0 +1,275 @@
+#include "mipgenerator.h"
+
+#include "cpuprofiler.h"
+#include "shaderregistry.h"
+#include "vulkanrenderer.h"
+
+#include <QDebug>
+#include <QVulkanDeviceFunctions>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace {
+const QString shaderName = QStringLiteral("downsample.comp");
+
+// Side of the source tile one workgroup reduces to a texel of level 6, the last workgroup reduces a tile of level 6
+constexpr int32_t groupTile = 64;
+constexpr uint32_t groupInvocations = 16 * 16;
+// Slots of the workgroup counters, dispatches recorded into one command buffer take consecutive ones
+constexpr int counterSlots = 64;
+// Sets of the uploads waiting for their submission
+constexpr uint32_t maxSets = 16;
+
+constexpr uint32_t sourceBinding = 0;
+constexpr uint32_t levelsBinding = 1;
+constexpr uint32_t countersBinding = 2;
+
+struct DownsamplePushConstants
+{
+    int32_t levelCount;
+    int32_t srgb;
+    int32_t counterSlot;
+};
+
+[[nodiscard]] bool isSrgb(VkFormat format)
+{
+    return format == VkFormat::VK_FORMAT_R8G8B8A8_SRGB;
+}
+}
+
+MipGenerator::MipGenerator(VulkanRenderer *vulkanRenderer)
+    : m_vulkanRenderer{vulkanRenderer}
+    , m_shaderModule{}
+    , m_descriptorSetLayout{}
+    , m_pipelineLayout{}
+    , m_pipeline{}
+    , m_descriptorPool{}
+    , m_counters{}
+    , m_nextCounterSlot{}
+    , m_countersCleared{}
+{
+}
+
+void MipGenerator::initResources()
+{
+    if (!m_vulkanRenderer->renderSettings().computeMipmaps) {
+        qDebug() << "Compute mipmaps disabled";
+        return;
+    }
+    auto *surface = m_vulkanRenderer->surface();
+    // The tile of a workgroup needs more invocations than the guaranteed minimum
+    if (surface->physicalDeviceProperties()->limits.maxComputeWorkGroupInvocations < groupInvocations) {
+        qDebug() << "Compute mipmaps not supported, max workgroup invocations: " << surface->physicalDeviceProperties()->limits.maxComputeWorkGroupInvocations;
+        return;
+    }
+    qDebug() << "Create mip generator";
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+
+    m_shaderModule = m_vulkanRenderer->createShaderModule(ShaderRegistry::shader(shaderName));
+    m_descriptorSetLayout = createDescriptorSetLayout();
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DownsamplePushConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VulkanRenderer::checkVkResult(devFuncs->vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout),
+                                  "failed to create downsample pipeline layout");
+    m_pipeline = m_vulkanRenderer->createComputePipeline(m_shaderModule, m_pipelineLayout);
+    m_descriptorPool = createDescriptorPool();
+
+    m_counters = m_vulkanRenderer->createBuffer(sizeof(uint32_t) * counterSlots,
+                                                static_cast<VkBufferUsageFlags>(VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+                                                | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY, AllocationTag::TEXTURE);
+    m_nextCounterSlot = 0;
+    m_countersCleared = false;
+}
+
+VkDescriptorSetLayout MipGenerator::createDescriptorSetLayout() const
+{
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    bindings[sourceBinding].binding = sourceBinding;
+    bindings[sourceBinding].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[sourceBinding].descriptorCount = 1;
+    bindings[levelsBinding].binding = levelsBinding;
+    bindings[levelsBinding].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[levelsBinding].descriptorCount = maxLevels;
+    bindings[countersBinding].binding = countersBinding;
+    bindings[countersBinding].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[countersBinding].descriptorCount = 1;
+    for (auto &binding : bindings) {
+        binding.stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindings.size();
+    layoutInfo.pBindings = bindings.data();
+    VkDescriptorSetLayout descriptorSetLayout{};
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateDescriptorSetLayout(m_vulkanRenderer->device(), &layoutInfo, nullptr, &descriptorSetLayout),
+                                  "failed to create downsample descriptor set layout");
+    return descriptorSetLayout;
+}
+
+VkDescriptorPool MipGenerator::createDescriptorPool() const
+{
+    // The sets live as long as the graph of one upload, they are freed one by one
+    std::array<VkDescriptorPoolSize, 2> poolSizes{{
+        {VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, (maxLevels + 1) * maxSets},
+        {VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxSets}
+    }};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VkDescriptorPoolCreateFlagBits::VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = maxSets;
+    VkDescriptorPool descriptorPool{};
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateDescriptorPool(m_vulkanRenderer->device(), &poolInfo, nullptr, &descriptorPool),
+                                  "failed to create downsample descriptor pool");
+    return descriptorPool;
+}
+
+bool MipGenerator::supports(VkFormat format, int32_t width, int32_t height, uint32_t mipLevels) const
+{
+    if (m_pipeline == VK_NULL_HANDLE || mipLevels < 2 || mipLevels - 1 > maxLevels) {
+        return false;
+    }
+    // The last workgroup reduces level 6 alone, it has to fit into one tile
+    if ((std::max(width, height) >> 6) > groupTile) {
+        return false;
+    }
+    return storageFormat(format) != VkFormat::VK_FORMAT_UNDEFINED;
+}
+
+VkFormat MipGenerator::storageFormat(VkFormat format)
+{
+    switch (format) {
+    case VkFormat::VK_FORMAT_R8G8B8A8_SRGB:
+    // The shader declares its images rgba8, storage views of other formats would need the without format features
+    case VkFormat::VK_FORMAT_R8G8B8A8_UNORM:
+        return VkFormat::VK_FORMAT_R8G8B8A8_UNORM;
+    default:
+        return VkFormat::VK_FORMAT_UNDEFINED;
+    }
+}
+
+void MipGenerator::addPasses(RenderGraph &graph, RenderGraph::Resource image, VkFormat format, int32_t width, int32_t height, uint32_t mipLevels)
+{
+    PROFILE_ZONE("MipGenerator::addPasses");
+    VkImage vkImage = graph.image(image);
+    if (vkImage == VK_NULL_HANDLE || !supports(format, width, height, mipLevels)) {
+        throw std::runtime_error{"unsupported image for compute mipmaps"};
+    }
+    qDebug() << "Generate mipmaps in one dispatch, levels: " << mipLevels;
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    auto linearFormat = storageFormat(format);
+
+    // Views of the levels the image does not have stay null, destroying them is a no-op
+    std::array<VkImageView, maxLevels + 1> views{};
+    auto destroyViews = [devFuncs, device](const std::array<VkImageView, maxLevels + 1> &createdViews) {
+        for (auto view : createdViews) {
+            devFuncs->vkDestroyImageView(device, view, nullptr);
+        }
+    };
+    VkDescriptorSet descriptorSet{};
+    try {
+        for (uint32_t level = 0; level < mipLevels; ++level) {
+            views[level] = m_vulkanRenderer->createImageView(vkImage, linearFormat, VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+        }
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &m_descriptorSetLayout;
+        VulkanRenderer::checkVkResult(devFuncs->vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet),
+                                      "failed to allocate downsample descriptor set");
+    } catch (...) {
+        destroyViews(views);
+        throw;
+    }
+    // The dispatch uses them until the graph is submitted, the graph releases them after that
+    graph.deferRelease([this, devFuncs, device, destroyViews, views, descriptorSet]() {
+        destroyViews(views);
+        devFuncs->vkFreeDescriptorSets(device, m_descriptorPool, 1, &descriptorSet);
+    });
+
+    VkDescriptorImageInfo sourceInfo{VK_NULL_HANDLE, views[0], VkImageLayout::VK_IMAGE_LAYOUT_GENERAL};
+    std::array<VkDescriptorImageInfo, maxLevels> levelInfos{};
+    for (uint32_t level = 0; level < maxLevels; ++level) {
+        levelInfos[level] = {VK_NULL_HANDLE, views[std::min(level + 1, mipLevels - 1)], VkImageLayout::VK_IMAGE_LAYOUT_GENERAL};
+    }
+    VkDescriptorBufferInfo countersInfo{m_counters.object, 0, VK_WHOLE_SIZE};
+    std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+    for (uint32_t i = 0; i < descriptorWrites.size(); ++i) {
+        descriptorWrites[i].sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = descriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    }
+    descriptorWrites[sourceBinding].pImageInfo = &sourceInfo;
+    descriptorWrites[levelsBinding].descriptorCount = maxLevels;
+    descriptorWrites[levelsBinding].pImageInfo = levelInfos.data();
+    descriptorWrites[countersBinding].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrites[countersBinding].pBufferInfo = &countersInfo;
+    devFuncs->vkUpdateDescriptorSets(device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+
+    DownsamplePushConstants pushConstants{static_cast<int32_t>(mipLevels - 1), isSrgb(format) ? 1 : 0, m_nextCounterSlot};
+    m_nextCounterSlot = (m_nextCounterSlot + 1) % counterSlots;
+    auto groupCountX = static_cast<uint32_t>((width + groupTile - 1) / groupTile);
+    auto groupCountY = static_cast<uint32_t>((height + groupTile - 1) / groupTile);
+
+    auto counters = graph.importBuffer(QStringLiteral("downsample counters"));
+    if (!m_countersCleared) {
+        graph.addPass(QStringLiteral("clear downsample counters"), [this](VkCommandBuffer commandBuffer) {
+            m_vulkanRenderer->devFuncs()->vkCmdFillBuffer(commandBuffer, m_counters.object, 0, VK_WHOLE_SIZE, 0);
+            m_countersCleared = true;
+        }).write(counters, RenderGraph::Access::TRANSFER_WRITE, true);
+    }
+
+    auto pass = graph.addPass(QStringLiteral("downsample"), [this, descriptorSet, pushConstants, groupCountX, groupCountY](VkCommandBuffer commandBuffer) {
+        auto *devFuncs = m_vulkanRenderer->devFuncs();
+        devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+        devFuncs->vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0,
+                                          1, &descriptorSet, 0, nullptr);
+        devFuncs->vkCmdPushConstants(commandBuffer, m_pipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT,
+                                     0, sizeof(pushConstants), &pushConstants);
+        devFuncs->vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+    });
+    pass.read(image, RenderGraph::Access::COMPUTE_READ, 0)
+        .read(counters, RenderGraph::Access::COMPUTE_READ)
+        .write(counters, RenderGraph::Access::COMPUTE_WRITE);
+    for (uint32_t level = 1; level < mipLevels; ++level) {
+        pass.write(image, RenderGraph::Access::COMPUTE_WRITE, level, true);
+    }
+}
+
+void MipGenerator::releaseResources()
+{
+    if (m_pipeline == VK_NULL_HANDLE) {
+        return;
+    }
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    m_counters.destroy(m_vulkanRenderer->allocator());
+    devFuncs->vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    m_descriptorPool = {};
+    devFuncs->vkDestroyPipeline(device, m_pipeline, nullptr);
+    m_pipeline = {};
+    devFuncs->vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+    m_pipelineLayout = {};
+    devFuncs->vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+    m_descriptorSetLayout = {};
+    devFuncs->vkDestroyShaderModule(device, m_shaderModule, nullptr);
+    m_shaderModule = {};
+}
@@ -0,0 +1,54 @@
+#ifndef MIPGENERATOR_H
+#define MIPGENERATOR_H
+
+#include "objectwithallocation.h"
+#include "rendergraph.h"
+
+#include <QVulkanInstance>
+
+class VulkanRenderer;
+
+// Builds the mip chain of an image in one compute dispatch instead of a blit and a barrier per level. sRGB images
+// are created with a linear format for the storage views and averaged in linear space, the sampled views keep the
+// sRGB format. Only RGBA8 images are handled, others and the ones with more than 12 levels below the source take the
+// blit chain.
+class MipGenerator
+{
+public:
+    static constexpr uint32_t maxLevels = 12;
+
+    explicit MipGenerator(VulkanRenderer *vulkanRenderer);
+
+    MipGenerator(const MipGenerator &) = delete;
+    MipGenerator(MipGenerator &&) = delete;
+    MipGenerator &operator=(const MipGenerator &) = delete;
+    MipGenerator &operator=(MipGenerator &&) = delete;
+
+    ~MipGenerator() = default;
+
+    void initResources();
+    void releaseResources();
+
+    [[nodiscard]] bool supports(VkFormat format, int32_t width, int32_t height, uint32_t mipLevels) const;
+    // Format the image has to be created with, together with the mutable format flag and storage usage
+    [[nodiscard]] static VkFormat storageFormat(VkFormat format);
+    // Level 0 has to be written by an earlier pass of the graph, the image must be imported
+    void addPasses(RenderGraph &graph, RenderGraph::Resource image, VkFormat format, int32_t width, int32_t height, uint32_t mipLevels);
+
+private:
+    VulkanRenderer *const m_vulkanRenderer;
+    VkShaderModule m_shaderModule;
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_pipeline;
+    VkDescriptorPool m_descriptorPool;
+    BufferWithAllocation m_counters;
+    int m_nextCounterSlot;
+    // Every dispatch leaves its slot at zero again, so only the first graph clears them
+    bool m_countersCleared;
+
+    [[nodiscard]] VkDescriptorSetLayout createDescriptorSetLayout() const;
+    [[nodiscard]] VkDescriptorPool createDescriptorPool() const;
+};
+
+#endif // MIPGENERATOR_H
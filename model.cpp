@@ -1,6 +1,7 @@
 #include "model.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
+#include "cpuprofiler.h"
 #include "externals/tinyobjloader/tiny_obj_loader.h"
 
 #include <QDataStream>
@@ -10,6 +11,10 @@
 #include <QHash>
 #include <QVector>
 
+#include <algorithm>
+#include <array>
+#include <limits>
+
 namespace {
 class DataStreamBuf final
         : public std::streambuf
@@ -42,6 +47,88 @@ DataStreamBuf::int_type DataStreamBuf::underflow()
     return std::char_traits<char>::to_int_type(*gptr());
 }
 
+// Cells per axis of the bounding box when the occluder is clustered from the mesh
+constexpr int occluderGridSize = 12;
+// Cells whose normals average to less than this length hold opposite faces of a part thinner than a cell
+constexpr float minOccluderNormalAgreement = 0.7F;
+const std::string occluderShapePrefix{"occluder"};
+
+// Collapses the vertices of every cell to their average and drops the triangles which degenerate. An occluder sticking
+// out of the mesh would hide visible objects, so every representative is pushed inwards along the average normal of its
+// cell by the cell diagonal, the farthest the average can be from any of the vertices. Cells of parts too thin to
+// survive that are left out together with their triangles, as are triangles turned inside out by the push.
+void clusterOccluder(Model &model)
+{
+    if (model.vertices.isEmpty()) {
+        return;
+    }
+    glm::vec3 boundsMin{model.vertices.constFirst().pos};
+    glm::vec3 boundsMax{boundsMin};
+    for (const auto &vertex : qAsConst(model.vertices)) {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    auto cellScale = static_cast<float>(occluderGridSize) / glm::max(boundsMax - boundsMin, glm::vec3{1e-6F});
+    auto inset = glm::length((boundsMax - boundsMin) / static_cast<float>(occluderGridSize));
+
+    QHash<int, uint32_t> cells{};
+    QVector<glm::vec3> sums{};
+    QVector<glm::vec3> normalSums{};
+    QVector<int> counts{};
+    QVector<uint32_t> vertexCells{};
+    vertexCells.reserve(model.vertices.size());
+    for (const auto &vertex : qAsConst(model.vertices)) {
+        auto cell = glm::min(glm::ivec3{(vertex.pos - boundsMin) * cellScale}, glm::ivec3{occluderGridSize - 1});
+        auto key = (cell.z * occluderGridSize + cell.y) * occluderGridSize + cell.x;
+        auto iCell = cells.constFind(key);
+        if (iCell == cells.cend()) {
+            iCell = cells.insert(key, static_cast<uint32_t>(sums.size()));
+            sums << glm::vec3{0.0F};
+            normalSums << glm::vec3{0.0F};
+            counts << 0;
+        }
+        sums[static_cast<int>(iCell.value())] += vertex.pos;
+        normalSums[static_cast<int>(iCell.value())] += vertex.normal;
+        ++counts[static_cast<int>(iCell.value())];
+        vertexCells << iCell.value();
+    }
+
+    // Cells left out keep no vertex, their triangles are dropped below
+    constexpr uint32_t droppedCell = std::numeric_limits<uint32_t>::max();
+    QVector<uint32_t> cellVertices(sums.size(), droppedCell);
+    QVector<glm::vec3> cellNormals(sums.size());
+    for (int i = 0; i < sums.size(); ++i) {
+        auto count = static_cast<float>(counts.at(i));
+        auto normal = normalSums.at(i) / count;
+        if (glm::length(normal) < minOccluderNormalAgreement) {
+            continue;
+        }
+        cellNormals[i] = glm::normalize(normal);
+        cellVertices[i] = static_cast<uint32_t>(model.occluderVertices.size());
+        model.occluderVertices << sums.at(i) / count - cellNormals.at(i) * inset;
+    }
+    for (int i = 0; i + 2 < model.indices.size(); i += 3) {
+        auto a = vertexCells.at(static_cast<int>(model.indices.at(i)));
+        auto b = vertexCells.at(static_cast<int>(model.indices.at(i + 1)));
+        auto c = vertexCells.at(static_cast<int>(model.indices.at(i + 2)));
+        if (a == b || b == c || a == c) {
+            continue;
+        }
+        std::array triangle{cellVertices.at(static_cast<int>(a)), cellVertices.at(static_cast<int>(b)), cellVertices.at(static_cast<int>(c))};
+        if (std::find(triangle.cbegin(), triangle.cend(), droppedCell) != triangle.cend()) {
+            continue;
+        }
+        const auto &p0 = model.occluderVertices.at(static_cast<int>(triangle[0]));
+        auto faceNormal = glm::cross(model.occluderVertices.at(static_cast<int>(triangle[1])) - p0,
+                                     model.occluderVertices.at(static_cast<int>(triangle[2])) - p0);
+        auto cellNormal = cellNormals.at(static_cast<int>(a)) + cellNormals.at(static_cast<int>(b)) + cellNormals.at(static_cast<int>(c));
+        if (glm::dot(faceNormal, cellNormal) <= 0.0F) {
+            continue;
+        }
+        model.occluderIndices << triangle[0] << triangle[1] << triangle[2];
+    }
+}
+
 class MaterialDirReader final
         : public tinyobj::MaterialReader
 {
@@ -83,6 +170,7 @@ bool MaterialDirReader::operator()(const std::string &matId,
 
 Model Model::loadModel(const QString &baseDirName, const QString &fileName)
 {
+    PROFILE_ZONE("Model::loadModel");
     tinyobj::attrib_t attrib{};
     std::vector<tinyobj::shape_t> shapes{};
 
@@ -124,6 +212,15 @@ Model Model::loadModel(const QString &baseDirName, const QString &fileName)
     qDebug() << "Shapes: " << shapes.size();
     for (const auto &shape : shapes) {
         auto meshSize = static_cast<int>(shape.mesh.indices.size());
+        if (shape.name.compare(0, occluderShapePrefix.size(), occluderShapePrefix) == 0) {
+            qDebug() << "Occluder indices: " << meshSize;
+            for (const auto &index : shape.mesh.indices) {
+                auto vi = 3 * index.vertex_index;
+                result.occluderIndices << static_cast<uint32_t>(result.occluderVertices.size());
+                result.occluderVertices << glm::vec3{attrib.vertices[vi + 0], attrib.vertices[vi + 1], attrib.vertices[vi + 2]};
+            }
+            continue;
+        }
         qDebug() << "Mesh indices: " << meshSize;
         result.indices.reserve(result.indices.size() + meshSize);
         result.vertices.reserve(result.vertices.size() + meshSize);
@@ -159,9 +256,30 @@ Model Model::loadModel(const QString &baseDirName, const QString &fileName)
         }
     }
     result.vertices.squeeze();
+    if (result.occluderIndices.isEmpty()) {
+        clusterOccluder(result);
+    }
+    result.computeBounds();
 
     qDebug() << "Vertices: " << result.vertices.size() << " (" << result.vertices.size() * sizeof(decltype(result.vertices)::value_type) << " bytes )";
     qDebug() << "Indices: " << result.indices.size() << " (" << result.indices.size() * sizeof(decltype(result.indices)::value_type) << " bytes )";
+    qDebug() << "Occluder triangles: " << result.occluderIndices.size() / 3;
 
     return result;
 }
+
+void Model::computeBounds()
+{
+    boundsMin = glm::vec3{std::numeric_limits<float>::max()};
+    boundsMax = glm::vec3{std::numeric_limits<float>::lowest()};
+    for (const auto &vertex : qAsConst(vertices)) {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    glm::vec3 center{0.5F * (boundsMin + boundsMax)};
+    float radius{};
+    for (const auto &vertex : qAsConst(vertices)) {
+        radius = std::max(radius, glm::distance(center, vertex.pos));
+    }
+    boundingSphere = {center, radius};
+}
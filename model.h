@@ -8,8 +8,18 @@ struct Model
 {
     QVector<TexVertex> vertices;
     QVector<uint32_t> indices;
+    // Low poly stand-in for CPU occlusion culling: the shapes named "occluder*" when the file has them,
+    // they are not drawn, a vertex clustered copy of the mesh shrunk to stay inside of it otherwise
+    QVector<glm::vec3> occluderVertices;
+    QVector<uint32_t> occluderIndices;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    // xyz - center, w - radius
+    glm::vec4 boundingSphere;
 
     [[nodiscard]] static Model loadModel(const QString &baseDirName, const QString &fileName);
+    // Sets the bounds from the vertices
+    void computeBounds();
 };
 
 
@@ -1,8 +1,13 @@
 #include "objectwithallocation.h"
 
+#include "memorystats.h"
+
 template<>
 void ObjectWithAllocation<VkBuffer>::destroy(VmaAllocator allocator)
 {
+    if (allocation != VK_NULL_HANDLE) {
+        MemoryStats::unregisterAllocation(allocator, allocation);
+    }
     vmaDestroyBuffer(allocator, object, allocation);
     *this = {};
 }
@@ -10,6 +15,9 @@ void ObjectWithAllocation<VkBuffer>::destroy(VmaAllocator allocator)
 template<>
 void ObjectWithAllocation<VkImage>::destroy(VmaAllocator allocator)
 {
+    if (allocation != VK_NULL_HANDLE) {
+        MemoryStats::unregisterAllocation(allocator, allocation);
+    }
     vmaDestroyImage(allocator, object, allocation);
     *this = {};
 }
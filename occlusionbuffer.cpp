@@ -0,0 +1,228 @@
+#include "occlusionbuffer.h"
+
+#include "cpuprofiler.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OCCLUSIONBUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Vertices nearer than this clip space w are not rasterized
+constexpr float minW = 1e-4F;
+// Triangles with less area in square pixels cover no pixel center worth the setup
+constexpr float minArea = 1e-4F;
+static_assert(OcclusionBuffer::width % 4 == 0, "rows are rasterized four pixels at a time");
+
+struct Edge
+{
+    float a;
+    float b;
+    float c;
+
+    [[nodiscard]] float at(float x, float y) const { return a * x + b * y + c; }
+};
+
+// Positive on the inner side of a counter clockwise edge
+[[nodiscard]] Edge edge(const glm::vec4 &from, const glm::vec4 &to)
+{
+    auto a = from.y - to.y;
+    auto b = to.x - from.x;
+    return {a, b, -(a * from.x + b * from.y)};
+}
+
+void rasterizeTriangle(float *depth, glm::vec4 v0, glm::vec4 v1, glm::vec4 v2, int rowBegin, int rowEnd)
+{
+    auto area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (std::abs(area) < minArea) {
+        return;
+    }
+    // Occluders are drawn from both sides, so only the winding is fixed up
+    if (area < 0.0F) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+    auto xBegin = std::max(0, static_cast<int>(std::floor(std::min({v0.x, v1.x, v2.x}))));
+    auto xEnd = std::min(OcclusionBuffer::width, static_cast<int>(std::ceil(std::max({v0.x, v1.x, v2.x}))));
+    auto yBegin = std::max(rowBegin, static_cast<int>(std::floor(std::min({v0.y, v1.y, v2.y}))));
+    auto yEnd = std::min(rowEnd, static_cast<int>(std::ceil(std::max({v0.y, v1.y, v2.y}))));
+    if (xBegin >= xEnd || yBegin >= yEnd) {
+        return;
+    }
+
+    // Edge i is opposite of vertex i, so edge / area is the barycentric weight of the vertex
+    auto e0 = edge(v1, v2);
+    auto e1 = edge(v2, v0);
+    auto e2 = edge(v0, v1);
+    Edge z{(e0.a * v0.z + e1.a * v1.z + e2.a * v2.z) / area,
+           (e0.b * v0.z + e1.b * v1.z + e2.b * v2.z) / area,
+           (e0.c * v0.z + e1.c * v1.z + e2.c * v2.z) / area};
+
+    xBegin &= ~3;
+    for (int y = yBegin; y < yEnd; ++y) {
+        auto *row = depth + static_cast<ptrdiff_t>(y) * OcclusionBuffer::width;
+        auto py = static_cast<float>(y) + 0.5F;
+        auto px = static_cast<float>(xBegin) + 0.5F;
+#ifdef OCCLUSIONBUFFER_SSE2
+        const __m128 lane = _mm_setr_ps(0.0F, 1.0F, 2.0F, 3.0F);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 w0 = _mm_add_ps(_mm_set1_ps(e0.at(px, py)), _mm_mul_ps(lane, _mm_set1_ps(e0.a)));
+        __m128 w1 = _mm_add_ps(_mm_set1_ps(e1.at(px, py)), _mm_mul_ps(lane, _mm_set1_ps(e1.a)));
+        __m128 w2 = _mm_add_ps(_mm_set1_ps(e2.at(px, py)), _mm_mul_ps(lane, _mm_set1_ps(e2.a)));
+        __m128 pixelDepth = _mm_add_ps(_mm_set1_ps(z.at(px, py)), _mm_mul_ps(lane, _mm_set1_ps(z.a)));
+        const __m128 w0Step = _mm_set1_ps(4.0F * e0.a);
+        const __m128 w1Step = _mm_set1_ps(4.0F * e1.a);
+        const __m128 w2Step = _mm_set1_ps(4.0F * e2.a);
+        const __m128 depthStep = _mm_set1_ps(4.0F * z.a);
+        for (int x = xBegin; x < xEnd; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+            if (_mm_movemask_ps(inside) != 0) {
+                __m128 stored = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(stored, pixelDepth);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+            }
+            w0 = _mm_add_ps(w0, w0Step);
+            w1 = _mm_add_ps(w1, w1Step);
+            w2 = _mm_add_ps(w2, w2Step);
+            pixelDepth = _mm_add_ps(pixelDepth, depthStep);
+        }
+#else
+        for (int x = xBegin; x < xEnd; ++x, px += 1.0F) {
+            if (e0.at(px, py) >= 0.0F && e1.at(px, py) >= 0.0F && e2.at(px, py) >= 0.0F) {
+                row[x] = std::min(row[x], z.at(px, py));
+            }
+        }
+#endif
+    }
+}
+
+void updateTiles(const float *depth, float *tileDepth, int tileColumns, int tileRowBegin, int tileRowEnd)
+{
+    for (int tileRow = tileRowBegin; tileRow < tileRowEnd; ++tileRow) {
+        for (int tileColumn = 0; tileColumn < tileColumns; ++tileColumn) {
+            float farthest = 0.0F;
+            for (int y = tileRow * OcclusionBuffer::tileSize; y < (tileRow + 1) * OcclusionBuffer::tileSize; ++y) {
+                const auto *row = depth + static_cast<ptrdiff_t>(y) * OcclusionBuffer::width + tileColumn * OcclusionBuffer::tileSize;
+                farthest = std::max(farthest, *std::max_element(row, row + OcclusionBuffer::tileSize));
+            }
+            tileDepth[tileRow * tileColumns + tileColumn] = farthest;
+        }
+    }
+}
+}
+
+OcclusionBuffer::OcclusionBuffer()
+    : m_projView{1.0F}
+    , m_height{}
+    , m_tileColumns{width / tileSize}
+    , m_tileRows{}
+    , m_triangleCount{}
+{
+}
+
+void OcclusionBuffer::begin(const glm::mat4 &projView, float aspectRatio)
+{
+    m_projView = projView;
+    auto tileRows = static_cast<int>(std::lround(static_cast<float>(width) / std::max(aspectRatio, 1e-3F) / tileSize));
+    m_tileRows = std::clamp(tileRows, 1, 4 * m_tileColumns);
+    m_height = m_tileRows * tileSize;
+    m_depth.fill(1.0F, width * m_height);
+    m_tileDepth.fill(1.0F, m_tileColumns * m_tileRows);
+    m_triangleCount = 0;
+}
+
+void OcclusionBuffer::renderOccluders(const QVector<glm::vec3> &vertices, const QVector<uint32_t> &indices, const QVector<glm::mat4> &transforms)
+{
+    PROFILE_ZONE("OcclusionBuffer::renderOccluders");
+    auto vertexCount = static_cast<int>(vertices.size());
+    auto transformCount = static_cast<int>(transforms.size());
+    m_screenVertices.resize(vertexCount * transformCount);
+    auto *screenVertices = m_screenVertices.data();
+    auto halfWidth = 0.5F * static_cast<float>(width);
+    auto halfHeight = 0.5F * static_cast<float>(m_height);
+    parallelFor(transformCount, idealWorkerCount(transformCount), [&, this](int, int transformIndex) {
+        auto matrix = m_projView * transforms.at(transformIndex);
+        auto *screenVertex = screenVertices + static_cast<ptrdiff_t>(transformIndex) * vertexCount;
+        for (const auto &vertex : vertices) {
+            auto clip = matrix * glm::vec4{vertex, 1.0F};
+            if (clip.w < minW || clip.z < 0.0F) {
+                *screenVertex++ = glm::vec4{0.0F};
+                continue;
+            }
+            auto invW = 1.0F / clip.w;
+            *screenVertex++ = glm::vec4{(clip.x * invW + 1.0F) * halfWidth, (clip.y * invW + 1.0F) * halfHeight, clip.z * invW, 1.0F};
+        }
+    });
+
+    auto *depth = m_depth.data();
+    auto *tileDepth = m_tileDepth.data();
+    auto bandCount = idealWorkerCount(m_tileRows);
+    parallelFor(bandCount, bandCount, [&, this](int, int band) {
+        auto tileRowBegin = band * m_tileRows / bandCount;
+        auto tileRowEnd = (band + 1) * m_tileRows / bandCount;
+        for (int transformIndex = 0; transformIndex < transformCount; ++transformIndex) {
+            const auto *screenVertex = screenVertices + static_cast<ptrdiff_t>(transformIndex) * vertexCount;
+            for (int i = 0; i + 2 < indices.size(); i += 3) {
+                const auto &v0 = screenVertex[indices.at(i)];
+                const auto &v1 = screenVertex[indices.at(i + 1)];
+                const auto &v2 = screenVertex[indices.at(i + 2)];
+                if (v0.w == 0.0F || v1.w == 0.0F || v2.w == 0.0F) {
+                    continue;
+                }
+                rasterizeTriangle(depth, v0, v1, v2, tileRowBegin * tileSize, tileRowEnd * tileSize);
+            }
+        }
+        updateTiles(depth, tileDepth, m_tileColumns, tileRowBegin, tileRowEnd);
+    });
+    m_triangleCount = static_cast<int64_t>(transformCount) * (indices.size() / 3);
+}
+
+bool OcclusionBuffer::isVisible(const std::array<glm::vec3, 8> &corners) const
+{
+    auto nearest = 1.0F;
+    glm::vec2 screenMin{std::numeric_limits<float>::max()};
+    glm::vec2 screenMax{std::numeric_limits<float>::lowest()};
+    for (const auto &corner : corners) {
+        auto clip = m_projView * glm::vec4{corner, 1.0F};
+        if (clip.w < minW || clip.z < 0.0F) {
+            return true;
+        }
+        auto invW = 1.0F / clip.w;
+        glm::vec2 screen{(clip.x * invW + 1.0F) * 0.5F * static_cast<float>(width), (clip.y * invW + 1.0F) * 0.5F * static_cast<float>(m_height)};
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        nearest = std::min(nearest, clip.z * invW);
+    }
+    // Every partly covered pixel counts, the occluders only cover the pixels with their center inside
+    auto xBegin = std::clamp(static_cast<int>(std::floor(screenMin.x)), 0, width);
+    auto xEnd = std::clamp(static_cast<int>(std::ceil(screenMax.x)), 0, width);
+    auto yBegin = std::clamp(static_cast<int>(std::floor(screenMin.y)), 0, m_height);
+    auto yEnd = std::clamp(static_cast<int>(std::ceil(screenMax.y)), 0, m_height);
+    if (xBegin >= xEnd || yBegin >= yEnd) {
+        // Off screen, the frustum test decides
+        return true;
+    }
+
+    for (int tileRow = yBegin / tileSize; tileRow <= (yEnd - 1) / tileSize; ++tileRow) {
+        for (int tileColumn = xBegin / tileSize; tileColumn <= (xEnd - 1) / tileSize; ++tileColumn) {
+            if (nearest > m_tileDepth.at(tileRow * m_tileColumns + tileColumn)) {
+                continue;
+            }
+            // The tile has pixels farther than the object, only the ones under the object matter
+            for (int y = std::max(yBegin, tileRow * tileSize); y < std::min(yEnd, (tileRow + 1) * tileSize); ++y) {
+                for (int x = std::max(xBegin, tileColumn * tileSize); x < std::min(xEnd, (tileColumn + 1) * tileSize); ++x) {
+                    if (nearest <= m_depth.at(y * width + x)) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
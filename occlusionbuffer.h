@@ -0,0 +1,46 @@
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+
+#include "glm.h"
+
+#include <QVector>
+
+#include <array>
+#include <cstdint>
+
+// Coarse depth buffer for conservative occlusion tests on the CPU. Occluders are rasterized four pixels at a time
+// with SSE on worker threads, every worker owns a band of tile rows. Each tile keeps the farthest depth of its
+// pixels, so most tests are decided per tile and only the tiles an object is partly in front of are read per pixel.
+class OcclusionBuffer
+{
+public:
+    static constexpr int width = 256;
+    static constexpr int tileSize = 8;
+
+    OcclusionBuffer();
+
+    // Clears the buffer, the height follows the aspect ratio of the target
+    void begin(const glm::mat4 &projView, float aspectRatio);
+    // Rasterizes the occluder once per transform, transforms map its vertices to world space.
+    // Triangles crossing the near plane are skipped, which only loses occlusion.
+    void renderOccluders(const QVector<glm::vec3> &vertices, const QVector<uint32_t> &indices, const QVector<glm::mat4> &transforms);
+    // World space corners of a box around the object
+    [[nodiscard]] bool isVisible(const std::array<glm::vec3, 8> &corners) const;
+
+    [[nodiscard]] int height() const { return m_height; }
+    // Occluder triangles rasterized by the last renderOccluders
+    [[nodiscard]] int64_t triangleCount() const { return m_triangleCount; }
+
+private:
+    glm::mat4 m_projView;
+    int m_height;
+    int m_tileColumns;
+    int m_tileRows;
+    int64_t m_triangleCount;
+    // Window space x, y in pixels, z - depth 0..1, w - 0 when the vertex is too near to rasterize
+    QVector<glm::vec4> m_screenVertices;
+    QVector<float> m_depth;
+    QVector<float> m_tileDepth;
+};
+
+#endif // OCCLUSIONBUFFER_H
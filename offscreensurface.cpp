@@ -0,0 +1,558 @@
+#include "offscreensurface.h"
+
+#include "vulkanrenderer.h"
+
+#include "externals/scope_guard/scope_guard.hpp"
+
+#include <QDebug>
+#include <QVulkanDeviceFunctions>
+#include <QVulkanFunctions>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr std::array<VkFormat, 3> depthStencilFormats{
+    VkFormat::VK_FORMAT_D24_UNORM_S8_UINT,
+    VkFormat::VK_FORMAT_D32_SFLOAT_S8_UINT,
+    VkFormat::VK_FORMAT_D16_UNORM_S8_UINT
+};
+constexpr std::array<VkSampleCountFlagBits, 7> sampleCounts{
+    VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT,
+    VkSampleCountFlagBits::VK_SAMPLE_COUNT_2_BIT,
+    VkSampleCountFlagBits::VK_SAMPLE_COUNT_4_BIT,
+    VkSampleCountFlagBits::VK_SAMPLE_COUNT_8_BIT,
+    VkSampleCountFlagBits::VK_SAMPLE_COUNT_16_BIT,
+    VkSampleCountFlagBits::VK_SAMPLE_COUNT_32_BIT,
+    VkSampleCountFlagBits::VK_SAMPLE_COUNT_64_BIT
+};
+
+[[nodiscard]] bool hasStencil(VkFormat format)
+{
+    return format == VkFormat::VK_FORMAT_D24_UNORM_S8_UINT || format == VkFormat::VK_FORMAT_D32_SFLOAT_S8_UINT
+            || format == VkFormat::VK_FORMAT_D16_UNORM_S8_UINT;
+}
+}
+
+OffscreenSurface::OffscreenSurface(QVulkanInstance *vulkanInstance, const QSize &size, int maxSampleCount, float timeStep)
+    : m_vulkanInstance{vulkanInstance}
+    , m_size{size}
+    , m_maxSampleCount{maxSampleCount}
+    , m_timeStep{timeStep}
+    , m_physicalDevice{}
+    , m_physicalDeviceProperties{}
+    , m_sampleCount{VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT}
+    , m_frameCount{defaultFrameCount}
+    , m_device{}
+    , m_devFuncs{}
+    , m_synchronization2Enabled{}
+    , m_graphicsQueueFamilyIndex{}
+    , m_graphicsQueue{}
+    , m_commandPool{}
+    , m_colorFormat{}
+    , m_depthStencilFormat{}
+    , m_renderPass{}
+    , m_frames{}
+    , m_images{}
+    , m_depthStencilImage{}
+    , m_msaaImage{}
+    , m_currentFrame{}
+    , m_currentImage{}
+    , m_lastImage{}
+    , m_frameNumber{}
+{
+    auto *funcs = m_vulkanInstance->functions();
+    uint32_t physicalDeviceCount{};
+    VulkanRenderer::checkVkResult(funcs->vkEnumeratePhysicalDevices(m_vulkanInstance->vkInstance(), &physicalDeviceCount, nullptr),
+                                  "failed to enumerate physical devices");
+    if (physicalDeviceCount == 0) {
+        throw std::runtime_error{"no physical device"};
+    }
+    QVector<VkPhysicalDevice> physicalDevices(static_cast<int>(physicalDeviceCount));
+    VulkanRenderer::checkVkResult(funcs->vkEnumeratePhysicalDevices(m_vulkanInstance->vkInstance(), &physicalDeviceCount, physicalDevices.data()),
+                                  "failed to enumerate physical devices");
+    m_physicalDevice = physicalDevices.constFirst();
+    funcs->vkGetPhysicalDeviceProperties(m_physicalDevice, &m_physicalDeviceProperties);
+    qDebug() << "Offscreen surface on device: " << m_physicalDeviceProperties.deviceName << ", size: " << m_size;
+}
+
+OffscreenSurface::~OffscreenSurface()
+{
+    destroy();
+}
+
+QVulkanInfoVector<QVulkanExtension> OffscreenSurface::supportedDeviceExtensions()
+{
+    auto *funcs = m_vulkanInstance->functions();
+    uint32_t extensionCount{};
+    VulkanRenderer::checkVkResult(funcs->vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr),
+                                  "failed to enumerate device extensions");
+    QVector<VkExtensionProperties> extensionProperties(static_cast<int>(extensionCount));
+    VulkanRenderer::checkVkResult(funcs->vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, extensionProperties.data()),
+                                  "failed to enumerate device extensions");
+    QVulkanInfoVector<QVulkanExtension> extensions{};
+    for (const auto &properties : extensionProperties) {
+        QVulkanExtension extension{};
+        extension.name = QByteArray{properties.extensionName};
+        extension.version = properties.specVersion;
+        extensions << extension;
+    }
+    return extensions;
+}
+
+QVector<int> OffscreenSurface::supportedSampleCounts()
+{
+    const auto &limits = m_physicalDeviceProperties.limits;
+    auto supported = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+    QVector<int> result{};
+    for (auto sampleCount : sampleCounts) {
+        if ((supported & sampleCount) != 0 && static_cast<int>(sampleCount) <= m_maxSampleCount) {
+            result << static_cast<int>(sampleCount);
+        }
+    }
+    return result;
+}
+
+void OffscreenSurface::setSampleCount(int sampleCount)
+{
+    m_sampleCount = static_cast<VkSampleCountFlagBits>(sampleCount);
+}
+
+void OffscreenSurface::create()
+{
+    createDevice();
+    m_colorFormat = chooseColorFormat();
+    m_depthStencilFormat = chooseDepthStencilFormat();
+    qDebug() << "Offscreen color format: " << m_colorFormat << ", depth format: " << m_depthStencilFormat << ", samples: " << m_sampleCount;
+    createRenderPass();
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_graphicsQueueFamilyIndex;
+    VulkanRenderer::checkVkResult(m_devFuncs->vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool),
+                                  "failed to create offscreen command pool");
+
+    m_frames.fill(Frame{}, m_frameCount);
+    for (auto &frame : m_frames) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.commandBufferCount = 1;
+        VulkanRenderer::checkVkResult(m_devFuncs->vkAllocateCommandBuffers(m_device, &allocInfo, &frame.commandBuffer),
+                                      "failed to allocate offscreen command buffer");
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VkFenceCreateFlagBits::VK_FENCE_CREATE_SIGNALED_BIT;
+        VulkanRenderer::checkVkResult(m_devFuncs->vkCreateFence(m_device, &fenceInfo, nullptr, &frame.fence),
+                                      "failed to create offscreen frame fence");
+    }
+}
+
+void OffscreenSurface::createDevice()
+{
+    auto *funcs = m_vulkanInstance->functions();
+    uint32_t queueFamilyCount{};
+    funcs->vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+    QVector<VkQueueFamilyProperties> queueFamilies(static_cast<int>(queueFamilyCount));
+    funcs->vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+    auto graphicsFamily = std::find_if(queueFamilies.cbegin(), queueFamilies.cend(), [](const VkQueueFamilyProperties &family) {
+        return (family.queueFlags & VkQueueFlagBits::VK_QUEUE_GRAPHICS_BIT) != 0;
+    });
+    if (graphicsFamily == queueFamilies.cend()) {
+        throw std::runtime_error{"no graphics queue family"};
+    }
+    m_graphicsQueueFamilyIndex = static_cast<uint32_t>(std::distance(queueFamilies.cbegin(), graphicsFamily));
+
+    float queuePriority = 1.0F;
+    VkDeviceQueueCreateInfo queueInfo{};
+    queueInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = m_graphicsQueueFamilyIndex;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &queuePriority;
+
+    // Same as QVulkanWindow: every supported core feature except robust buffer access
+    VkPhysicalDeviceFeatures features{};
+    funcs->vkGetPhysicalDeviceFeatures(m_physicalDevice, &features);
+    features.robustBufferAccess = VK_FALSE;
+
+    auto supportedExtensions = supportedDeviceExtensions();
+    QVector<const char *> extensions{};
+    for (const auto &extension : qAsConst(m_deviceExtensions)) {
+        if (supportedExtensions.contains(extension)) {
+            extensions << extension.constData();
+        }
+    }
+
+    VkDeviceCreateInfo deviceInfo{};
+    deviceInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    deviceInfo.enabledExtensionCount = extensions.size();
+    deviceInfo.ppEnabledExtensionNames = extensions.constData();
+    deviceInfo.pEnabledFeatures = &features;
+
+    // Enabling the extension does not enable the feature, it has to be requested through the feature struct
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    m_synchronization2Enabled = false;
+    if (std::any_of(extensions.cbegin(), extensions.cend(), [](const char *extension) {
+                return std::strcmp(extension, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) == 0;
+            })
+            && m_physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_1) {
+        auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+                    m_vulkanInstance->getInstanceProcAddr("vkGetPhysicalDeviceFeatures2"));
+        if (getPhysicalDeviceFeatures2 != nullptr) {
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &synchronization2Features;
+            getPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+            m_synchronization2Enabled = synchronization2Features.synchronization2 == VK_TRUE;
+        }
+        if (m_synchronization2Enabled) {
+            deviceInfo.pNext = &synchronization2Features;
+        }
+    }
+    VulkanRenderer::checkVkResult(funcs->vkCreateDevice(m_physicalDevice, &deviceInfo, nullptr, &m_device),
+                                  "failed to create offscreen device");
+    m_devFuncs = m_vulkanInstance->deviceFunctions(m_device);
+    m_devFuncs->vkGetDeviceQueue(m_device, m_graphicsQueueFamilyIndex, 0, &m_graphicsQueue);
+}
+
+VkFormat OffscreenSurface::chooseColorFormat() const
+{
+    auto *funcs = m_vulkanInstance->functions();
+    VkFormatFeatureFlags expectedFeatures = static_cast<VkFormatFeatureFlags>(VkFormatFeatureFlagBits::VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
+            | VkFormatFeatureFlagBits::VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+    for (auto format : m_preferredColorFormats) {
+        VkFormatProperties formatProperties{};
+        funcs->vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &formatProperties);
+        if ((formatProperties.optimalTilingFeatures & expectedFeatures) == expectedFeatures) {
+            return format;
+        }
+    }
+    return VkFormat::VK_FORMAT_B8G8R8A8_UNORM;
+}
+
+VkFormat OffscreenSurface::chooseDepthStencilFormat() const
+{
+    auto *funcs = m_vulkanInstance->functions();
+    for (auto format : depthStencilFormats) {
+        VkFormatProperties formatProperties{};
+        funcs->vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &formatProperties);
+        if ((formatProperties.optimalTilingFeatures & VkFormatFeatureFlagBits::VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) != 0) {
+            return format;
+        }
+    }
+    throw std::runtime_error{"no supported depth stencil format"};
+}
+
+void OffscreenSurface::createRenderPass()
+{
+    // Attachment order matches the default render pass of QVulkanWindow: resolved color, depth stencil, multisample color
+    bool multisample = m_sampleCount > VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+    std::array<VkAttachmentDescription, 3> attachments{};
+
+    VkAttachmentDescription &colorAttachment = attachments[0];
+    colorAttachment.format = m_colorFormat;
+    colorAttachment.samples = VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = multisample ? VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_DONT_CARE : VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    VkAttachmentDescription &depthAttachment = attachments[1];
+    depthAttachment.format = m_depthStencilFormat;
+    depthAttachment.samples = m_sampleCount;
+    depthAttachment.loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.stencilStoreOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription &msaaAttachment = attachments[2];
+    msaaAttachment.format = m_colorFormat;
+    msaaAttachment.samples = m_sampleCount;
+    msaaAttachment.loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+    msaaAttachment.storeOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    msaaAttachment.stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    msaaAttachment.stencilStoreOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    msaaAttachment.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
+    msaaAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorRef{multisample ? 2U : 0U, VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference resolveRef{0, VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depthRef{1, VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorRef;
+    subpass.pResolveAttachments = multisample ? &resolveRef : nullptr;
+    subpass.pDepthStencilAttachment = &depthRef;
+
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = static_cast<VkPipelineStageFlags>(VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT)
+            | VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependency.dstStageMask = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_READ_BIT;
+    dependency.dstAccessMask = VkAccessFlagBits::VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = multisample ? 3 : 2;
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+    VulkanRenderer::checkVkResult(m_devFuncs->vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass),
+                                  "failed to create offscreen render pass");
+}
+
+uint32_t OffscreenSurface::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+{
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    m_vulkanInstance->functions()->vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        if ((typeBits & (1U << i)) != 0 && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error{"no suitable memory type"};
+}
+
+OffscreenSurface::DeviceImage OffscreenSurface::createDeviceImage(VkFormat format, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageAspectFlags aspect) const
+{
+    DeviceImage result{};
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VkImageType::VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = static_cast<uint32_t>(m_size.width());
+    imageInfo.extent.height = static_cast<uint32_t>(m_size.height());
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VkImageTiling::VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VkSharingMode::VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = samples;
+    VulkanRenderer::checkVkResult(m_devFuncs->vkCreateImage(m_device, &imageInfo, nullptr, &result.image),
+                                  "failed to create offscreen image");
+    auto imageGuard = sg::make_scope_guard([&, this]{ if (result.view == VK_NULL_HANDLE) { destroyDeviceImage(result); } });
+
+    VkMemoryRequirements memoryRequirements{};
+    m_devFuncs->vkGetImageMemoryRequirements(m_device, result.image, &memoryRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memoryRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VulkanRenderer::checkVkResult(m_devFuncs->vkAllocateMemory(m_device, &allocInfo, nullptr, &result.memory),
+                                  "failed to allocate offscreen image memory");
+    VulkanRenderer::checkVkResult(m_devFuncs->vkBindImageMemory(m_device, result.image, result.memory, 0),
+                                  "failed to bind offscreen image memory");
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = result.image;
+    viewInfo.viewType = VkImageViewType::VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = aspect;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    VulkanRenderer::checkVkResult(m_devFuncs->vkCreateImageView(m_device, &viewInfo, nullptr, &result.view),
+                                  "failed to create offscreen image view");
+    return result;
+}
+
+void OffscreenSurface::destroyDeviceImage(DeviceImage &image) const
+{
+    m_devFuncs->vkDestroyImageView(m_device, image.view, nullptr);
+    m_devFuncs->vkDestroyImage(m_device, image.image, nullptr);
+    m_devFuncs->vkFreeMemory(m_device, image.memory, nullptr);
+    image = {};
+}
+
+void OffscreenSurface::createImages()
+{
+    qDebug() << "Create offscreen images";
+    bool multisample = m_sampleCount > VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+    VkImageAspectFlags depthAspect = VkImageAspectFlagBits::VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (hasStencil(m_depthStencilFormat)) {
+        depthAspect |= VkImageAspectFlagBits::VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    m_depthStencilImage = createDeviceImage(m_depthStencilFormat, m_sampleCount,
+                                            VkImageUsageFlagBits::VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspect);
+    if (multisample) {
+        m_msaaImage = createDeviceImage(m_colorFormat, m_sampleCount,
+                                        static_cast<VkImageUsageFlags>(VkImageUsageFlagBits::VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
+                                        | VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                                        VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+    for (auto &target : m_images) {
+        target.color = createDeviceImage(m_colorFormat, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT,
+                                         static_cast<VkImageUsageFlags>(VkImageUsageFlagBits::VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
+                                         | VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                         VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT);
+        std::array<VkImageView, 3> views{target.color.view, m_depthStencilImage.view, m_msaaImage.view};
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = m_renderPass;
+        framebufferInfo.attachmentCount = multisample ? 3 : 2;
+        framebufferInfo.pAttachments = views.data();
+        framebufferInfo.width = static_cast<uint32_t>(m_size.width());
+        framebufferInfo.height = static_cast<uint32_t>(m_size.height());
+        framebufferInfo.layers = 1;
+        VulkanRenderer::checkVkResult(m_devFuncs->vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &target.framebuffer),
+                                      "failed to create offscreen framebuffer");
+    }
+}
+
+void OffscreenSurface::beginFrame()
+{
+    const auto &frame = m_frames.at(m_currentFrame);
+    VulkanRenderer::checkVkResult(m_devFuncs->vkWaitForFences(m_device, 1, &frame.fence, VK_TRUE, UINT64_MAX),
+                                  "failed to wait for offscreen frame fence");
+    VulkanRenderer::checkVkResult(m_devFuncs->vkResetFences(m_device, 1, &frame.fence),
+                                  "failed to reset offscreen frame fence");
+    VulkanRenderer::checkVkResult(m_devFuncs->vkResetCommandBuffer(frame.commandBuffer, {}),
+                                  "failed to reset offscreen command buffer");
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VulkanRenderer::checkVkResult(m_devFuncs->vkBeginCommandBuffer(frame.commandBuffer, &beginInfo),
+                                  "failed to begin offscreen command buffer");
+}
+
+void OffscreenSurface::frameReady()
+{
+    const auto &frame = m_frames.at(m_currentFrame);
+    VulkanRenderer::checkVkResult(m_devFuncs->vkEndCommandBuffer(frame.commandBuffer),
+                                  "failed to end offscreen command buffer");
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
+    VulkanRenderer::checkVkResult(m_devFuncs->vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, frame.fence),
+                                  "failed to submit offscreen frame");
+    m_lastImage = m_currentImage;
+    m_currentFrame = (m_currentFrame + 1) % m_frameCount;
+    m_currentImage = (m_currentImage + 1) % imageCount;
+    ++m_frameNumber;
+}
+
+void OffscreenSurface::waitIdle() const
+{
+    VulkanRenderer::checkVkResult(m_devFuncs->vkDeviceWaitIdle(m_device),
+                                  "failed to wait for offscreen device");
+}
+
+QImage OffscreenSurface::grabLastFrame()
+{
+    qDebug() << "Grab offscreen frame";
+    waitIdle();
+    auto width = static_cast<uint32_t>(m_size.width());
+    auto height = static_cast<uint32_t>(m_size.height());
+    VkDeviceSize size = VkDeviceSize{width} * height * 4;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VkSharingMode::VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer buffer{};
+    VulkanRenderer::checkVkResult(m_devFuncs->vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer),
+                                  "failed to create readback buffer");
+    VkDeviceMemory memory{};
+    auto bufferGuard = sg::make_scope_guard([&, this]{
+        m_devFuncs->vkDestroyBuffer(m_device, buffer, nullptr);
+        m_devFuncs->vkFreeMemory(m_device, memory, nullptr);
+    });
+    VkMemoryRequirements memoryRequirements{};
+    m_devFuncs->vkGetBufferMemoryRequirements(m_device, buffer, &memoryRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memoryRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits,
+                                               static_cast<VkMemoryPropertyFlags>(VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+                                               | VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VulkanRenderer::checkVkResult(m_devFuncs->vkAllocateMemory(m_device, &allocInfo, nullptr, &memory),
+                                  "failed to allocate readback memory");
+    VulkanRenderer::checkVkResult(m_devFuncs->vkBindBufferMemory(m_device, buffer, memory, 0),
+                                  "failed to bind readback memory");
+
+    auto &frame = m_frames.at(m_currentFrame);
+    beginFrame();
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {width, height, 1};
+    // The render pass leaves the image in transfer source layout
+    m_devFuncs->vkCmdCopyImageToBuffer(frame.commandBuffer, m_images.at(m_lastImage).color.image,
+                                       VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+    VulkanRenderer::checkVkResult(m_devFuncs->vkEndCommandBuffer(frame.commandBuffer),
+                                  "failed to end readback command buffer");
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
+    VulkanRenderer::checkVkResult(m_devFuncs->vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, frame.fence),
+                                  "failed to submit readback");
+    waitIdle();
+
+    void *data{};
+    VulkanRenderer::checkVkResult(m_devFuncs->vkMapMemory(m_device, memory, 0, size, {}, &data),
+                                  "failed to map readback memory");
+    auto mapGuard = sg::make_scope_guard([&, this]{ m_devFuncs->vkUnmapMemory(m_device, memory); });
+    bool bgra = m_colorFormat == VkFormat::VK_FORMAT_B8G8R8A8_SRGB || m_colorFormat == VkFormat::VK_FORMAT_B8G8R8A8_UNORM;
+    QImage image{static_cast<int>(width), static_cast<int>(height), bgra ? QImage::Format::Format_ARGB32 : QImage::Format::Format_RGBA8888};
+    std::memcpy(image.bits(), data, size);
+    return image;
+}
+
+void OffscreenSurface::destroyImages()
+{
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+    qDebug() << "Destroy offscreen images";
+    for (auto &target : m_images) {
+        m_devFuncs->vkDestroyFramebuffer(m_device, target.framebuffer, nullptr);
+        target.framebuffer = {};
+        destroyDeviceImage(target.color);
+    }
+    destroyDeviceImage(m_msaaImage);
+    destroyDeviceImage(m_depthStencilImage);
+}
+
+void OffscreenSurface::destroy()
+{
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+    qDebug() << "Destroy offscreen surface";
+    waitIdle();
+    destroyImages();
+    for (auto &frame : m_frames) {
+        m_devFuncs->vkDestroyFence(m_device, frame.fence, nullptr);
+    }
+    m_frames.clear();
+    m_devFuncs->vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    m_commandPool = {};
+    m_devFuncs->vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+    m_renderPass = {};
+    m_devFuncs->vkDestroyDevice(m_device, nullptr);
+    m_vulkanInstance->resetDeviceFunctions(m_device);
+    m_devFuncs = {};
+    m_synchronization2Enabled = false;
+    m_device = {};
+}
@@ -0,0 +1,125 @@
+#ifndef OFFSCREENSURFACE_H
+#define OFFSCREENSURFACE_H
+
+#include "rendersurface.h"
+
+#include <QImage>
+
+#include <array>
+
+// Renders into color, depth and optional multisample images of a fixed size without any window or swap chain.
+// The frame loop is driven by the owner through beginFrame() and the renderer's frameReady().
+class OffscreenSurface final : public RenderSurface
+{
+public:
+    OffscreenSurface(QVulkanInstance *vulkanInstance, const QSize &size, int maxSampleCount, float timeStep);
+    ~OffscreenSurface() override;
+
+    [[nodiscard]] QVulkanInfoVector<QVulkanExtension> supportedDeviceExtensions() override;
+    [[nodiscard]] QByteArrayList deviceExtensions() const override { return m_deviceExtensions; }
+    void setDeviceExtensions(const QByteArrayList &extensions) override { m_deviceExtensions = extensions; }
+    [[nodiscard]] QVector<int> supportedSampleCounts() override;
+    void setSampleCount(int sampleCount) override;
+    void setPreferredColorFormats(const QVector<VkFormat> &formats) override { m_preferredColorFormats = formats; }
+    void setMaxConcurrentFrameCount(int count) override { m_frameCount = count; }
+
+    [[nodiscard]] QVulkanInstance *vulkanInstance() const override { return m_vulkanInstance; }
+    [[nodiscard]] VkPhysicalDevice physicalDevice() const override { return m_physicalDevice; }
+    [[nodiscard]] const VkPhysicalDeviceProperties *physicalDeviceProperties() const override { return &m_physicalDeviceProperties; }
+    [[nodiscard]] VkDevice device() const override { return m_device; }
+    [[nodiscard]] VkQueue graphicsQueue() const override { return m_graphicsQueue; }
+    [[nodiscard]] uint32_t graphicsQueueFamilyIndex() const override { return m_graphicsQueueFamilyIndex; }
+    [[nodiscard]] VkCommandPool graphicsCommandPool() const override { return m_commandPool; }
+    [[nodiscard]] VkRenderPass defaultRenderPass() const override { return m_renderPass; }
+    [[nodiscard]] VkFormat colorFormat() const override { return m_colorFormat; }
+    [[nodiscard]] VkFormat depthStencilFormat() const override { return m_depthStencilFormat; }
+    [[nodiscard]] VkSampleCountFlagBits sampleCountFlagBits() const override { return m_sampleCount; }
+    [[nodiscard]] int concurrentFrameCount() const override { return m_frameCount; }
+    [[nodiscard]] bool synchronization2Enabled() const override { return m_synchronization2Enabled; }
+
+    [[nodiscard]] QSize swapChainImageSize() const override { return m_size; }
+    [[nodiscard]] int swapChainImageCount() const override { return imageCount; }
+    [[nodiscard]] VkImage depthStencilImage() const override { return m_depthStencilImage.image; }
+
+    [[nodiscard]] int currentFrame() const override { return m_currentFrame; }
+    [[nodiscard]] int currentSwapChainImageIndex() const override { return m_currentImage; }
+    [[nodiscard]] VkCommandBuffer currentCommandBuffer() const override { return m_frames.at(m_currentFrame).commandBuffer; }
+    [[nodiscard]] VkFramebuffer currentFramebuffer() const override { return m_images.at(m_currentImage).framebuffer; }
+    [[nodiscard]] float animationTime() const override { return static_cast<float>(m_frameNumber) * m_timeStep; }
+    void frameReady() override;
+
+    // Call after preInitResources and before initResources
+    void create();
+    // Call after initResources and before initSwapChainResources
+    void createImages();
+    void beginFrame();
+    void waitIdle() const;
+    // Reads back the image of the last submitted frame
+    [[nodiscard]] QImage grabLastFrame();
+    void destroyImages();
+    void destroy();
+
+private:
+    static constexpr int defaultFrameCount = 2;
+    static constexpr int imageCount = 2;
+
+    struct DeviceImage
+    {
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView view;
+    };
+
+    struct TargetImage
+    {
+        DeviceImage color;
+        VkFramebuffer framebuffer;
+    };
+
+    struct Frame
+    {
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+    };
+
+    QVulkanInstance *const m_vulkanInstance;
+    const QSize m_size;
+    const int m_maxSampleCount;
+    const float m_timeStep;
+    VkPhysicalDevice m_physicalDevice;
+    VkPhysicalDeviceProperties m_physicalDeviceProperties;
+    QByteArrayList m_deviceExtensions;
+    QVector<VkFormat> m_preferredColorFormats;
+    VkSampleCountFlagBits m_sampleCount;
+    int m_frameCount;
+
+    VkDevice m_device;
+    QVulkanDeviceFunctions *m_devFuncs;
+    bool m_synchronization2Enabled;
+    uint32_t m_graphicsQueueFamilyIndex;
+    VkQueue m_graphicsQueue;
+    VkCommandPool m_commandPool;
+    VkFormat m_colorFormat;
+    VkFormat m_depthStencilFormat;
+    VkRenderPass m_renderPass;
+
+    QVector<Frame> m_frames;
+    std::array<TargetImage, imageCount> m_images;
+    DeviceImage m_depthStencilImage;
+    DeviceImage m_msaaImage;
+
+    int m_currentFrame;
+    int m_currentImage;
+    int m_lastImage;
+    int m_frameNumber;
+
+    void createDevice();
+    void createRenderPass();
+    [[nodiscard]] VkFormat chooseColorFormat() const;
+    [[nodiscard]] VkFormat chooseDepthStencilFormat() const;
+    [[nodiscard]] uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+    [[nodiscard]] DeviceImage createDeviceImage(VkFormat format, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageAspectFlags aspect) const;
+    void destroyDeviceImage(DeviceImage &image) const;
+};
+
+#endif // OFFSCREENSURFACE_H
@@ -0,0 +1,16 @@
+#include "parallel.h"
+
+#include "jobsystem.h"
+
+#include <algorithm>
+
+int idealWorkerCount(int itemCount)
+{
+    // The calling thread works as well
+    return std::clamp(JobSystem::instance().workerCount() + 1, 1, std::max(itemCount, 1));
+}
+
+void parallelFor(int itemCount, int workerCount, const std::function<void(int workerIndex, int itemIndex)> &body)
+{
+    JobSystem::instance().parallelFor(itemCount, workerCount, body);
+}
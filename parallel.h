@@ -0,0 +1,12 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+[[nodiscard]] int idealWorkerCount(int itemCount);
+
+// Calls body(workerIndex, itemIndex) for every item in [0, itemCount) using up to workerCount jobs of the shared JobSystem,
+// the calling thread takes part as worker 0. The first exception thrown by body is rethrown after all workers finished.
+void parallelFor(int itemCount, int workerCount, const std::function<void(int workerIndex, int itemIndex)> &body);
+
+#endif // PARALLEL_H
@@ -0,0 +1,205 @@
+#include "perfcheck.h"
+
+#include "headlessrunner.h"
+#include "syntheticmodel.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+// Animation advances by a fixed step per frame, so every run draws exactly the same frames
+constexpr float perfTimeStep = 1.0F / 60.0F;
+
+const QSize hdSize{1280, 720};
+const QSize uhdSize{3840, 2160};
+
+[[nodiscard]] std::vector<PerfScene> createPerfScenes()
+{
+    std::vector<PerfScene> scenes{};
+    // The bundled model and texture without multisampling, the callers change what their scene is about
+    auto addScene = [&scenes](const QString &name, const QSize &size, int frames) -> PerfScene & {
+        PerfScene scene{};
+        scene.name = name;
+        scene.size = size;
+        scene.samples = 1;
+        scene.frames = frames;
+        scenes.push_back(scene);
+        return scenes.back();
+    };
+
+    addScene(QStringLiteral("viking_room"), hdSize, 300).samples = 4;
+    // Vertex bound: two million triangles
+    addScene(QStringLiteral("stress_geometry"), hdSize, 200).gridSize = 1024;
+    // Fill and resolve bound
+    addScene(QStringLiteral("stress_fill"), uhdSize, 100).samples = 8;
+    // The same with the fragments shaded once behind a depth prepass, compare with stress_fill
+    auto &fillPrepass = addScene(QStringLiteral("stress_fill_prepass"), uhdSize, 100);
+    fillPrepass.samples = 8;
+    fillPrepass.depthPrepass = true;
+    // Object count bound, most copies are outside of the frustum
+    addScene(QStringLiteral("stress_instances"), hdSize, 200).instanceCount = 65536;
+    // Texture upload bound: thirteen levels built by the compute downsampler, the load time holds the upload
+    addScene(QStringLiteral("stress_mipmaps"), hdSize, 10).textureSize = 4096;
+    // The same levels built by a chain of blits, compare with stress_mipmaps
+    auto &mipmapsBlit = addScene(QStringLiteral("stress_mipmaps_blit"), hdSize, 10);
+    mipmapsBlit.textureSize = 4096;
+    mipmapsBlit.blitMipmaps = true;
+    return scenes;
+}
+
+const std::vector<PerfScene> perfScenes = createPerfScenes();
+
+// Checked metrics, all of them lower is better
+const std::vector<QString> metricNames{
+    QStringLiteral("loadTimeMs"),
+    QStringLiteral("firstFrameMs"),
+    QStringLiteral("p50Ms"),
+    QStringLiteral("p90Ms"),
+    QStringLiteral("p99Ms"),
+    QStringLiteral("peakRssKiB"),
+    QStringLiteral("vmaBytes")
+};
+
+const QString tolerancesKey = QStringLiteral("tolerances");
+const QString scenesKey = QStringLiteral("scenes");
+const QString relativeKey = QStringLiteral("relative");
+const QString absoluteKey = QStringLiteral("absolute");
+
+[[nodiscard]] const PerfScene &findScene(const QString &name)
+{
+    auto scene = std::find_if(perfScenes.cbegin(), perfScenes.cend(), [&name](const PerfScene &scene) { return scene.name == name; });
+    if (scene == perfScenes.cend()) {
+        throw std::runtime_error{"unknown perf scene"};
+    }
+    return *scene;
+}
+
+[[nodiscard]] QJsonObject readBaseline(const QString &fileName)
+{
+    QFile file{fileName};
+    if (!file.open(QFile::OpenModeFlag::ReadOnly)) {
+        throw std::runtime_error{"can not open perf baseline"};
+    }
+    QJsonParseError error{};
+    auto document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (document.isNull()) {
+        qDebug() << "Perf baseline parse error: " << error.errorString();
+        throw std::runtime_error{"can not parse perf baseline"};
+    }
+    return document.object();
+}
+
+void writeBaseline(const QString &fileName, const QJsonObject &baseline)
+{
+    QSaveFile file{fileName};
+    auto json = QJsonDocument{baseline}.toJson(QJsonDocument::JsonFormat::Indented);
+    if (!file.open(QFile::OpenModeFlag::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        throw std::runtime_error{"can not write perf baseline"};
+    }
+}
+}
+
+PerfCheck::PerfCheck(QVulkanInstance *vulkanInstance, PerfCheckOptions options)
+    : m_vulkanInstance{vulkanInstance}
+    , m_options{std::move(options)}
+{
+}
+
+QStringList PerfCheck::sceneNames()
+{
+    QStringList result{};
+    for (const auto &scene : perfScenes) {
+        result << scene.name;
+    }
+    return result;
+}
+
+int PerfCheck::run()
+{
+    const auto &scene = findScene(m_options.sceneName);
+    auto baseline = readBaseline(m_options.baselineFile);
+
+    QTemporaryDir modelDir{};
+    HeadlessOptions headlessOptions{};
+    headlessOptions.frames = scene.frames;
+    headlessOptions.size = scene.size;
+    headlessOptions.samples = scene.samples;
+    headlessOptions.timeStep = perfTimeStep;
+    headlessOptions.instanceCount = scene.instanceCount;
+    headlessOptions.depthPrepass = scene.depthPrepass;
+    headlessOptions.blitMipmaps = scene.blitMipmaps;
+    if ((scene.gridSize > 0 || scene.textureSize > 0) && !modelDir.isValid()) {
+        throw std::runtime_error{"can not create temporary directory"};
+    }
+    if (scene.gridSize > 0) {
+        headlessOptions.modelFile = QDir{modelDir.path()}.filePath(QStringLiteral("grid.obj"));
+        writeSyntheticObj(headlessOptions.modelFile, scene.gridSize);
+    }
+    if (scene.textureSize > 0) {
+        headlessOptions.textureFile = QDir{modelDir.path()}.filePath(QStringLiteral("noise.png"));
+        writeSyntheticTexture(headlessOptions.textureFile, scene.textureSize);
+    }
+    auto stats = HeadlessRunner{m_vulkanInstance, headlessOptions}.run();
+    HeadlessRunner::report(stats);
+    auto measured = stats.toJson();
+
+    auto scenes = baseline.value(scenesKey).toObject();
+    if (m_options.update) {
+        QJsonObject sceneBaseline{};
+        for (const auto &metric : metricNames) {
+            sceneBaseline.insert(metric, measured.value(metric));
+        }
+        scenes.insert(scene.name, sceneBaseline);
+        baseline.insert(scenesKey, scenes);
+        writeBaseline(m_options.baselineFile, baseline);
+        std::printf("Updated baseline of %s in %s\n", qPrintable(scene.name), qPrintable(m_options.baselineFile));
+        return 0;
+    }
+
+    // Baselines are recorded per machine, a check without one would pass every slowdown
+    if (!scenes.contains(scene.name)) {
+        std::printf("%s: %s, no baseline in %s, record one with the perf_update target\n", qPrintable(scene.name),
+                    m_options.allowMissingBaseline ? "skipped" : "FAILED", qPrintable(m_options.baselineFile));
+        return m_options.allowMissingBaseline ? 0 : 1;
+    }
+    auto sceneBaseline = scenes.value(scene.name).toObject();
+    auto tolerances = baseline.value(tolerancesKey).toObject();
+
+    // Only slowdowns fail, getting faster is reported as ok
+    int regressions{};
+    std::printf("%-14s %14s %14s %14s  %s\n", "metric", "baseline", "measured", "limit", "status");
+    for (const auto &metric : metricNames) {
+        if (!sceneBaseline.contains(metric)) {
+            continue;
+        }
+        auto tolerance = tolerances.value(metric).toObject();
+        auto expected = sceneBaseline.value(metric).toDouble();
+        auto actual = measured.value(metric).toDouble();
+        auto limit = expected * (1.0 + tolerance.value(relativeKey).toDouble() * m_options.toleranceScale)
+                + tolerance.value(absoluteKey).toDouble() * m_options.toleranceScale;
+        bool regressed = actual > limit;
+        auto change = expected > 0.0 ? (actual - expected) / expected * 100.0 : 0.0;
+        std::printf("%-14s %14.3f %14.3f %14.3f  %s (%+.1f%%)\n", qPrintable(metric), expected, actual, limit,
+                    regressed ? "REGRESSION" : "ok", change);
+        if (regressed) {
+            ++regressions;
+        }
+    }
+    std::fflush(stdout);
+    if (regressions > 0) {
+        std::printf("%s: %d metric(s) regressed\n", qPrintable(scene.name), regressions);
+        return 1;
+    }
+    return 0;
+}
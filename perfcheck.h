@@ -0,0 +1,57 @@
+#ifndef PERFCHECK_H
+#define PERFCHECK_H
+
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+class QVulkanInstance;
+
+// Fixed headless workload measured against the checked-in baseline
+struct PerfScene
+{
+    QString name;
+    QSize size;
+    int samples;
+    int frames;
+    // Side of a generated grid model in quads, the bundled viking room when 0
+    int gridSize;
+    // Copies of the model, the render settings decide when 0
+    int instanceCount;
+    bool depthPrepass;
+    // Side of a generated texture in texels, the bundled texture when 0
+    int textureSize;
+    // Builds the mip chains with blits instead of the compute downsampler
+    bool blitMipmaps;
+};
+
+struct PerfCheckOptions
+{
+    QString sceneName;
+    QString baselineFile;
+    // Stores the measurement as the new baseline of the scene instead of comparing
+    bool update;
+    // Multiplies every tolerance of the baseline, for noisy machines
+    double toleranceScale;
+    // Passes a scene without a baseline instead of failing it, for machines which have not recorded one yet
+    bool allowMissingBaseline;
+};
+
+// Runs one scene per process, so the peak RSS belongs to that scene alone
+class PerfCheck
+{
+public:
+    PerfCheck(QVulkanInstance *vulkanInstance, PerfCheckOptions options);
+
+    // Returns the process exit code, non zero when a metric regressed or the scene has no baseline, unless missing
+    // baselines are allowed.
+    [[nodiscard]] int run();
+
+    [[nodiscard]] static QStringList sceneNames();
+
+private:
+    QVulkanInstance *const m_vulkanInstance;
+    const PerfCheckOptions m_options;
+};
+
+#endif // PERFCHECK_H
@@ -0,0 +1,177 @@
+#include "pipelinebuilder.h"
+
+#include "cpuprofiler.h"
+#include "parallel.h"
+#include "shaderregistry.h"
+#include "vulkanrenderer.h"
+
+#include "externals/scope_guard/scope_guard.hpp"
+
+#include <QDebug>
+#include <QVulkanDeviceFunctions>
+
+#include <array>
+
+namespace {
+constexpr std::array<VkDynamicState, 2> viewportDynamicStates{
+    VkDynamicState::VK_DYNAMIC_STATE_VIEWPORT,
+    VkDynamicState::VK_DYNAMIC_STATE_SCISSOR
+};
+}
+
+void GraphicsPipelineDescription::specialize(const PipelineVariantKey &key, uint32_t constantCount)
+{
+    specializationData = key;
+    for (uint32_t i = 0; i < constantCount; ++i) {
+        VkSpecializationMapEntry &entry = specializationMapEntries.at(i);
+        entry.constantID = i;
+        entry.offset = i * sizeof(uint32_t);
+        entry.size = sizeof(uint32_t);
+    }
+    specializationInfo.mapEntryCount = constantCount;
+    specializationInfo.dataSize = constantCount * sizeof(uint32_t);
+}
+
+VkGraphicsPipelineCreateInfo GraphicsPipelineDescription::createInfo()
+{
+    specializationInfo.pMapEntries = specializationMapEntries.data();
+    specializationInfo.pData = specializationData.constants.data();
+    for (auto &shaderStage : shaderStages) {
+        shaderStage.pSpecializationInfo = specializationInfo.mapEntryCount > 0 ? &specializationInfo : nullptr;
+    }
+
+    vertexInputInfo.vertexBindingDescriptionCount = bindingDescriptions.size();
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.constData();
+    vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.constData();
+
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+
+    dynamicState.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = viewportDynamicStates.size();
+    dynamicState.pDynamicStates = viewportDynamicStates.data();
+
+    colorBlending.attachmentCount = depthOnly ? 0 : 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = shaderStages.size();
+    pipelineInfo.pStages = shaderStages.constData();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = dynamicViewport ? &dynamicState : nullptr;
+    pipelineInfo.layout = layout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = subpass;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+    return pipelineInfo;
+}
+
+PipelineBuilder::PipelineBuilder(VulkanRenderer *vulkanRenderer)
+    : m_vulkanRenderer{vulkanRenderer}
+{
+}
+
+void PipelineBuilder::addShaderModule(const QString &shaderName, VkShaderModule *target)
+{
+    m_shaderModules.push_back({shaderName, target});
+}
+
+void PipelineBuilder::addShaderModules(const QString &vertShaderName, const QString &fragShaderName, ShaderModules *target)
+{
+    addShaderModule(vertShaderName, &target->vert);
+    addShaderModule(fragShaderName, &target->frag);
+}
+
+void PipelineBuilder::addGraphicsPipeline(GraphicsPipelineDescription description, VkPipeline *target)
+{
+    m_graphicsPipelines.push_back({std::move(description), target});
+}
+
+void PipelineBuilder::build()
+{
+    buildShaderModules();
+    buildGraphicsPipelines();
+}
+
+void PipelineBuilder::buildShaderModules()
+{
+    PROFILE_ZONE("PipelineBuilder::buildShaderModules");
+    auto count = static_cast<int>(m_shaderModules.size());
+    qDebug() << "Build shader modules: " << count;
+    auto requestsGuard = sg::make_scope_guard([this]{ m_shaderModules.clear(); });
+    for (auto &request : m_shaderModules) {
+        *request.target = VK_NULL_HANDLE;
+    }
+    // The modules built before a failing one would be lost to the caller, which does not own them yet
+    auto modulesGuard = sg::make_scope_guard([this]{
+        for (auto &request : m_shaderModules) {
+            m_vulkanRenderer->devFuncs()->vkDestroyShaderModule(m_vulkanRenderer->device(), *request.target, nullptr);
+            *request.target = VK_NULL_HANDLE;
+        }
+    });
+    parallelFor(count, idealWorkerCount(count), [this](int, int index) {
+        PROFILE_ZONE("PipelineBuilder::createShaderModule");
+        auto &request = m_shaderModules[index];
+        *request.target = m_vulkanRenderer->createShaderModule(ShaderRegistry::shader(request.name));
+    });
+    modulesGuard.dismiss();
+}
+
+void PipelineBuilder::buildGraphicsPipelines()
+{
+    PROFILE_ZONE("PipelineBuilder::buildGraphicsPipelines");
+    auto count = static_cast<int>(m_graphicsPipelines.size());
+    qDebug() << "Build graphics pipelines: " << count;
+    auto workerCount = idealWorkerCount(count);
+    auto mainPipelineCache = m_vulkanRenderer->pipelineCache();
+    auto requestsGuard = sg::make_scope_guard([this]{ m_graphicsPipelines.clear(); });
+
+    if (workerCount <= 1) {
+        for (auto &request : m_graphicsPipelines) {
+            createGraphicsPipeline(request, mainPipelineCache);
+        }
+        return;
+    }
+
+    // Pipeline cache access must be externally synchronized, so every worker fills its own one
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    std::vector<VkPipelineCache> workerPipelineCaches(workerCount, VK_NULL_HANDLE);
+    auto cachesGuard = sg::make_scope_guard([&]{
+        for (auto workerPipelineCache : workerPipelineCaches) {
+            devFuncs->vkDestroyPipelineCache(device, workerPipelineCache, nullptr);
+        }
+    });
+    {
+        auto initialData = m_vulkanRenderer->pipelineCacheData();
+        for (auto &workerPipelineCache : workerPipelineCaches) {
+            workerPipelineCache = m_vulkanRenderer->createPipelineCache(initialData);
+        }
+    }
+
+    parallelFor(count, workerCount, [&, this](int workerIndex, int index) {
+        createGraphicsPipeline(m_graphicsPipelines[index], workerPipelineCaches[workerIndex]);
+    });
+
+    VulkanRenderer::checkVkResult(devFuncs->vkMergePipelineCaches(device, mainPipelineCache, workerPipelineCaches.size(), workerPipelineCaches.data()),
+                                  "failed to merge pipeline caches");
+}
+
+void PipelineBuilder::createGraphicsPipeline(GraphicsPipelineRequest &request, VkPipelineCache pipelineCache) const
+{
+    PROFILE_ZONE("PipelineBuilder::createGraphicsPipeline");
+    auto pipelineInfo = request.description.createInfo();
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateGraphicsPipelines(m_vulkanRenderer->device(), pipelineCache, 1, &pipelineInfo, nullptr, request.target),
+                                  "failed to create graphics pipeline");
+}
@@ -0,0 +1,79 @@
+#ifndef PIPELINEBUILDER_H
+#define PIPELINEBUILDER_H
+
+#include "pipelinevariantkey.h"
+
+#include <QVulkanInstance>
+#include <QVector>
+
+#include <vector>
+
+class VulkanRenderer;
+struct ShaderModules;
+
+struct GraphicsPipelineDescription
+{
+    QVector<VkPipelineShaderStageCreateInfo> shaderStages;
+    QVector<VkVertexInputBindingDescription> bindingDescriptions;
+    QVector<VkVertexInputAttributeDescription> attributeDescriptions;
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+    VkViewport viewport;
+    VkRect2D scissor;
+    VkPipelineViewportStateCreateInfo viewportState;
+    // Viewport and scissor are set while recording, viewport and scissor above are ignored
+    bool dynamicViewport;
+    VkPipelineDynamicStateCreateInfo dynamicState;
+    VkPipelineRasterizationStateCreateInfo rasterizer;
+    VkPipelineMultisampleStateCreateInfo multisampling;
+    VkPipelineDepthStencilStateCreateInfo depthStencil;
+    VkPipelineColorBlendAttachmentState colorBlendAttachment;
+    // The render pass has no color attachment, colorBlendAttachment is ignored
+    bool depthOnly;
+    VkPipelineColorBlendStateCreateInfo colorBlending;
+    std::array<VkSpecializationMapEntry, maxSpecializationConstants> specializationMapEntries;
+    PipelineVariantKey specializationData;
+    VkSpecializationInfo specializationInfo;
+    VkPipelineLayout layout;
+    VkRenderPass renderPass;
+    uint32_t subpass;
+
+    // Specializes constant ids 0..constantCount - 1 of every shader stage with the values of the key
+    void specialize(const PipelineVariantKey &key, uint32_t constantCount);
+    // Links the nested create infos to this description, so it must stay in place while the result is in use
+    [[nodiscard]] VkGraphicsPipelineCreateInfo createInfo();
+};
+
+class PipelineBuilder
+{
+public:
+    explicit PipelineBuilder(VulkanRenderer *vulkanRenderer);
+
+    void addShaderModule(const QString &shaderName, VkShaderModule *target);
+    void addShaderModules(const QString &vertShaderName, const QString &fragShaderName, ShaderModules *target);
+    void addGraphicsPipeline(GraphicsPipelineDescription description, VkPipeline *target);
+    void build();
+
+private:
+    struct ShaderModuleRequest
+    {
+        QString name;
+        VkShaderModule *target;
+    };
+
+    struct GraphicsPipelineRequest
+    {
+        GraphicsPipelineDescription description;
+        VkPipeline *target;
+    };
+
+    VulkanRenderer *m_vulkanRenderer;
+    std::vector<ShaderModuleRequest> m_shaderModules;
+    std::vector<GraphicsPipelineRequest> m_graphicsPipelines;
+
+    void buildShaderModules();
+    void buildGraphicsPipelines();
+    void createGraphicsPipeline(GraphicsPipelineRequest &request, VkPipelineCache pipelineCache) const;
+};
+
+#endif // PIPELINEBUILDER_H
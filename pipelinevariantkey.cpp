@@ -0,0 +1,13 @@
+#include "pipelinevariantkey.h"
+
+#include <QHashFunctions>
+
+bool PipelineVariantKey::operator==(const PipelineVariantKey &other) const
+{
+    return constants == other.constants;
+}
+
+uint qHash(const PipelineVariantKey &key, uint seed) noexcept
+{
+    return qHashRange(key.constants.cbegin(), key.constants.cend(), seed);
+}
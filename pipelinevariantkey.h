@@ -0,0 +1,21 @@
+#ifndef PIPELINEVARIANTKEY_H
+#define PIPELINEVARIANTKEY_H
+
+#include <array>
+#include <cstdint>
+
+#include <QtGlobal>
+
+constexpr uint32_t maxSpecializationConstants = 4;
+
+// Values of the specialization constants with ids 0..maxSpecializationConstants - 1
+struct PipelineVariantKey
+{
+    std::array<uint32_t, maxSpecializationConstants> constants;
+
+    [[nodiscard]] bool operator==(const PipelineVariantKey &other) const;
+};
+
+uint qHash(const PipelineVariantKey &key, uint seed = 0) noexcept;
+
+#endif // PIPELINEVARIANTKEY_H
@@ -0,0 +1,55 @@
+#include "pipelinevariants.h"
+
+#include "pipelinebuilder.h"
+#include "vulkanrenderer.h"
+
+#include <QDebug>
+#include <QVulkanDeviceFunctions>
+
+#include <stdexcept>
+
+PipelineVariants::PipelineVariants(VulkanRenderer *vulkanRenderer, DescriptionFactory descriptionFactory)
+    : m_vulkanRenderer{vulkanRenderer}
+    , m_descriptionFactory{std::move(descriptionFactory)}
+    , m_layout{}
+{
+}
+
+void PipelineVariants::describe(PipelineBuilder &pipelineBuilder, const QVector<PipelineVariantKey> &keys)
+{
+    qDebug() << "Describe pipeline variants: " << keys.size();
+    // Insert every key before taking pointers to the values, so the builder targets stay in place
+    m_pipelines.reserve(m_pipelines.size() + keys.size());
+    for (const auto &key : keys) {
+        m_pipelines.insert(key, VK_NULL_HANDLE);
+    }
+    for (const auto &key : keys) {
+        pipelineBuilder.addGraphicsPipeline(m_descriptionFactory(key), &m_pipelines[key]);
+    }
+}
+
+VkPipeline PipelineVariants::pipeline(const PipelineVariantKey &key) const
+{
+    auto iPipeline = m_pipelines.constFind(key);
+    if (iPipeline == m_pipelines.cend() || iPipeline.value() == VK_NULL_HANDLE) {
+        throw std::runtime_error{"pipeline variant was not described"};
+    }
+    return iPipeline.value();
+}
+
+void PipelineVariants::destroyPipelines()
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    for (auto pipeline : qAsConst(m_pipelines)) {
+        devFuncs->vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    m_pipelines.clear();
+}
+
+void PipelineVariants::destroy()
+{
+    destroyPipelines();
+    m_vulkanRenderer->devFuncs()->vkDestroyPipelineLayout(m_vulkanRenderer->device(), m_layout, nullptr);
+    m_layout = {};
+}
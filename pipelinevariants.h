@@ -0,0 +1,41 @@
+#ifndef PIPELINEVARIANTS_H
+#define PIPELINEVARIANTS_H
+
+#include "pipelinevariantkey.h"
+
+#include <functional>
+
+#include <QHash>
+#include <QVector>
+#include <QVulkanInstance>
+
+class VulkanRenderer;
+class PipelineBuilder;
+struct GraphicsPipelineDescription;
+
+class PipelineVariants
+{
+public:
+    using DescriptionFactory = std::function<GraphicsPipelineDescription(const PipelineVariantKey &key)>;
+
+    PipelineVariants(VulkanRenderer *vulkanRenderer, DescriptionFactory descriptionFactory);
+
+    void setLayout(VkPipelineLayout layout) { m_layout = layout; }
+    [[nodiscard]] VkPipelineLayout layout() const { return m_layout; }
+
+    void describe(PipelineBuilder &pipelineBuilder, const QVector<PipelineVariantKey> &keys);
+    // Only looks the variant up, recording never waits for a pipeline to compile. Throws for a variant which was not
+    // described.
+    [[nodiscard]] VkPipeline pipeline(const PipelineVariantKey &key) const;
+    // Keeps the layout, for describing the variants again
+    void destroyPipelines();
+    void destroy();
+
+private:
+    VulkanRenderer *m_vulkanRenderer;
+    DescriptionFactory m_descriptionFactory;
+    VkPipelineLayout m_layout;
+    QHash<PipelineVariantKey, VkPipeline> m_pipelines;
+};
+
+#endif // PIPELINEVARIANTS_H
@@ -0,0 +1,89 @@
+#include "qualitycalibration.h"
+
+#include "headlessrunner.h"
+#include "resolutiongovernor.h"
+#include "settings.h"
+#include "vulkanrenderer.h"
+
+#include <QDebug>
+#include <QVector>
+
+#include <stdexcept>
+
+namespace {
+// Long enough for the frames in flight to saturate, short enough to run every level before the window shows up
+constexpr int calibrationFrames = 40;
+constexpr float calibrationTimeStep = 1.0F / 60.0F;
+// Same limit as the sample counts QVulkanWindow offers
+constexpr int calibrationSamples = 64;
+}
+
+QualityCalibration::QualityCalibration(QVulkanInstance *vulkanInstance, const QSize &size)
+    : m_vulkanInstance{vulkanInstance}
+    , m_size{size}
+{
+}
+
+int QualityCalibration::run(bool force)
+{
+    auto renderSettings = Settings::loadRenderSettings();
+    if (renderSettings.qualityLevel >= 0) {
+        qDebug() << "Pinned quality level: " << renderSettings.qualityLevel;
+        return renderSettings.qualityLevel;
+    }
+    auto key = deviceKey(physicalDeviceProperties());
+    if (!force) {
+        auto storedLevel = Settings::loadQualityLevel(key, renderSettings.frameBudgetMs);
+        if (storedLevel >= 0) {
+            qDebug() << "Calibrated quality level: " << storedLevel;
+            return storedLevel;
+        }
+    }
+
+    qDebug() << "Calibrate quality level, device: " << key << ", size: " << m_size << ", budget: " << renderSettings.frameBudgetMs << " ms";
+    // The cheapest level is kept when none fits
+    auto level = ResolutionGovernor::levelCount() - 1;
+    for (int candidate = 0; candidate < ResolutionGovernor::levelCount(); ++candidate) {
+        HeadlessOptions options{};
+        options.frames = calibrationFrames;
+        options.size = m_size;
+        options.samples = calibrationSamples;
+        options.timeStep = calibrationTimeStep;
+        options.qualityLevel = candidate;
+        auto stats = HeadlessRunner{m_vulkanInstance, options}.run();
+        qDebug() << "Quality level: " << candidate << ", p90: " << stats.p90Ms << " ms";
+        if (stats.p90Ms <= renderSettings.frameBudgetMs) {
+            level = candidate;
+            break;
+        }
+    }
+    Settings::saveQualityLevel(key, renderSettings.frameBudgetMs, level);
+    qDebug() << "Calibrated quality level: " << level;
+    return level;
+}
+
+QString QualityCalibration::deviceKey(const VkPhysicalDeviceProperties &properties)
+{
+    return QStringLiteral("%1-%2-%3")
+        .arg(properties.vendorID, 4, 16, QLatin1Char{'0'})
+        .arg(properties.deviceID, 4, 16, QLatin1Char{'0'})
+        .arg(properties.driverVersion, 8, 16, QLatin1Char{'0'});
+}
+
+VkPhysicalDeviceProperties QualityCalibration::physicalDeviceProperties() const
+{
+    // The window and the offscreen surface both use the first physical device
+    auto *funcs = m_vulkanInstance->functions();
+    uint32_t physicalDeviceCount{};
+    VulkanRenderer::checkVkResult(funcs->vkEnumeratePhysicalDevices(m_vulkanInstance->vkInstance(), &physicalDeviceCount, nullptr),
+                                  "failed to enumerate physical devices");
+    if (physicalDeviceCount == 0) {
+        throw std::runtime_error{"no physical device"};
+    }
+    QVector<VkPhysicalDevice> physicalDevices(static_cast<int>(physicalDeviceCount));
+    VulkanRenderer::checkVkResult(funcs->vkEnumeratePhysicalDevices(m_vulkanInstance->vkInstance(), &physicalDeviceCount, physicalDevices.data()),
+                                  "failed to enumerate physical devices");
+    VkPhysicalDeviceProperties properties{};
+    funcs->vkGetPhysicalDeviceProperties(physicalDevices.constFirst(), &properties);
+    return properties;
+}
@@ -0,0 +1,30 @@
+#ifndef QUALITYCALIBRATION_H
+#define QUALITYCALIBRATION_H
+
+#include <QSize>
+#include <QString>
+#include <QVulkanInstance>
+
+// Picks the quality level of the resolution governor the renderer starts with. The scene is rendered offscreen at
+// the window size once per level, from the highest quality down, and the first level whose frame time fits into the
+// budget is stored for the device and driver, so later starts skip the measurement.
+class QualityCalibration
+{
+public:
+    QualityCalibration(QVulkanInstance *vulkanInstance, const QSize &size);
+
+    // Returns the level pinned in the render settings, otherwise measures only when no level is stored for the device
+    // or when forced, returns the level
+    int run(bool force);
+
+    // Identifies the device and driver the stored level belongs to
+    [[nodiscard]] static QString deviceKey(const VkPhysicalDeviceProperties &properties);
+
+private:
+    QVulkanInstance *const m_vulkanInstance;
+    const QSize m_size;
+
+    [[nodiscard]] VkPhysicalDeviceProperties physicalDeviceProperties() const;
+};
+
+#endif // QUALITYCALIBRATION_H
@@ -0,0 +1,517 @@
+#include "rendergraph.h"
+
+#include "cpuprofiler.h"
+#include "vulkanrenderer.h"
+
+#include "externals/scope_guard/scope_guard.hpp"
+
+#include <QDebug>
+#include <QVulkanDeviceFunctions>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+struct AccessInfo
+{
+    VkPipelineStageFlags2KHR stages;
+    VkAccessFlags2KHR accesses;
+    VkImageLayout layout;
+    bool write;
+};
+
+// Every stage and access used here has the same bit in the legacy flags, so the fallback only narrows them
+[[nodiscard]] AccessInfo accessInfo(RenderGraph::Access access)
+{
+    switch (access) {
+    case RenderGraph::Access::TRANSFER_READ:
+        return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false};
+    case RenderGraph::Access::TRANSFER_WRITE:
+        return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true};
+    case RenderGraph::Access::COMPUTE_READ:
+        return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_GENERAL, false};
+    case RenderGraph::Access::COMPUTE_WRITE:
+        return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_GENERAL, true};
+    case RenderGraph::Access::FRAGMENT_SAMPLED:
+        return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+    case RenderGraph::Access::COLOR_ATTACHMENT_WRITE:
+        return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true};
+    case RenderGraph::Access::DEPTH_ATTACHMENT_WRITE:
+        return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true};
+    case RenderGraph::Access::INDIRECT_READ:
+        return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case RenderGraph::Access::VERTEX_READ:
+        return {VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT_KHR, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR | VK_ACCESS_2_INDEX_READ_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case RenderGraph::Access::HOST_READ:
+        return {VK_PIPELINE_STAGE_2_HOST_BIT_KHR, VK_ACCESS_2_HOST_READ_BIT_KHR,
+                VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED, false};
+    }
+    throw std::runtime_error{"unknown render graph access"};
+}
+
+[[nodiscard]] bool sameDescription(const RenderGraph::ImageDescription &left, const RenderGraph::ImageDescription &right)
+{
+    return left.size == right.size && left.format == right.format && left.samples == right.samples
+            && left.usage == right.usage && left.aspectMask == right.aspectMask;
+}
+
+// Barriers of neighbouring mip levels which only differ in the level become one
+[[nodiscard]] bool extendsBarrier(const VkImageMemoryBarrier2KHR &barrier, const VkImageMemoryBarrier2KHR &next)
+{
+    return barrier.image == next.image && barrier.oldLayout == next.oldLayout && barrier.newLayout == next.newLayout
+            && barrier.srcStageMask == next.srcStageMask && barrier.srcAccessMask == next.srcAccessMask
+            && barrier.dstStageMask == next.dstStageMask && barrier.dstAccessMask == next.dstAccessMask
+            && barrier.subresourceRange.baseMipLevel + barrier.subresourceRange.levelCount == next.subresourceRange.baseMipLevel;
+}
+
+constexpr VkImageUsageFlags attachmentUsage = static_cast<VkImageUsageFlags>(VkImageUsageFlagBits::VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
+        | VkImageUsageFlagBits::VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+        | VkImageUsageFlagBits::VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+}
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph *graph, int pass)
+    : m_graph{graph}
+    , m_pass{pass}
+{
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::read(Resource resource, Access access)
+{
+    m_graph->addUsage(m_pass, {resource, access, 0, 0, false, false});
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::read(Resource resource, Access access, uint32_t mipLevel)
+{
+    m_graph->addUsage(m_pass, {resource, access, mipLevel, 1, false, false});
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::write(Resource resource, Access access, bool discard)
+{
+    m_graph->addUsage(m_pass, {resource, access, 0, 0, true, discard});
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::write(Resource resource, Access access, uint32_t mipLevel, bool discard)
+{
+    m_graph->addUsage(m_pass, {resource, access, mipLevel, 1, true, discard});
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::sideEffects()
+{
+    m_graph->m_passes[m_pass].sideEffects = true;
+    return *this;
+}
+
+RenderGraph::RenderGraph(const VulkanRenderer *vulkanRenderer)
+    : m_vulkanRenderer{vulkanRenderer}
+    , m_compiled{}
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+    clear();
+}
+
+RenderGraph::Resource RenderGraph::importImage(const QString &name, VkImage image, VkImageAspectFlags aspectMask, uint32_t mipLevels)
+{
+    Storage storage{};
+    storage.image = image;
+    storage.aspectMask = aspectMask;
+    storage.states.resize(mipLevels);
+    m_storages.push_back(std::move(storage));
+    m_resources.push_back({name, static_cast<int>(m_storages.size()) - 1, false, {}, false, {}});
+    return static_cast<Resource>(m_resources.size()) - 1;
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const QString &name)
+{
+    Storage storage{};
+    storage.states.resize(1);
+    m_storages.push_back(std::move(storage));
+    m_resources.push_back({name, static_cast<int>(m_storages.size()) - 1, false, {}, false, {}});
+    return static_cast<Resource>(m_resources.size()) - 1;
+}
+
+RenderGraph::Resource RenderGraph::importExternal(const QString &name)
+{
+    m_resources.push_back({name, -1, false, {}, false, {}});
+    return static_cast<Resource>(m_resources.size()) - 1;
+}
+
+RenderGraph::Resource RenderGraph::createImage(const QString &name, const ImageDescription &description)
+{
+    m_resources.push_back({name, -1, true, description, false, {}});
+    return static_cast<Resource>(m_resources.size()) - 1;
+}
+
+void RenderGraph::exportResource(Resource resource, Access access)
+{
+    auto &entry = m_resources.at(resource);
+    entry.exported = true;
+    entry.exportAccess = access;
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(const QString &name, Record record)
+{
+    m_passes.push_back({name, std::move(record), {}, false, false});
+    m_compiled = false;
+    return PassBuilder{this, static_cast<int>(m_passes.size()) - 1};
+}
+
+void RenderGraph::deferRelease(std::function<void()> release)
+{
+    m_releases.push_back(std::move(release));
+}
+
+void RenderGraph::addUsage(int pass, Usage usage)
+{
+    if (usage.resource < 0 || usage.resource >= static_cast<Resource>(m_resources.size())) {
+        throw std::runtime_error{"unknown render graph resource"};
+    }
+    m_passes[pass].usages << usage;
+}
+
+void RenderGraph::compile()
+{
+    PROFILE_ZONE("RenderGraph::compile");
+    cullPasses();
+    createTransientImages();
+    m_compiled = true;
+}
+
+void RenderGraph::cullPasses()
+{
+    // Walks back from the exported resources, a pass survives when a later surviving pass or the export needs its writes
+    std::vector<bool> needed(m_resources.size());
+    for (std::size_t resource = 0; resource < m_resources.size(); ++resource) {
+        needed[resource] = m_resources[resource].exported;
+    }
+    int culledCount = 0;
+    for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); ++pass) {
+        pass->culled = !pass->sideEffects && std::none_of(pass->usages.cbegin(), pass->usages.cend(), [&needed](const Usage &usage) {
+            return usage.write && needed[usage.resource];
+        });
+        if (pass->culled) {
+            qDebug() << "Cull render graph pass: " << pass->name;
+            ++culledCount;
+            continue;
+        }
+        // A write which keeps the rest of the content depends on the earlier writers as well
+        for (const auto &usage : qAsConst(pass->usages)) {
+            if (!usage.write || !usage.discard) {
+                needed[usage.resource] = true;
+            }
+        }
+    }
+    qDebug() << "Render graph passes: " << m_passes.size() - culledCount << ", culled: " << culledCount;
+}
+
+void RenderGraph::createTransientImages()
+{
+    struct Lifetime
+    {
+        int first;
+        int last;
+    };
+    std::vector<Lifetime> lifetimes(m_resources.size(), Lifetime{-1, -1});
+    for (int passIndex = 0; passIndex < static_cast<int>(m_passes.size()); ++passIndex) {
+        auto &pass = m_passes[passIndex];
+        if (pass.culled) {
+            continue;
+        }
+        for (auto &usage : pass.usages) {
+            if (!m_resources[usage.resource].transient) {
+                continue;
+            }
+            auto &lifetime = lifetimes[usage.resource];
+            if (lifetime.first < 0) {
+                // The image may have held another transient before, nothing of it is kept
+                lifetime.first = passIndex;
+                usage.discard = true;
+            }
+            lifetime.last = passIndex;
+        }
+    }
+
+    std::vector<Resource> transients{};
+    for (Resource resource = 0; resource < static_cast<Resource>(m_resources.size()); ++resource) {
+        if (m_resources[resource].transient && m_resources[resource].storage < 0 && lifetimes[resource].first >= 0) {
+            transients.push_back(resource);
+        }
+    }
+    std::sort(transients.begin(), transients.end(), [&lifetimes](Resource left, Resource right) {
+        return lifetimes[left].first < lifetimes[right].first;
+    });
+
+    // Last pass using each transient storage, a later transient of the same description may take it over
+    std::vector<std::pair<Resource, int>> lastUses{};
+    for (auto resource : transients) {
+        auto &entry = m_resources[resource];
+        const auto &lifetime = lifetimes[resource];
+        auto reused = std::find_if(lastUses.begin(), lastUses.end(), [&](const std::pair<Resource, int> &lastUse) {
+            return lastUse.second < lifetime.first && sameDescription(m_resources[lastUse.first].description, entry.description);
+        });
+        if (reused != lastUses.end()) {
+            qDebug() << "Render graph image: " << entry.name << " shares the image of: " << m_resources[reused->first].name;
+            entry.storage = m_resources[reused->first].storage;
+            *reused = {resource, lifetime.last};
+            continue;
+        }
+
+        const auto &description = entry.description;
+        auto usage = description.usage;
+        auto memoryUsage = VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY;
+        if ((usage & ~attachmentUsage) == 0) {
+            // Attachments which live within render passes may never get memory on tiled GPUs
+            usage |= VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            VmaAllocationCreateInfo lazyInfo{};
+            lazyInfo.usage = VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+            uint32_t memoryTypeIndex{};
+            if (vmaFindMemoryTypeIndex(m_vulkanRenderer->allocator(), UINT32_MAX, &lazyInfo, &memoryTypeIndex) == VkResult::VK_SUCCESS) {
+                memoryUsage = VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+            }
+        }
+        qDebug() << "Create render graph image: " << entry.name << ", size: " << description.size << ", samples: " << description.samples
+                 << ", lazily allocated: " << (memoryUsage == VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED);
+        Storage storage{};
+        storage.aspectMask = description.aspectMask;
+        storage.states.resize(1);
+        storage.ownedImage = m_vulkanRenderer->createImage(static_cast<uint32_t>(description.size.width()), static_cast<uint32_t>(description.size.height()), 1,
+                                                           description.samples, description.format, VkImageTiling::VK_IMAGE_TILING_OPTIMAL, usage, memoryUsage,
+                                                           AllocationTag::RENDER_TARGET);
+        storage.image = storage.ownedImage.object;
+        try {
+            storage.view = m_vulkanRenderer->createImageView(storage.image, description.format, description.aspectMask, 0, 1);
+        } catch (...) {
+            storage.ownedImage.destroy(m_vulkanRenderer->allocator());
+            throw;
+        }
+        m_storages.push_back(std::move(storage));
+        entry.storage = static_cast<int>(m_storages.size()) - 1;
+        lastUses.emplace_back(resource, lifetime.last);
+    }
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    PROFILE_ZONE("RenderGraph::execute");
+    if (!m_compiled) {
+        compile();
+    }
+    for (const auto &pass : m_passes) {
+        if (pass.culled) {
+            continue;
+        }
+        Barriers barriers{};
+        for (const auto &usage : pass.usages) {
+            addBarriers(barriers, usage);
+        }
+        recordBarriers(commandBuffer, barriers);
+        pass.record(commandBuffer);
+    }
+
+    Barriers barriers{};
+    for (Resource resource = 0; resource < static_cast<Resource>(m_resources.size()); ++resource) {
+        const auto &entry = m_resources[resource];
+        if (entry.exported) {
+            addBarriers(barriers, {resource, entry.exportAccess, 0, 0, accessInfo(entry.exportAccess).write, false});
+        }
+    }
+    recordBarriers(commandBuffer, barriers);
+}
+
+void RenderGraph::submit(const char *name)
+{
+    compile();
+    VkCommandBuffer commandBuffer = m_vulkanRenderer->beginSingleTimeCommands(name);
+    auto bufferGuard = sg::make_scope_guard([&, this]{ m_vulkanRenderer->endSingleTimeCommands(commandBuffer); });
+    execute(commandBuffer);
+}
+
+void RenderGraph::clear()
+{
+    for (auto release = m_releases.rbegin(); release != m_releases.rend(); ++release) {
+        (*release)();
+    }
+    m_releases.clear();
+    if (!m_storages.empty()) {
+        auto *devFuncs = m_vulkanRenderer->devFuncs();
+        VkDevice device = m_vulkanRenderer->device();
+        for (auto &storage : m_storages) {
+            if (storage.ownedImage.object != VK_NULL_HANDLE) {
+                devFuncs->vkDestroyImageView(device, storage.view, nullptr);
+                storage.ownedImage.destroy(m_vulkanRenderer->allocator());
+            }
+        }
+    }
+    m_storages.clear();
+    m_resources.clear();
+    m_passes.clear();
+    m_compiled = false;
+}
+
+VkImage RenderGraph::image(Resource resource) const
+{
+    auto storage = m_resources.at(resource).storage;
+    return storage >= 0 ? m_storages[storage].image : VK_NULL_HANDLE;
+}
+
+VkImageView RenderGraph::imageView(Resource resource) const
+{
+    auto storage = m_resources.at(resource).storage;
+    return storage >= 0 ? m_storages[storage].view : VK_NULL_HANDLE;
+}
+
+void RenderGraph::addBarriers(Barriers &barriers, const Usage &usage)
+{
+    const auto &entry = m_resources[usage.resource];
+    if (entry.storage < 0) {
+        return;
+    }
+    auto &storage = m_storages[entry.storage];
+    auto info = accessInfo(usage.access);
+    bool isImage = storage.image != VK_NULL_HANDLE;
+    auto levelCount = static_cast<uint32_t>(storage.states.size());
+    auto endLevel = usage.mipLevelCount == 0 ? levelCount : std::min(levelCount, usage.baseMipLevel + usage.mipLevelCount);
+
+    for (auto level = usage.baseMipLevel; level < endLevel; ++level) {
+        auto &state = storage.states[level];
+        auto newLayout = isImage ? info.layout : VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
+        bool transition = newLayout != state.layout;
+
+        // Writes and layout transitions wait for every earlier access, reads only for a write they do not see yet
+        VkPipelineStageFlags2KHR srcStages{};
+        VkAccessFlags2KHR srcAccesses{};
+        if (transition || info.write) {
+            srcStages = state.writeStages | state.readStages;
+            srcAccesses = state.writeAccesses;
+        } else if ((info.stages & ~state.visibleStages) != 0 || (info.accesses & ~state.visibleAccesses) != 0) {
+            srcStages = state.writeStages;
+            srcAccesses = state.writeAccesses;
+        }
+
+        if (transition) {
+            VkImageMemoryBarrier2KHR barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+            barrier.srcStageMask = srcStages;
+            barrier.srcAccessMask = srcAccesses;
+            barrier.dstStageMask = info.stages;
+            barrier.dstAccessMask = info.accesses;
+            barrier.oldLayout = usage.discard ? VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+            barrier.newLayout = newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = storage.image;
+            barrier.subresourceRange.aspectMask = storage.aspectMask;
+            barrier.subresourceRange.baseMipLevel = level;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            if (!barriers.imageBarriers.empty() && extendsBarrier(barriers.imageBarriers.back(), barrier)) {
+                ++barriers.imageBarriers.back().subresourceRange.levelCount;
+            } else {
+                barriers.imageBarriers.push_back(barrier);
+            }
+        } else if (srcStages != 0) {
+            barriers.memorySrcStages |= srcStages;
+            barriers.memorySrcAccesses |= srcAccesses;
+            barriers.memoryDstStages |= info.stages;
+            barriers.memoryDstAccesses |= info.accesses;
+        }
+
+        state.layout = newLayout;
+        if (info.write) {
+            state.writeStages = info.stages;
+            state.writeAccesses = info.accesses;
+            state.readStages = 0;
+            state.visibleStages = 0;
+            state.visibleAccesses = 0;
+        } else {
+            if (transition) {
+                // The transition is a write of its own, later reads in other stages have to wait for it
+                state.writeStages = info.stages;
+                state.writeAccesses = 0;
+                state.readStages = 0;
+                state.visibleStages = info.stages;
+                state.visibleAccesses = info.accesses;
+            } else if (srcStages != 0) {
+                state.visibleStages |= info.stages;
+                state.visibleAccesses |= info.accesses;
+            }
+            state.readStages |= info.stages;
+        }
+    }
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, Barriers &barriers) const
+{
+    bool memoryBarrierNeeded = barriers.memorySrcStages != 0;
+    if (!memoryBarrierNeeded && barriers.imageBarriers.empty()) {
+        return;
+    }
+
+    auto cmdPipelineBarrier2 = m_vulkanRenderer->cmdPipelineBarrier2();
+    if (cmdPipelineBarrier2 != nullptr) {
+        VkMemoryBarrier2KHR memoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+        memoryBarrier.srcStageMask = barriers.memorySrcStages;
+        memoryBarrier.srcAccessMask = barriers.memorySrcAccesses;
+        memoryBarrier.dstStageMask = barriers.memoryDstStages;
+        memoryBarrier.dstAccessMask = barriers.memoryDstAccesses;
+        VkDependencyInfoKHR dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependencyInfo.memoryBarrierCount = memoryBarrierNeeded ? 1 : 0;
+        dependencyInfo.pMemoryBarriers = &memoryBarrier;
+        dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.imageBarriers.size());
+        dependencyInfo.pImageMemoryBarriers = barriers.imageBarriers.data();
+        cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+        return;
+    }
+
+    // Without synchronization2 one call has to cover everything, its stage masks are the union of all barriers
+    auto srcStages = static_cast<VkPipelineStageFlags>(barriers.memorySrcStages);
+    auto dstStages = static_cast<VkPipelineStageFlags>(barriers.memoryDstStages);
+    std::vector<VkImageMemoryBarrier> imageBarriers{};
+    imageBarriers.reserve(barriers.imageBarriers.size());
+    for (const auto &barrier2 : barriers.imageBarriers) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VkStructureType::VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = static_cast<VkAccessFlags>(barrier2.srcAccessMask);
+        barrier.dstAccessMask = static_cast<VkAccessFlags>(barrier2.dstAccessMask);
+        barrier.oldLayout = barrier2.oldLayout;
+        barrier.newLayout = barrier2.newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = barrier2.image;
+        barrier.subresourceRange = barrier2.subresourceRange;
+        imageBarriers.push_back(barrier);
+        srcStages |= static_cast<VkPipelineStageFlags>(barrier2.srcStageMask);
+        dstStages |= static_cast<VkPipelineStageFlags>(barrier2.dstStageMask);
+    }
+    if (srcStages == 0) {
+        srcStages = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = static_cast<VkAccessFlags>(barriers.memorySrcAccesses);
+    memoryBarrier.dstAccessMask = static_cast<VkAccessFlags>(barriers.memoryDstAccesses);
+    m_vulkanRenderer->devFuncs()->vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, {},
+                                                       memoryBarrierNeeded ? 1 : 0, &memoryBarrier,
+                                                       0, nullptr,
+                                                       static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
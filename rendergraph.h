@@ -0,0 +1,183 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include "objectwithallocation.h"
+
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <QVulkanInstance>
+
+#include <functional>
+#include <vector>
+
+class VulkanRenderer;
+
+// Work recorded as passes which declare how they use each resource. compile() drops the passes nothing depends on
+// and creates the transient images of the others, sharing one image between transients which are never alive at the
+// same time. execute() records every pass behind a single barrier batch holding the layout transitions and hazards of
+// all its resources, with synchronization2 when the device has it enabled. Resource states carry over from one
+// execute() to the next, so the frame graph is built once per swap chain and replayed every frame.
+class RenderGraph
+{
+public:
+    // How a pass uses a resource, each one implies the pipeline stages, the accesses and the image layout
+    enum class Access : int
+    {
+        TRANSFER_READ = 0,
+        TRANSFER_WRITE = 1,
+        COMPUTE_READ = 2,
+        COMPUTE_WRITE = 3,
+        FRAGMENT_SAMPLED = 4,
+        COLOR_ATTACHMENT_WRITE = 5,
+        DEPTH_ATTACHMENT_WRITE = 6,
+        INDIRECT_READ = 7,
+        VERTEX_READ = 8,
+        HOST_READ = 9
+    };
+
+    using Resource = int;
+    using Record = std::function<void(VkCommandBuffer commandBuffer)>;
+
+    struct ImageDescription
+    {
+        QSize size;
+        VkFormat format;
+        VkSampleCountFlagBits samples;
+        VkImageUsageFlags usage;
+        VkImageAspectFlags aspectMask;
+    };
+
+    class PassBuilder
+    {
+    public:
+        PassBuilder &read(Resource resource, Access access);
+        PassBuilder &read(Resource resource, Access access, uint32_t mipLevel);
+        // A discarding write does not need the previous content, the image starts from an undefined layout
+        PassBuilder &write(Resource resource, Access access, bool discard = false);
+        PassBuilder &write(Resource resource, Access access, uint32_t mipLevel, bool discard);
+        // Keeps the pass even when nothing uses what it writes, for readbacks and work without declared outputs
+        PassBuilder &sideEffects();
+
+    private:
+        friend class RenderGraph;
+
+        PassBuilder(RenderGraph *graph, int pass);
+
+        RenderGraph *const m_graph;
+        const int m_pass;
+    };
+
+    explicit RenderGraph(const VulkanRenderer *vulkanRenderer);
+
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph(RenderGraph &&) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+    RenderGraph &operator=(RenderGraph &&) = delete;
+
+    ~RenderGraph();
+
+    // The content of an imported image is undefined until a pass writes it
+    [[nodiscard]] Resource importImage(const QString &name, VkImage image, VkImageAspectFlags aspectMask, uint32_t mipLevels);
+    // Buffer hazards become global memory barriers, which do not name the buffer
+    [[nodiscard]] Resource importBuffer(const QString &name);
+    // Output synchronized outside of the graph, like the swap chain image of the default render pass
+    [[nodiscard]] Resource importExternal(const QString &name);
+    // Single level image owned by the graph, created by compile()
+    [[nodiscard]] Resource createImage(const QString &name, const ImageDescription &description);
+    // Access the resource is left ready for after every execute(), its writers are never culled
+    void exportResource(Resource resource, Access access);
+    PassBuilder addPass(const QString &name, Record record);
+    // Runs when the graph is cleared or destroyed, for objects only its passes use
+    void deferRelease(std::function<void()> release);
+
+    void compile();
+    void execute(VkCommandBuffer commandBuffer);
+    // Compiles and executes once in a command buffer of its own and waits for it, for uploads
+    void submit(const char *name);
+    // Destroys the transient images and forgets every pass and resource
+    void clear();
+
+    // Valid after compile()
+    [[nodiscard]] VkImage image(Resource resource) const;
+    [[nodiscard]] VkImageView imageView(Resource resource) const;
+
+private:
+    struct Usage
+    {
+        Resource resource;
+        Access access;
+        uint32_t baseMipLevel;
+        // 0 covers every level of the image
+        uint32_t mipLevelCount;
+        bool write;
+        bool discard;
+    };
+
+    struct Pass
+    {
+        QString name;
+        Record record;
+        QVector<Usage> usages;
+        bool sideEffects;
+        bool culled;
+    };
+
+    struct SubresourceState
+    {
+        VkImageLayout layout;
+        VkPipelineStageFlags2KHR writeStages;
+        VkAccessFlags2KHR writeAccesses;
+        // Reads since the last write, a later write has to wait for them
+        VkPipelineStageFlags2KHR readStages;
+        // Stages and accesses the last write is already visible to
+        VkPipelineStageFlags2KHR visibleStages;
+        VkAccessFlags2KHR visibleAccesses;
+    };
+
+    // What the barriers act on: a buffer, an imported image or a transient image shared by one or more resources
+    struct Storage
+    {
+        VkImage image;
+        VkImageView view;
+        ObjectWithAllocation<VkImage> ownedImage;
+        VkImageAspectFlags aspectMask;
+        // One per mip level, buffers have a single one
+        std::vector<SubresourceState> states;
+    };
+
+    struct ResourceEntry
+    {
+        QString name;
+        // -1 for external resources, set by compile() for transient images
+        int storage;
+        bool transient;
+        ImageDescription description;
+        bool exported;
+        Access exportAccess;
+    };
+
+    struct Barriers
+    {
+        VkPipelineStageFlags2KHR memorySrcStages;
+        VkAccessFlags2KHR memorySrcAccesses;
+        VkPipelineStageFlags2KHR memoryDstStages;
+        VkAccessFlags2KHR memoryDstAccesses;
+        std::vector<VkImageMemoryBarrier2KHR> imageBarriers;
+    };
+
+    const VulkanRenderer *const m_vulkanRenderer;
+    std::vector<ResourceEntry> m_resources;
+    std::vector<Storage> m_storages;
+    std::vector<Pass> m_passes;
+    std::vector<std::function<void()>> m_releases;
+    bool m_compiled;
+
+    void addUsage(int pass, Usage usage);
+    void cullPasses();
+    void createTransientImages();
+    void addBarriers(Barriers &barriers, const Usage &usage);
+    void recordBarriers(VkCommandBuffer commandBuffer, Barriers &barriers) const;
+};
+
+#endif // RENDERGRAPH_H
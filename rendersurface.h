@@ -0,0 +1,62 @@
+#ifndef RENDERSURFACE_H
+#define RENDERSURFACE_H
+
+#include <QByteArrayList>
+#include <QSize>
+#include <QVector>
+#include <QVulkanInstance>
+
+// What the renderer needs from its output: the device, a render pass compatible with the framebuffers and the frame loop.
+// Mirrors the part of QVulkanWindow the renderer uses, so the same pipelines render into a window or offscreen.
+class RenderSurface
+{
+public:
+    RenderSurface() = default;
+
+    RenderSurface(const RenderSurface &) = delete;
+    RenderSurface(RenderSurface &&) = delete;
+    RenderSurface &operator=(const RenderSurface &) = delete;
+    RenderSurface &operator=(RenderSurface &&) = delete;
+
+    virtual ~RenderSurface() = default;
+
+    // Only valid in preInitResources
+    [[nodiscard]] virtual QVulkanInfoVector<QVulkanExtension> supportedDeviceExtensions() = 0;
+    // Replaces the extensions requested so far, deviceExtensions() returns them to append to
+    [[nodiscard]] virtual QByteArrayList deviceExtensions() const = 0;
+    virtual void setDeviceExtensions(const QByteArrayList &extensions) = 0;
+    [[nodiscard]] virtual QVector<int> supportedSampleCounts() = 0;
+    virtual void setSampleCount(int sampleCount) = 0;
+    virtual void setPreferredColorFormats(const QVector<VkFormat> &formats) = 0;
+    // Upper bound of concurrentFrameCount()
+    virtual void setMaxConcurrentFrameCount(int count) = 0;
+
+    [[nodiscard]] virtual QVulkanInstance *vulkanInstance() const = 0;
+    [[nodiscard]] virtual VkPhysicalDevice physicalDevice() const = 0;
+    [[nodiscard]] virtual const VkPhysicalDeviceProperties *physicalDeviceProperties() const = 0;
+    [[nodiscard]] virtual VkDevice device() const = 0;
+    [[nodiscard]] virtual VkQueue graphicsQueue() const = 0;
+    [[nodiscard]] virtual uint32_t graphicsQueueFamilyIndex() const = 0;
+    [[nodiscard]] virtual VkCommandPool graphicsCommandPool() const = 0;
+    [[nodiscard]] virtual VkRenderPass defaultRenderPass() const = 0;
+    [[nodiscard]] virtual VkFormat colorFormat() const = 0;
+    [[nodiscard]] virtual VkFormat depthStencilFormat() const = 0;
+    [[nodiscard]] virtual VkSampleCountFlagBits sampleCountFlagBits() const = 0;
+    [[nodiscard]] virtual int concurrentFrameCount() const = 0;
+    // Whether the device was created with the synchronization2 feature, the extension alone is not enough
+    [[nodiscard]] virtual bool synchronization2Enabled() const = 0;
+
+    [[nodiscard]] virtual QSize swapChainImageSize() const = 0;
+    [[nodiscard]] virtual int swapChainImageCount() const = 0;
+    [[nodiscard]] virtual VkImage depthStencilImage() const = 0;
+
+    [[nodiscard]] virtual int currentFrame() const = 0;
+    [[nodiscard]] virtual int currentSwapChainImageIndex() const = 0;
+    [[nodiscard]] virtual VkCommandBuffer currentCommandBuffer() const = 0;
+    [[nodiscard]] virtual VkFramebuffer currentFramebuffer() const = 0;
+    // Seconds of animation time for the frame being recorded
+    [[nodiscard]] virtual float animationTime() const = 0;
+    virtual void frameReady() = 0;
+};
+
+#endif // RENDERSURFACE_H
@@ -0,0 +1,143 @@
+#include "resolutiongovernor.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+constexpr std::array<ResolutionGovernor::Level, 7> levels{{
+    // Same as rendering without the governor
+    {1.0F, 0, 0.2F},
+    {1.0F, 0, 0.0F},
+    {0.85F, 0, 0.0F},
+    {0.75F, 0, 0.0F},
+    {0.75F, 1, 0.0F},
+    {0.6F, 1, 0.0F},
+    {0.5F, 2, 0.0F}
+}};
+
+// Share of a shaded sample which every further sample adds for its depth test, blending and resolve
+constexpr double sampleCost = 0.25;
+// Weight of the latest frame in the moving average
+constexpr double averageWeight = 0.1;
+// A higher level has to fit into this share of the budget
+constexpr double raiseHeadroom = 0.8;
+constexpr int framesToLower = 8;
+constexpr int minFramesToRaise = 90;
+constexpr int maxFramesToRaise = 1440;
+constexpr int cooldownFrames = 30;
+// A raise which held this long was a good one
+constexpr int settleFrames = 600;
+}
+
+ResolutionGovernor::ResolutionGovernor(double budgetMs)
+    : m_budgetMs{budgetMs}
+    , m_averageMs{}
+    , m_level{}
+    , m_maxSampleCount{1}
+    , m_overBudgetFrames{}
+    , m_underBudgetFrames{}
+    , m_cooldownFrames{}
+    , m_raiseFrames{minFramesToRaise}
+    , m_sinceRaise{-1}
+{
+}
+
+int ResolutionGovernor::levelCount()
+{
+    return static_cast<int>(levels.size());
+}
+
+const ResolutionGovernor::Level &ResolutionGovernor::levelAt(int index)
+{
+    return levels.at(index);
+}
+
+const ResolutionGovernor::Level &ResolutionGovernor::level() const
+{
+    return levels.at(m_level);
+}
+
+void ResolutionGovernor::reset(int level, int maxSampleCount)
+{
+    m_level = std::clamp(level, 0, levelCount() - 1);
+    m_maxSampleCount = std::max(1, maxSampleCount);
+    m_averageMs = 0.0;
+    m_overBudgetFrames = 0;
+    m_underBudgetFrames = 0;
+    m_cooldownFrames = 0;
+    m_raiseFrames = minFramesToRaise;
+    m_sinceRaise = -1;
+}
+
+bool ResolutionGovernor::addFrameTime(double gpuMs)
+{
+    if (gpuMs <= 0.0) {
+        return false;
+    }
+    m_averageMs = m_averageMs > 0.0 ? m_averageMs + averageWeight * (gpuMs - m_averageMs) : gpuMs;
+    if (m_sinceRaise >= 0 && ++m_sinceRaise >= settleFrames) {
+        m_sinceRaise = -1;
+        m_raiseFrames = minFramesToRaise;
+    }
+    if (m_cooldownFrames > 0) {
+        --m_cooldownFrames;
+        return false;
+    }
+
+    // The fragment cost of the higher level grows with its pixel, sample and shading counts
+    auto predictedMs = m_averageMs;
+    if (m_level > 0) {
+        predictedMs *= levelCost(m_level - 1) / levelCost(m_level);
+    }
+    if (m_averageMs > m_budgetMs) {
+        ++m_overBudgetFrames;
+        m_underBudgetFrames = 0;
+    } else if (m_level > 0 && predictedMs < raiseHeadroom * m_budgetMs) {
+        ++m_underBudgetFrames;
+        m_overBudgetFrames = 0;
+    } else {
+        m_overBudgetFrames = 0;
+        m_underBudgetFrames = 0;
+    }
+
+    if (m_overBudgetFrames >= framesToLower && m_level + 1 < levelCount()) {
+        if (m_sinceRaise >= 0) {
+            m_raiseFrames = std::min(2 * m_raiseFrames, maxFramesToRaise);
+            m_sinceRaise = -1;
+        }
+        return setLevel(m_level + 1);
+    }
+    if (m_underBudgetFrames >= m_raiseFrames) {
+        m_sinceRaise = 0;
+        return setLevel(m_level - 1);
+    }
+    return false;
+}
+
+double ResolutionGovernor::levelCost(int level) const
+{
+    const auto &candidate = levels.at(level);
+    auto samples = std::max(1, m_maxSampleCount >> candidate.sampleCountShift);
+    // Per sample shading runs the fragment shader for this many samples of every pixel
+    auto shadedSamples = 1.0;
+    if (candidate.minSampleShading > 0.0F) {
+        shadedSamples = std::max(1.0, std::ceil(static_cast<double>(samples) * static_cast<double>(candidate.minSampleShading)));
+    }
+    auto scale = static_cast<double>(candidate.scale);
+    return scale * scale * (shadedSamples + sampleCost * static_cast<double>(samples - 1));
+}
+
+bool ResolutionGovernor::setLevel(int level)
+{
+    qDebug() << "Resolution governor, average GPU time: " << m_averageMs << " ms, budget: " << m_budgetMs
+             << " ms, level: " << m_level << " -> " << level << ", scale: " << levels.at(level).scale;
+    m_level = level;
+    m_averageMs = 0.0;
+    m_overBudgetFrames = 0;
+    m_underBudgetFrames = 0;
+    m_cooldownFrames = cooldownFrames;
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef RESOLUTIONGOVERNOR_H
+#define RESOLUTIONGOVERNOR_H
+
+// Picks the quality level which keeps the GPU frame time within a budget. The levels give up per sample shading
+// and render resolution first and the MSAA sample count last, because changing it rebuilds the pipelines.
+// Lowering reacts within a few frames, raising waits much longer and only happens when the higher level is expected
+// to fit, judged by the pixel, sample and shading counts of both levels, and every raise which had to be taken back doubles the wait for the next one, so the level does not oscillate.
+class ResolutionGovernor
+{
+public:
+    struct Level
+    {
+        // Render size relative to the output size
+        float scale;
+        // Steps down from the highest supported sample count
+        int sampleCountShift;
+        // 0 disables per sample shading
+        float minSampleShading;
+    };
+
+    explicit ResolutionGovernor(double budgetMs);
+
+    // Levels from the highest quality to the cheapest, every one is cheaper than the previous one
+    [[nodiscard]] static int levelCount();
+    [[nodiscard]] static const Level &levelAt(int index);
+
+    // Starts over from the given level, for example the one picked by the startup calibration.
+    // The highest supported sample count is the one the sample count shifts of the levels start from.
+    void reset(int level, int maxSampleCount);
+    // Feeds the GPU time of a finished frame, returns true when the level changed
+    [[nodiscard]] bool addFrameTime(double gpuMs);
+
+    [[nodiscard]] const Level &level() const;
+    [[nodiscard]] int levelIndex() const { return m_level; }
+    [[nodiscard]] double averageMs() const { return m_averageMs; }
+
+private:
+    const double m_budgetMs;
+    double m_averageMs;
+    int m_level;
+    int m_maxSampleCount;
+    int m_overBudgetFrames;
+    int m_underBudgetFrames;
+    // Frames of the previous level are still in flight right after a change
+    int m_cooldownFrames;
+    int m_raiseFrames;
+    // Frames since the last raise, -1 once it held long enough
+    int m_sinceRaise;
+
+    // Estimated GPU cost of a level relative to one shaded sample per output pixel
+    [[nodiscard]] double levelCost(int level) const;
+    [[nodiscard]] bool setLevel(int level);
+};
+
+#endif // RESOLUTIONGOVERNOR_H
@@ -0,0 +1,222 @@
+#include "scenegraph.h"
+
+#include "cpuprofiler.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SCENEGRAPH_SSE2
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+namespace {
+// Nodes per work item, large enough to pay for handing it to a worker
+constexpr int batchSize = 1024;
+static_assert(batchSize % 4 == 0, "batches are split into groups of four nodes");
+
+[[nodiscard]] int batchCount(int itemCount)
+{
+    return (itemCount + batchSize - 1) / batchSize;
+}
+}
+
+SceneGraph::SceneGraph()
+    : m_anyDirty{}
+{
+}
+
+int SceneGraph::addNode(int parent)
+{
+    auto node = nodeCount();
+    auto depth = parent == noParent ? 0 : m_depths[parent] + 1;
+    m_parents.push_back(parent);
+    m_depths.push_back(depth);
+    if (static_cast<int>(m_levels.size()) <= depth) {
+        m_levels.emplace_back();
+    }
+    m_levels[depth].push_back(node);
+
+    m_translationX.push_back(0.0F);
+    m_translationY.push_back(0.0F);
+    m_translationZ.push_back(0.0F);
+    m_rotationX.push_back(0.0F);
+    m_rotationY.push_back(0.0F);
+    m_rotationZ.push_back(0.0F);
+    m_rotationW.push_back(1.0F);
+    m_scales.push_back(1.0F);
+    m_dirty.push_back(1);
+    m_anyDirty = true;
+
+    m_localMatrices.emplace_back(1.0F);
+    m_worldMatrices.emplace_back(1.0F);
+    m_normalMatrices.emplace_back(1.0F);
+    m_worldScales.push_back(1.0F);
+    return node;
+}
+
+void SceneGraph::clear()
+{
+    *this = SceneGraph{};
+}
+
+void SceneGraph::markDirty(int node)
+{
+    m_dirty[node] = 1;
+    m_anyDirty = true;
+}
+
+void SceneGraph::setTranslation(int node, const glm::vec3 &translation)
+{
+    m_translationX[node] = translation.x;
+    m_translationY[node] = translation.y;
+    m_translationZ[node] = translation.z;
+    markDirty(node);
+}
+
+void SceneGraph::setRotation(int node, float angle, const glm::vec3 &axis)
+{
+    auto halfAngle = 0.5F * angle;
+    auto sinHalfAngle = std::sin(halfAngle);
+    m_rotationX[node] = axis.x * sinHalfAngle;
+    m_rotationY[node] = axis.y * sinHalfAngle;
+    m_rotationZ[node] = axis.z * sinHalfAngle;
+    m_rotationW[node] = std::cos(halfAngle);
+    markDirty(node);
+}
+
+void SceneGraph::setScale(int node, float scale)
+{
+    m_scales[node] = scale;
+    markDirty(node);
+}
+
+void SceneGraph::update()
+{
+    PROFILE_ZONE("SceneGraph::update");
+    if (!m_anyDirty) {
+        return;
+    }
+    // Local matrices do not depend on each other
+    auto localBatchCount = batchCount(nodeCount());
+    parallelFor(localBatchCount, idealWorkerCount(localBatchCount), [this](int, int batch) {
+        updateLocalMatrices(batch * batchSize, std::min(nodeCount(), (batch + 1) * batchSize));
+    });
+    // A level only reads the world matrices of the previous one
+    for (const auto &level : m_levels) {
+        auto levelSize = static_cast<int>(level.size());
+        auto levelBatchCount = batchCount(levelSize);
+        parallelFor(levelBatchCount, idealWorkerCount(levelBatchCount), [this, &level, levelSize](int, int batch) {
+            auto end = std::min(levelSize, (batch + 1) * batchSize);
+            for (int i = batch * batchSize; i < end; ++i) {
+                updateWorldMatrix(level[i]);
+            }
+        });
+    }
+    std::fill(m_dirty.begin(), m_dirty.end(), char{});
+    m_anyDirty = false;
+}
+
+void SceneGraph::updateLocalMatrices(int begin, int end)
+{
+    int node = begin;
+#ifdef SCENEGRAPH_SSE2
+    // Rotation and scale of four nodes per lane, transposed into the columns of their matrices
+    const __m128 one = _mm_set1_ps(1.0F);
+    const __m128 two = _mm_set1_ps(2.0F);
+    for (; node + 4 <= end; node += 4) {
+        if ((m_dirty[node] | m_dirty[node + 1] | m_dirty[node + 2] | m_dirty[node + 3]) == 0) {
+            continue;
+        }
+        __m128 x = _mm_loadu_ps(&m_rotationX[node]);
+        __m128 y = _mm_loadu_ps(&m_rotationY[node]);
+        __m128 z = _mm_loadu_ps(&m_rotationZ[node]);
+        __m128 w = _mm_loadu_ps(&m_rotationW[node]);
+        __m128 scale = _mm_loadu_ps(&m_scales[node]);
+        __m128 twoScale = _mm_mul_ps(two, scale);
+        __m128 xx = _mm_mul_ps(x, x);
+        __m128 yy = _mm_mul_ps(y, y);
+        __m128 zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y);
+        __m128 xz = _mm_mul_ps(x, z);
+        __m128 yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x);
+        __m128 wy = _mm_mul_ps(w, y);
+        __m128 wz = _mm_mul_ps(w, z);
+
+        std::array<std::array<__m128, 4>, 4> columns{{
+            {_mm_sub_ps(scale, _mm_mul_ps(twoScale, _mm_add_ps(yy, zz))),
+             _mm_mul_ps(twoScale, _mm_add_ps(xy, wz)),
+             _mm_mul_ps(twoScale, _mm_sub_ps(xz, wy)),
+             _mm_setzero_ps()},
+            {_mm_mul_ps(twoScale, _mm_sub_ps(xy, wz)),
+             _mm_sub_ps(scale, _mm_mul_ps(twoScale, _mm_add_ps(xx, zz))),
+             _mm_mul_ps(twoScale, _mm_add_ps(yz, wx)),
+             _mm_setzero_ps()},
+            {_mm_mul_ps(twoScale, _mm_add_ps(xz, wy)),
+             _mm_mul_ps(twoScale, _mm_sub_ps(yz, wx)),
+             _mm_sub_ps(scale, _mm_mul_ps(twoScale, _mm_add_ps(xx, yy))),
+             _mm_setzero_ps()},
+            {_mm_loadu_ps(&m_translationX[node]),
+             _mm_loadu_ps(&m_translationY[node]),
+             _mm_loadu_ps(&m_translationZ[node]),
+             one}
+        }};
+        for (int column = 0; column < 4; ++column) {
+            auto &lanes = columns[column];
+            _MM_TRANSPOSE4_PS(lanes[0], lanes[1], lanes[2], lanes[3]);
+            for (int lane = 0; lane < 4; ++lane) {
+                _mm_storeu_ps(&m_localMatrices[node + lane][column][0], lanes[lane]);
+            }
+        }
+    }
+#endif
+    for (; node < end; ++node) {
+        if (m_dirty[node] != 0) {
+            updateLocalMatrix(node);
+        }
+    }
+}
+
+void SceneGraph::updateLocalMatrix(int node)
+{
+    auto x = m_rotationX[node];
+    auto y = m_rotationY[node];
+    auto z = m_rotationZ[node];
+    auto w = m_rotationW[node];
+    auto scale = m_scales[node];
+    m_localMatrices[node] = glm::mat4{
+        glm::vec4{1.0F - 2.0F * (y * y + z * z), 2.0F * (x * y + w * z), 2.0F * (x * z - w * y), 0.0F} * scale,
+        glm::vec4{2.0F * (x * y - w * z), 1.0F - 2.0F * (x * x + z * z), 2.0F * (y * z + w * x), 0.0F} * scale,
+        glm::vec4{2.0F * (x * z + w * y), 2.0F * (y * z - w * x), 1.0F - 2.0F * (x * x + y * y), 0.0F} * scale,
+        glm::vec4{m_translationX[node], m_translationY[node], m_translationZ[node], 1.0F}
+    };
+}
+
+void SceneGraph::updateWorldMatrix(int node)
+{
+    auto parentNode = m_parents[node];
+    if (parentNode == noParent) {
+        if (m_dirty[node] == 0) {
+            return;
+        }
+        m_worldMatrices[node] = m_localMatrices[node];
+        m_worldScales[node] = m_scales[node];
+    } else {
+        if (m_dirty[parentNode] != 0) {
+            m_dirty[node] = 1;
+        } else if (m_dirty[node] == 0) {
+            return;
+        }
+        // glm multiplies with SSE as well, GLM_FORCE_INTRINSICS is set in glm.h
+        m_worldMatrices[node] = m_worldMatrices[parentNode] * m_localMatrices[node];
+        m_worldScales[node] = m_worldScales[parentNode] * m_scales[node];
+    }
+    // Rotations and uniform scales only, so the inverse transpose is the matrix divided by the squared scale
+    auto worldScale = m_worldScales[node];
+    auto inverseScale2 = worldScale != 0.0F ? 1.0F / (worldScale * worldScale) : 0.0F;
+    m_normalMatrices[node] = glm::mat3{m_worldMatrices[node]} * inverseScale2;
+}
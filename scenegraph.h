@@ -0,0 +1,68 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include "glm.h"
+
+#include <glm/mat3x3.hpp>
+
+#include <vector>
+
+// Hierarchy of nodes, each with a translation, rotation and uniform scale relative to its parent.
+// The local components are stored as structure of arrays, so the local matrices are composed four nodes at a time
+// with SSE. Parents always precede their children, so update() walks the hierarchy one depth level at a time and
+// splits every level across worker threads, recomputing only the nodes which changed or have a changed ancestor.
+class SceneGraph
+{
+public:
+    static constexpr int noParent = -1;
+
+    SceneGraph();
+
+    [[nodiscard]] int addNode(int parent = noParent);
+    void clear();
+
+    void setTranslation(int node, const glm::vec3 &translation);
+    // Angle in radians around a unit axis
+    void setRotation(int node, float angle, const glm::vec3 &axis);
+    void setScale(int node, float scale);
+
+    // Recomputes the world and normal matrices of the changed nodes and their descendants
+    void update();
+
+    [[nodiscard]] int nodeCount() const { return static_cast<int>(m_parents.size()); }
+    [[nodiscard]] int parent(int node) const { return m_parents[node]; }
+    [[nodiscard]] const glm::mat4 &worldMatrix(int node) const { return m_worldMatrices[node]; }
+    // Inverse transpose of the upper 3x3 of the world matrix, for transforming normals
+    [[nodiscard]] const glm::mat3 &normalMatrix(int node) const { return m_normalMatrices[node]; }
+
+private:
+    std::vector<int> m_parents;
+    std::vector<int> m_depths;
+    // Nodes of every depth in creation order
+    std::vector<std::vector<int>> m_levels;
+
+    std::vector<float> m_translationX;
+    std::vector<float> m_translationY;
+    std::vector<float> m_translationZ;
+    // Unit quaternion, x, y, z - axis part, w - scalar part
+    std::vector<float> m_rotationX;
+    std::vector<float> m_rotationY;
+    std::vector<float> m_rotationZ;
+    std::vector<float> m_rotationW;
+    std::vector<float> m_scales;
+    // Set by the setters, extended to the descendants during update
+    std::vector<char> m_dirty;
+    bool m_anyDirty;
+
+    std::vector<glm::mat4> m_localMatrices;
+    std::vector<glm::mat4> m_worldMatrices;
+    std::vector<glm::mat3> m_normalMatrices;
+    std::vector<float> m_worldScales;
+
+    void markDirty(int node);
+    void updateLocalMatrices(int begin, int end);
+    void updateLocalMatrix(int node);
+    void updateWorldMatrix(int node);
+};
+
+#endif // SCENEGRAPH_H
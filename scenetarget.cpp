@@ -0,0 +1,379 @@
+#include "scenetarget.h"
+
+#include "pipelinebuilder.h"
+#include "vulkanrenderer.h"
+
+#include <QDebug>
+#include <QVulkanDeviceFunctions>
+
+#include <algorithm>
+#include <array>
+
+namespace {
+const QString upscaleVertShaderName = QStringLiteral("upscale.vert");
+const QString upscaleFragShaderName = QStringLiteral("upscale.frag");
+
+struct UpscalePushConstants {
+    glm::vec2 uvScale;
+    glm::vec2 uvMax;
+};
+
+[[nodiscard]] constexpr VkImageAspectFlags depthAspectFlags(VkFormat format)
+{
+    if (format == VkFormat::VK_FORMAT_D32_SFLOAT_S8_UINT || format == VkFormat::VK_FORMAT_D24_UNORM_S8_UINT) {
+        return static_cast<VkImageAspectFlags>(VkImageAspectFlagBits::VK_IMAGE_ASPECT_DEPTH_BIT) | VkImageAspectFlagBits::VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    return VkImageAspectFlagBits::VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+}
+
+SceneTarget::SceneTarget(VulkanRenderer *vulkanRenderer)
+    : m_vulkanRenderer{vulkanRenderer}
+    , m_sampleCount{VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT}
+    , m_renderPass{}
+    , m_colorImage{-1}
+    , m_depthImage{-1}
+    , m_msaaImage{-1}
+    , m_framebuffer{}
+    , m_vertShaderModule{}
+    , m_fragShaderModule{}
+    , m_sampler{}
+    , m_descriptorSetLayout{}
+    , m_pipelineLayout{}
+    , m_descriptorPool{}
+    , m_descriptorSet{}
+    , m_upscalePipeline{}
+{
+}
+
+void SceneTarget::initResources()
+{
+    qDebug() << "Create scene target";
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VkFilter::VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VkFilter::VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VkSamplerMipmapMode::VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VkSamplerAddressMode::VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VkSamplerAddressMode::VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VkSamplerAddressMode::VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0F;
+    samplerInfo.maxLod = 0.0F;
+    VulkanRenderer::checkVkResult(devFuncs->vkCreateSampler(device, &samplerInfo, nullptr, &m_sampler),
+                                  "failed to create scene sampler");
+
+    VkDescriptorSetLayoutBinding samplerBinding{};
+    samplerBinding.binding = 0;
+    samplerBinding.descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerBinding.descriptorCount = 1;
+    samplerBinding.stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &samplerBinding;
+    VulkanRenderer::checkVkResult(devFuncs->vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_descriptorSetLayout),
+                                  "failed to create upscale descriptor set layout");
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(UpscalePushConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VulkanRenderer::checkVkResult(devFuncs->vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout),
+                                  "failed to create upscale pipeline layout");
+
+    // One set, rewritten whenever the images are recreated
+    VkDescriptorPoolSize poolSize{VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+    VulkanRenderer::checkVkResult(devFuncs->vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool),
+                                  "failed to create upscale descriptor pool");
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+    VulkanRenderer::checkVkResult(devFuncs->vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet),
+                                  "failed to allocate upscale descriptor set");
+}
+
+void SceneTarget::describeShaderModules(PipelineBuilder &pipelineBuilder)
+{
+    pipelineBuilder.addShaderModule(upscaleVertShaderName, &m_vertShaderModule);
+    pipelineBuilder.addShaderModule(upscaleFragShaderName, &m_fragShaderModule);
+}
+
+void SceneTarget::declareImages(RenderGraph &graph, VkSampleCountFlagBits sampleCount)
+{
+    auto *surface = m_vulkanRenderer->surface();
+    m_sampleCount = sampleCount;
+    m_size = surface->swapChainImageSize();
+    qDebug() << "Declare scene target images, size: " << m_size << ", samples: " << m_sampleCount;
+    m_renderPass = createRenderPass();
+
+    VkFormat colorFormat = surface->colorFormat();
+    VkFormat depthFormat = surface->depthStencilFormat();
+    m_colorImage = graph.createImage(QStringLiteral("scene color"),
+                                     {m_size, colorFormat, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT,
+                                      static_cast<VkImageUsageFlags>(VkImageUsageFlagBits::VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
+                                      | VkImageUsageFlagBits::VK_IMAGE_USAGE_SAMPLED_BIT,
+                                      VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT});
+    m_depthImage = graph.createImage(QStringLiteral("scene depth"),
+                                     {m_size, depthFormat, m_sampleCount, VkImageUsageFlagBits::VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                                      depthAspectFlags(depthFormat)});
+    m_msaaImage = -1;
+    if (multisample()) {
+        m_msaaImage = graph.createImage(QStringLiteral("scene multisample color"),
+                                        {m_size, colorFormat, m_sampleCount, VkImageUsageFlagBits::VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                         VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT});
+    }
+}
+
+void SceneTarget::addSceneWrites(RenderGraph::PassBuilder &pass) const
+{
+    // The render pass clears or resolves into every attachment, nothing of the previous frame is kept
+    pass.write(m_colorImage, RenderGraph::Access::COLOR_ATTACHMENT_WRITE, true);
+    pass.write(m_depthImage, RenderGraph::Access::DEPTH_ATTACHMENT_WRITE, true);
+    if (multisample()) {
+        pass.write(m_msaaImage, RenderGraph::Access::COLOR_ATTACHMENT_WRITE, true);
+    }
+}
+
+void SceneTarget::addUpscaleReads(RenderGraph::PassBuilder &pass) const
+{
+    pass.read(m_colorImage, RenderGraph::Access::FRAGMENT_SAMPLED);
+}
+
+void SceneTarget::initSwapChainResources(const RenderGraph &graph)
+{
+    createFramebuffer(graph);
+    createDescriptorSet(graph);
+}
+
+VkRenderPass SceneTarget::createRenderPass() const
+{
+    auto *surface = m_vulkanRenderer->surface();
+    std::array<VkAttachmentDescription, 3> attachments{};
+
+    // The frame graph transitions every attachment before and after the render pass, which keeps their layouts
+    VkAttachmentDescription &colorAttachment = attachments[0];
+    colorAttachment.format = surface->colorFormat();
+    colorAttachment.samples = VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = multisample() ? VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_DONT_CARE : VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription &depthAttachment = attachments[1];
+    depthAttachment.format = surface->depthStencilFormat();
+    depthAttachment.samples = m_sampleCount;
+    depthAttachment.loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.stencilStoreOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription &msaaAttachment = attachments[2];
+    msaaAttachment.format = surface->colorFormat();
+    msaaAttachment.samples = m_sampleCount;
+    msaaAttachment.loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+    msaaAttachment.storeOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    msaaAttachment.stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    msaaAttachment.stencilStoreOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    msaaAttachment.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    msaaAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorRef{multisample() ? 2U : 0U, VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference resolveRef{0, VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depthRef{1, VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorRef;
+    subpass.pResolveAttachments = multisample() ? &resolveRef : nullptr;
+    subpass.pDepthStencilAttachment = &depthRef;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = multisample() ? 3 : 2;
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    VkRenderPass renderPass{};
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateRenderPass(m_vulkanRenderer->device(), &renderPassInfo, nullptr, &renderPass),
+                                  "failed to create scene render pass");
+    return renderPass;
+}
+
+void SceneTarget::createFramebuffer(const RenderGraph &graph)
+{
+    std::array attachments{graph.imageView(m_colorImage), graph.imageView(m_depthImage),
+                           multisample() ? graph.imageView(m_msaaImage) : VK_NULL_HANDLE};
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = m_renderPass;
+    framebufferInfo.attachmentCount = multisample() ? 3 : 2;
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = m_size.width();
+    framebufferInfo.height = m_size.height();
+    framebufferInfo.layers = 1;
+    VulkanRenderer::checkVkResult(m_vulkanRenderer->devFuncs()->vkCreateFramebuffer(m_vulkanRenderer->device(), &framebufferInfo, nullptr, &m_framebuffer),
+                                  "failed to create scene framebuffer");
+}
+
+void SceneTarget::createDescriptorSet(const RenderGraph &graph)
+{
+    VkDescriptorImageInfo imageInfo{m_sampler, graph.imageView(m_colorImage), VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_descriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+    m_vulkanRenderer->devFuncs()->vkUpdateDescriptorSets(m_vulkanRenderer->device(), 1, &descriptorWrite, 0, nullptr);
+}
+
+void SceneTarget::describePipelines(PipelineBuilder &pipelineBuilder)
+{
+    qDebug() << "Describe upscale pipeline";
+    auto *surface = m_vulkanRenderer->surface();
+
+    GraphicsPipelineDescription description{};
+
+    description.shaderStages.resize(2);
+
+    VkPipelineShaderStageCreateInfo &vertShaderStageInfo = description.shaderStages[0];
+    vertShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = m_vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo &fragShaderStageInfo = description.shaderStages[1];
+    fragShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = m_fragShaderModule;
+    fragShaderStageInfo.pName = "main";
+
+    description.vertexInputInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    description.inputAssembly.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    description.inputAssembly.topology = VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    description.inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    description.viewport.width = static_cast<float>(m_size.width());
+    description.viewport.height = static_cast<float>(m_size.height());
+    description.viewport.maxDepth = 1.0F;
+    description.scissor = VulkanRenderer::createVkRect2D(m_size);
+    description.viewportState.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+
+    description.rasterizer.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    description.rasterizer.polygonMode = VkPolygonMode::VK_POLYGON_MODE_FILL;
+    description.rasterizer.lineWidth = 1.0F;
+    description.rasterizer.cullMode = VkCullModeFlagBits::VK_CULL_MODE_NONE;
+    description.rasterizer.frontFace = VkFrontFace::VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    description.multisampling.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    description.multisampling.rasterizationSamples = surface->sampleCountFlagBits();
+
+    // The default render pass still has its depth attachment, the upscale neither tests nor writes it
+    description.depthStencil.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    description.depthStencil.depthTestEnable = VK_FALSE;
+    description.depthStencil.depthWriteEnable = VK_FALSE;
+    description.depthStencil.depthCompareOp = VkCompareOp::VK_COMPARE_OP_ALWAYS;
+    description.depthStencil.maxDepthBounds = 1.0F;
+
+    description.colorBlendAttachment.colorWriteMask =
+            VkColorComponentFlags{}
+            | VkColorComponentFlagBits::VK_COLOR_COMPONENT_B_BIT
+            | VkColorComponentFlagBits::VK_COLOR_COMPONENT_G_BIT
+            | VkColorComponentFlagBits::VK_COLOR_COMPONENT_R_BIT
+            | VkColorComponentFlagBits::VK_COLOR_COMPONENT_A_BIT;
+    description.colorBlendAttachment.blendEnable = VK_FALSE;
+    description.colorBlending.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    description.colorBlending.logicOpEnable = VK_FALSE;
+
+    description.layout = m_pipelineLayout;
+    description.renderPass = surface->defaultRenderPass();
+    description.subpass = 0;
+    pipelineBuilder.addGraphicsPipeline(std::move(description), &m_upscalePipeline);
+}
+
+void SceneTarget::recordUpscale(VkCommandBuffer commandBuffer, const QSize &renderSize) const
+{
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    glm::vec2 targetSize{static_cast<float>(m_size.width()), static_cast<float>(m_size.height())};
+    glm::vec2 sceneSize{static_cast<float>(renderSize.width()), static_cast<float>(renderSize.height())};
+    UpscalePushConstants pushConstants{sceneSize / targetSize, (sceneSize - 0.5F) / targetSize};
+
+    devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_upscalePipeline);
+    devFuncs->vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0,
+                                      1, &m_descriptorSet, 0, nullptr);
+    devFuncs->vkCmdPushConstants(commandBuffer, m_pipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT,
+                                 0, sizeof(pushConstants), &pushConstants);
+    devFuncs->vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void SceneTarget::releaseSwapChainResources()
+{
+    if (m_renderPass == VK_NULL_HANDLE) {
+        return;
+    }
+    m_vulkanRenderer->devFuncs()->vkDestroyPipeline(m_vulkanRenderer->device(), m_upscalePipeline, nullptr);
+    m_upscalePipeline = {};
+    releaseImages();
+}
+
+void SceneTarget::releaseImages()
+{
+    // The images belong to the frame graph
+    qDebug() << "Destroy scene target framebuffer";
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    devFuncs->vkDestroyFramebuffer(device, m_framebuffer, nullptr);
+    m_framebuffer = {};
+    m_colorImage = -1;
+    m_depthImage = -1;
+    m_msaaImage = -1;
+    devFuncs->vkDestroyRenderPass(device, m_renderPass, nullptr);
+    m_renderPass = {};
+}
+
+void SceneTarget::releaseResources()
+{
+    if (m_descriptorPool == VK_NULL_HANDLE) {
+        return;
+    }
+    auto *devFuncs = m_vulkanRenderer->devFuncs();
+    VkDevice device = m_vulkanRenderer->device();
+    devFuncs->vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    m_descriptorPool = {};
+    m_descriptorSet = {};
+    devFuncs->vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+    m_pipelineLayout = {};
+    devFuncs->vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+    m_descriptorSetLayout = {};
+    devFuncs->vkDestroySampler(device, m_sampler, nullptr);
+    m_sampler = {};
+    devFuncs->vkDestroyShaderModule(device, m_fragShaderModule, nullptr);
+    m_fragShaderModule = {};
+    devFuncs->vkDestroyShaderModule(device, m_vertShaderModule, nullptr);
+    m_vertShaderModule = {};
+}
@@ -0,0 +1,75 @@
+#ifndef SCENETARGET_H
+#define SCENETARGET_H
+
+#include "rendergraph.h"
+
+#include <QSize>
+#include <QVulkanInstance>
+
+class PipelineBuilder;
+class VulkanRenderer;
+
+// Offscreen color and depth the pipelines draw the scene into with dynamic resolution. The images have the size of
+// the swap chain, the scene covers only the scaled part of them, so changing the scale needs no new resources.
+// The upscale pass samples that part with a bilinear filter into the default render pass. The images are transient
+// images of the frame graph, which also places the barriers between the scene and the upscale.
+// Attachment order matches the default render pass of QVulkanWindow: resolved color, depth stencil, multisample color.
+class SceneTarget
+{
+public:
+    explicit SceneTarget(VulkanRenderer *vulkanRenderer);
+
+    SceneTarget(const SceneTarget &) = delete;
+    SceneTarget(SceneTarget &&) = delete;
+    SceneTarget &operator=(const SceneTarget &) = delete;
+    SceneTarget &operator=(SceneTarget &&) = delete;
+
+    ~SceneTarget() = default;
+
+    void initResources();
+    void describeShaderModules(PipelineBuilder &pipelineBuilder);
+    // Creates the render pass and declares the images, before the frame graph is compiled
+    void declareImages(RenderGraph &graph, VkSampleCountFlagBits sampleCount);
+    void addSceneWrites(RenderGraph::PassBuilder &pass) const;
+    void addUpscaleReads(RenderGraph::PassBuilder &pass) const;
+    // After the frame graph is compiled
+    void initSwapChainResources(const RenderGraph &graph);
+    void describePipelines(PipelineBuilder &pipelineBuilder);
+    // Must be recorded inside the default render pass
+    void recordUpscale(VkCommandBuffer commandBuffer, const QSize &renderSize) const;
+    void releaseSwapChainResources();
+    // Render pass and framebuffer, the upscale pipeline draws into the default render pass and is kept. Followed by
+    // declareImages with another sample count.
+    void releaseImages();
+    void releaseResources();
+
+    [[nodiscard]] VkRenderPass renderPass() const { return m_renderPass; }
+    [[nodiscard]] VkFramebuffer framebuffer() const { return m_framebuffer; }
+    [[nodiscard]] VkSampleCountFlagBits sampleCountFlagBits() const { return m_sampleCount; }
+
+private:
+    VulkanRenderer *const m_vulkanRenderer;
+    VkSampleCountFlagBits m_sampleCount;
+    QSize m_size;
+    VkRenderPass m_renderPass;
+    RenderGraph::Resource m_colorImage;
+    RenderGraph::Resource m_depthImage;
+    RenderGraph::Resource m_msaaImage;
+    VkFramebuffer m_framebuffer;
+
+    VkShaderModule m_vertShaderModule;
+    VkShaderModule m_fragShaderModule;
+    VkSampler m_sampler;
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkPipelineLayout m_pipelineLayout;
+    VkDescriptorPool m_descriptorPool;
+    VkDescriptorSet m_descriptorSet;
+    VkPipeline m_upscalePipeline;
+
+    [[nodiscard]] bool multisample() const { return m_sampleCount > VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT; }
+    [[nodiscard]] VkRenderPass createRenderPass() const;
+    void createFramebuffer(const RenderGraph &graph);
+    void createDescriptorSet(const RenderGraph &graph);
+};
+
+#endif // SCENETARGET_H
@@ -4,6 +4,8 @@
 #include <QSettings>
 #include <QWindow>
 
+#include <algorithm>
+
 namespace {
 enum class PipelineCacheLayoutVersion : int
 {
@@ -18,11 +20,62 @@ const QString mainWindow = QStringLiteral("mainWindow");
 const QString graphics = QStringLiteral("graphics");
 const QString pipelineCache = QStringLiteral("pipelineCache");
 const QString pipelineCacheLayoutVersionName = QStringLiteral("pipelineCacheLayoutVersion");
+const QString pipelineCacheShaderHashName = QStringLiteral("pipelineCacheShaderHash");
+const QString rendering = QStringLiteral("rendering");
+const QString framesInFlight = QStringLiteral("framesInFlight");
+const QString secondaryCommandBuffers = QStringLiteral("secondaryCommandBuffers");
+const QString framePolicy = QStringLiteral("framePolicy");
+const QString fpsCap = QStringLiteral("fpsCap");
+const QString gpuProfiler = QStringLiteral("gpuProfiler");
+const QString traceFile = QStringLiteral("traceFile");
+const QString memoryStatsInterval = QStringLiteral("memoryStatsInterval");
+const QString memoryStatsFile = QStringLiteral("memoryStatsFile");
+const QString modelFile = QStringLiteral("modelFile");
+const QString textureFile = QStringLiteral("textureFile");
+const QString computeMipmaps = QStringLiteral("computeMipmaps");
+const QString unlitDistance = QStringLiteral("unlitDistance");
+const QString instanceCount = QStringLiteral("instanceCount");
+const QString instanceSpacing = QStringLiteral("instanceSpacing");
+const QString gpuCulling = QStringLiteral("gpuCulling");
+const QString occlusionCulling = QStringLiteral("occlusionCulling");
+const QString softwareOcclusion = QStringLiteral("softwareOcclusion");
+const QString depthPrepass = QStringLiteral("depthPrepass");
+const QString dynamicResolution = QStringLiteral("dynamicResolution");
+const QString frameBudgetMs = QStringLiteral("frameBudgetMs");
+const QString qualityLevel = QStringLiteral("qualityLevel");
+const QString calibration = QStringLiteral("calibration");
 constexpr int defaultWidth = 800;
 constexpr int defaultHeight = 600;
 constexpr QSize defaultSize{defaultWidth, defaultHeight};
 constexpr QRect defaultGeometry{QPoint{0, 0}, defaultSize};
 constexpr PipelineCacheLayoutVersion pipelineCacheLayoutVersion = PipelineCacheLayoutVersion::COMPRESS_B64;
+constexpr FramePolicy defaultFramePolicy = FramePolicy::ON_DEMAND;
+constexpr int defaultFpsCap = 30;
+constexpr int defaultFramesInFlight = 2;
+constexpr int maxFramesInFlight = 3;
+constexpr int defaultInstanceCount = 1;
+constexpr float defaultInstanceSpacing = 2.5F;
+// One frame at 60 Hz
+constexpr double defaultFrameBudgetMs = 16.6;
+constexpr double minFrameBudgetMs = 1.0;
+
+[[nodiscard]] FramePolicy parseFramePolicy(const QString &value)
+{
+    if (value == QStringLiteral("continuous")) {
+        return FramePolicy::CONTINUOUS;
+    }
+    if (value == QStringLiteral("vsync")) {
+        return FramePolicy::VSYNC_CAPPED;
+    }
+    if (value == QStringLiteral("ondemand")) {
+        return FramePolicy::ON_DEMAND;
+    }
+    if (value == QStringLiteral("fps")) {
+        return FramePolicy::FPS_CAP;
+    }
+    qDebug() << "Unknown frame policy: " << value;
+    return defaultFramePolicy;
+}
 
 [[nodiscard]] constexpr Qt::WindowStates filterWindowStates(Qt::WindowStates windowStates)
 {
@@ -30,6 +83,61 @@ constexpr PipelineCacheLayoutVersion pipelineCacheLayoutVersion = PipelineCacheL
 }
 }
 
+RenderSettings Settings::defaultRenderSettings()
+{
+    RenderSettings renderSettings{};
+    renderSettings.framesInFlight = defaultFramesInFlight;
+    renderSettings.secondaryCommandBuffers = false;
+    renderSettings.framePolicy = defaultFramePolicy;
+    renderSettings.fpsCap = defaultFpsCap;
+    renderSettings.gpuProfiler = false;
+    renderSettings.memoryStatsInterval = 0;
+    renderSettings.computeMipmaps = true;
+    renderSettings.unlitDistance = 0.0F;
+    renderSettings.instanceCount = defaultInstanceCount;
+    renderSettings.instanceSpacing = defaultInstanceSpacing;
+    renderSettings.gpuCulling = true;
+    renderSettings.occlusionCulling = true;
+    renderSettings.softwareOcclusion = false;
+    renderSettings.depthPrepass = false;
+    renderSettings.dynamicResolution = false;
+    renderSettings.frameBudgetMs = defaultFrameBudgetMs;
+    renderSettings.qualityLevel = -1;
+    return renderSettings;
+}
+
+RenderSettings Settings::loadRenderSettings()
+{
+    QSettings settings{};
+    qDebug() << "Load render settings from: " << settings.fileName();
+    settings.beginGroup(rendering);
+    const auto defaults = defaultRenderSettings();
+    RenderSettings renderSettings{};
+    renderSettings.framesInFlight = std::clamp(settings.value(framesInFlight, defaults.framesInFlight).toInt(), 1, maxFramesInFlight);
+    renderSettings.secondaryCommandBuffers = settings.value(secondaryCommandBuffers, defaults.secondaryCommandBuffers).toBool();
+    renderSettings.framePolicy = settings.contains(framePolicy) ? parseFramePolicy(settings.value(framePolicy).toString()) : defaults.framePolicy;
+    renderSettings.fpsCap = settings.value(fpsCap, defaults.fpsCap).toInt();
+    renderSettings.gpuProfiler = settings.value(gpuProfiler, defaults.gpuProfiler).toBool();
+    renderSettings.traceFile = settings.value(traceFile).toString();
+    renderSettings.memoryStatsInterval = settings.value(memoryStatsInterval, defaults.memoryStatsInterval).toInt();
+    renderSettings.memoryStatsFile = settings.value(memoryStatsFile).toString();
+    renderSettings.modelFile = settings.value(modelFile).toString();
+    renderSettings.textureFile = settings.value(textureFile).toString();
+    renderSettings.computeMipmaps = settings.value(computeMipmaps, defaults.computeMipmaps).toBool();
+    renderSettings.unlitDistance = std::max(0.0F, settings.value(unlitDistance, defaults.unlitDistance).toFloat());
+    renderSettings.instanceCount = std::max(1, settings.value(instanceCount, defaults.instanceCount).toInt());
+    renderSettings.instanceSpacing = settings.value(instanceSpacing, defaults.instanceSpacing).toFloat();
+    renderSettings.gpuCulling = settings.value(gpuCulling, defaults.gpuCulling).toBool();
+    renderSettings.occlusionCulling = settings.value(occlusionCulling, defaults.occlusionCulling).toBool();
+    renderSettings.softwareOcclusion = settings.value(softwareOcclusion, defaults.softwareOcclusion).toBool();
+    renderSettings.depthPrepass = settings.value(depthPrepass, defaults.depthPrepass).toBool();
+    renderSettings.dynamicResolution = settings.value(dynamicResolution, defaults.dynamicResolution).toBool();
+    renderSettings.frameBudgetMs = std::max(minFrameBudgetMs, settings.value(frameBudgetMs, defaults.frameBudgetMs).toDouble());
+    renderSettings.qualityLevel = settings.value(qualityLevel, defaults.qualityLevel).toInt();
+    settings.endGroup();
+    return renderSettings;
+}
+
 void Settings::saveSettings(const QWindow &w)
 {
     QSettings settings{};
@@ -52,7 +160,7 @@ void Settings::loadSettings(QWindow &w)
     settings.endGroup();
 }
 
-void Settings::savePipelineCache(const QByteArray &cache)
+void Settings::savePipelineCache(const QByteArray &cache, uint64_t shaderHash)
 {
     QSettings settings{};
     settings.beginGroup(graphics);
@@ -65,15 +173,21 @@ void Settings::savePipelineCache(const QByteArray &cache)
     }
     settings.setValue(pipelineCache, convertedCache);
     settings.setValue(pipelineCacheLayoutVersionName, static_cast<int>(pipelineCacheLayoutVersion));
+    settings.setValue(pipelineCacheShaderHashName, static_cast<qulonglong>(shaderHash));
     settings.endGroup();
     qDebug() << "Save pipeline cache to: " << settings.fileName();
 }
 
-QByteArray Settings::loadPipelineCache()
+QByteArray Settings::loadPipelineCache(uint64_t shaderHash)
 {
     QSettings settings{};
     qDebug() << "Load pipeline cache from: " << settings.fileName();
     settings.beginGroup(graphics);
+    if (settings.value(pipelineCacheShaderHashName).toULongLong() != shaderHash) {
+        qDebug() << "Stored pipeline cache was built for other shaders";
+        settings.endGroup();
+        return {};
+    }
     auto result = settings.value(pipelineCache).toByteArray();
     auto version = static_cast<PipelineCacheLayoutVersion>(settings.value(pipelineCacheLayoutVersionName).toInt());
     switch (version) {
@@ -101,3 +215,33 @@ QByteArray Settings::loadPipelineCache()
     settings.endGroup();
     return result;
 }
+
+void Settings::saveQualityLevel(const QString &deviceKey, double frameBudgetMs, int qualityLevel)
+{
+    QSettings settings{};
+    settings.beginGroup(calibration);
+    settings.beginGroup(deviceKey);
+    settings.setValue(::frameBudgetMs, frameBudgetMs);
+    settings.setValue(::qualityLevel, qualityLevel);
+    settings.endGroup();
+    settings.endGroup();
+    qDebug() << "Save quality level of device: " << deviceKey << " to: " << settings.fileName();
+}
+
+int Settings::loadQualityLevel(const QString &deviceKey, double frameBudgetMs)
+{
+    QSettings settings{};
+    settings.beginGroup(calibration);
+    settings.beginGroup(deviceKey);
+    auto result = -1;
+    if (!settings.contains(::qualityLevel)) {
+        qDebug() << "Device was not calibrated: " << deviceKey;
+    } else if (!qFuzzyCompare(settings.value(::frameBudgetMs).toDouble(), frameBudgetMs)) {
+        qDebug() << "Device was calibrated for another frame budget: " << deviceKey;
+    } else {
+        result = settings.value(::qualityLevel).toInt();
+    }
+    settings.endGroup();
+    settings.endGroup();
+    return result;
+}
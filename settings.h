@@ -1,16 +1,76 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <QString>
+
+#include <cstdint>
+
 class QWindow;
 class QByteArray;
 
+enum class FramePolicy : int
+{
+    // Renders back to back, whether something changed or not
+    CONTINUOUS = 0,
+    // Renders changes at most at the screen refresh rate
+    VSYNC_CAPPED = 1,
+    // Renders changes as soon as the window asks for an update
+    ON_DEMAND = 2,
+    // Renders changes at most at fpsCap frames per second
+    FPS_CAP = 3
+};
+
+struct RenderSettings
+{
+    // Frames the CPU may record ahead of the GPU, fewer lower the latency, more keep the GPU busy
+    int framesInFlight;
+    bool secondaryCommandBuffers;
+    FramePolicy framePolicy;
+    int fpsCap;
+    bool gpuProfiler;
+    QString traceFile;
+    int memoryStatsInterval;
+    QString memoryStatsFile;
+    // OBJ file drawn by the tex pipeline instead of the bundled viking room when not empty
+    QString modelFile;
+    // Image used by the tex pipeline instead of the bundled texture when not empty
+    QString textureFile;
+    // Build the mip chain of runtime textures in one compute dispatch, a chain of blits otherwise
+    bool computeMipmaps;
+    // The tex pipeline drops lighting when the camera is farther than this from the model, never when 0
+    float unlitDistance;
+    // Copies of the model drawn by the tex pipeline, laid out on a grid
+    int instanceCount;
+    float instanceSpacing;
+    // Frustum cull the copies in a compute pass and draw the survivors indirectly
+    bool gpuCulling;
+    // With GPU culling, also cull the copies hidden behind the ones visible in the previous frame
+    bool occlusionCulling;
+    // Without GPU culling, cull the copies on the CPU against a software rasterized depth buffer of the nearest ones
+    bool softwareOcclusion;
+    // Lay down the depth of the tex pipeline first, so its expensive fragments are only shaded once per sample
+    bool depthPrepass;
+    // Render the scene offscreen at a resolution, sample count and sample shading chosen to keep the GPU time
+    // of a frame within frameBudgetMs, then upscale it into the swap chain image
+    bool dynamicResolution;
+    double frameBudgetMs;
+    // Quality level of the resolution governor the renderer starts with, the calibrated one of the device when negative
+    int qualityLevel;
+};
+
 class Settings
 {
 public:
+    // What loadRenderSettings returns for a user who never changed a setting
+    [[nodiscard]] static RenderSettings defaultRenderSettings();
+    [[nodiscard]] static RenderSettings loadRenderSettings();
     static void saveSettings(const QWindow &w);
     static void loadSettings(QWindow &w);
-    static void savePipelineCache(const QByteArray &cache);
-    [[nodiscard]] static QByteArray loadPipelineCache();
+    static void savePipelineCache(const QByteArray &cache, uint64_t shaderHash);
+    [[nodiscard]] static QByteArray loadPipelineCache(uint64_t shaderHash);
+    // Calibration results per device and driver, a result measured for another frame budget does not count
+    static void saveQualityLevel(const QString &deviceKey, double frameBudgetMs, int qualityLevel);
+    [[nodiscard]] static int loadQualityLevel(const QString &deviceKey, double frameBudgetMs);
 };
 
 #endif // SETTINGS_H
@@ -0,0 +1,25 @@
+#include "shaderregistry.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include <QDebug>
+#include <QLatin1String>
+#include <QString>
+
+const EmbeddedShader &ShaderRegistry::shader(const QString &name)
+{
+    const auto *iShader = std::find_if(begin(), end(), [&name](const EmbeddedShader &shader) { return name == QLatin1String{shader.name}; });
+    if (iShader == end()) {
+        qDebug() << "shader not found: " << name;
+        throw std::runtime_error{"shader not found"};
+    }
+    return *iShader;
+}
+
+uint64_t ShaderRegistry::combinedHash()
+{
+    // combiner taken from N3876 / boost::hash_combine
+    return std::accumulate(begin(), end(), uint64_t{}, [](uint64_t s, const EmbeddedShader &shader) { return s ^ (shader.hash + 0x9e3779b97f4a7c15ULL + (s << 6U) + (s >> 2U)); });
+}
@@ -0,0 +1,28 @@
+#ifndef SHADERREGISTRY_H
+#define SHADERREGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+
+class QString;
+
+struct EmbeddedShader
+{
+    const char *name;
+    const uint32_t *code;
+    std::size_t size;
+    uint64_t hash;
+};
+
+class ShaderRegistry
+{
+public:
+    [[nodiscard]] static const EmbeddedShader &shader(const QString &name);
+    [[nodiscard]] static uint64_t combinedHash();
+
+    // Defined in the embeddedshaders.cpp generated at build time
+    [[nodiscard]] static const EmbeddedShader *begin();
+    [[nodiscard]] static const EmbeddedShader *end();
+};
+
+#endif // SHADERREGISTRY_H
@@ -1,9 +1,11 @@
 #version 450
 
+layout(constant_id = 0) const bool useVertexColor = true;
+
 layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    outColor = vec4(useVertexColor ? fragColor : vec3(1.0), 1.0);
 }
@@ -0,0 +1,26 @@
+#version 450
+
+// Depth prepass of tex.vert, the position has to be computed exactly like there
+// for the main pass to pass its equal depth test
+
+layout(binding = 0) uniform VertBindingLayout {
+    mat4 model;
+    mat4 projView;
+    mat3 modelInvTrans;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 3) in vec4 inInstanceRotation;
+layout(location = 4) in vec4 inInstancePositionScale;
+
+invariant gl_Position;
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() {
+    vec3 instancePosition = rotate(inInstanceRotation, inPosition) * inInstancePositionScale.w + inInstancePositionScale.xyz;
+    vec4 mpos = ubo.model * vec4(instancePosition, 1.0);
+    gl_Position = ubo.projView * mpos;
+}
@@ -1,5 +1,8 @@
 #version 450
 
+layout(constant_id = 0) const bool enableLighting = true;
+layout(constant_id = 1) const bool enableTexturing = true;
+
 layout(binding = 1) uniform sampler2D texSampler;
 layout(binding = 2) uniform FragBindingLayout {
     vec3 ambientColor;
@@ -14,8 +17,13 @@ layout(location = 2) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 
 void main() {
+    vec3 albedo = enableTexturing ? texture(texSampler, fragTexCoord).rgb : vec3(0.8);
+    if (!enableLighting) {
+        outColor = vec4(albedo, 1.0);
+        return;
+    }
     vec3 lightDir = normalize(ubo.diffuseLightPos - fragPosition);
     float diff = max(dot(normalize(fragNormal), lightDir), 0.0);
     vec3 diffuse = diff * ubo.diffuseLightColor;
-    outColor = vec4((diffuse + ubo.ambientColor) * texture(texSampler, fragTexCoord).rgb, 1.0);
+    outColor = vec4((diffuse + ubo.ambientColor) * albedo, 1.0);
 }
@@ -9,15 +9,26 @@ layout(binding = 0) uniform VertBindingLayout {
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec4 inInstanceRotation;
+layout(location = 4) in vec4 inInstancePositionScale;
 
 layout(location = 0) out vec3 fragPosition;
 layout(location = 1) out vec3 fragNormal;
 layout(location = 2) out vec2 fragTexCoord;
 
+// Matches depth.vert bit for bit, the depth prepass relies on it
+invariant gl_Position;
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
 void main() {
-    vec4 mpos = ubo.model * vec4(inPosition, 1.0);
+    vec3 instancePosition = rotate(inInstanceRotation, inPosition) * inInstancePositionScale.w + inInstancePositionScale.xyz;
+    vec4 mpos = ubo.model * vec4(instancePosition, 1.0);
     gl_Position = ubo.projView * mpos;
     fragPosition = mpos.xyz;
-    fragNormal = ubo.modelInvTrans * inNormal;
+    // Uniform scale keeps normals perpendicular, so the rotation is enough
+    fragNormal = ubo.modelInvTrans * rotate(inInstanceRotation, inNormal);
     fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,19 @@
+#version 450
+
+// The scene covers only the top left part of its image, uvScale maps the output onto it
+// and uvMax keeps the bilinear filter from reading the texels outside of it
+
+layout(binding = 0) uniform sampler2D sceneSampler;
+
+layout(push_constant) uniform UpscaleInfo {
+    vec2 uvScale;
+    vec2 uvMax;
+} upscaleInfo;
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(sceneSampler, min(fragTexCoord * upscaleInfo.uvScale, upscaleInfo.uvMax));
+}
@@ -0,0 +1,69 @@
+#include "syntheticmodel.h"
+
+#include <QFile>
+#include <QImage>
+#include <QRandomGenerator>
+#include <QTextStream>
+
+#include <cmath>
+#include <stdexcept>
+
+void writeSyntheticObj(const QString &fileName, int gridSize)
+{
+    QFile file{fileName};
+    if (!file.open(QFile::OpenModeFlag::WriteOnly | QFile::OpenModeFlag::Truncate)) {
+        throw std::runtime_error{"can not write synthetic model"};
+    }
+    QTextStream out{&file};
+    auto side = gridSize + 1;
+    auto step = 1.0F / static_cast<float>(gridSize);
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            auto u = static_cast<float>(x) * step;
+            auto v = static_cast<float>(y) * step;
+            auto z = 0.05F * std::sin(u * 20.0F) * std::cos(v * 20.0F);
+            out << "v " << u << ' ' << v << ' ' << z << '\n';
+        }
+    }
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            auto u = static_cast<float>(x) * step;
+            auto v = static_cast<float>(y) * step;
+            out << "vn " << -std::cos(u * 20.0F) << ' ' << std::sin(v * 20.0F) << ' ' << 1.0F << '\n';
+            out << "vt " << u << ' ' << v << '\n';
+        }
+    }
+    // OBJ indices are one based, every corner uses the same index for position, texture coordinate and normal
+    for (int y = 0; y < gridSize; ++y) {
+        for (int x = 0; x < gridSize; ++x) {
+            auto i0 = y * side + x + 1;
+            auto i1 = i0 + 1;
+            auto i2 = i0 + side;
+            auto i3 = i2 + 1;
+            out << "f " << i0 << '/' << i0 << '/' << i0 << ' ' << i1 << '/' << i1 << '/' << i1 << ' ' << i3 << '/' << i3 << '/' << i3 << '\n';
+            out << "f " << i0 << '/' << i0 << '/' << i0 << ' ' << i3 << '/' << i3 << '/' << i3 << ' ' << i2 << '/' << i2 << '/' << i2 << '\n';
+        }
+    }
+    out.flush();
+    if (out.status() != QTextStream::Status::Ok) {
+        throw std::runtime_error{"can not write synthetic model"};
+    }
+}
+
+void writeSyntheticTexture(const QString &fileName, int size)
+{
+    QImage image{size, size, QImage::Format::Format_ARGB32};
+    // Fixed seed, so every run uploads the same texels
+    QRandomGenerator random{1};
+    for (int y = 0; y < size; ++y) {
+        auto *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < size; ++x) {
+            auto checker = ((x / 64 + y / 64) % 2) * 96;
+            auto noise = static_cast<int>(random.bounded(160U));
+            line[x] = qRgba(checker + noise / 2, noise, 255 - checker - noise / 2, 255);
+        }
+    }
+    if (!image.save(fileName, "PNG")) {
+        throw std::runtime_error{"can not write synthetic texture"};
+    }
+}
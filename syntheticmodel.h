@@ -0,0 +1,12 @@
+#ifndef SYNTHETICMODEL_H
+#define SYNTHETICMODEL_H
+
+#include <QString>
+
+// Writes a wavy grid of gridSize x gridSize quads as a Wavefront OBJ with positions, normals and texture coordinates.
+// Neighbouring faces share their corners, so the result exercises vertex deduplication like a real mesh.
+void writeSyntheticObj(const QString &fileName, int gridSize);
+// Writes a size x size PNG of value noise over a checker pattern, so every mip level has detail left to average
+void writeSyntheticTexture(const QString &fileName, int size);
+
+#endif // SYNTHETICMODEL_H
@@ -1,21 +1,28 @@
 #include "texpipeline.h"
 
+#include "cpuprofiler.h"
+#include "jobsystem.h"
 #include "externals/scope_guard/scope_guard.hpp"
 #include "vulkanrenderer.h"
 #include "utils.h"
 #include "texvertex.h"
 #include "model.h"
+#include "cookedasset.h"
+#include "assetpack.h"
 
 #include <QVulkanDeviceFunctions>
-#include <QImage>
-#include <QColorSpace>
+
+#include <cmath>
+#include <exception>
+#include <utility>
 
 namespace {
-const QString texVertShaderName = QStringLiteral(":/shaders/tex.vert.spv");
-const QString texFragShaderName = QStringLiteral(":/shaders/tex.frag.spv");
-const QString modelDirName = QStringLiteral(":/models");
-const QString modelName = QStringLiteral("viking_room.obj");
-const QString textureName = QStringLiteral(":/textures/viking_room.png");
+const QString texVertShaderName = QStringLiteral("tex.vert");
+const QString texFragShaderName = QStringLiteral("tex.frag");
+const QString depthVertShaderName = QStringLiteral("depth.vert");
+// Cooked and packed at build time by vktutor2_cook
+const QString modelName = QStringLiteral("models/viking_room.mesh");
+const QString textureName = QStringLiteral("textures/viking_room.tex");
 
 struct VertBindingObject {
     alignas(16) glm::mat4 model;
@@ -30,15 +37,49 @@ struct FragBindingObject {
 };
 
 constexpr VkFormat textureFormat = VkFormat::VK_FORMAT_R8G8B8A8_SRGB;
+
+// Specialization constants of tex.frag: 0 - enableLighting, 1 - enableTexturing
+constexpr uint32_t texVariantConstantCount = 2;
+// Not passed to the shaders, selects the equal depth test against the depth prepass
+constexpr uint32_t depthEqualConstant = 2;
+// Not passed to the shaders either, minSampleShading in percent, 0 shades once per pixel
+constexpr uint32_t minSampleShadingConstant = 3;
+constexpr PipelineVariantKey litVariant{{VK_TRUE, VK_TRUE, VK_FALSE}};
+constexpr PipelineVariantKey unlitVariant{{VK_FALSE, VK_TRUE, VK_FALSE}};
+constexpr PipelineVariantKey litDepthEqualVariant{{VK_TRUE, VK_TRUE, VK_TRUE}};
+constexpr PipelineVariantKey unlitDepthEqualVariant{{VK_FALSE, VK_TRUE, VK_TRUE}};
+
+[[nodiscard]] PipelineVariantKey withSampleShading(PipelineVariantKey key, float minSampleShading)
+{
+    key.constants[minSampleShadingConstant] = static_cast<uint32_t>(std::lround(minSampleShading * 100.0F));
+    return key;
+}
+
+// Golden angle, so neighbouring copies never face the same way
+constexpr float instanceTurn = 2.39996323F;
 }
 
 TexPipeline::TexPipeline(VulkanRenderer *vulkanRenderer)
     : AbstractPipeline{vulkanRenderer}
     , m_vertexBuffer{}
     , m_indexBuffer{}
-    , m_graphicsPipelineWithLayout{}
+    , m_occluderVertices{}
+    , m_occluderIndices{}
+    , m_occluderVertexBuffer{}
+    , m_occluderIndexBuffer{}
+    , m_modelNode{}
+    , m_boundingSphere{}
+    , m_instanceBuffer{vulkanRenderer}
+    , m_instanceCuller{vulkanRenderer, &m_instanceBuffer}
+    , m_cpuInstanceCuller{vulkanRenderer, &m_instanceBuffer}
+    , m_pipelineVariants{vulkanRenderer, [this](const PipelineVariantKey &key) { return createGraphicsPipelineDescription(key); }}
+    , m_drawVariant{litVariant}
+    , m_depthPrepassPipeline{}
+    , m_occluderPipeline{}
     , m_shaderModules{}
+    , m_depthShaderModule{}
     , m_descriptorSetLayout{}
+    , m_decodedTexture{}
     , m_textureImage{}
     , m_textureImageView{}
     , m_textureSampler{}
@@ -48,46 +89,127 @@ TexPipeline::TexPipeline(VulkanRenderer *vulkanRenderer)
 
 void TexPipeline::preInitResources()
 {
-    loadModel();
+    m_modelNode = vulkanRenderer()->sceneGraph().addNode();
+    // The texture decodes on a worker while this thread parses the model
+    auto &jobSystem = JobSystem::instance();
+    JobCounter textureCounter{};
+    jobSystem.submit(textureCounter, [this]{
+        PROFILE_ZONE("TexPipeline::decodeTexture");
+        m_decodedTexture = loadTexture();
+    });
+    std::exception_ptr modelError{};
+    try {
+        loadModel();
+    } catch (...) {
+        modelError = std::current_exception();
+    }
+    jobSystem.wait(textureCounter);
+    if (modelError) {
+        std::rethrow_exception(modelError);
+    }
+    createInstances();
 }
 
 void TexPipeline::initResources()
 {
     m_vertexBuffer = vulkanRenderer()->createVertexBuffer(m_vertices);
     m_indexBuffer = vulkanRenderer()->createIndexBuffer(m_indices);
-    m_shaderModules = vulkanRenderer()->createShaderModules(texVertShaderName, texFragShaderName);
+    // Without a proxy nothing is drawn into the occluder depth and nothing counts as occluded
+    if (gpuCulling() && !m_occluderIndices.isEmpty()) {
+        m_occluderVertexBuffer = vulkanRenderer()->createVertexBuffer(m_occluderVertices);
+        m_occluderIndexBuffer = vulkanRenderer()->createIndexBuffer(m_occluderIndices);
+    }
     m_descriptorSetLayout = createDescriptorSetLayout();
     createTextureImage();
     createTextureImageView();
     createTextureSampler();
+    if (gpuCulling()) {
+        m_instanceCuller.initResources();
+    }
+}
+
+void TexPipeline::describeShaderModules(PipelineBuilder &pipelineBuilder)
+{
+    pipelineBuilder.addShaderModules(texVertShaderName, texFragShaderName, &m_shaderModules);
+    pipelineBuilder.addShaderModule(depthVertShaderName, &m_depthShaderModule);
 }
 
 void TexPipeline::initSwapChainResources()
 {
     createVertUniformBuffers();
     createFragUniformBuffers();
+    m_instanceBuffer.create(vulkanRenderer()->surface()->concurrentFrameCount());
+    if (gpuCulling()) {
+        m_instanceCuller.initSwapChainResources(m_indices.size(), m_occluderIndices.size());
+    } else if (cpuCulling()) {
+        m_cpuInstanceCuller.initSwapChainResources();
+    }
     createDescriptorSets(m_descriptorSets);
-    m_graphicsPipelineWithLayout = createGraphicsPipeline();
+    m_pipelineVariants.setLayout(createPipelineLayout());
+}
+
+void TexPipeline::describePipelines(PipelineBuilder &pipelineBuilder)
+{
+    describeScenePipelines(pipelineBuilder);
+    // Drawn into the occluder depth pass of the culler, which does not depend on the scene
+    if (gpuCulling() && m_instanceCuller.occlusionEnabled()) {
+        pipelineBuilder.addGraphicsPipeline(createOccluderPipelineDescription(), &m_occluderPipeline);
+    }
+}
+
+void TexPipeline::describeScenePipelines(PipelineBuilder &pipelineBuilder)
+{
+    // Both depth modes, the prepass can be switched at any frame
+    QVector<PipelineVariantKey> variants{};
+    for (auto minSampleShading : vulkanRenderer()->minSampleShadings()) {
+        for (const auto &variant : {litVariant, unlitVariant, litDepthEqualVariant, unlitDepthEqualVariant}) {
+            variants << withSampleShading(variant, minSampleShading);
+        }
+    }
+    m_pipelineVariants.describe(pipelineBuilder, variants);
+    pipelineBuilder.addGraphicsPipeline(createDepthPrepassPipelineDescription(), &m_depthPrepassPipeline);
+}
+
+void TexPipeline::releaseScenePipelines()
+{
+    vulkanRenderer()->devFuncs()->vkDestroyPipeline(vulkanRenderer()->device(), m_depthPrepassPipeline, nullptr);
+    m_depthPrepassPipeline = {};
+    m_pipelineVariants.destroyPipelines();
 }
 
-DescriptorPoolSizes TexPipeline::descriptorPoolSizes(int swapChainImageCount) const
+DescriptorPoolSizes TexPipeline::descriptorPoolSizes(int frameCount) const
 {
-    return {
+    DescriptorPoolSizes poolSizes{
         {
-            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * swapChainImageCount),
-            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, swapChainImageCount)
+            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * frameCount),
+            std::make_pair(VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frameCount)
         },
-        static_cast<uint32_t>(swapChainImageCount)
+        static_cast<uint32_t>(frameCount)
     };
+    if (gpuCulling()) {
+        auto cullerPoolSizes = m_instanceCuller.descriptorPoolSizes(frameCount);
+        for (auto iPoolSize = cullerPoolSizes.poolSize.cbegin(); iPoolSize != cullerPoolSizes.poolSize.cend(); ++iPoolSize) {
+            poolSizes.poolSize[iPoolSize.key()] += iPoolSize.value();
+        }
+        poolSizes.maxSets += cullerPoolSizes.maxSets;
+    }
+    return poolSizes;
+}
+
+void TexPipeline::updateScene(float time)
+{
+    vulkanRenderer()->sceneGraph().setRotation(m_modelNode, time * glm::radians(16.0F), glm::vec3{0.0F, 0.0F, 1.0F});
 }
 
-void TexPipeline::updateUniformBuffers(float time, int currentSwapChainImageIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView) const
+void TexPipeline::updateUniformBuffers(float time, int currentFrameIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView)
 {
     auto *devFuncs = vulkanRenderer()->devFuncs();
     VkDevice device = vulkanRenderer()->device();
     VmaAllocator allocator = vulkanRenderer()->allocator();
+    // Before the culler, which has to see the buffer the update may have reallocated
+    m_instanceBuffer.update(currentFrameIndex);
     {
-        VmaAllocation vertUniformBufferAllocation = m_vertUniformBuffers.at(currentSwapChainImageIndex).allocation;
+        VmaAllocation vertUniformBufferAllocation = m_vertUniformBuffers.at(currentFrameIndex).allocation;
 
         VertBindingObject *vertUbo{};
 
@@ -95,14 +217,26 @@ void TexPipeline::updateUniformBuffers(float time, int currentSwapChainImageInde
                                       "failed to map uniform buffer object memory");
         auto mapGuard = sg::make_scope_guard([&]{ vmaUnmapMemory(allocator, vertUniformBufferAllocation); });
 
-        vertUbo->model = glm::rotate(glm::mat4{1.0F}, time * glm::radians(16.0F), glm::vec3{0.0F, 0.0F, 1.0F});
+        const auto &sceneGraph = vulkanRenderer()->sceneGraph();
+        vertUbo->model = sceneGraph.worldMatrix(m_modelNode);
 
-        vertUbo->modelInvTrans = glm::transpose(glm::inverse(glm::mat3(vertUbo->model)));
+        vertUbo->modelInvTrans = sceneGraph.normalMatrix(m_modelNode);
 
         vertUbo->projView = projView;
+
+        glm::vec3 eye{glm::inverse(view)[3]};
+        glm::vec3 modelCenter{vertUbo->model[3]};
+        auto unlitDistance = vulkanRenderer()->renderSettings().unlitDistance;
+        m_drawVariant = unlitDistance > 0.0F && glm::distance(eye, modelCenter) > unlitDistance ? unlitVariant : litVariant;
+
+        if (gpuCulling()) {
+            m_instanceCuller.updateUniformBuffers(currentFrameIndex, vertUbo->model, projView, m_boundingSphere);
+        } else if (cpuCulling()) {
+            m_cpuInstanceCuller.update(currentFrameIndex, vertUbo->model, projView);
+        }
     }
     {
-        VmaAllocation fragUniformBufferAllocation = m_fragUniformBuffers.at(currentSwapChainImageIndex).allocation;
+        VmaAllocation fragUniformBufferAllocation = m_fragUniformBuffers.at(currentFrameIndex).allocation;
 
         FragBindingObject *fragUbo{};
 
@@ -118,25 +252,92 @@ void TexPipeline::updateUniformBuffers(float time, int currentSwapChainImageInde
     }
 }
 
-void TexPipeline::drawCommands(VkCommandBuffer commandBuffer, int currentSwapChainImageIndex) const
+void TexPipeline::addPasses(RenderGraph &graph)
+{
+    if (gpuCulling()) {
+        m_instanceCuller.addPasses(graph, [this](VkCommandBuffer commandBuffer, int currentFrameIndex, VkBuffer instanceBuffer, VkBuffer drawCommandBuffer) {
+            drawOccluders(commandBuffer, currentFrameIndex, instanceBuffer, drawCommandBuffer);
+        });
+    }
+}
+
+void TexPipeline::addSceneReads(RenderGraph::PassBuilder &scenePass) const
+{
+    if (gpuCulling()) {
+        m_instanceCuller.addDrawReads(scenePass);
+    }
+}
+
+// The proxy instead of the mesh, so the full mesh is only rasterized by the main pass
+void TexPipeline::drawOccluders(VkCommandBuffer commandBuffer, int currentFrameIndex, VkBuffer instanceBuffer, VkBuffer drawCommandBuffer) const
+{
+    if (m_occluderIndexBuffer.object == VK_NULL_HANDLE) {
+        return;
+    }
+    auto *devFuncs = vulkanRenderer()->devFuncs();
+    devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_occluderPipeline);
+
+    std::array vertexBuffers{m_occluderVertexBuffer.object, instanceBuffer};
+    std::array offsets{static_cast<VkDeviceSize>(0), static_cast<VkDeviceSize>(0)};
+    devFuncs->vkCmdBindVertexBuffers(commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), offsets.data());
+
+    devFuncs->vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineVariants.layout(), 0,
+                                        1, &m_descriptorSets.at(currentFrameIndex), 0, nullptr);
+    devFuncs->vkCmdBindIndexBuffer(commandBuffer, m_occluderIndexBuffer.object, 0, VkIndexType::VK_INDEX_TYPE_UINT32);
+    devFuncs->vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void TexPipeline::drawCommands(VkCommandBuffer commandBuffer, int currentFrameIndex) const
 {
     auto *devFuncs = vulkanRenderer()->devFuncs();
-    devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipelineWithLayout.pipeline);
 
-    std::array vertexBuffers{m_vertexBuffer.object};
-    std::array offsets{static_cast<VkDeviceSize>(0)};
+    VkBuffer instanceBuffer = m_instanceBuffer.buffer(currentFrameIndex);
+    if (gpuCulling()) {
+        instanceBuffer = m_instanceCuller.visibleInstanceBuffer(currentFrameIndex);
+    } else if (cpuCulling()) {
+        instanceBuffer = m_cpuInstanceCuller.visibleInstanceBuffer(currentFrameIndex);
+    }
+    std::array vertexBuffers{m_vertexBuffer.object, instanceBuffer};
+    std::array offsets{static_cast<VkDeviceSize>(0), static_cast<VkDeviceSize>(0)};
     devFuncs->vkCmdBindVertexBuffers(commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), offsets.data());
 
-    devFuncs->vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipelineWithLayout.layout, 0,
-                                        1, &m_descriptorSets.at(currentSwapChainImageIndex), 0, nullptr);
+    devFuncs->vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineVariants.layout(), 0,
+                                        1, &m_descriptorSets.at(currentFrameIndex), 0, nullptr);
     devFuncs->vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.object, 0, VkIndexType::VK_INDEX_TYPE_UINT32);
 
-    devFuncs->vkCmdDrawIndexed(commandBuffer, m_indices.size(), 1, 0, 0, 0);
+    auto draw = [&, this]{
+        if (gpuCulling()) {
+            // The instance count was written by the cull pass, one mesh never needs more than one command
+            devFuncs->vkCmdDrawIndexedIndirect(commandBuffer, m_instanceCuller.drawCommandBuffer(currentFrameIndex), 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+        } else if (cpuCulling()) {
+            devFuncs->vkCmdDrawIndexed(commandBuffer, m_indices.size(), m_cpuInstanceCuller.visibleCount(), 0, 0, 0);
+        } else {
+            devFuncs->vkCmdDrawIndexed(commandBuffer, m_indices.size(), m_instanceBuffer.count(), 0, 0, 0);
+        }
+    };
+
+    // Both passes share the pipeline layout, so the bindings above stay valid for the second one
+    auto drawVariant = withSampleShading(m_drawVariant, vulkanRenderer()->minSampleShading());
+    if (depthPrepass()) {
+        devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_depthPrepassPipeline);
+        draw();
+        drawVariant.constants[depthEqualConstant] = VK_TRUE;
+    }
+    devFuncs->vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineVariants.pipeline(drawVariant));
+    draw();
 }
 
 void TexPipeline::releaseSwapChainResources()
 {
-    vulkanRenderer()->destroyPipelineWithLayout(m_graphicsPipelineWithLayout);
+    auto *devFuncs = vulkanRenderer()->devFuncs();
+    VkDevice device = vulkanRenderer()->device();
+    devFuncs->vkDestroyPipeline(device, m_occluderPipeline, nullptr);
+    m_occluderPipeline = {};
+    releaseScenePipelines();
+    m_pipelineVariants.destroy();
+    m_instanceCuller.releaseSwapChainResources();
+    m_cpuInstanceCuller.releaseSwapChainResources();
+    m_instanceBuffer.destroy();
     vulkanRenderer()->destroyUniformBuffers(m_fragUniformBuffers);
     vulkanRenderer()->destroyUniformBuffers(m_vertUniformBuffers);
 }
@@ -146,9 +347,14 @@ void TexPipeline::releaseResources()
     auto *devFuncs = vulkanRenderer()->devFuncs();
     VkDevice device = vulkanRenderer()->device();
     VmaAllocator allocator = vulkanRenderer()->allocator();
+    m_instanceCuller.releaseResources();
     devFuncs->vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
     m_descriptorSetLayout = {};
     vulkanRenderer()->destroyShaderModules(m_shaderModules);
+    devFuncs->vkDestroyShaderModule(device, m_depthShaderModule, nullptr);
+    m_depthShaderModule = {};
+    m_occluderIndexBuffer.destroy(allocator);
+    m_occluderVertexBuffer.destroy(allocator);
     m_indexBuffer.destroy(allocator);
     m_vertexBuffer.destroy(allocator);
     devFuncs->vkDestroySampler(device, m_textureSampler, nullptr);
@@ -159,44 +365,69 @@ void TexPipeline::releaseResources()
     m_descriptorSetLayout = {};
 }
 
-PipelineWithLayout TexPipeline::createGraphicsPipeline() const
+CullStats TexPipeline::cullStats() const
+{
+    if (gpuCulling()) {
+        return m_instanceCuller.stats();
+    }
+    return cpuCulling() ? m_cpuInstanceCuller.stats() : CullStats{};
+}
+
+VkPipelineLayout TexPipeline::createPipelineLayout() const
 {
-    qDebug() << "Create graphics pipeline";
+    qDebug() << "Create pipeline layout";
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+    VkPipelineLayout pipelineLayout{};
+    VulkanRenderer::checkVkResult(vulkanRenderer()->devFuncs()->vkCreatePipelineLayout(vulkanRenderer()->device(), &pipelineLayoutInfo, nullptr, &pipelineLayout),
+                                  "failed to create pipeline layout");
+    return pipelineLayout;
+}
+
+GraphicsPipelineDescription TexPipeline::createGraphicsPipelineDescription(const PipelineVariantKey &key) const
+{
+    qDebug() << "Describe graphics pipeline";
+
+    GraphicsPipelineDescription description{};
 
-    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+    description.shaderStages.resize(2);
 
-    VkPipelineShaderStageCreateInfo &vertShaderStageInfo = shaderStages[0];
+    VkPipelineShaderStageCreateInfo &vertShaderStageInfo = description.shaderStages[0];
     vertShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT;
     vertShaderStageInfo.module = m_shaderModules.vert;
     vertShaderStageInfo.pName = "main";
 
-    VkPipelineShaderStageCreateInfo &fragShaderStageInfo = shaderStages[1];
+    VkPipelineShaderStageCreateInfo &fragShaderStageInfo = description.shaderStages[1];
     fragShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module = m_shaderModules.frag;
     fragShaderStageInfo.pName = "main";
 
-    auto bindingDescription = TexVertex::createBindingDescription();
+    description.bindingDescriptions << TexVertex::createBindingDescription() << InstanceData::createBindingDescription();
     auto attributeDescriptions = TexVertex::createAttributeDescriptions();
+    auto instanceAttributeDescriptions = InstanceData::createAttributeDescriptions();
+    std::copy(attributeDescriptions.cbegin(), attributeDescriptions.cend(), std::back_inserter(description.attributeDescriptions));
+    std::copy(instanceAttributeDescriptions.cbegin(), instanceAttributeDescriptions.cend(), std::back_inserter(description.attributeDescriptions));
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    VkPipelineVertexInputStateCreateInfo &vertexInputInfo = description.vertexInputInfo;
     vertexInputInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    VkPipelineInputAssemblyStateCreateInfo &inputAssembly = description.inputAssembly;
     inputAssembly.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssembly.topology = VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    auto *window = vulkanRenderer()->window();
+    auto *surface = vulkanRenderer()->surface();
+    auto swapChainImageSize = surface->swapChainImageSize();
 
-    auto swapChainImageSize = window->swapChainImageSize();
-
-    VkViewport viewport{};
+    VkViewport &viewport = description.viewport;
     viewport.x = 0.0F;
     viewport.y = 0.0F;
     viewport.width = static_cast<float>(swapChainImageSize.width());
@@ -204,16 +435,12 @@ PipelineWithLayout TexPipeline::createGraphicsPipeline() const
     viewport.minDepth = 0.0F;
     viewport.maxDepth = 1.0F;
 
-    VkRect2D scissor = VulkanRenderer::createVkRect2D(swapChainImageSize);
+    description.scissor = VulkanRenderer::createVkRect2D(swapChainImageSize);
 
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    description.viewportState.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    description.dynamicViewport = true;
 
-    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    VkPipelineRasterizationStateCreateInfo &rasterizer = description.rasterizer;
     rasterizer.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizer.depthClampEnable = VK_FALSE;
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
@@ -226,20 +453,23 @@ PipelineWithLayout TexPipeline::createGraphicsPipeline() const
     rasterizer.depthBiasClamp = 0.0F;
     rasterizer.depthBiasSlopeFactor = 0.0F;
 
-    VkPipelineMultisampleStateCreateInfo multisampling{};
+    VkPipelineMultisampleStateCreateInfo &multisampling = description.multisampling;
     multisampling.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_TRUE;
-    multisampling.rasterizationSamples = window->sampleCountFlagBits();
-    multisampling.minSampleShading = 0.2F;
+    auto minSampleShadingPercent = key.constants[minSampleShadingConstant];
+    multisampling.sampleShadingEnable = minSampleShadingPercent > 0 ? VK_TRUE : VK_FALSE;
+    multisampling.rasterizationSamples = vulkanRenderer()->sceneSampleCountFlagBits();
+    multisampling.minSampleShading = static_cast<float>(minSampleShadingPercent) / 100.0F;
     multisampling.pSampleMask = nullptr;
     multisampling.alphaToCoverageEnable = VK_FALSE;
     multisampling.alphaToOneEnable = VK_FALSE;
 
-    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    VkPipelineDepthStencilStateCreateInfo &depthStencil = description.depthStencil;
     depthStencil.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    // After the depth prepass only the nearest fragment of every sample passes, there is nothing left to write
+    auto depthEqual = key.constants[depthEqualConstant] != VK_FALSE;
     depthStencil.depthTestEnable = VK_TRUE;
-    depthStencil.depthWriteEnable = VK_TRUE;
-    depthStencil.depthCompareOp = VkCompareOp::VK_COMPARE_OP_LESS;
+    depthStencil.depthWriteEnable = depthEqual ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = depthEqual ? VkCompareOp::VK_COMPARE_OP_EQUAL : VkCompareOp::VK_COMPARE_OP_LESS;
     depthStencil.depthBoundsTestEnable = VK_FALSE;
     depthStencil.minDepthBounds = 0.0F;
     depthStencil.maxDepthBounds = 1.0F;
@@ -247,7 +477,7 @@ PipelineWithLayout TexPipeline::createGraphicsPipeline() const
     depthStencil.front = {};
     depthStencil.back = {};
 
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    VkPipelineColorBlendAttachmentState &colorBlendAttachment = description.colorBlendAttachment;
     colorBlendAttachment.colorWriteMask =
             VkColorComponentFlags{}
             | VkColorComponentFlagBits::VK_COLOR_COMPONENT_B_BIT
@@ -262,47 +492,63 @@ PipelineWithLayout TexPipeline::createGraphicsPipeline() const
     colorBlendAttachment.dstAlphaBlendFactor = VkBlendFactor::VK_BLEND_FACTOR_ZERO;
     colorBlendAttachment.alphaBlendOp = VkBlendOp::VK_BLEND_OP_ADD;
 
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    VkPipelineColorBlendStateCreateInfo &colorBlending = description.colorBlending;
     colorBlending.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VkLogicOp::VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
     std::fill(std::begin(colorBlending.blendConstants), std::end(colorBlending.blendConstants), 0.0F);
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    description.specialize(key, texVariantConstantCount);
 
-    auto *devFuncs = vulkanRenderer()->devFuncs();
-    VkDevice device = vulkanRenderer()->device();
-    PipelineWithLayout pipelineWithLayout{};
-    VulkanRenderer::checkVkResult(devFuncs->vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineWithLayout.layout),
-                                  "failed to create pipeline layout");
+    description.layout = m_pipelineVariants.layout();
+    description.renderPass = vulkanRenderer()->sceneRenderPass();
+    description.subpass = 0;
+    return description;
+}
 
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = shaderStages.size();
-    pipelineInfo.pStages = shaderStages.data();
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = &depthStencil;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = nullptr;
-    pipelineInfo.layout = pipelineWithLayout.layout;
-    pipelineInfo.renderPass = window->defaultRenderPass();
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.basePipelineIndex = -1;
-    VulkanRenderer::checkVkResult(devFuncs->vkCreateGraphicsPipelines(device, vulkanRenderer()->pipelineCache(), 1, &pipelineInfo, nullptr, &pipelineWithLayout.pipeline),
-                                  "failed to create graphics pipeline");
-    return pipelineWithLayout;
+GraphicsPipelineDescription TexPipeline::createDepthPrepassPipelineDescription() const
+{
+    qDebug() << "Describe depth prepass pipeline";
+
+    // State of the main pass, positions only and without a fragment stage
+    auto description = createGraphicsPipelineDescription(litVariant);
+    description.shaderStages.resize(1);
+    description.shaderStages[0].module = m_depthShaderModule;
+    description.specialize(PipelineVariantKey{}, 0);
+
+    description.attributeDescriptions.clear();
+    description.attributeDescriptions << TexVertex::createAttributeDescriptions().at(0);
+    auto instanceAttributeDescriptions = InstanceData::createAttributeDescriptions();
+    std::copy(instanceAttributeDescriptions.cbegin(), instanceAttributeDescriptions.cend(), std::back_inserter(description.attributeDescriptions));
+
+    // Without a fragment shader there is nothing to shade per sample
+    description.multisampling.sampleShadingEnable = VK_FALSE;
+    description.colorBlendAttachment.colorWriteMask = {};
+    return description;
+}
+
+GraphicsPipelineDescription TexPipeline::createOccluderPipelineDescription() const
+{
+    qDebug() << "Describe occluder pipeline";
+
+    // Vertex stage of the depth prepass at the size of the occluder depth, fed with the proxy positions
+    auto description = createDepthPrepassPipelineDescription();
+    VkVertexInputBindingDescription &occluderBinding = description.bindingDescriptions[0];
+    occluderBinding.stride = sizeof(glm::vec3);
+    description.attributeDescriptions[0].offset = 0;
+
+    auto depthSize = m_instanceCuller.depthSize();
+    description.viewport.width = static_cast<float>(depthSize.width());
+    description.viewport.height = static_cast<float>(depthSize.height());
+    description.scissor = VulkanRenderer::createVkRect2D(depthSize);
+    description.dynamicViewport = false;
+
+    description.multisampling.rasterizationSamples = VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+    description.depthOnly = true;
+
+    description.renderPass = m_instanceCuller.depthRenderPass();
+    description.subpass = 0;
+    return description;
 }
 
 VkDescriptorSetLayout TexPipeline::createDescriptorSetLayout() const
@@ -347,15 +593,15 @@ void TexPipeline::createDescriptorSets(QVector<VkDescriptorSet> &descriptorSets)
     qDebug() << "Create descriptors sets";
     auto *devFuncs = vulkanRenderer()->devFuncs();
     VkDevice device = vulkanRenderer()->device();
-    auto swapChainImageCount = vulkanRenderer()->window()->swapChainImageCount();
-    QVector<VkDescriptorSetLayout> layouts{swapChainImageCount, m_descriptorSetLayout};
+    auto frameCount = vulkanRenderer()->surface()->concurrentFrameCount();
+    QVector<VkDescriptorSetLayout> layouts{frameCount, m_descriptorSetLayout};
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = vulkanRenderer()->descriptorPool();
-    allocInfo.descriptorSetCount = swapChainImageCount;
+    allocInfo.descriptorSetCount = frameCount;
     allocInfo.pSetLayouts = layouts.data();
     descriptorSets.clear();
-    descriptorSets.resize(swapChainImageCount);
+    descriptorSets.resize(frameCount);
     VulkanRenderer::checkVkResult(devFuncs->vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()),
                                   "failed to allocate descriptor sets");
 
@@ -427,56 +673,111 @@ void TexPipeline::createFragUniformBuffers()
 
 void TexPipeline::loadModel()
 {
+    PROFILE_ZONE("TexPipeline::loadModel");
     qDebug() << "Load model";
-    auto model = Model::loadModel(modelDirName, modelName);
+    const auto &modelFile = vulkanRenderer()->renderSettings().modelFile;
+    auto model = modelFile.isEmpty() ? loadCookedModel(AssetPack::instance().data(modelName)) : loadModelFile(modelFile);
     m_vertices.swap(model.vertices);
     m_indices.swap(model.indices);
+    m_boundingSphere = model.boundingSphere;
+    m_occluderVertices.swap(model.occluderVertices);
+    m_occluderIndices.swap(model.occluderIndices);
+    m_cpuInstanceCuller.setModel(model.boundsMin, model.boundsMax, m_occluderVertices, m_occluderIndices);
+}
+
+void TexPipeline::createInstances()
+{
+    const auto &renderSettings = vulkanRenderer()->renderSettings();
+    auto count = renderSettings.instanceCount;
+    auto spacing = renderSettings.instanceSpacing;
+    qDebug() << "Create instances: " << count;
+    // Square grid centered on the origin of the model space
+    auto side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    auto offset = 0.5F * static_cast<float>(side - 1) * spacing;
+    QVector<InstanceData> instances{};
+    instances.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        auto angle = 0.5F * instanceTurn * static_cast<float>(i);
+        InstanceData instance{};
+        instance.rotation = {0.0F, 0.0F, std::sin(angle), std::cos(angle)};
+        instance.positionScale = {static_cast<float>(i % side) * spacing - offset, static_cast<float>(i / side) * spacing - offset, 0.0F, 1.0F};
+        instances << instance;
+    }
+    m_instanceBuffer.setInstances(std::move(instances));
+}
+
+TextureData TexPipeline::loadTexture() const
+{
+    const auto &textureFile = vulkanRenderer()->renderSettings().textureFile;
+    return textureFile.isEmpty() ? loadCookedTexture(AssetPack::instance().data(textureName), textureFormat) : loadTextureFile(textureFile, textureFormat);
 }
 
 void TexPipeline::createTextureImage()
 {
+    PROFILE_ZONE("TexPipeline::createTextureImage");
     qDebug() << "Create texture image";
     BufferWithAllocation stagingBuffer{};
     int texWidth{};
     int texHeight{};
-    auto *window = vulkanRenderer()->window();
+    QVector<CookedTextureLevel> levels{};
+    auto *surface = vulkanRenderer()->surface();
     auto *devFuncs = vulkanRenderer()->devFuncs();
     VkDevice device = vulkanRenderer()->device();
     VmaAllocator allocator = vulkanRenderer()->allocator();
     try {
-        QImage texture = QImage{textureName}
-                .convertToFormat(QImage::Format::Format_RGBA8888);
-        texture.convertToColorSpace(QColorSpace::NamedColorSpace::SRgb);
-        if (texture.isNull()) {
-            throw std::runtime_error{"failed to load texture image"};
-        }
-        VkDeviceSize imageSize = texture.sizeInBytes();
-        texWidth = texture.width();
-        texHeight = texture.height();
-        m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-        stagingBuffer = vulkanRenderer()->createBuffer(imageSize, VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_ONLY);
+        // Decoded in preInitResources, again when the device is recreated without it
+        TextureData texture = m_decodedTexture.levels.isEmpty() ? loadTexture() : std::exchange(m_decodedTexture, TextureData{});
+        VkDeviceSize imageSize = texture.texels.size();
+        texWidth = static_cast<int>(texture.width());
+        texHeight = static_cast<int>(texture.height());
+        // Cooked textures bring their mip chain, the GPU builds it for the others
+        m_mipLevels = texture.hasMipmaps() ? static_cast<uint32_t>(texture.levels.size())
+                                           : static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+        levels = texture.levels;
+
+        stagingBuffer = vulkanRenderer()->createBuffer(imageSize, VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_ONLY,
+                                                       AllocationTag::STAGING);
 
         uint8_t *data{};
         VulkanRenderer::checkVkResult(vmaMapMemory(allocator, stagingBuffer.allocation, reinterpret_cast<void **>(&data)),
                                       "failed to map texture staging buffer memory");
         auto mapGuard = sg::make_scope_guard([&]{ vmaUnmapMemory(allocator, stagingBuffer.allocation); });
-        std::copy_n(texture.constBits(), imageSize, data);
+        std::copy_n(texture.texels.constData(), imageSize, data);
     } catch (...) {
         stagingBuffer.destroy(allocator);
         throw;
     }
 
     auto bufferGuard = sg::make_scope_guard([&, this]{ stagingBuffer.destroy(allocator); });
-    VkImageUsageFlags usage = static_cast<VkImageUsageFlags>(VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
-            | VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_DST_BIT
+    VkImageUsageFlags usage = static_cast<VkImageUsageFlags>(VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_DST_BIT)
             | VkImageUsageFlagBits::VK_IMAGE_USAGE_SAMPLED_BIT;
 
-    m_textureImage = vulkanRenderer()->createImage(texWidth, texHeight, m_mipLevels, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT,
-                                                   textureFormat, VkImageTiling::VK_IMAGE_TILING_OPTIMAL, usage, VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY);
-    vulkanRenderer()->transitionImageLayout(m_textureImage.object, textureFormat, VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_mipLevels);
-    vulkanRenderer()->copyBufferToImage(stagingBuffer.object, m_textureImage.object, texWidth, texHeight);
-    vulkanRenderer()->generateMipmaps(m_textureImage.object, textureFormat, texWidth, texHeight, m_mipLevels);
+    // Copy, mip chain and the transition for sampling go into one submission
+    RenderGraph upload{vulkanRenderer()};
+    if (levels.size() > 1) {
+        m_textureImage = vulkanRenderer()->createImage(texWidth, texHeight, m_mipLevels, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT, textureFormat,
+                                                       VkImageTiling::VK_IMAGE_TILING_OPTIMAL, usage, VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY,
+                                                       AllocationTag::TEXTURE);
+        auto texture = upload.importImage(QStringLiteral("texture"), m_textureImage.object, VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
+        upload.addPass(QStringLiteral("copy texture levels"), [&, this](VkCommandBuffer commandBuffer) {
+            for (int level = 0; level < levels.size(); ++level) {
+                const auto &cookedLevel = levels.at(level);
+                vulkanRenderer()->copyBufferToImage(commandBuffer, stagingBuffer.object, m_textureImage.object, cookedLevel.width, cookedLevel.height,
+                                                    cookedLevel.offset, static_cast<uint32_t>(level));
+            }
+        }).write(texture, RenderGraph::Access::TRANSFER_WRITE, true);
+        upload.exportResource(texture, RenderGraph::Access::FRAGMENT_SAMPLED);
+        upload.submit("upload texture");
+        return;
+    }
+    m_textureImage = vulkanRenderer()->createMipmappedImage(texWidth, texHeight, m_mipLevels, textureFormat, usage, AllocationTag::TEXTURE);
+    auto texture = upload.importImage(QStringLiteral("texture"), m_textureImage.object, VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
+    upload.addPass(QStringLiteral("copy texture"), [&, this](VkCommandBuffer commandBuffer) {
+        vulkanRenderer()->copyBufferToImage(commandBuffer, stagingBuffer.object, m_textureImage.object, texWidth, texHeight);
+    }).write(texture, RenderGraph::Access::TRANSFER_WRITE, 0, true);
+    vulkanRenderer()->addMipmapPasses(upload, texture, textureFormat, texWidth, texHeight, m_mipLevels);
+    upload.exportResource(texture, RenderGraph::Access::FRAGMENT_SAMPLED);
+    upload.submit("upload texture");
 }
 
 void TexPipeline::createTextureSampler()
@@ -2,9 +2,16 @@
 #define TEXPIPELINE_H
 
 #include "abstractpipeline.h"
+#include "cookedasset.h"
+#include "cpuinstanceculler.h"
+#include "instancebuffer.h"
+#include "instanceculler.h"
+#include "pipelinebuilder.h"
+#include "pipelinevariants.h"
 #include "texvertex.h"
 #include "vulkanrenderer.h"
 
+#include <QImage>
 #include <QVector>
 
 class TexVertex;
@@ -14,33 +21,72 @@ class TexPipeline final : public AbstractPipeline
 public:
     explicit TexPipeline(VulkanRenderer *vulkanRenderer);
 
+    [[nodiscard]] const char *name() const override { return "tex pipeline"; }
+
     void preInitResources() override;
     void initResources() override;
+    void describeShaderModules(PipelineBuilder &pipelineBuilder) override;
     void initSwapChainResources() override;
-    [[nodiscard]] DescriptorPoolSizes descriptorPoolSizes(int swapChainImageCount) const override;
-    void updateUniformBuffers(float time, int currentSwapChainImageIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView) const override;
-    void drawCommands(VkCommandBuffer commandBuffer, int currentSwapChainImageIndex) const override;
+    void describePipelines(PipelineBuilder &pipelineBuilder) override;
+    void describeScenePipelines(PipelineBuilder &pipelineBuilder) override;
+    void releaseScenePipelines() override;
+    [[nodiscard]] DescriptorPoolSizes descriptorPoolSizes(int frameCount) const override;
+    void updateScene(float time) override;
+    void updateUniformBuffers(float time, int currentFrameIndex, const glm::mat4 &proj, const glm::mat4 &view, const glm::mat4 &projView) override;
+    void addPasses(RenderGraph &graph) override;
+    void addSceneReads(RenderGraph::PassBuilder &scenePass) const override;
+    void drawCommands(VkCommandBuffer commandBuffer, int currentFrameIndex) const override;
     void releaseSwapChainResources() override;
     void releaseResources() override;
+    [[nodiscard]] CullStats cullStats() const override;
 
 private:
     QVector<TexVertex> m_vertices;
     QVector<uint32_t> m_indices;
     BufferWithAllocation m_vertexBuffer;
     BufferWithAllocation m_indexBuffer;
-    PipelineWithLayout m_graphicsPipelineWithLayout;
+    // Proxy of the mesh kept inside of it, drawn as the occluders of the GPU culler and rasterized by the CPU one
+    QVector<glm::vec3> m_occluderVertices;
+    QVector<uint32_t> m_occluderIndices;
+    BufferWithAllocation m_occluderVertexBuffer;
+    BufferWithAllocation m_occluderIndexBuffer;
+    // Scene node placing the model
+    int m_modelNode;
+    // Model space bounds of the mesh, xyz - center, w - radius
+    glm::vec4 m_boundingSphere;
+    InstanceBuffer m_instanceBuffer;
+    InstanceCuller m_instanceCuller;
+    CpuInstanceCuller m_cpuInstanceCuller;
+    PipelineVariants m_pipelineVariants;
+    PipelineVariantKey m_drawVariant;
+    // Position only, lays down the depth for the equal depth test of the main pass
+    VkPipeline m_depthPrepassPipeline;
+    // Depth only variant drawing the occluder proxies of the instance culler
+    VkPipeline m_occluderPipeline;
     QVector<VkDescriptorSet> m_descriptorSets;
     ShaderModules m_shaderModules;
+    VkShaderModule m_depthShaderModule;
     VkDescriptorSetLayout m_descriptorSetLayout;
     QVector<BufferWithAllocation> m_vertUniformBuffers;
     QVector<BufferWithAllocation> m_fragUniformBuffers;
+    // Decoded while the model loads, moved into the texture image by createTextureImage
+    TextureData m_decodedTexture;
     ObjectWithAllocation<VkImage> m_textureImage;
     VkImageView m_textureImageView;
     VkSampler m_textureSampler;
     uint32_t m_mipLevels;
 
+    [[nodiscard]] bool gpuCulling() const { return vulkanRenderer()->renderSettings().gpuCulling; }
+    [[nodiscard]] bool cpuCulling() const { return !gpuCulling() && vulkanRenderer()->renderSettings().softwareOcclusion; }
+    [[nodiscard]] bool depthPrepass() const { return vulkanRenderer()->renderSettings().depthPrepass; }
     void loadModel();
-    [[nodiscard]] PipelineWithLayout createGraphicsPipeline() const;
+    [[nodiscard]] TextureData loadTexture() const;
+    void createInstances();
+    [[nodiscard]] VkPipelineLayout createPipelineLayout() const;
+    [[nodiscard]] GraphicsPipelineDescription createGraphicsPipelineDescription(const PipelineVariantKey &key) const;
+    [[nodiscard]] GraphicsPipelineDescription createDepthPrepassPipelineDescription() const;
+    [[nodiscard]] GraphicsPipelineDescription createOccluderPipelineDescription() const;
+    void drawOccluders(VkCommandBuffer commandBuffer, int currentFrameIndex, VkBuffer instanceBuffer, VkBuffer drawCommandBuffer) const;
     [[nodiscard]] VkDescriptorSetLayout createDescriptorSetLayout() const;
     void createDescriptorSets(QVector<VkDescriptorSet> &descriptorSets) const;
     void createVertUniformBuffers();
@@ -1,5 +1,6 @@
 #include "utils.h"
 
+#include <QColorSpace>
 #include <QDebug>
 #include <QFile>
 
@@ -20,3 +21,14 @@ const QByteArrayList vulkanLayers{
     }
     return file.readAll();
 }
+
+QImage loadTextureImage(const QString &fileName)
+{
+    QImage texture = QImage{fileName}
+            .convertToFormat(QImage::Format::Format_RGBA8888);
+    texture.convertToColorSpace(QColorSpace::NamedColorSpace::SRgb);
+    if (texture.isNull()) {
+        throw std::runtime_error{"failed to load texture image"};
+    }
+    return texture;
+}
@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <QByteArrayList>
+#include <QImage>
 
 extern const QByteArrayList vulkanLayers;
 
@@ -14,5 +15,7 @@ constexpr bool enableValidationLayers =
 ;
 
 [[nodiscard]] QByteArray readFile(const QString &fileName);
+// Decodes a texture into tightly packed RGBA8888 in the sRGB color space
+[[nodiscard]] QImage loadTextureImage(const QString &fileName);
 
 #endif // UTILS_H
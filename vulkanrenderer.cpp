@@ -4,12 +4,18 @@
 #include "settings.h"
 #include "texpipeline.h"
 #include "colorpipeline.h"
+#include "cpuprofiler.h"
+#include "parallel.h"
+#include "pipelinebuilder.h"
+#include "qualitycalibration.h"
+#include "shaderregistry.h"
 
 #include "externals/scope_guard/scope_guard.hpp"
 
 #include <algorithm>
-#include <chrono>
+#include <cmath>
 #include <string>
+#include <utility>
 
 #include <QDebug>
 #include <QVulkanDeviceFunctions>
@@ -28,15 +34,6 @@ constexpr VkClearDepthStencilValue clearDepthStencil{1.0F, 0};
     return clearValue;
 }
 
-[[noreturn]] void unsupportedLayoutTransition(VkImageLayout oldLayout, VkImageLayout newLayout)
-{
-    std::string message{"unsupported layout transition from: "};
-    message += std::to_string(oldLayout);
-    message += " to: ";
-    message += std::to_string(newLayout);
-    throw std::runtime_error(message);
-}
-
 [[noreturn]] void throwErrorMessage(VkResult actualResult, const char *errorMessage, VkResult expectedResult)
 {
     std::string message{errorMessage};
@@ -52,11 +49,8 @@ constexpr bool hasStencilComponent(VkFormat format)
     return format == VkFormat::VK_FORMAT_D32_SFLOAT_S8_UINT || format == VkFormat::VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-constexpr VkImageAspectFlags evalAspectFlags(VkImageLayout newLayout, VkFormat format)
+constexpr VkImageAspectFlags depthAspectFlags(VkFormat format)
 {
-    if (newLayout != VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        return VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
-    }
     if (!hasStencilComponent(format)) {
         return VkImageAspectFlagBits::VK_IMAGE_ASPECT_DEPTH_BIT;
     }
@@ -74,18 +68,34 @@ constexpr VkBufferCreateInfo createBufferInfo(VkDeviceSize size, VkBufferUsageFl
 }
 }
 
-VulkanRenderer::VulkanRenderer(QVulkanWindow *w)
-    : m_window{w}
-    , m_vkInst{m_window->vulkanInstance()}
+VulkanRenderer::VulkanRenderer(RenderSurface *surface)
+    : VulkanRenderer{surface, Settings::loadRenderSettings()}
+{
+}
+
+VulkanRenderer::VulkanRenderer(RenderSurface *surface, RenderSettings renderSettings)
+    : m_surface{surface}
+    , m_vkInst{m_surface->vulkanInstance()}
     , m_funcs{m_vkInst->functions()}
     , m_physDevice{}
     , m_device{}
     , m_devFuncs{}
     , m_allocator{}
+    , m_memoryBudgetSupported{}
+    , m_frameCounter{}
     , m_pipelineCache{}
     , m_texShaderModules{}
     , m_colorShaderModules{}
     , m_descriptorPool{}
+    , m_renderSettings{std::move(renderSettings)}
+    , m_commandRecorder{this}
+    , m_gpuProfiler{this}
+    , m_sceneTarget{this}
+    , m_mipGenerator{this}
+    , m_resolutionGovernor{m_renderSettings.frameBudgetMs}
+    , m_sceneTargetEnabled{}
+    , m_frameGraph{this}
+    , m_cmdPipelineBarrier2{}
     , m_pipelines{std::make_unique<TexPipeline>(this), std::make_unique<ColorPipeline>(this)}
 {
     qDebug() << "Create vulkan renderer";
@@ -94,14 +104,43 @@ VulkanRenderer::VulkanRenderer(QVulkanWindow *w)
 void VulkanRenderer::preInitResources()
 {
     qDebug() << "preInitResources";
+    if (cpuProfilerEnabled && traceEnabled()) {
+        CpuProfiler::instance().start(&m_trace);
+    }
     qDebug() << "Vulkan version: " << m_vkInst->apiVersion();
-    m_window->setPreferredColorFormats({
+    m_surface->setPreferredColorFormats({
         VkFormat::VK_FORMAT_B8G8R8A8_SRGB,
         VkFormat::VK_FORMAT_B8G8R8A8_UNORM
     });
-    if (auto supportedSampleCounts = m_window->supportedSampleCounts(); !supportedSampleCounts.isEmpty()) {
-        m_window->setSampleCount(supportedSampleCounts.constLast());
+    // Per frame resources follow the frames in flight, not the swap chain images
+    qDebug() << "Frames in flight: " << m_renderSettings.framesInFlight;
+    m_surface->setMaxConcurrentFrameCount(m_renderSettings.framesInFlight);
+    m_supportedSampleCounts = m_surface->supportedSampleCounts();
+    m_resolutionGovernor.reset(startQualityLevel(), m_supportedSampleCounts.isEmpty() ? 1 : m_supportedSampleCounts.constLast());
+    // Scaled scenes are drawn into the scene target, the governor may scale the scene at any time
+    m_sceneTargetEnabled = dynamicResolution() || m_resolutionGovernor.level().scale < 1.0F;
+    // With the scene target it is multisampled instead, the upscale writes every pixel once
+    if (!m_supportedSampleCounts.isEmpty()) {
+        m_surface->setSampleCount(m_sceneTargetEnabled ? 1 : governedSampleCount());
     }
+    // Appended to the extensions requested elsewhere, a recreated device finds its own ones already in the list
+    auto supportedExtensions = m_surface->supportedDeviceExtensions();
+    auto deviceExtensions = m_surface->deviceExtensions();
+    auto enableExtension = [&supportedExtensions, &deviceExtensions](const QByteArray &name) {
+        if (!supportedExtensions.contains(name)) {
+            return false;
+        }
+        if (!deviceExtensions.contains(name)) {
+            deviceExtensions << name;
+        }
+        return true;
+    };
+    m_memoryBudgetSupported = enableExtension(QByteArrayLiteral(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+    // The render graph records its barriers with it when the surface also enables the feature
+    enableExtension(QByteArrayLiteral(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME));
+    m_surface->setDeviceExtensions(deviceExtensions);
+    // Pipelines add their nodes again when the device is recreated
+    m_sceneGraph.clear();
     for (const auto &pipeline : m_pipelines) {
         pipeline->preInitResources();
     }
@@ -109,25 +148,63 @@ void VulkanRenderer::preInitResources()
 
 void VulkanRenderer::initResources()
 {
+    PROFILE_ZONE("initResources");
     qDebug() << "initResources";
-    m_physDevice = m_window->physicalDevice();
-    m_device = m_window->device();
+    m_physDevice = m_surface->physicalDevice();
+    m_device = m_surface->device();
     m_devFuncs = m_vkInst->deviceFunctions(m_device);
+    if (m_surface->synchronization2Enabled()) {
+        m_cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(m_funcs->vkGetDeviceProcAddr(m_device, "vkCmdPipelineBarrier2KHR"));
+    }
+    qDebug() << "Synchronization2: " << (m_cmdPipelineBarrier2 != nullptr);
     m_allocator = createAllocator();
+    m_memoryStats.create(m_allocator, m_memoryBudgetSupported, m_renderSettings.memoryStatsInterval, m_renderSettings.memoryStatsFile);
     m_pipelineCache = createPipelineCache();
+    // The resolution governor is driven by the GPU time of the profiled frames
+    m_gpuProfiler.create(m_surface->concurrentFrameCount(), m_renderSettings.gpuProfiler || dynamicResolution(), traceEnabled() ? &m_trace : nullptr);
+    if (m_renderSettings.secondaryCommandBuffers) {
+        m_commandRecorder.create(m_surface->concurrentFrameCount(), idealWorkerCount(static_cast<int>(m_pipelines.size())));
+    }
+    // The pipelines upload their textures in initResources
+    m_mipGenerator.initResources();
+    PipelineBuilder pipelineBuilder{this};
     for (const auto &pipeline : m_pipelines) {
         pipeline->initResources();
+        pipeline->describeShaderModules(pipelineBuilder);
     }
+    if (m_sceneTargetEnabled) {
+        m_sceneTarget.initResources();
+        m_sceneTarget.describeShaderModules(pipelineBuilder);
+    }
+    pipelineBuilder.build();
 }
 
 void VulkanRenderer::initSwapChainResources()
 {
+    PROFILE_ZONE("initSwapChainResources");
     qDebug() << "initSwapChainResources";
     updateDepthResources();
     m_descriptorPool = createDescriptorPool();
+    // The frame graph imports the images and buffers the pipelines create here
     for (const auto &pipeline : m_pipelines) {
         pipeline->initSwapChainResources();
     }
+    // The images of the scene target are transient images of the frame graph
+    if (m_sceneTargetEnabled) {
+        m_sceneTarget.declareImages(m_frameGraph, governedSampleCount());
+    }
+    buildFrameGraph();
+    m_frameGraph.compile();
+    PipelineBuilder pipelineBuilder{this};
+    // The pipelines of the scene are created for the render pass of the scene target
+    if (m_sceneTargetEnabled) {
+        m_sceneTarget.initSwapChainResources(m_frameGraph);
+        m_sceneTarget.describePipelines(pipelineBuilder);
+    }
+    for (const auto &pipeline : m_pipelines) {
+        pipeline->describePipelines(pipelineBuilder);
+    }
+    pipelineBuilder.build();
 }
 
 void VulkanRenderer::releaseSwapChainResources()
@@ -136,6 +213,8 @@ void VulkanRenderer::releaseSwapChainResources()
     for (const auto &pipeline : m_pipelines) {
         pipeline->releaseSwapChainResources();
     }
+    m_sceneTarget.releaseSwapChainResources();
+    m_frameGraph.clear();
     m_devFuncs->vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
     m_descriptorPool = {};
 }
@@ -146,49 +225,38 @@ void VulkanRenderer::releaseResources()
     for (const auto &pipeline : m_pipelines) {
         pipeline->releaseResources();
     }
+    m_sceneTarget.releaseResources();
+    m_mipGenerator.releaseResources();
     destroyShaderModules(m_texShaderModules);
     destroyShaderModules(m_colorShaderModules);
+    m_commandRecorder.destroy();
+    m_gpuProfiler.destroy();
+    if (traceEnabled()) {
+        CpuProfiler::instance().stop();
+        m_trace.save(m_renderSettings.traceFile);
+    }
     savePipelineCache();
     m_devFuncs->vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
     m_pipelineCache = {};
+    m_memoryStats.destroy();
     vmaDestroyAllocator(m_allocator);
     m_allocator = {};
+    m_cmdPipelineBarrier2 = {};
     m_devFuncs = {};
     m_device = {};
     m_physDevice = {};
 }
 
-ShaderModules VulkanRenderer::createShaderModules(const QString &vertShaderName, const QString &fragShaderName) const
-{
-    ShaderModules shaderModules{};
-    {
-        auto vertShaderCode = readFile(vertShaderName);
-        shaderModules.vert = createShaderModule(vertShaderCode);
-    }
-    try {
-        auto fragShaderCode = readFile(fragShaderName);
-        shaderModules.frag = createShaderModule(fragShaderCode);
-        try {
-            return shaderModules;
-        } catch (...) {
-            m_devFuncs->vkDestroyShaderModule(m_device, shaderModules.frag, nullptr);
-            throw;
-        }
-    } catch (...) {
-        m_devFuncs->vkDestroyShaderModule(m_device, shaderModules.vert, nullptr);
-        throw;
-    }
-}
-
-VkShaderModule VulkanRenderer::createShaderModule(const QByteArray &code) const
+VkShaderModule VulkanRenderer::createShaderModule(const EmbeddedShader &shader) const
 {
-    qDebug() << "create shader module";
+    PROFILE_ZONE("createShaderModule");
+    qDebug() << "create shader module: " << shader.name;
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t *>(code.constData());
+    createInfo.codeSize = shader.size;
+    createInfo.pCode = shader.code;
     VkShaderModule shaderModule{};
-    checkVkResult(m_devFuncs->vkCreateShaderModule(m_window->device(), &createInfo, nullptr, &shaderModule),
+    checkVkResult(m_devFuncs->vkCreateShaderModule(m_surface->device(), &createInfo, nullptr, &shaderModule),
                   "failed to create shader module");
     return shaderModule;
 }
@@ -197,46 +265,256 @@ void VulkanRenderer::createUniformBuffers(QVector<BufferWithAllocation> &buffers
 {
     qDebug() << "Create uniform buffers";
 
-    auto swapChainImageCount = m_window->swapChainImageCount();
+    auto frameCount = m_surface->concurrentFrameCount();
     buffers.clear();
-    buffers.reserve(swapChainImageCount);
-    for (int i = 0; i < swapChainImageCount; ++i) {
-        vmaSetCurrentFrameIndex(m_allocator, i);
-        buffers << createBuffer(size, VkBufferUsageFlagBits::VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_TO_GPU);
+    buffers.reserve(frameCount);
+    for (int i = 0; i < frameCount; ++i) {
+        buffers << createBuffer(size, VkBufferUsageFlagBits::VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_TO_GPU, AllocationTag::UNIFORM);
     }
 }
 
 void VulkanRenderer::startNextFrame()
 {
-    auto currentSwapChainImageIndex = m_window->currentSwapChainImageIndex();
-    vmaSetCurrentFrameIndex(m_allocator, currentSwapChainImageIndex);
-    updateUniformBuffers(currentSwapChainImageIndex);
+    PROFILE_ZONE("startNextFrame");
+    auto currentFrameIndex = m_surface->currentFrame();
+    vmaSetCurrentFrameIndex(m_allocator, static_cast<uint32_t>(++m_frameCounter));
+    VkCommandBuffer commandBuffer = m_surface->currentCommandBuffer();
+    // The sample count the governor picked in an earlier frame, before anything of this one is recorded
+    if (dynamicResolution()) {
+        updateSceneSampleCount();
+    }
+    // Reads back the GPU time of the frame which used this slot before, the resolution may change with it
+    m_gpuProfiler.beginFrame(commandBuffer, currentFrameIndex);
+    if (dynamicResolution()) {
+        updateResolution();
+    }
+    updateUniformBuffers(currentFrameIndex);
+    m_frameGraph.execute(commandBuffer);
+    m_surface->frameReady();
+}
+
+void VulkanRenderer::buildFrameGraph()
+{
+    // The default render pass synchronizes the swap chain image with the presentation engine itself
+    auto output = m_frameGraph.importExternal(QStringLiteral("swap chain image"));
+    m_frameGraph.exportResource(output, RenderGraph::Access::COLOR_ATTACHMENT_WRITE);
+    for (const auto &pipeline : m_pipelines) {
+        pipeline->addPasses(m_frameGraph);
+    }
+    auto scenePass = m_frameGraph.addPass(QStringLiteral("scene"), [this](VkCommandBuffer commandBuffer) { recordScenePass(commandBuffer); });
+    for (const auto &pipeline : m_pipelines) {
+        pipeline->addSceneReads(scenePass);
+    }
+    if (!m_sceneTargetEnabled) {
+        scenePass.write(output, RenderGraph::Access::COLOR_ATTACHMENT_WRITE);
+        return;
+    }
+    m_sceneTarget.addSceneWrites(scenePass);
+    auto upscalePass = m_frameGraph.addPass(QStringLiteral("upscale"), [this](VkCommandBuffer commandBuffer) { recordUpscalePass(commandBuffer); });
+    m_sceneTarget.addUpscaleReads(upscalePass);
+    upscalePass.write(output, RenderGraph::Access::COLOR_ATTACHMENT_WRITE);
+}
+
+void VulkanRenderer::recordScenePass(VkCommandBuffer commandBuffer)
+{
+    auto currentFrameIndex = m_surface->currentFrame();
+    auto sceneSize = this->sceneSize();
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = sceneRenderPass();
+    renderPassInfo.framebuffer = m_sceneTargetEnabled ? m_sceneTarget.framebuffer() : m_surface->currentFramebuffer();
+    renderPassInfo.renderArea = createVkRect2D(sceneSize);
+    auto clearValues = createClearValues();
+    renderPassInfo.clearValueCount = sceneSampleCountFlagBits() > VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
+    renderPassInfo.pClearValues = clearValues.data();
+
+    GpuScope renderPassScope{m_gpuProfiler, commandBuffer, "render pass"};
+    if (m_renderSettings.secondaryCommandBuffers) {
+        m_devFuncs->vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        recordSecondaryDrawCommands(commandBuffer, currentFrameIndex, sceneSize);
+    } else {
+        m_devFuncs->vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_INLINE);
+        setSceneViewport(commandBuffer, sceneSize);
+        for (const auto &pipeline : m_pipelines) {
+            GpuScope pipelineScope{m_gpuProfiler, commandBuffer, pipeline->name()};
+            pipeline->drawCommands(commandBuffer, currentFrameIndex);
+        }
+    }
+    m_devFuncs->vkCmdEndRenderPass(commandBuffer);
+}
+
+void VulkanRenderer::recordUpscalePass(VkCommandBuffer commandBuffer)
+{
+    // A shader pass rather than a blit, the swap chain images of QVulkanWindow can not be transfer destinations
+    GpuScope upscaleScope{m_gpuProfiler, commandBuffer, "upscale"};
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_window->defaultRenderPass();
-    renderPassInfo.framebuffer = m_window->currentFramebuffer();
-    renderPassInfo.renderArea = createVkRect2D(m_window->swapChainImageSize());
+    renderPassInfo.renderPass = m_surface->defaultRenderPass();
+    renderPassInfo.framebuffer = m_surface->currentFramebuffer();
+    renderPassInfo.renderArea = createVkRect2D(m_surface->swapChainImageSize());
     auto clearValues = createClearValues();
-    renderPassInfo.clearValueCount = m_window->sampleCountFlagBits() > VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
+    renderPassInfo.clearValueCount = m_surface->sampleCountFlagBits() > VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
     renderPassInfo.pClearValues = clearValues.data();
-    VkCommandBuffer commandBuffer = m_window->currentCommandBuffer();
     m_devFuncs->vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_INLINE);
+    m_sceneTarget.recordUpscale(commandBuffer, sceneSize());
+    m_devFuncs->vkCmdEndRenderPass(commandBuffer);
+}
+
+void VulkanRenderer::updateResolution()
+{
+    // The scale and the sample shading of a new level apply to this frame, its sample count to the next one
+    if (m_resolutionGovernor.addFrameTime(m_gpuProfiler.lastFrameMs()) && governedSampleCount() != m_sceneTarget.sampleCountFlagBits()) {
+        qDebug() << "Scene sample count with the next frame: " << governedSampleCount();
+    }
+}
+
+void VulkanRenderer::updateSceneSampleCount()
+{
+    auto sampleCount = governedSampleCount();
+    if (sampleCount == m_sceneTarget.sampleCountFlagBits()) {
+        return;
+    }
+    // Only the scene target images, its render pass and the pipelines drawing into it depend on the sample count.
+    // The frames in flight still use them, the governor steps through the sample counts last and rarely.
+    PROFILE_ZONE("VulkanRenderer::updateSceneSampleCount");
+    qDebug() << "Scene sample count: " << m_sceneTarget.sampleCountFlagBits() << " -> " << sampleCount;
+    checkVkResult(m_devFuncs->vkDeviceWaitIdle(m_device), "failed to wait for device idle");
     for (const auto &pipeline : m_pipelines) {
-        pipeline->drawCommands(commandBuffer, currentSwapChainImageIndex);
+        pipeline->releaseScenePipelines();
     }
-    m_devFuncs->vkCmdEndRenderPass(commandBuffer);
-    m_window->frameReady();
-    m_window->requestUpdate();
+    m_sceneTarget.releaseImages();
+    // The transient images live in the frame graph, the passes of the pipelines only import what they own
+    m_frameGraph.clear();
+    m_sceneTarget.declareImages(m_frameGraph, sampleCount);
+    buildFrameGraph();
+    m_frameGraph.compile();
+    m_sceneTarget.initSwapChainResources(m_frameGraph);
+    PipelineBuilder pipelineBuilder{this};
+    for (const auto &pipeline : m_pipelines) {
+        pipeline->describeScenePipelines(pipelineBuilder);
+    }
+    pipelineBuilder.build();
+}
+
+int VulkanRenderer::startQualityLevel() const
+{
+    if (m_renderSettings.qualityLevel >= 0) {
+        return m_renderSettings.qualityLevel;
+    }
+    const auto *properties = m_surface->physicalDeviceProperties();
+    if (properties == nullptr) {
+        return 0;
+    }
+    return std::max(0, Settings::loadQualityLevel(QualityCalibration::deviceKey(*properties), m_renderSettings.frameBudgetMs));
+}
+
+VkSampleCountFlagBits VulkanRenderer::governedSampleCount() const
+{
+    if (m_supportedSampleCounts.isEmpty()) {
+        return VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+    }
+    auto index = std::max(0, static_cast<int>(m_supportedSampleCounts.size()) - 1 - m_resolutionGovernor.level().sampleCountShift);
+    return static_cast<VkSampleCountFlagBits>(m_supportedSampleCounts.at(index));
+}
+
+VkRenderPass VulkanRenderer::sceneRenderPass() const
+{
+    return m_sceneTargetEnabled ? m_sceneTarget.renderPass() : m_surface->defaultRenderPass();
 }
 
-void VulkanRenderer::updateUniformBuffers(int currentSwapChainImageIndex) const
+VkSampleCountFlagBits VulkanRenderer::sceneSampleCountFlagBits() const
 {
-    static auto startTime = std::chrono::high_resolution_clock::now();
+    return m_sceneTargetEnabled ? m_sceneTarget.sampleCountFlagBits() : m_surface->sampleCountFlagBits();
+}
+
+float VulkanRenderer::minSampleShading() const
+{
+    return m_resolutionGovernor.level().minSampleShading;
+}
+
+QVector<float> VulkanRenderer::minSampleShadings() const
+{
+    if (!dynamicResolution()) {
+        return {minSampleShading()};
+    }
+    QVector<float> result{};
+    for (int level = 0; level < ResolutionGovernor::levelCount(); ++level) {
+        auto value = ResolutionGovernor::levelAt(level).minSampleShading;
+        if (!result.contains(value)) {
+            result << value;
+        }
+    }
+    return result;
+}
+
+QSize VulkanRenderer::sceneSize() const
+{
+    auto swapChainImageSize = m_surface->swapChainImageSize();
+    if (!m_sceneTargetEnabled) {
+        return swapChainImageSize;
+    }
+    auto scale = m_resolutionGovernor.level().scale;
+    return {std::max(1, static_cast<int>(std::lround(static_cast<float>(swapChainImageSize.width()) * scale))),
+            std::max(1, static_cast<int>(std::lround(static_cast<float>(swapChainImageSize.height()) * scale)))};
+}
+
+void VulkanRenderer::setSceneViewport(VkCommandBuffer commandBuffer, const QSize &size) const
+{
+    VkViewport viewport{};
+    viewport.x = 0.0F;
+    viewport.y = 0.0F;
+    viewport.width = static_cast<float>(size.width());
+    viewport.height = static_cast<float>(size.height());
+    viewport.minDepth = 0.0F;
+    viewport.maxDepth = 1.0F;
+    m_devFuncs->vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    auto scissor = createVkRect2D(size);
+    m_devFuncs->vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void VulkanRenderer::recordSecondaryDrawCommands(VkCommandBuffer commandBuffer, int currentFrameIndex, const QSize &sceneSize)
+{
+    PROFILE_ZONE("recordSecondaryDrawCommands");
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = sceneRenderPass();
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = m_sceneTargetEnabled ? m_sceneTarget.framebuffer() : m_surface->currentFramebuffer();
 
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+    std::vector<CommandRecorder::RecordTask> tasks{};
+    tasks.reserve(m_pipelines.size());
+    for (const auto &pipeline : m_pipelines) {
+        tasks.emplace_back([this, &pipeline, currentFrameIndex, sceneSize](VkCommandBuffer secondaryCommandBuffer) {
+            // Dynamic state is not inherited from the primary command buffer
+            setSceneViewport(secondaryCommandBuffer, sceneSize);
+            GpuScope pipelineScope{m_gpuProfiler, secondaryCommandBuffer, pipeline->name()};
+            pipeline->drawCommands(secondaryCommandBuffer, currentFrameIndex);
+        });
+    }
+    auto secondaryCommandBuffers = m_commandRecorder.record(m_surface->currentFrame(), inheritanceInfo, tasks);
+    m_devFuncs->vkCmdExecuteCommands(commandBuffer, secondaryCommandBuffers.size(), secondaryCommandBuffers.constData());
+}
+
+CullStats VulkanRenderer::cullStats() const
+{
+    CullStats result{};
+    for (const auto &pipeline : m_pipelines) {
+        auto stats = pipeline->cullStats();
+        result.instances += stats.instances;
+        result.frustumCulled += stats.frustumCulled;
+        result.occluded += stats.occluded;
+        result.drawn += stats.drawn;
+        result.cpuMs += stats.cpuMs;
+    }
+    return result;
+}
+
+void VulkanRenderer::updateUniformBuffers(int currentFrameIndex)
+{
+    PROFILE_ZONE("updateUniformBuffers");
+    float time = m_surface->animationTime();
 
-    auto swapChainImageSize = m_window->swapChainImageSize();
+    auto swapChainImageSize = m_surface->swapChainImageSize();
 
     auto aspect = static_cast<float>(swapChainImageSize.width()) / static_cast<float>(swapChainImageSize.height());
 
@@ -248,21 +526,26 @@ void VulkanRenderer::updateUniformBuffers(int currentSwapChainImageIndex) const
     auto projView{proj * view};
 
     for (const auto &pipeline : m_pipelines) {
-        pipeline->updateUniformBuffers(time, currentSwapChainImageIndex, proj, view, projView);
+        pipeline->updateScene(time);
+    }
+    m_sceneGraph.update();
+
+    for (const auto &pipeline : m_pipelines) {
+        pipeline->updateUniformBuffers(time, currentFrameIndex, proj, view, projView);
     }
 }
 
 VkDescriptorPool VulkanRenderer::createDescriptorPool() const
 {
     qDebug() << "Create descriptor pool";
-    auto swapChainImageCount = m_window->swapChainImageCount();
+    auto frameCount = m_surface->concurrentFrameCount();
 
     uint32_t maxSets{};
     QVector<VkDescriptorPoolSize> poolSizes{};
     {
         QHash<VkDescriptorType, uint32_t> poolSizesDict{};
         for (const auto &pipeline : m_pipelines) {
-            auto poolSizes = pipeline->descriptorPoolSizes(swapChainImageCount);
+            auto poolSizes = pipeline->descriptorPoolSizes(frameCount);
             maxSets += poolSizes.maxSets;
             poolSizesDict.reserve(poolSizes.poolSize.size());
             for (auto iPoolSize = poolSizes.poolSize.cbegin(); iPoolSize != poolSizes.poolSize.cend(); ++iPoolSize) {
@@ -290,8 +573,26 @@ VkDescriptorPool VulkanRenderer::createDescriptorPool() const
     return descriptorPool;
 }
 
-void VulkanRenderer::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) const
+ObjectWithAllocation<VkImage> VulkanRenderer::createMipmappedImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format,
+                                                                  VkImageUsageFlags usage, AllocationTag tag) const
+{
+    // Storage views can not be sRGB, the image gets the linear format and the sampled views reinterpret it
+    if (m_mipGenerator.supports(format, static_cast<int32_t>(width), static_cast<int32_t>(height), mipLevels)) {
+        return createImage(width, height, mipLevels, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT, MipGenerator::storageFormat(format),
+                           VkImageTiling::VK_IMAGE_TILING_OPTIMAL, usage | VkImageUsageFlagBits::VK_IMAGE_USAGE_STORAGE_BIT,
+                           VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY, tag, VkImageCreateFlagBits::VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT);
+    }
+    return createImage(width, height, mipLevels, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT, format, VkImageTiling::VK_IMAGE_TILING_OPTIMAL,
+                       static_cast<VkImageUsageFlags>(VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_SRC_BIT) | VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_DST_BIT | usage,
+                       VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY, tag);
+}
+
+void VulkanRenderer::addMipmapPasses(RenderGraph &graph, RenderGraph::Resource image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
 {
+    if (m_mipGenerator.supports(imageFormat, texWidth, texHeight, mipLevels)) {
+        m_mipGenerator.addPasses(graph, image, imageFormat, texWidth, texHeight, mipLevels);
+        return;
+    }
     qDebug() << "Generate mipmaps for levels: " << mipLevels;
     VkFormatProperties formatProperties{};
     m_funcs->vkGetPhysicalDeviceFormatProperties(m_physDevice, imageFormat, &formatProperties);
@@ -299,98 +600,45 @@ void VulkanRenderer::generateMipmaps(VkImage image, VkFormat imageFormat, int32_
     if ((formatProperties.optimalTilingFeatures & expectedFeatures) != expectedFeatures) {
         throw std::runtime_error{"texture image format does not support linear blitting"};
     }
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-    auto bufferGuard = sg::make_scope_guard([&, this]{ endSingleTimeCommands(commandBuffer); });
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VkStructureType::VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.image = image;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.subresourceRange.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.subresourceRange.levelCount = 1;
-
-    VkImageBlit blit{};
-    blit.srcOffsets[0] = {0, 0, 0};
-    blit.srcSubresource.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
-    blit.srcSubresource.baseArrayLayer = 0;
-    blit.srcSubresource.layerCount = 1;
-    blit.dstOffsets[0] = {0, 0, 0};
-    blit.dstSubresource.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
-    blit.dstSubresource.baseArrayLayer = 0;
-    blit.dstSubresource.layerCount = 1;
 
     int32_t mipWidth = texWidth;
     int32_t mipHeight = texHeight;
-
     for (uint32_t i = 1; i < mipLevels; ++i) {
-        qDebug() << "Generating level: " << i << ", mipWidth: " << mipWidth << ", mipHeight: " << mipHeight;
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_READ_BIT;
-
-        m_devFuncs->vkCmdPipelineBarrier(commandBuffer,
-                                         VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                         VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                         {},
-                                         0, nullptr,
-                                         0, nullptr,
-                                         1, &barrier);
-
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = {0, 0, 0};
         blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+        blit.srcSubresource.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
         blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
         if (mipWidth > 1) {
             mipWidth /= 2;
         }
         if (mipHeight > 1) {
             mipHeight /= 2;
         }
+        blit.dstOffsets[0] = {0, 0, 0};
         blit.dstOffsets[1] = {mipWidth, mipHeight, 1};
+        blit.dstSubresource.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
         blit.dstSubresource.mipLevel = i;
-
-        m_devFuncs->vkCmdBlitImage(commandBuffer,
-                                   image, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                   image, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                   1, &blit,
-                                   VkFilter::VK_FILTER_LINEAR);
-
-        barrier.oldLayout = VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.newLayout = VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = VkAccessFlagBits::VK_ACCESS_SHADER_READ_BIT;
-
-        m_devFuncs->vkCmdPipelineBarrier(commandBuffer,
-                                         VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                         VkPipelineStageFlagBits::VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                         {},
-                                         0, nullptr,
-                                         0, nullptr,
-                                         1, &barrier);
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+
+        // Each level is a pass of its own, the graph puts the barrier between the write of a level and its read
+        graph.addPass(QStringLiteral("mip %1").arg(i), [this, &graph, image, blit](VkCommandBuffer commandBuffer) {
+            VkImage vkImage = graph.image(image);
+            m_devFuncs->vkCmdBlitImage(commandBuffer,
+                                       vkImage, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                       vkImage, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                       1, &blit,
+                                       VkFilter::VK_FILTER_LINEAR);
+        }).read(image, RenderGraph::Access::TRANSFER_READ, i - 1).write(image, RenderGraph::Access::TRANSFER_WRITE, i, true);
     }
-
-    qDebug() << "Generating level: " << mipLevels << ", mipWidth: " << mipWidth << ", mipHeight: " << mipHeight;
-
-    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-    barrier.oldLayout = VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VkAccessFlagBits::VK_ACCESS_SHADER_READ_BIT;
-
-    m_devFuncs->vkCmdPipelineBarrier(commandBuffer,
-                                     VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                     VkPipelineStageFlagBits::VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                     {},
-                                     0, nullptr,
-                                     0, nullptr,
-                                     1, &barrier);
 }
 
-BufferWithAllocation VulkanRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) const
+BufferWithAllocation VulkanRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, AllocationTag tag) const
 {
+    PROFILE_ZONE("createBuffer");
     qDebug() << "Create buffer";
 
     auto bufferInfo = createBufferInfo(size, usage);
@@ -403,12 +651,15 @@ BufferWithAllocation VulkanRenderer::createBuffer(VkDeviceSize size, VkBufferUsa
     result.usage = usage;
     checkVkResult(vmaCreateBuffer(m_allocator, &bufferInfo, &allocationInfo, &result.object, &result.allocation, nullptr),
                   "failed to create buffer with allocation");
+    MemoryStats::registerAllocation(m_allocator, result.allocation, tag);
     return result;
 }
 
 ObjectWithAllocation<VkImage> VulkanRenderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
-                                                          VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage) const
+                                                          VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                                          AllocationTag tag, VkImageCreateFlags flags) const
 {
+    PROFILE_ZONE("createImage");
     qDebug() << "Create image";
 
     VkImageCreateInfo imageInfo{};
@@ -425,7 +676,7 @@ ObjectWithAllocation<VkImage> VulkanRenderer::createImage(uint32_t width, uint32
     imageInfo.usage = usage;
     imageInfo.sharingMode = VkSharingMode::VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.samples = numSamples;
-    imageInfo.flags = {};
+    imageInfo.flags = flags;
 
     VmaAllocationCreateInfo allocationInfo{};
     allocationInfo.usage = memoryUsage;
@@ -433,14 +684,16 @@ ObjectWithAllocation<VkImage> VulkanRenderer::createImage(uint32_t width, uint32
     ObjectWithAllocation<VkImage> result{};
     checkVkResult(vmaCreateImage(m_allocator, &imageInfo, &allocationInfo, &result.object, &result.allocation, nullptr),
                   "failed to create image");
+    MemoryStats::registerAllocation(m_allocator, result.allocation, tag);
     return result;
 }
 
 void VulkanRenderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) const
 {
+    PROFILE_ZONE("copyBuffer");
     qDebug() << "Copy buffer";
 
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands("copy buffer");
     auto bufferGuard = sg::make_scope_guard([&, this]{ endSingleTimeCommands(commandBuffer); });
 
     VkBufferCopy copyRegion{};
@@ -450,87 +703,16 @@ void VulkanRenderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDevice
     m_devFuncs->vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 }
 
-void VulkanRenderer::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) const
-{
-    qDebug() << "Transition image layout";
-
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-    auto bufferGuard = sg::make_scope_guard([&, this]{ endSingleTimeCommands(commandBuffer); });
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VkStructureType::VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-
-    barrier.subresourceRange.aspectMask = evalAspectFlags(newLayout, format);
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = mipLevels;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags sourceStage{};
-    VkPipelineStageFlags destinationStage{};
-
-    switch (oldLayout) {
-    case VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED:
-        barrier.srcAccessMask = {};
-
-        sourceStage = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        switch (newLayout) {
-        case VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-            barrier.dstAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            destinationStage = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            barrier.dstAccessMask = VkAccessFlagBits::VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VkAccessFlagBits::VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-            destinationStage = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-            break;
-        default:
-            unsupportedLayoutTransition(oldLayout, newLayout);
-        }
-        break;
-    case VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-        if (newLayout == VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-            barrier.srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VkAccessFlagBits::VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        } else {
-            unsupportedLayoutTransition(oldLayout, newLayout);
-        }
-        break;
-    default:
-        unsupportedLayoutTransition(oldLayout, newLayout);
-    }
-
-    m_devFuncs->vkCmdPipelineBarrier(
-                commandBuffer,
-                sourceStage, destinationStage,
-                {},
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-}
-
-void VulkanRenderer::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) const
+void VulkanRenderer::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height,
+                                       VkDeviceSize bufferOffset, uint32_t mipLevel) const
 {
     qDebug() << "Copy buffer to image";
-
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-    auto bufferGuard = sg::make_scope_guard([&, this]{ endSingleTimeCommands(commandBuffer); });
-
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = bufferOffset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.mipLevel = mipLevel;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
     region.imageOffset = {0, 0, 0};
@@ -542,10 +724,10 @@ void VulkanRenderer::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t
     m_devFuncs->vkCmdCopyBufferToImage(commandBuffer, buffer, image, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
 
-VkCommandBuffer VulkanRenderer::beginSingleTimeCommands() const
+VkCommandBuffer VulkanRenderer::beginSingleTimeCommands(const char *name) const
 {
     qDebug() << "Begin single time command";
-    VkCommandPool commandPool = m_window->graphicsCommandPool();
+    VkCommandPool commandPool = m_surface->graphicsCommandPool();
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -563,6 +745,7 @@ VkCommandBuffer VulkanRenderer::beginSingleTimeCommands() const
 
         checkVkResult(m_devFuncs->vkBeginCommandBuffer(commandBuffer, &beginInfo),
                       "failed to begin command buffer for copy");
+        m_gpuProfiler.beginUpload(commandBuffer, name);
 
         return commandBuffer;
     } catch (...) {
@@ -574,8 +757,9 @@ VkCommandBuffer VulkanRenderer::beginSingleTimeCommands() const
 void VulkanRenderer::endSingleTimeCommands(VkCommandBuffer commandBuffer) const
 {
     qDebug() << "End single time command";
-    auto bufferGuard = sg::make_scope_guard([&, this]{ m_devFuncs->vkFreeCommandBuffers(m_device, m_window->graphicsCommandPool(), 1, &commandBuffer); });
+    auto bufferGuard = sg::make_scope_guard([&, this]{ m_devFuncs->vkFreeCommandBuffers(m_device, m_surface->graphicsCommandPool(), 1, &commandBuffer); });
 
+    m_gpuProfiler.endUpload(commandBuffer);
     checkVkResult(m_devFuncs->vkEndCommandBuffer(commandBuffer),
                   "failed to end command buffer for copy");
 
@@ -584,14 +768,20 @@ void VulkanRenderer::endSingleTimeCommands(VkCommandBuffer commandBuffer) const
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    VkQueue queue = m_window->graphicsQueue();
+    VkQueue queue = m_surface->graphicsQueue();
     checkVkResult(m_devFuncs->vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE),
                   "failed to submit command buffer for copy");
     checkVkResult(m_devFuncs->vkQueueWaitIdle(queue),
                   "failed to wait queue for copy");
+    m_gpuProfiler.collectUpload();
 }
 
 VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, uint32_t mipLevels) const
+{
+    return createImageView(image, format, VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels);
+}
+
+VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t baseMipLevel, uint32_t mipLevels) const
 {
     qDebug() << "Create image view";
     VkImageViewCreateInfo viewInfo{};
@@ -599,8 +789,8 @@ VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, uint
     viewInfo.image = image;
     viewInfo.viewType = VkImageViewType::VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format = format;
-    viewInfo.subresourceRange.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.aspectMask = aspectMask;
+    viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
     viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
@@ -614,27 +804,33 @@ VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, uint
 void VulkanRenderer::updateDepthResources() const
 {
     qDebug() << "Update depth resources";
-    transitionImageLayout(m_window->depthStencilImage(), m_window->depthStencilFormat(),
-                          VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED, VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+    RenderGraph graph{this};
+    auto depthStencil = graph.importImage(QStringLiteral("depth stencil"), m_surface->depthStencilImage(),
+                                          depthAspectFlags(m_surface->depthStencilFormat()), 1);
+    graph.exportResource(depthStencil, RenderGraph::Access::DEPTH_ATTACHMENT_WRITE);
+    graph.submit("depth stencil layout");
 }
 
 VkPipelineCache VulkanRenderer::createPipelineCache() const
+{
+    return createPipelineCache(Settings::loadPipelineCache(ShaderRegistry::combinedHash()));
+}
+
+VkPipelineCache VulkanRenderer::createPipelineCache(const QByteArray &initialData) const
 {
     qDebug() << "Create pipeline cache";
-    auto pipelineCacheData = Settings::loadPipelineCache();
     VkPipelineCacheCreateInfo pipelineCacheInfo{};
     pipelineCacheInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    pipelineCacheInfo.initialDataSize = pipelineCacheData.size();
-    pipelineCacheInfo.pInitialData = pipelineCacheData.constData();
+    pipelineCacheInfo.initialDataSize = initialData.size();
+    pipelineCacheInfo.pInitialData = initialData.constData();
     VkPipelineCache pipelineCache{};
     checkVkResult(m_devFuncs->vkCreatePipelineCache(m_device, &pipelineCacheInfo, nullptr, &pipelineCache),
                   "failed to create pipeline cache");
     return pipelineCache;
 }
 
-void VulkanRenderer::savePipelineCache() const
+QByteArray VulkanRenderer::pipelineCacheData() const
 {
-    qDebug() << "Save pipeline cache";
     std::size_t dataSize{};
     checkVkResult(m_devFuncs->vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr),
                   "failed to get pipeline cache data size");
@@ -642,27 +838,52 @@ void VulkanRenderer::savePipelineCache() const
     checkVkResult(m_devFuncs->vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, pipelineCacheData.data()),
                   "failed to get pipeline cache data");
     pipelineCacheData.resize(static_cast<int>(dataSize));
-    Settings::savePipelineCache(pipelineCacheData);
+    return pipelineCacheData;
+}
+
+void VulkanRenderer::savePipelineCache() const
+{
+    qDebug() << "Save pipeline cache";
+    Settings::savePipelineCache(pipelineCacheData(), ShaderRegistry::combinedHash());
 }
 
 void VulkanRenderer::destroyUniformBuffers(QVector<BufferWithAllocation> &buffers) const
 {
     qDebug() << "Destroy buffers";
-    int i = 0;
     for (auto &buffer : buffers) {
-        vmaSetCurrentFrameIndex(m_allocator, i);
-        ++i;
         buffer.destroy(m_allocator);
     }
     buffers.clear();
 }
 
-void VulkanRenderer::destroyPipelineWithLayout(PipelineWithLayout &pipelineWithLayout) const
+VkPipeline VulkanRenderer::createGraphicsPipeline(GraphicsPipelineDescription &description) const
 {
-    qDebug() << "Destroy pipeline with layout";
-    m_devFuncs->vkDestroyPipeline(m_device, pipelineWithLayout.pipeline, nullptr);
-    m_devFuncs->vkDestroyPipelineLayout(m_device, pipelineWithLayout.layout, nullptr);
-    pipelineWithLayout = {};
+    PROFILE_ZONE("createGraphicsPipeline");
+    qDebug() << "Create graphics pipeline";
+    QMutexLocker locker{&m_pipelineCacheMutex};
+    auto pipelineInfo = description.createInfo();
+    VkPipeline pipeline{};
+    checkVkResult(m_devFuncs->vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline),
+                  "failed to create graphics pipeline");
+    return pipeline;
+}
+
+VkPipeline VulkanRenderer::createComputePipeline(VkShaderModule shaderModule, VkPipelineLayout pipelineLayout) const
+{
+    PROFILE_ZONE("createComputePipeline");
+    qDebug() << "Create compute pipeline";
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    QMutexLocker locker{&m_pipelineCacheMutex};
+    VkPipeline pipeline{};
+    checkVkResult(m_devFuncs->vkCreateComputePipelines(m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline),
+                  "failed to create compute pipeline");
+    return pipeline;
 }
 
 void VulkanRenderer::destroyShaderModules(ShaderModules &shaderModules) const
@@ -731,6 +952,9 @@ VmaAllocator VulkanRenderer::createAllocator() const
     allocatorInfo.device = m_device;
     allocatorInfo.instance = m_vkInst->vkInstance();
     allocatorInfo.pVulkanFunctions = &vulkanFunctions;
+    if (m_memoryBudgetSupported) {
+        allocatorInfo.flags |= VmaAllocatorCreateFlagBits::VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
 
     VmaAllocator allocator{};
     checkVkResult(vmaCreateAllocator(&allocatorInfo, &allocator),
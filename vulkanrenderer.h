@@ -1,17 +1,26 @@
 #ifndef VULKANRENDERER_H
 #define VULKANRENDERER_H
 
+#include <QMutex>
 #include <QVulkanWindowRenderer>
 #include "vkmemalloc.h"
 
 #include "abstractpipeline.h"
+#include "chrometrace.h"
+#include "commandrecorder.h"
+#include "gpuprofiler.h"
+#include "memorystats.h"
+#include "mipgenerator.h"
 #include "objectwithallocation.h"
+#include "rendergraph.h"
+#include "rendersurface.h"
+#include "resolutiongovernor.h"
+#include "scenegraph.h"
+#include "scenetarget.h"
+#include "settings.h"
 
-struct PipelineWithLayout
-{
-    VkPipelineLayout layout;
-    VkPipeline pipeline;
-};
+struct EmbeddedShader;
+struct GraphicsPipelineDescription;
 
 struct ShaderModules
 {
@@ -22,7 +31,8 @@ struct ShaderModules
 class VulkanRenderer final : public QVulkanWindowRenderer
 {
 public:
-    explicit VulkanRenderer(QVulkanWindow *w);
+    explicit VulkanRenderer(RenderSurface *surface);
+    VulkanRenderer(RenderSurface *surface, RenderSettings renderSettings);
 
     void startNextFrame() override;    
     void preInitResources() override;
@@ -41,53 +51,106 @@ public:
     [[nodiscard]] BufferWithAllocation createIndexBuffer(const std::array<T, Size> &indices) const;
     static void checkVkResult(VkResult actualResult, const char *errorMessage, VkResult expectedResult = VkResult::VK_SUCCESS);
     [[nodiscard]] static VkRect2D createVkRect2D(const QSize &rect);
-    [[nodiscard]] ShaderModules createShaderModules(const QString &vertShaderName, const QString &fragShaderName) const;
+    [[nodiscard]] VkShaderModule createShaderModule(const EmbeddedShader &shader) const;
+    [[nodiscard]] VkPipelineCache createPipelineCache(const QByteArray &initialData) const;
+    [[nodiscard]] QByteArray pipelineCacheData() const;
     void destroyShaderModules(ShaderModules &shaderModules) const;
-    void destroyPipelineWithLayout(PipelineWithLayout &pipelineWithLayout) const;
+    [[nodiscard]] VkPipeline createGraphicsPipeline(GraphicsPipelineDescription &description) const;
+    [[nodiscard]] VkPipeline createComputePipeline(VkShaderModule shaderModule, VkPipelineLayout pipelineLayout) const;
     template<typename T>
     void createUniformBuffers(QVector<BufferWithAllocation> &buffers) const { createUniformBuffers(buffers, sizeof(T)); }
     void destroyUniformBuffers(QVector<BufferWithAllocation> &buffers) const;
-    [[nodiscard]] BufferWithAllocation createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) const;
+    [[nodiscard]] BufferWithAllocation createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, AllocationTag tag) const;
     [[nodiscard]] ObjectWithAllocation<VkImage> createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
-                                                  VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage) const;
-    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) const;
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) const;
-    void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) const;
+                                                  VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                                  AllocationTag tag, VkImageCreateFlags flags = {}) const;
+    // Image for addMipmapPasses, prepared for the compute downsampler when it can build the mip chain
+    [[nodiscard]] ObjectWithAllocation<VkImage> createMipmappedImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format,
+                                                                     VkImageUsageFlags usage, AllocationTag tag) const;
+    void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height,
+                           VkDeviceSize bufferOffset = 0, uint32_t mipLevel = 0) const;
+    // Builds every level of the image from level 0, which has to be written by an earlier pass. One compute dispatch
+    // for images created by createMipmappedImage when the downsampler supports them, a blit per level otherwise.
+    void addMipmapPasses(RenderGraph &graph, RenderGraph::Resource image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+    [[nodiscard]] VkCommandBuffer beginSingleTimeCommands(const char *name) const;
+    void endSingleTimeCommands(VkCommandBuffer commandBuffer) const;
     [[nodiscard]] VkImageView createImageView(VkImage image, VkFormat format, uint32_t mipLevels) const;
+    [[nodiscard]] VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t baseMipLevel, uint32_t mipLevels) const;
 
     [[nodiscard]] VmaAllocator allocator() const { return m_allocator; }
     [[nodiscard]] QVulkanDeviceFunctions *devFuncs() const { return m_devFuncs; }
     [[nodiscard]] VkDevice device() const { return m_device; }
-    [[nodiscard]] QVulkanWindow *window() const { return m_window; }
+    [[nodiscard]] RenderSurface *surface() const { return m_surface; }
     [[nodiscard]] VkPipelineCache pipelineCache() const { return m_pipelineCache; }
     [[nodiscard]] VkDescriptorPool descriptorPool() const { return m_descriptorPool; }
+    [[nodiscard]] const RenderSettings &renderSettings() const { return m_renderSettings; }
+    // Takes effect with the next recorded frame, the pipelines of both modes are created up front
+    void setDepthPrepass(bool depthPrepass) { m_renderSettings.depthPrepass = depthPrepass; }
+    [[nodiscard]] VkDeviceSize allocatedBytes() const { return m_memoryStats.allocatedBytes(); }
+    [[nodiscard]] GpuProfiler &gpuProfiler() const { return m_gpuProfiler; }
+    [[nodiscard]] CullStats cullStats() const;
+    [[nodiscard]] SceneGraph &sceneGraph() { return m_sceneGraph; }
+    [[nodiscard]] const SceneGraph &sceneGraph() const { return m_sceneGraph; }
+    [[nodiscard]] uint64_t frameCounter() const { return m_frameCounter; }
+    // Null unless the device was created with synchronization2
+    [[nodiscard]] PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2() const { return m_cmdPipelineBarrier2; }
+
+    // The scene is drawn into the scene target when it is scaled and into the default render pass otherwise
+    [[nodiscard]] bool dynamicResolution() const { return m_renderSettings.dynamicResolution; }
+    [[nodiscard]] VkRenderPass sceneRenderPass() const;
+    [[nodiscard]] VkSampleCountFlagBits sceneSampleCountFlagBits() const;
+    [[nodiscard]] float minSampleShading() const;
+    // Every value minSampleShading() takes until the swap chain resources are recreated, the pipelines of the scene
+    // create a variant for each up front, so the governor never waits for a pipeline in the frames it measures
+    [[nodiscard]] QVector<float> minSampleShadings() const;
+    // Part of the swap chain image size the scene is drawn at, pipelines of the scene set their viewport dynamically
+    [[nodiscard]] QSize sceneSize() const;
 
 private:
     std::array<std::unique_ptr<AbstractPipeline>, 2> m_pipelines;
-    QVulkanWindow *const m_window;
+    RenderSurface *const m_surface;
     QVulkanInstance *const m_vkInst;
     QVulkanFunctions *const m_funcs;
     VkPhysicalDevice m_physDevice;
     VkDevice m_device;
     QVulkanDeviceFunctions *m_devFuncs;
     VmaAllocator m_allocator;
+    bool m_memoryBudgetSupported;
+    // Frames started since construction, per frame resources are indexed by the frame slot of the surface instead
+    uint64_t m_frameCounter;
+    MemoryStats m_memoryStats;
 
     VkPipelineCache m_pipelineCache;
+    mutable QMutex m_pipelineCacheMutex;
 
     ShaderModules m_texShaderModules;
     ShaderModules m_colorShaderModules;
 
     VkDescriptorPool m_descriptorPool;
 
-    [[nodiscard]] VkShaderModule createShaderModule(const QByteArray &code) const;
-
+    RenderSettings m_renderSettings;
+    CommandRecorder m_commandRecorder;
+    // Upload scopes are recorded from const helpers
+    mutable GpuProfiler m_gpuProfiler;
+    ChromeTrace m_trace;
+    SceneGraph m_sceneGraph;
+    SceneTarget m_sceneTarget;
+    MipGenerator m_mipGenerator;
+    ResolutionGovernor m_resolutionGovernor;
+    QVector<int> m_supportedSampleCounts;
+    bool m_sceneTargetEnabled;
+    // Built for every swap chain, replayed by every frame
+    RenderGraph m_frameGraph;
+    PFN_vkCmdPipelineBarrier2KHR m_cmdPipelineBarrier2;
+
+    [[nodiscard]] bool traceEnabled() const { return !m_renderSettings.traceFile.isEmpty(); }
     void savePipelineCache() const;
     [[nodiscard]] VkPipelineCache createPipelineCache() const;
 
     [[nodiscard]] VkDescriptorPool createDescriptorPool() const;
 
     template<typename T, typename Iterator>
-    [[nodiscard]] BufferWithAllocation createBuffer(Iterator begin, Iterator end, VkBufferUsageFlags usage) const;
+    [[nodiscard]] BufferWithAllocation createBuffer(Iterator begin, Iterator end, VkBufferUsageFlags usage, AllocationTag tag) const;
 
     void createUniformBuffers(QVector<BufferWithAllocation> &buffers, std::size_t size) const;
 
@@ -95,10 +158,16 @@ private:
 
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) const;
 
-    [[nodiscard]] VkCommandBuffer beginSingleTimeCommands() const;
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer) const;
-
-    void updateUniformBuffers(int currentSwapChainImageIndex) const;
+    void updateUniformBuffers(int currentFrameIndex);
+    void updateResolution();
+    void updateSceneSampleCount();
+    void buildFrameGraph();
+    void recordScenePass(VkCommandBuffer commandBuffer);
+    void recordUpscalePass(VkCommandBuffer commandBuffer);
+    [[nodiscard]] int startQualityLevel() const;
+    [[nodiscard]] VkSampleCountFlagBits governedSampleCount() const;
+    void setSceneViewport(VkCommandBuffer commandBuffer, const QSize &size) const;
+    void recordSecondaryDrawCommands(VkCommandBuffer commandBuffer, int currentFrameIndex, const QSize &sceneSize);
     [[nodiscard]] VmaAllocator createAllocator() const;
 };
 
@@ -12,7 +12,7 @@ BufferWithAllocation VulkanRenderer::createVertexBuffer(const QVector<T> &vertic
 {
     qDebug() << "Create vertex buffer";
 
-    return createBuffer<T>(vertices.cbegin(), vertices.cend(), VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    return createBuffer<T>(vertices.cbegin(), vertices.cend(), VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, AllocationTag::VERTEX);
 }
 
 template<typename T>
@@ -20,7 +20,7 @@ BufferWithAllocation VulkanRenderer::createIndexBuffer(const QVector<T> &indices
 {
     qDebug() << "Create index buffer";
 
-    return createBuffer<T>(indices.cbegin(), indices.cend(), VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    return createBuffer<T>(indices.cbegin(), indices.cend(), VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDEX_BUFFER_BIT, AllocationTag::INDEX);
 }
 
 template<typename T, std::size_t Size>
@@ -28,7 +28,7 @@ BufferWithAllocation VulkanRenderer::createVertexBuffer(const std::array<T, Size
 {
     qDebug() << "Create vertex buffer";
 
-    return createBuffer<T>(vertices.cbegin(), vertices.cend(), VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    return createBuffer<T>(vertices.cbegin(), vertices.cend(), VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, AllocationTag::VERTEX);
 }
 
 template<typename T, std::size_t Size>
@@ -36,17 +36,17 @@ BufferWithAllocation VulkanRenderer::createIndexBuffer(const std::array<T, Size>
 {
     qDebug() << "Create index buffer";
 
-    return createBuffer<T>(indices.cbegin(), indices.cend(), VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    return createBuffer<T>(indices.cbegin(), indices.cend(), VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDEX_BUFFER_BIT, AllocationTag::INDEX);
 }
 
 template<typename T, typename Iterator>
-BufferWithAllocation VulkanRenderer::createBuffer(Iterator begin, Iterator end, VkBufferUsageFlags usage) const
+BufferWithAllocation VulkanRenderer::createBuffer(Iterator begin, Iterator end, VkBufferUsageFlags usage, AllocationTag tag) const
 {
     qDebug() << "Create buffer";
 
     VkDeviceSize bufferSize = std::distance(begin, end) * sizeof(T);
 
-    auto stagingBuffer = createBuffer(bufferSize, VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_ONLY);
+    auto stagingBuffer = createBuffer(bufferSize, VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_ONLY, AllocationTag::STAGING);
     auto bufferGuard = sg::make_scope_guard([&, this]{ stagingBuffer.destroy(m_allocator); });
 
     T *data{};
@@ -58,7 +58,7 @@ BufferWithAllocation VulkanRenderer::createBuffer(Iterator begin, Iterator end,
     }
 
     auto deviceBuffer = createBuffer(bufferSize, VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
-                                                 VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY);
+                                                 VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY, tag);
     try {
         copyBuffer(stagingBuffer.object, deviceBuffer.object, bufferSize);
 
@@ -70,6 +70,7 @@ BufferWithAllocation VulkanRenderer::createBuffer(Iterator begin, Iterator end,
 }
 
 template BufferWithAllocation VulkanRenderer::createVertexBuffer(const QVector<TexVertex> &vertices) const;
+template BufferWithAllocation VulkanRenderer::createVertexBuffer(const QVector<glm::vec3> &vertices) const;
 template BufferWithAllocation VulkanRenderer::createIndexBuffer(const QVector<uint32_t> &indices) const;
 template BufferWithAllocation VulkanRenderer::createVertexBuffer(const std::array<ColorVertex, 14> &vertices) const;
 template BufferWithAllocation VulkanRenderer::createIndexBuffer(const std::array<uint16_t, 72> &indices) const;
@@ -0,0 +1,79 @@
+#include "windowsurface.h"
+
+#include "framescheduler.h"
+
+WindowSurface::WindowSurface(QVulkanWindow *window, FrameScheduler *frameScheduler)
+    : m_window{window}
+    , m_frameScheduler{frameScheduler}
+    , m_deviceExtensions{}
+    , m_synchronization2Features{}
+    , m_synchronization2Enabled{}
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+    m_window->setEnabledFeaturesModifier(QVulkanWindow::EnabledFeatures2Modifier{[this](VkPhysicalDeviceFeatures2 &features) {
+        modifyEnabledFeatures(features);
+    }});
+#endif
+}
+
+void WindowSurface::setDeviceExtensions(const QByteArrayList &extensions)
+{
+    m_deviceExtensions = extensions;
+    m_window->setDeviceExtensions(extensions);
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+void WindowSurface::modifyEnabledFeatures(VkPhysicalDeviceFeatures2 &features)
+{
+    // Called for every device QVulkanWindow creates, the physical device is already picked
+    m_synchronization2Enabled = false;
+    m_synchronization2Features = {};
+    m_synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    const auto *properties = m_window->physicalDeviceProperties();
+    auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+                m_window->vulkanInstance()->getInstanceProcAddr("vkGetPhysicalDeviceFeatures2"));
+    if (properties == nullptr || properties->apiVersion < VK_API_VERSION_1_1 || getPhysicalDeviceFeatures2 == nullptr) {
+        return;
+    }
+    VkPhysicalDeviceFeatures2 supportedFeatures{};
+    supportedFeatures.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &m_synchronization2Features;
+    getPhysicalDeviceFeatures2(m_window->physicalDevice(), &supportedFeatures);
+    m_synchronization2Features.pNext = nullptr;
+
+    // Same core features QVulkanWindow enables without a modifier
+    features.features = supportedFeatures.features;
+    features.features.robustBufferAccess = VK_FALSE;
+
+    // Enabling the extension does not enable the feature, it has to be requested through the feature struct
+    if (!m_deviceExtensions.contains(QByteArrayLiteral(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME))
+            || m_synchronization2Features.synchronization2 != VK_TRUE) {
+        return;
+    }
+    // The Vulkan 1.3 feature struct, when chained, must carry the feature itself instead of the KHR struct
+    auto **next = reinterpret_cast<VkBaseOutStructure **>(&features.pNext);
+    while (*next != nullptr) {
+#ifdef VK_VERSION_1_3
+        if ((*next)->sType == VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES) {
+            reinterpret_cast<VkPhysicalDeviceVulkan13Features *>(*next)->synchronization2 = VK_TRUE;
+            m_synchronization2Enabled = true;
+            return;
+        }
+#endif
+        next = &(*next)->pNext;
+    }
+    *next = reinterpret_cast<VkBaseOutStructure *>(&m_synchronization2Features);
+    m_synchronization2Enabled = true;
+}
+#endif
+
+float WindowSurface::animationTime() const
+{
+    return m_frameScheduler->animationTime();
+}
+
+void WindowSurface::frameReady()
+{
+    m_window->frameReady();
+    m_frameScheduler->frameRendered();
+}
@@ -0,0 +1,63 @@
+#ifndef WINDOWSURFACE_H
+#define WINDOWSURFACE_H
+
+#include "rendersurface.h"
+
+#include <QVulkanWindow>
+
+class FrameScheduler;
+
+class WindowSurface final : public RenderSurface
+{
+public:
+    WindowSurface(QVulkanWindow *window, FrameScheduler *frameScheduler);
+
+    [[nodiscard]] QVulkanInfoVector<QVulkanExtension> supportedDeviceExtensions() override { return m_window->supportedDeviceExtensions(); }
+    // QVulkanWindow does not return the list it was given
+    [[nodiscard]] QByteArrayList deviceExtensions() const override { return m_deviceExtensions; }
+    void setDeviceExtensions(const QByteArrayList &extensions) override;
+    [[nodiscard]] QVector<int> supportedSampleCounts() override { return m_window->supportedSampleCounts(); }
+    void setSampleCount(int sampleCount) override { m_window->setSampleCount(sampleCount); }
+    void setPreferredColorFormats(const QVector<VkFormat> &formats) override { m_window->setPreferredColorFormats(formats); }
+    void setMaxConcurrentFrameCount(int count) override { m_window->setMaxConcurrentFrameCount(count); }
+
+    [[nodiscard]] QVulkanInstance *vulkanInstance() const override { return m_window->vulkanInstance(); }
+    [[nodiscard]] VkPhysicalDevice physicalDevice() const override { return m_window->physicalDevice(); }
+    [[nodiscard]] const VkPhysicalDeviceProperties *physicalDeviceProperties() const override { return m_window->physicalDeviceProperties(); }
+    [[nodiscard]] VkDevice device() const override { return m_window->device(); }
+    [[nodiscard]] VkQueue graphicsQueue() const override { return m_window->graphicsQueue(); }
+    [[nodiscard]] uint32_t graphicsQueueFamilyIndex() const override { return m_window->graphicsQueueFamilyIndex(); }
+    [[nodiscard]] VkCommandPool graphicsCommandPool() const override { return m_window->graphicsCommandPool(); }
+    [[nodiscard]] VkRenderPass defaultRenderPass() const override { return m_window->defaultRenderPass(); }
+    [[nodiscard]] VkFormat colorFormat() const override { return m_window->colorFormat(); }
+    [[nodiscard]] VkFormat depthStencilFormat() const override { return m_window->depthStencilFormat(); }
+    [[nodiscard]] VkSampleCountFlagBits sampleCountFlagBits() const override { return m_window->sampleCountFlagBits(); }
+    [[nodiscard]] int concurrentFrameCount() const override { return m_window->concurrentFrameCount(); }
+    // Chained through the enabled features modifier, which QVulkanWindow offers for VkPhysicalDeviceFeatures2 since Qt 6.7
+    [[nodiscard]] bool synchronization2Enabled() const override { return m_synchronization2Enabled; }
+
+    [[nodiscard]] QSize swapChainImageSize() const override { return m_window->swapChainImageSize(); }
+    [[nodiscard]] int swapChainImageCount() const override { return m_window->swapChainImageCount(); }
+    [[nodiscard]] VkImage depthStencilImage() const override { return m_window->depthStencilImage(); }
+
+    [[nodiscard]] int currentFrame() const override { return m_window->currentFrame(); }
+    [[nodiscard]] int currentSwapChainImageIndex() const override { return m_window->currentSwapChainImageIndex(); }
+    [[nodiscard]] VkCommandBuffer currentCommandBuffer() const override { return m_window->currentCommandBuffer(); }
+    [[nodiscard]] VkFramebuffer currentFramebuffer() const override { return m_window->currentFramebuffer(); }
+    [[nodiscard]] float animationTime() const override;
+    void frameReady() override;
+
+private:
+    QVulkanWindow *const m_window;
+    FrameScheduler *const m_frameScheduler;
+    QByteArrayList m_deviceExtensions;
+    // Referenced by the device create info, so it has to outlive the modifier call
+    VkPhysicalDeviceSynchronization2FeaturesKHR m_synchronization2Features;
+    bool m_synchronization2Enabled;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+    void modifyEnabledFeatures(VkPhysicalDeviceFeatures2 &features);
+#endif
+};
+
+#endif // WINDOWSURFACE_H